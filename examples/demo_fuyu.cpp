@@ -26,6 +26,7 @@ int main(int argc, char **argv) {
     auto processor = FuyuProcessor(vocab_path);
 
     FuyuConfig config(tokens_limit, "8B");
+    config.top_k = 1; // greedy decoding only needs the best token
     auto model = FuyuModel(config);
     model.load(model_path);
 
@@ -50,9 +51,8 @@ int main(int argc, char **argv) {
         std::cout << "[A] " << std::flush;
         for (int step = 0; step < 20; step++) {
             auto result = model({input_tensors[0], input_tensors[1], input_tensors[2]});
-            auto outputs = processor.detokenize(result[0]);
-            auto out_string = outputs.first;
-            auto out_token = outputs.second;
+            auto out_token = topKToken(result[0]);
+            auto out_string = processor.detokenize({out_token});
             if (out_token == 71013) {
                 break;
             }
@@ -32,6 +32,7 @@ int main(int argc, char **argv) {
     auto tokenizer = GemmaTokenizer(vocab_path);
 
     GemmaConfig config(tokens_limit, "2B", RoPEType::HFHUBROPE);
+    config.top_k = 1;
     auto model = GemmaForCausalLM(config);
     model.load(model_path);
 
@@ -47,9 +48,9 @@ int main(int argc, char **argv) {
         std::cout << "[A] " << std::flush;
         for (int step = 0; step < 100; step++) {
             auto result = model({input_tensor});
-            auto outputs = tokenizer.detokenize(result[0]);
-            auto out_string = outputs.first;
-            auto out_token = outputs.second;
+            // the lm_head returns the best token only (top_k = 1)
+            auto out_token = topKToken(result[0]);
+            auto out_string = tokenizer.detokenize({out_token});
             if (out_token == tokenizer.eos_id && step != 0) break;
             std::cout << out_string << std::flush;
             chatPostProcessing(out_token, input_tensor, {});
@@ -7,6 +7,8 @@
 #include "models/llama/modeling_llama.hpp"
 #include "models/llama/tokenization_llama.hpp"
 #include "processor/PostProcess.hpp"
+#include "Grammar.hpp"
+#include "backends/cpu/compute/Parallel.hpp"
 
 using namespace mllm;
 
@@ -16,16 +18,55 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("model", 'm', "specify mllm model path", false, "../models/llama-2-7b-chat-q4_k.mllm");
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 400);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<string>("affinity", '\0', "pin the threads: none, big (the big cores of big.LITTLE) or numa<N>", false, "none");
+    cmdParser.add<int>("pool", 'p', "memory pool size in MB, 0 uses system malloc", false, 0);
+    cmdParser.add("pack", '\0', "pack q/k/v and gate/up weights at load time");
+    cmdParser.add<string>("rope_scaling", '\0', "RoPE context extension: none, linear, dynamic or yarn", false, "none", cmdline::oneof<string>("none", "linear", "dynamic", "yarn"));
+    cmdParser.add<float>("rope_factor", '\0', "context extension factor over the trained 4096 tokens", false, 1.0f);
+    cmdParser.add<float>("temperature", '\0', "sampling temperature, 0 decodes greedily", false, 0.0f);
+    cmdParser.add<int>("top_k", '\0', "sample from the k most likely tokens, 0 for all", false, 0);
+    cmdParser.add<float>("top_p", '\0', "sample from the most likely tokens adding up to top_p", false, 1.0f);
+    cmdParser.add<float>("min_p", '\0', "drop tokens less likely than min_p times the best one", false, 0.0f);
+    cmdParser.add<float>("repeat_penalty", '\0', "penalty on the last 64 tokens, 1 for none", false, 1.0f);
+    cmdParser.add<int>("seed", '\0', "sampling seed", false, 0);
+    cmdParser.add("json", '\0', "constrain the answers to one JSON value");
     cmdParser.parse_check(argc, argv);
 
     string vocab_path = cmdParser.get<string>("vocab");
     string model_path = cmdParser.get<string>("model");
     int tokens_limit = cmdParser.get<int>("limits");
     CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+    const string affinity = cmdParser.get<string>("affinity");
+    if (affinity != "none" && !cpu_pin_threads(affinity)) {
+        std::cerr << "cannot pin the threads to " << affinity << std::endl;
+    }
+    Module::memory_pool_size = (size_t)cmdParser.get<int>("pool") * 1024 * 1024;
+    SamplingParams sampling;
+    sampling.temperature = cmdParser.get<float>("temperature");
+    sampling.top_k = cmdParser.get<int>("top_k");
+    sampling.top_p = cmdParser.get<float>("top_p");
+    sampling.min_p = cmdParser.get<float>("min_p");
+    sampling.repetition_penalty = cmdParser.get<float>("repeat_penalty");
+    sampling.seed = cmdParser.get<int>("seed");
 
     auto tokenizer = LLaMATokenizer(vocab_path);
+    std::shared_ptr<JsonGrammar> json;
+    if (cmdParser.exist("json")) {
+        json = std::make_shared<JsonGrammar>(tokenizer.tokenTexts(), vector<token_id_t>{2});
+    }
 
     LLaMAConfig config(tokens_limit, "7B", LLAMAROPE);
+    config.pack_projections = cmdParser.exist("pack");
+    const string rope_scaling = cmdParser.get<string>("rope_scaling");
+    if (rope_scaling != "none") {
+        config.rope_scaling.type = rope_scaling == "linear" ? ROPE_SCALING_LINEAR : (rope_scaling == "dynamic" ? ROPE_SCALING_DYNAMIC_NTK : ROPE_SCALING_YARN);
+        config.rope_scaling.factor = cmdParser.get<float>("rope_factor");
+        config.rope_scaling.original_max_position_embeddings = 4096;
+    }
+    // plain greedy decoding only needs the best token out of the lm_head
+    if (sampling.temperature <= 0 && sampling.repetition_penalty == 1.0f && !json) {
+        config.top_k = 1;
+    }
     auto model = LLaMAModel(config);
     model.load(model_path);
 
@@ -37,13 +78,24 @@ int main(int argc, char **argv) {
     for (int i = 0; i < in_strs.size(); ++i) {
         auto in_str = in_strs[i];
         auto input_tensor = tokenizer.tokenize(in_str, i);
+        Sampler sampler(sampling);
+        std::unique_ptr<JsonConstraint> constraint;
+        if (json) {
+            constraint = std::make_unique<JsonConstraint>(json);
+            sampler.setConstraint(constraint.get());
+        }
         std::cout << "[Q] " << in_str << std::endl;
         std::cout << "[A] " << std::flush;
         for (int step = 0; step < 100; step++) {
             auto result = model({input_tensor});
-            auto outputs = tokenizer.detokenize(result[0]);
-            auto out_string = outputs.first;
-            auto out_token = outputs.second;
+            unsigned out_token;
+            string out_string;
+            if (config.top_k > 0) {
+                out_token = topKToken(result[0]);
+                out_string = tokenizer.detokenize({out_token});
+            } else {
+                std::tie(out_string, out_token) = tokenizer.detokenize(result[0], &sampler);
+            }
             if (out_token == 2) {
                 break;
             }
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include "cmdline.h"
+#include "models/llama/modeling_llama.hpp"
+#include "models/llama/tokenization_llama.hpp"
+#include "BatchScheduler.hpp"
+#include "Timing.hpp"
+#include "backends/cpu/compute/Parallel.hpp"
+
+using namespace mllm;
+
+// Serves a stream of chat requests with continuous batching and reports throughput and latency.
+// Requests arrive every --interval ms; with --sweep the same workload is replayed for max batch
+// sizes 1, 2, 4, ... up to --batch, which traces the throughput / latency trade-off.
+int main(int argc, char **argv) {
+    cmdline::parser cmdParser;
+    cmdParser.add<string>("vocab", 'v', "specify mllm tokenizer model path", false, "../vocab/llama_vocab.mllm");
+    cmdParser.add<string>("model", 'm', "specify mllm model path", false, "../models/llama-2-7b-chat-q4_k.mllm");
+    cmdParser.add<int>("limits", 'l', "max KV cache size per sequence", false, 400);
+    cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<string>("affinity", '\0', "pin the threads: none, big (the big cores of big.LITTLE) or numa<N>", false, "none");
+    cmdParser.add<int>("batch", 'b', "max sequences decoded together", false, 4);
+    cmdParser.add<int>("requests", 'n', "number of requests", false, 8);
+    cmdParser.add<int>("interval", 'i', "ms between request arrivals", false, 0);
+    cmdParser.add<int>("tokens", '\0', "max new tokens per request", false, 64);
+    cmdParser.add("sweep", '\0', "replay the workload for max batch 1, 2, 4, ... up to --batch");
+    cmdParser.add("pack", '\0', "pack q/k/v and gate/up weights at load time");
+    cmdParser.add<int>("chunk", '\0', "prompt tokens per prefill forward, 0 for whole prompts", false, 0);
+    cmdParser.add("interleave", '\0', "run one prefill chunk per step between the decode steps");
+    cmdParser.add<float>("temperature", '\0', "sampling temperature, 0 decodes greedily", false, 0.0f);
+    cmdParser.add<int>("top_k", '\0', "sample from the k most likely tokens, 0 for all", false, 0);
+    cmdParser.add<float>("top_p", '\0', "sample from the most likely tokens adding up to top_p", false, 1.0f);
+    cmdParser.add<int>("seed", '\0', "sampling seed of the first request, the next ones count up", false, 0);
+    cmdParser.add("json", '\0', "constrain the answers to one JSON value");
+    cmdParser.parse_check(argc, argv);
+
+    string vocab_path = cmdParser.get<string>("vocab");
+    string model_path = cmdParser.get<string>("model");
+    int tokens_limit = cmdParser.get<int>("limits");
+    CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+    const string affinity = cmdParser.get<string>("affinity");
+    if (affinity != "none" && !cpu_pin_threads(affinity)) {
+        std::cerr << "cannot pin the threads to " << affinity << std::endl;
+    }
+    const int max_batch = cmdParser.get<int>("batch");
+    const int n_requests = cmdParser.get<int>("requests");
+    const int interval_ms = cmdParser.get<int>("interval");
+    const int max_new_tokens = cmdParser.get<int>("tokens");
+    SamplingParams sampling;
+    sampling.temperature = cmdParser.get<float>("temperature");
+    sampling.top_k = cmdParser.get<int>("top_k");
+    sampling.top_p = cmdParser.get<float>("top_p");
+    const int seed = cmdParser.get<int>("seed");
+
+    auto tokenizer = LLaMATokenizer(vocab_path);
+    std::shared_ptr<JsonGrammar> json;
+    if (cmdParser.exist("json")) {
+        json = std::make_shared<JsonGrammar>(tokenizer.tokenTexts(), vector<token_id_t>{2});
+    }
+    LLaMAConfig config(tokens_limit, "7B", LLAMAROPE);
+    config.pack_projections = cmdParser.exist("pack");
+    auto model = LLaMAModel(config);
+    model.load(model_path);
+
+    vector<string> in_strs = {
+        " Hello, who are you?",
+        " What can you do?",
+        "Please introduce Beijing University of Posts and Telecommunications.",
+        " Write a haiku about the sea.",
+        " How do I boil an egg?",
+        " What is the capital of France?",
+        " Explain continuous batching in one paragraph.",
+        " Give me three names for a cat."};
+    vector<vector<token_id_t>> prompts;
+    for (int i = 0; i < n_requests; ++i) {
+        auto in_str = in_strs[i % in_strs.size()];
+        auto input = tokenizer.tokenize(in_str);
+        vector<token_id_t> ids(input.sequence());
+        for (int s = 0; s < input.sequence(); ++s) {
+            ids[s] = (token_id_t)input.dataAt<float>(0, 0, s, 0);
+        }
+        prompts.push_back(ids);
+    }
+
+    vector<int> batch_sizes = {max_batch};
+    if (cmdParser.exist("sweep")) {
+        batch_sizes.clear();
+        for (int b = 1; b < max_batch; b *= 2) {
+            batch_sizes.push_back(b);
+        }
+        batch_sizes.push_back(max_batch);
+    }
+    for (int batch : batch_sizes) {
+        BatchScheduler scheduler(model, batch, tokens_limit);
+        scheduler.prefill_chunk = cmdParser.get<int>("chunk");
+        scheduler.interleave_prefill = cmdParser.exist("interleave");
+        const int64_t start = mllm_time_ms();
+        int submitted = 0;
+        vector<GenerationResult> results;
+        while (submitted < n_requests || !scheduler.idle()) {
+            // requests that have arrived by now join at the next step
+            while (submitted < n_requests && mllm_time_ms() - start >= (int64_t)submitted * interval_ms) {
+                sampling.seed = seed + submitted;
+                std::shared_ptr<TokenConstraint> constraint;
+                if (json) {
+                    constraint = std::make_shared<JsonConstraint>(json);
+                }
+                scheduler.submit({submitted, prompts[submitted], max_new_tokens, 2, sampling, constraint});
+                submitted++;
+            }
+            if (scheduler.idle()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            auto done = scheduler.step();
+            for (auto &result : done) {
+                if (batch_sizes.size() == 1) {
+                    std::cout << "[" << result.id << "] " << in_strs[result.id % in_strs.size()] << "\n    "
+                              << tokenizer.detokenize(result.tokens) << std::endl;
+                }
+            }
+            results.insert(results.end(), done.begin(), done.end());
+        }
+        std::cout << "max batch " << batch << ": ";
+        scheduler.report(results).print();
+    }
+    return 0;
+}
@@ -31,6 +31,7 @@ int main(int argc, char **argv) {
 
     auto tokenizer = MistralTokenizer(vocab_path);
     MistralConfig config(tokens_limit, "7B", RoPEType::HFHUBROPE);
+    config.top_k = 1;
     auto model = MistralForCausalLM(config);
     model.load(model_path);
 
@@ -54,9 +55,9 @@ int main(int argc, char **argv) {
         std::cout << "[A] " << std::flush;
         for (int step = 0; step < 100; step++) {
             auto result = model({input_tensor});
-            auto outputs = tokenizer.detokenize(result[0]);
-            auto out_string = outputs.first;
-            auto out_token = outputs.second;
+            // the lm_head returns the best token only (top_k = 1)
+            auto out_token = topKToken(result[0]);
+            auto out_string = tokenizer.detokenize({out_token});
             auto [isOk, print_string] = processOutput(out_string);
             if (isOk) {
                 std::cout << print_string << std::flush;
@@ -12,6 +12,7 @@
 #include "models/qwen/modeling_qwen.hpp"
 #include "models/qwen/tokenization_qwen.hpp"
 #include "processor/PostProcess.hpp"
+#include "Grammar.hpp"
 
 using namespace mllm;
 
@@ -22,6 +23,7 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("model", 'm', "specify mllm model path", false, "../models/qwen-1.5-0.5b-q4_k.mllm");
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 400);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add("json", '\0', "constrain the answers to one JSON value");
     cmdParser.parse_check(argc, argv);
 
     string vocab_path = cmdParser.get<string>("vocab");
@@ -31,7 +33,15 @@ int main(int argc, char **argv) {
     CPUBackend::cpu_threads = cmdParser.get<int>("thread");
 
     auto tokenizer = QWenTokenizer(vocab_path, merge_path);
+    std::shared_ptr<JsonGrammar> json;
+    if (cmdParser.exist("json")) {
+        json = std::make_shared<JsonGrammar>(tokenizer.tokenTexts(), vector<token_id_t>{tokenizer.eos_id_, tokenizer.bos_id_});
+    }
     QWenConfig config(tokens_limit, "0.5B", RoPEType::HFHUBROPE);
+    // greedy decoding without a constraint only needs the best token out of the lm_head
+    if (!json) {
+        config.top_k = 1;
+    }
     auto model = QWenForCausalLM(config);
     model.load(model_path);
 
@@ -52,11 +62,25 @@ int main(int argc, char **argv) {
         auto input_tensor = tokenizer.tokenize(in_str, i);
         std::cout << "[Q] " << in_str << std::endl;
         std::cout << "[A] " << std::flush;
+        Sampler sampler;
+        std::unique_ptr<JsonConstraint> constraint;
+        if (json) {
+            constraint = std::make_unique<JsonConstraint>(json);
+            sampler.setConstraint(constraint.get());
+        }
         for (int step = 0; step < 100; step++) {
             auto result = model({input_tensor});
-            auto outputs = tokenizer.detokenize(result[0]);
-            auto out_string = outputs.first;
-            auto out_token = outputs.second;
+            unsigned out_token;
+            std::string out_string;
+            if (config.top_k > 0) {
+                out_token = topKToken(result[0]);
+                out_string = tokenizer.detokenize({out_token});
+            } else {
+                std::tie(out_string, out_token) = tokenizer.detokenize(result[0], &sampler);
+            }
+            if (json && json->isEos(out_token)) {
+                break;
+            }
             auto [isOk, print_string] = processOutput(out_string);
             if (isOk) {
                 std::cout << print_string << std::flush;
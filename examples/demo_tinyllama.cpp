@@ -26,6 +26,7 @@ int main(int argc, char **argv) {
     auto tokenizer = LLaMATokenizer(vocab_path);
 
     TinyLLaMAConfig config(tokens_limit, "1.5B", HFHUBROPE);
+    config.top_k = 1;
     auto model = TinyLLaMAModel(config);
     model.load(model_path);
 
@@ -45,9 +46,9 @@ int main(int argc, char **argv) {
         std::cout << "[A] " << std::flush;
         for (int step = 0; step < 100; step++) {
             auto result = model({input_tensor});
-            auto outputs = tokenizer.detokenize(result[0]);
-            auto out_string = outputs.first;
-            auto out_token = outputs.second;
+            // the lm_head returns the best token only (top_k = 1)
+            auto out_token = topKToken(result[0]);
+            auto out_string = tokenizer.detokenize({out_token});
             if (out_token == 2) {
                 break;
             }
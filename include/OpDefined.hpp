@@ -45,6 +45,7 @@ enum OpType {
     RANGE,
     WHERE,
     REPLACE,
+    FUSEDLINEAR,
     OP_NUM
 };
 
@@ -86,6 +87,7 @@ static const vector<string> OpNames = {
     "Range",
     "Where",
     "Replace",
+    "FusedLinear",
     "OP_NUM"};
 
 enum TensorFuncType {
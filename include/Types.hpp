@@ -117,6 +117,35 @@ enum RoPEType {
     HFHUBROPE = 4,
 };
 
+// RoPE context extension, as in the `rope_scaling` entry of HuggingFace configs
+enum RoPEScalingType {
+    ROPE_SCALING_NONE = 0,
+    ROPE_SCALING_LINEAR = 1,      // position interpolation: positions divided by factor
+    ROPE_SCALING_DYNAMIC_NTK = 2, // base grows with the current length once it passes the trained context
+    ROPE_SCALING_YARN = 3,        // per-frequency blend of interpolation/extrapolation plus attention scaling
+};
+
+struct RoPEScaling {
+    RoPEScalingType type = ROPE_SCALING_NONE;
+    float factor = 1.0;
+    int original_max_position_embeddings = 0; // trained context; 0 means max_position_embeddings
+};
+
+// causal structure of an attention matmul: output row m (query m of q_len) only involves key
+// positions <= m + k_len - q_len, so the rest can be skipped instead of masked with -inf
+enum CausalMMType {
+    CAUSAL_MM_NONE = 0,
+    CAUSAL_MM_OUTPUT = 1, // scores = Q x K^T: future columns are left unwritten (a causal softmax never reads them)
+    CAUSAL_MM_INPUT0 = 2, // out = P x V: P is zero on future keys, so the reduction stops at the last visible key
+};
+
+// activation applied to the gate of a gated linear unit (SwiGLU / GeGLU)
+enum GLUType {
+    GLU_NONE = 0,
+    GLU_SILU = 1,
+    GLU_GELU = 2,
+};
+
 /*
  * This code is based on ggml(https://github.com/ggerganov/ggml),
  * please see https://github.com/ggerganov/ggml/blob/master/src/ggml.c
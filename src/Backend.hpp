@@ -16,10 +16,38 @@ class Backend;
 
 
 
+/**
+ * \brief How the rows of a forward map to independent sequences, set by a batched caller such as
+ *        BatchScheduler around each forward. Row b continues the sequence held in KV-cache slot
+ *        first_slot + b, and its first token in this forward is at position positions[b]; the KV
+ *        caches hold \p slots sequences. With no positions (the default) the ops keep their own
+ *        running position shared by all rows, i.e. one conversation at a time.
+ */
+struct SequenceBatch {
+    int slots = 0;
+    int first_slot = 0;
+    vector<int> positions;
+    bool active() const {
+        return !positions.empty();
+    }
+    // keys of each row after a forward of q_len tokens per row: its earlier tokens and these
+    vector<int> keyLengths(int q_len) const {
+        vector<int> lens(positions.size());
+        for (size_t b = 0; b < positions.size(); ++b) {
+            lens[b] = positions[b] + q_len;
+        }
+        return lens;
+    }
+};
+
 class TensorFunction{
 public:
     virtual void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) = 0;
     virtual void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) = 0;
+    // output may share the memory of inputs[0], see Op::inPlace()
+    virtual bool inPlace() const {
+        return false;
+    }
 };
 class Backend {
 public:
@@ -63,8 +91,25 @@ public:
     virtual void registerOps() = 0;
     virtual void registerFuncs() = 0;
 
+    /**
+     * \brief A counter advanced after every Op/TensorFunction execution on this backend.
+     * Data derived from an activation (e.g. its quantized copy) can be reused while the epoch is unchanged.
+     */
+    uint64_t executionEpoch() const {
+        return execution_epoch_;
+    }
+    void advanceEpoch() {
+        execution_epoch_++;
+    }
+
+    SequenceBatch &sequenceBatch() {
+        return sequence_batch_;
+    }
+
 private:
     shared_ptr<MemoryManager> mem_manager_;
+    uint64_t execution_epoch_ = 0;
+    SequenceBatch sequence_batch_;
 };
 
 } // namespace mllm
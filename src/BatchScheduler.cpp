@@ -0,0 +1,218 @@
+#include "BatchScheduler.hpp"
+#include "Timing.hpp"
+#include <algorithm>
+
+namespace mllm {
+
+BatchScheduler::BatchScheduler(Module &model, int max_batch, int cache_limit) :
+    model_(model), max_batch_(max_batch), cache_limit_(cache_limit), slots_(max_batch), busy_(max_batch, false) {
+    assert(max_batch > 0);
+    Module::initBackend(MLLM_CPU);
+}
+
+void BatchScheduler::submit(GenerationRequest request) {
+    const int64_t now = mllm_time_us();
+    if (start_us_ < 0) {
+        start_us_ = now;
+    }
+    queue_.push_back({std::move(request), now});
+}
+
+int BatchScheduler::running() const {
+    return (int)std::count(busy_.begin(), busy_.end(), true);
+}
+
+vector<token_id_t> BatchScheduler::forward(const vector<vector<token_id_t>> &tokens, int first_slot, const vector<int> &positions,
+                                           const vector<Sampler *> &samplers) {
+    auto &batch = Module::backends[MLLM_CPU]->sequenceBatch();
+    batch.slots = max_batch_;
+    batch.first_slot = first_slot;
+    batch.positions = positions;
+    auto input = Tokenizer::tokens2Input(tokens);
+    auto logits = model_({input})[0];
+    batch.positions.clear();
+    vector<token_id_t> next(logits.batch(), 0);
+    for (int b = 0; b < logits.batch(); ++b) {
+        if (samplers[b] != nullptr) {
+            next[b] = samplers[b]->sample(logits, b);
+        }
+    }
+    return next;
+}
+
+bool BatchScheduler::emit(Sequence &seq, token_id_t token, int64_t now_us) {
+    if (seq.result.tokens.empty()) {
+        seq.result.first_token_ms = (now_us - seq.submit_us) / 1000.0;
+    }
+    seq.result.tokens.push_back(token);
+    seq.result.total_ms = (now_us - seq.submit_us) / 1000.0;
+    last_us_ = now_us;
+    if (on_token) {
+        on_token(seq.request.id, token);
+    }
+    seq.next = token;
+    return token == seq.request.eos || (int)seq.result.tokens.size() >= seq.request.max_new_tokens || seq.length >= cache_limit_;
+}
+
+bool BatchScheduler::prefill(int slot) {
+    auto &seq = slots_[slot];
+    const auto &prompt = seq.request.prompt;
+    const int remaining = (int)prompt.size() - seq.prefilled;
+    const int n = prefill_chunk > 0 ? std::min(prefill_chunk, remaining) : remaining;
+    const vector<token_id_t> chunk(prompt.begin() + seq.prefilled, prompt.begin() + seq.prefilled + n);
+    const int position = seq.prefilled;
+    seq.prefilled += n;
+    // only the logits after the whole prompt are sampled
+    const auto next = forward({chunk}, slot, {position}, {seq.decoding() ? &seq.sampler : nullptr});
+    if (!seq.decoding()) {
+        return false;
+    }
+    // the logits of the prompt's last token give the first generated one
+    seq.length = seq.result.prompt_len;
+    return emit(seq, next[0], mllm_time_us());
+}
+
+vector<GenerationResult> BatchScheduler::step() {
+    vector<GenerationResult> finished;
+    // admit: each queued request takes the lowest free slot; a rejected one leaves it to the next
+    for (int slot = 0; slot < max_batch_ && !queue_.empty(); ++slot) {
+        while (!busy_[slot] && !queue_.empty()) {
+            auto queued = std::move(queue_.front());
+            queue_.pop_front();
+            auto &seq = slots_[slot];
+            seq = Sequence();
+            seq.request = std::move(queued.request);
+            seq.submit_us = queued.submit_us;
+            seq.result.id = seq.request.id;
+            seq.result.prompt_len = (int)seq.request.prompt.size();
+            seq.result.queue_ms = (mllm_time_us() - seq.submit_us) / 1000.0;
+            seq.sampler = Sampler(seq.request.sampling);
+            seq.sampler.accept(seq.request.prompt);
+            seq.sampler.setConstraint(seq.request.constraint.get());
+            if (seq.request.prompt.empty() || seq.result.prompt_len >= cache_limit_) {
+                std::cerr << "[BatchScheduler] request " << seq.request.id << ": prompt of " << seq.result.prompt_len
+                          << " tokens does not fit a KV cache of " << cache_limit_ << std::endl;
+                finished.push_back(seq.result);
+                continue;
+            }
+            busy_[slot] = true;
+        }
+    }
+    // prefill: whole prompts, or one chunk of each when interleaving with the decode steps
+    for (int slot = 0; slot < max_batch_; ++slot) {
+        while (busy_[slot] && !slots_[slot].decoding()) {
+            const bool done = prefill(slot);
+            if (done) {
+                finished.push_back(slots_[slot].result);
+                busy_[slot] = false;
+            }
+            if (interleave_prefill) {
+                break;
+            }
+        }
+    }
+    // decode: one row per slot from the first to the last decoding one. The slots in between ride
+    // along and their output is dropped: a free slot at position 0, one still being prefilled at
+    // the position its next chunk overwrites
+    int lo = max_batch_, hi = 0;
+    for (int slot = 0; slot < max_batch_; ++slot) {
+        if (busy_[slot] && slots_[slot].decoding()) {
+            lo = std::min(lo, slot);
+            hi = slot + 1;
+        }
+    }
+    if (lo >= hi) {
+        return finished;
+    }
+    vector<vector<token_id_t>> tokens(hi - lo, vector<token_id_t>{0});
+    vector<int> positions(hi - lo, 0);
+    vector<Sampler *> samplers(hi - lo, nullptr);
+    for (int slot = lo; slot < hi; ++slot) {
+        if (!busy_[slot]) {
+            continue;
+        }
+        auto &seq = slots_[slot];
+        if (seq.decoding()) {
+            tokens[slot - lo][0] = seq.next;
+            positions[slot - lo] = seq.length;
+            samplers[slot - lo] = &seq.sampler;
+        } else {
+            positions[slot - lo] = seq.prefilled;
+        }
+    }
+    const auto next = forward(tokens, lo, positions, samplers);
+    const int64_t now = mllm_time_us();
+    decode_steps_++;
+    for (int slot = lo; slot < hi; ++slot) {
+        if (!busy_[slot] || !slots_[slot].decoding()) {
+            continue;
+        }
+        decode_rows_++;
+        auto &seq = slots_[slot];
+        seq.length++;
+        if (emit(seq, next[slot - lo], now)) {
+            finished.push_back(seq.result);
+            busy_[slot] = false;
+        }
+    }
+    return finished;
+}
+
+vector<GenerationResult> BatchScheduler::run() {
+    vector<GenerationResult> finished;
+    while (!idle()) {
+        auto done = step();
+        finished.insert(finished.end(), done.begin(), done.end());
+    }
+    return finished;
+}
+
+// the value below which a fraction q of the sorted values lie
+static double percentile(vector<double> values, double q) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(q * values.size()))];
+}
+
+ServingReport BatchScheduler::report(const vector<GenerationResult> &results) const {
+    ServingReport r;
+    r.requests = (int)results.size();
+    r.wall_s = start_us_ < 0 ? 0 : (last_us_ - start_us_) / 1e6;
+    r.mean_batch = decode_steps_ > 0 ? (double)decode_rows_ / decode_steps_ : 0;
+    vector<double> first, total;
+    int decode_tokens = 0;
+    double decode_ms = 0;
+    for (const auto &result : results) {
+        r.generated_tokens += (int)result.tokens.size();
+        if (result.tokens.empty()) {
+            continue;
+        }
+        first.push_back(result.first_token_ms);
+        total.push_back(result.total_ms);
+        decode_tokens += (int)result.tokens.size() - 1;
+        decode_ms += result.total_ms - result.first_token_ms;
+    }
+    r.tokens_per_s = r.wall_s > 0 ? r.generated_tokens / r.wall_s : 0;
+    if (!first.empty()) {
+        for (size_t i = 0; i < first.size(); ++i) {
+            r.mean_first_token_ms += first[i] / first.size();
+            r.mean_total_ms += total[i] / total.size();
+        }
+        r.p90_first_token_ms = percentile(first, 0.9);
+        r.p90_total_ms = percentile(total, 0.9);
+    }
+    r.mean_token_ms = decode_tokens > 0 ? decode_ms / decode_tokens : 0;
+    return r;
+}
+
+void ServingReport::print(std::ostream &os) const {
+    os << requests << " requests, " << generated_tokens << " tokens in " << wall_s << " s: "
+       << tokens_per_s << " tokens/s, " << mean_batch << " sequences per decode step\n"
+       << "  first token: mean " << mean_first_token_ms << " ms, p90 " << p90_first_token_ms << " ms\n"
+       << "  per token:   mean " << mean_token_ms << " ms\n"
+       << "  request:     mean " << mean_total_ms << " ms, p90 " << p90_total_ms << " ms" << std::endl;
+}
+
+} // namespace mllm
@@ -0,0 +1,145 @@
+#ifndef MLLM_BATCHSCHEDULER_HPP
+#define MLLM_BATCHSCHEDULER_HPP
+
+#include "Grammar.hpp"
+#include "Module.hpp"
+#include "Sampler.hpp"
+#include "tokenizers/Tokenizer.hpp"
+
+#include <deque>
+#include <functional>
+#include <iostream>
+
+namespace mllm {
+
+/**
+ * \brief One prompt to complete: generation stops after max_new_tokens or at eos.
+ */
+struct GenerationRequest {
+    int id = 0;
+    vector<token_id_t> prompt;
+    int max_new_tokens = 100;
+    token_id_t eos = 2;
+    SamplingParams sampling; // greedy by default
+    std::shared_ptr<TokenConstraint> constraint; // e.g. a JsonConstraint, nullptr for free text
+};
+
+/**
+ * \brief A finished request. Times are in ms since the request was submitted.
+ */
+struct GenerationResult {
+    int id = 0;
+    int prompt_len = 0;
+    vector<token_id_t> tokens; // generated tokens, ending with eos if it stopped there
+    double queue_ms = 0;       // until it got a KV-cache slot
+    double first_token_ms = 0; // until its prefill produced the first token
+    double total_ms = 0;       // until its last token
+};
+
+/**
+ * \brief Throughput and latency of a finished workload, see BatchScheduler::report.
+ */
+struct ServingReport {
+    int requests = 0;
+    int generated_tokens = 0;
+    double wall_s = 0;
+    double tokens_per_s = 0;    // generated tokens over the wall time
+    double mean_batch = 0;      // running sequences per decode step
+    double mean_first_token_ms = 0;
+    double p90_first_token_ms = 0;
+    double mean_token_ms = 0;   // per generated token after the first, as seen by one request
+    double mean_total_ms = 0;
+    double p90_total_ms = 0;
+    void print(std::ostream &os = std::cout) const;
+};
+
+/**
+ * \brief Continuous batching over a decoder model (e.g. LLaMAModel): many sequences share the model,
+ *        each in its own KV-cache slot, and their decode steps run as one batched forward
+ *        [running, 1, 1, 1], so the weights are read once per step for all of them.
+ *
+ *        Requests queue in submit(); each step() first admits queued requests into free slots and
+ *        prefills them, then runs one decode step for every running sequence, which may have joined
+ *        at any earlier step. A finished sequence frees its slot for the next step.
+ *
+ *        With prefill_chunk set, a prompt goes through the KV cache prefill_chunk tokens per forward,
+ *        which bounds the attention scores to [chunk, length] per head instead of [length, length].
+ *        With interleave_prefill as well, each step runs only one chunk of each prompt being
+ *        prefilled, so a long prompt no longer stalls the decode steps of the other sequences.
+ *
+ *        The rows, slots and positions of each forward are passed to the ops through the backend's
+ *        SequenceBatch, which RoPE, KVCache, the causal masks / Softmax and the attention matmuls
+ *        follow: each row only attends to, and only pays for, its own keys. A model driven by a
+ *        scheduler keeps its KV caches per slot, so it should not also be run directly.
+ *        Each sequence draws its tokens with its own Sampler, set up from its request's sampling.
+ */
+class BatchScheduler {
+public:
+    /**
+     * \param max_batch   KV-cache slots, i.e. sequences decoded together.
+     * \param cache_limit the model's KV-cache length: a sequence stops when its slot is full.
+     */
+    BatchScheduler(Module &model, int max_batch, int cache_limit);
+
+    void submit(GenerationRequest request);
+    // nothing queued or running
+    bool idle() const {
+        return queue_.empty() && running() == 0;
+    }
+    int running() const;
+    // admit, then decode one token for every running sequence; returns the requests that finished
+    vector<GenerationResult> step();
+    // step() until idle
+    vector<GenerationResult> run();
+    // called with each generated token, in order per request
+    std::function<void(int id, token_id_t token)> on_token;
+    // prompt tokens per prefill forward, 0 for the whole prompt at once
+    int prefill_chunk = 0;
+    // one prefill chunk per sequence and step, between the decode steps, rather than whole prompts
+    bool interleave_prefill = false;
+
+    // over the requests finished so far, from the first submit to the last token
+    ServingReport report(const vector<GenerationResult> &results) const;
+
+private:
+    struct Sequence {
+        GenerationRequest request;
+        GenerationResult result;
+        int64_t submit_us = 0;
+        int prefilled = 0; // prompt tokens in its slot; it decodes once they all are
+        int length = 0;    // tokens in its slot
+        token_id_t next = 0;
+        Sampler sampler;
+        bool decoding() const {
+            return prefilled == (int)request.prompt.size();
+        }
+    };
+    struct Queued {
+        GenerationRequest request;
+        int64_t submit_us;
+    };
+
+    // one forward of \p tokens rows, row b in slot first_slot + b after positions[b] tokens;
+    // returns the next token of each row drawn by samplers[b], 0 for the rows without one
+    vector<token_id_t> forward(const vector<vector<token_id_t>> &tokens, int first_slot, const vector<int> &positions,
+                               const vector<Sampler *> &samplers);
+    // runs the next prefill chunk of the sequence in \p slot; returns whether it finished
+    bool prefill(int slot);
+    // stores \p token and returns whether the sequence is done
+    bool emit(Sequence &seq, token_id_t token, int64_t now_us);
+
+    Module &model_;
+    int max_batch_;
+    int cache_limit_;
+    std::deque<Queued> queue_;
+    vector<Sequence> slots_;
+    vector<bool> busy_;
+    int64_t start_us_ = -1;
+    int64_t last_us_ = 0;
+    int64_t decode_steps_ = 0;
+    int64_t decode_rows_ = 0;
+};
+
+} // namespace mllm
+
+#endif // MLLM_BATCHSCHEDULER_HPP
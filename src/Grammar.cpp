@@ -0,0 +1,352 @@
+#include "Grammar.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace mllm {
+
+bool any_allowed(const vector<uint64_t> &allowed, int n) {
+    for (int w = 0; w * 64 < n && w < (int)allowed.size(); ++w) {
+        const int bits = std::min(n - w * 64, 64);
+        const uint64_t in_range = bits == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1;
+        if (allowed[w] & in_range) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void mask_logits(float *logits, int n, const vector<uint64_t> &allowed) {
+    for (int w = 0; w * 64 < n; ++w) {
+        const uint64_t bits = w < (int)allowed.size() ? allowed[w] : 0;
+        if (bits == ~(uint64_t)0) {
+            continue;
+        }
+        float *x = logits + w * 64;
+        const int end = std::min(n - w * 64, 64);
+        if (bits == 0) {
+            std::fill(x, x + end, -INFINITY);
+            continue;
+        }
+        int i = 0;
+        // 8 tokens per mask byte: each lane tests its bit and selects the logit or -inf
+#if defined(__AVX2__)
+        const __m256i lane_bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256 ninf = _mm256_set1_ps(-INFINITY);
+        for (; i + 8 <= end; i += 8) {
+            const __m256i byte = _mm256_set1_epi32((int)((bits >> i) & 0xFF));
+            const __m256 keep = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(byte, lane_bit), lane_bit));
+            _mm256_storeu_ps(x + i, _mm256_blendv_ps(ninf, _mm256_loadu_ps(x + i), keep));
+        }
+#elif defined(__ARM_NEON)
+        const uint32_t lo_bits[4] = {1, 2, 4, 8};
+        const uint32_t hi_bits[4] = {16, 32, 64, 128};
+        const uint32x4_t lane_lo = vld1q_u32(lo_bits);
+        const uint32x4_t lane_hi = vld1q_u32(hi_bits);
+        const float32x4_t ninf = vdupq_n_f32(-INFINITY);
+        for (; i + 8 <= end; i += 8) {
+            const uint32x4_t byte = vdupq_n_u32((uint32_t)((bits >> i) & 0xFF));
+            vst1q_f32(x + i, vbslq_f32(vtstq_u32(byte, lane_lo), vld1q_f32(x + i), ninf));
+            vst1q_f32(x + i + 4, vbslq_f32(vtstq_u32(byte, lane_hi), vld1q_f32(x + i + 4), ninf));
+        }
+#endif
+        for (; i < end; ++i) {
+            if (((bits >> i) & 1) == 0) {
+                x[i] = -INFINITY;
+            }
+        }
+    }
+}
+
+std::string JsonState::hash() const {
+    std::string h = {(char)mode, (char)aux, (char)ws, (char)key};
+    return h + stack;
+}
+
+static const char *const json_literals[] = {"true", "false", "null"};
+
+static bool json_ws(unsigned char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+JsonGrammar::JsonGrammar(const vector<std::string> &token_texts, vector<token_id_t> eos, int max_depth, int max_ws) :
+    texts_(token_texts), eos_(std::move(eos)), max_depth_(max_depth), max_ws_(max_ws) {
+    assert(!eos_.empty());
+    for (token_id_t id = 0; id < texts_.size(); ++id) {
+        if (!texts_[id].empty()) {
+            sorted_.push_back(id);
+        }
+    }
+    std::sort(sorted_.begin(), sorted_.end(), [this](token_id_t a, token_id_t b) {
+        return texts_[a] < texts_[b];
+    });
+    common_.resize(sorted_.size(), 0);
+    for (size_t k = 1; k < sorted_.size(); ++k) {
+        const auto &a = texts_[sorted_[k - 1]];
+        const auto &b = texts_[sorted_[k]];
+        size_t n = 0;
+        while (n < a.size() && n < b.size() && a[n] == b[n]) {
+            n++;
+        }
+        common_[k] = (int)n;
+    }
+}
+
+bool JsonGrammar::isEos(token_id_t token) const {
+    return std::find(eos_.begin(), eos_.end(), token) != eos_.end();
+}
+
+void JsonGrammar::valueDone(JsonState &state) {
+    state.mode = state.stack.empty() ? JsonState::DONE : JsonState::AFTER;
+    state.aux = 0;
+}
+
+bool JsonGrammar::complete(const JsonState &state) const {
+    if (state.mode == JsonState::DONE) {
+        return true;
+    }
+    // a top-level number only ends with the text
+    return state.stack.empty()
+           && (state.mode == JsonState::ZERO || state.mode == JsonState::INT || state.mode == JsonState::FRAC || state.mode == JsonState::EXP);
+}
+
+bool JsonGrammar::step(JsonState &state, unsigned char c) const {
+    switch (state.mode) {
+    case JsonState::STRING:
+        if (c == '"') {
+            if (state.key) {
+                state.key = false;
+                state.mode = JsonState::COLON;
+            } else {
+                valueDone(state);
+            }
+        } else if (c == '\\') {
+            state.mode = JsonState::ESCAPE;
+        }
+        return c >= 0x20;
+    case JsonState::ESCAPE:
+        if (c == 'u') {
+            state.mode = JsonState::UNICODE;
+            state.aux = 4;
+            return true;
+        }
+        state.mode = JsonState::STRING;
+        return c != 0 && strchr("\"\\/bfnrt", c) != nullptr;
+    case JsonState::UNICODE:
+        if (--state.aux == 0) {
+            state.mode = JsonState::STRING;
+        }
+        return isxdigit(c);
+    case JsonState::LITERAL: {
+        const char *literal = json_literals[state.aux >> 3];
+        const int pos = state.aux & 7;
+        if (c != (unsigned char)literal[pos]) {
+            return false;
+        }
+        if (literal[pos + 1] == 0) {
+            valueDone(state);
+        } else {
+            state.aux++;
+        }
+        return true;
+    }
+    case JsonState::MINUS:
+        state.mode = c == '0' ? JsonState::ZERO : JsonState::INT;
+        return isdigit(c);
+    case JsonState::FRAC_FIRST:
+        state.mode = JsonState::FRAC;
+        return isdigit(c);
+    case JsonState::EXP_FIRST:
+        if (c == '+' || c == '-') {
+            state.mode = JsonState::EXP_SIGN;
+            return true;
+        }
+        state.mode = JsonState::EXP;
+        return isdigit(c);
+    case JsonState::EXP_SIGN:
+        state.mode = JsonState::EXP;
+        return isdigit(c);
+    case JsonState::ZERO:
+    case JsonState::INT:
+    case JsonState::FRAC:
+    case JsonState::EXP:
+        if (isdigit(c) && state.mode != JsonState::ZERO) {
+            return true;
+        }
+        if (c == '.' && (state.mode == JsonState::ZERO || state.mode == JsonState::INT)) {
+            state.mode = JsonState::FRAC_FIRST;
+            return true;
+        }
+        if ((c == 'e' || c == 'E') && state.mode != JsonState::EXP) {
+            state.mode = JsonState::EXP_FIRST;
+            return true;
+        }
+        // the first byte after a number belongs to what follows it
+        valueDone(state);
+        if (state.mode == JsonState::DONE) {
+            return false;
+        }
+        break;
+    case JsonState::DONE:
+        return false;
+    default:
+        break;
+    }
+    // between the tokens of the value
+    if (json_ws(c)) {
+        return ++state.ws <= max_ws_;
+    }
+    state.ws = 0;
+    switch (state.mode) {
+    case JsonState::ARRAY_FIRST:
+        if (c == ']') {
+            state.stack.pop_back();
+            valueDone(state);
+            return true;
+        }
+        // fall through
+    case JsonState::VALUE:
+        if (c == '{' || c == '[') {
+            if ((int)state.stack.size() >= max_depth_) {
+                return false;
+            }
+            state.stack.push_back((char)c);
+            state.mode = c == '{' ? JsonState::OBJECT_FIRST : JsonState::ARRAY_FIRST;
+            return true;
+        }
+        if (c == '"') {
+            state.mode = JsonState::STRING;
+            state.key = false;
+            return true;
+        }
+        if (c == '-') {
+            state.mode = JsonState::MINUS;
+            return true;
+        }
+        if (isdigit(c)) {
+            state.mode = c == '0' ? JsonState::ZERO : JsonState::INT;
+            return true;
+        }
+        for (int i = 0; i < 3; ++i) {
+            if (c == (unsigned char)json_literals[i][0]) {
+                state.mode = JsonState::LITERAL;
+                state.aux = (uint8_t)(i << 3 | 1);
+                return true;
+            }
+        }
+        return false;
+    case JsonState::OBJECT_FIRST:
+        if (c == '}') {
+            state.stack.pop_back();
+            valueDone(state);
+            return true;
+        }
+        // fall through
+    case JsonState::KEY:
+        if (c == '"') {
+            state.mode = JsonState::STRING;
+            state.key = true;
+            return true;
+        }
+        return false;
+    case JsonState::COLON:
+        if (c == ':') {
+            state.mode = JsonState::VALUE;
+            return true;
+        }
+        return false;
+    case JsonState::AFTER: {
+        const bool object = state.stack.back() == '{';
+        if (c == ',') {
+            state.mode = object ? JsonState::KEY : JsonState::VALUE;
+            return true;
+        }
+        if (c == (object ? '}' : ']')) {
+            state.stack.pop_back();
+            valueDone(state);
+            return true;
+        }
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+bool JsonGrammar::advance(JsonState &state, const std::string &text) const {
+    for (unsigned char c : text) {
+        if (!step(state, c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const vector<uint64_t> &JsonGrammar::mask(const JsonState &state) {
+    const auto key = state.hash();
+    auto cached = masks_.find(key);
+    if (cached != masks_.end()) {
+        return cached->second;
+    }
+    if (masks_.size() >= 4096) { // deep or whitespace-heavy output; start over rather than grow
+        masks_.clear();
+    }
+    vector<uint64_t> bits((texts_.size() + 63) / 64, 0);
+    // states[j] is the state after the first j bytes of the current text; consecutive texts share
+    // their common prefix, and the first `fit` bytes of the last text were taken
+    vector<JsonState> states(1, state);
+    int fit = 0;
+    bool rejected = false;
+    for (size_t k = 0; k < sorted_.size(); ++k) {
+        const auto id = sorted_[k];
+        const auto &text = texts_[id];
+        const int common = common_[k];
+        if (rejected && common > fit) { // starts with the byte the last text was rejected at
+            continue;
+        }
+        if (states.size() < text.size() + 1) {
+            states.resize(text.size() + 1);
+        }
+        int j = std::min(common, fit);
+        rejected = false;
+        for (; j < (int)text.size(); ++j) {
+            states[j + 1] = states[j];
+            if (!step(states[j + 1], (unsigned char)text[j])) {
+                rejected = true;
+                break;
+            }
+        }
+        fit = j;
+        if (!rejected) {
+            bits[id / 64] |= (uint64_t)1 << (id % 64);
+        }
+    }
+    if (complete(state)) {
+        for (auto id : eos_) {
+            if (id < texts_.size()) {
+                bits[id / 64] |= (uint64_t)1 << (id % 64);
+            }
+        }
+    }
+    return masks_.emplace(key, std::move(bits)).first->second;
+}
+
+void JsonConstraint::accept(token_id_t token) {
+    if (grammar_->isEos(token)) {
+        return;
+    }
+    if (!grammar_->advance(state_, grammar_->text(token))) {
+        // a token the mask did not allow: nothing but eos can follow
+        state_ = JsonState();
+        state_.mode = JsonState::DONE;
+    }
+}
+
+} // namespace mllm
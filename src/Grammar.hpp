@@ -0,0 +1,149 @@
+#ifndef MLLM_GRAMMAR_HPP
+#define MLLM_GRAMMAR_HPP
+
+#include "tokenizers/Tokenizer.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+namespace mllm {
+
+/**
+ * \brief Restricts the tokens a Sampler may choose: before each draw the logits of the tokens that are
+ *        not allowed are set to -inf, and the token drawn is passed to accept.
+ */
+class TokenConstraint {
+public:
+    virtual ~TokenConstraint() = default;
+    // bit (id % 64) of word id / 64 is set when token id may come next
+    virtual const vector<uint64_t> &allowed() = 0;
+    virtual void accept(token_id_t token) = 0;
+    // back to the state before the first token
+    virtual void reset() = 0;
+    // the token to end with when allowed() leaves no token of the vocab, e.g. a complete value whose
+    // eos is not in the vocab, or a text the grammar cannot continue
+    virtual token_id_t eos() const = 0;
+};
+
+// logits[id] = -inf for the ids not set in \p allowed
+void mask_logits(float *logits, int n, const vector<uint64_t> &allowed);
+// whether any id in [0, n) is set in \p allowed
+bool any_allowed(const vector<uint64_t> &allowed, int n);
+
+/**
+ * \brief Where a JsonGrammar is in the text generated so far: a pushdown automaton over bytes, whose
+ *        stack holds the open containers ('{' or '[').
+ */
+struct JsonState {
+    enum Mode : uint8_t {
+        VALUE,        // a value, e.g. after ':' or ','
+        ARRAY_FIRST,  // a value or ']', after '['
+        OBJECT_FIRST, // a key or '}', after '{'
+        KEY,          // a key, after ',' in an object
+        COLON,
+        AFTER,        // ',' or the close of the container, after a value
+        STRING,
+        ESCAPE,       // after '\' in a string
+        UNICODE,      // in the 4 hex digits of \u
+        MINUS,        // number: after '-'
+        ZERO,         // number: a leading 0
+        INT,
+        FRAC_FIRST,   // number: after '.'
+        FRAC,
+        EXP_FIRST,    // number: after 'e'
+        EXP_SIGN,
+        EXP,
+        LITERAL,      // true, false or null
+        DONE,         // the top-level value is complete
+    };
+    Mode mode = VALUE;
+    uint8_t aux = 0;  // LITERAL: which one and how far; UNICODE: hex digits left
+    uint8_t ws = 0;   // whitespace bytes in a row
+    bool key = false; // the STRING is an object key
+    std::string stack;
+
+    std::string hash() const;
+};
+
+/**
+ * \brief Constrains generation to one JSON value (RFC 8259), for structured output like tool calls.
+ *
+ *        The allowed-token mask of a state is found by running every token's text (see
+ *        Tokenizer::tokenTexts) through the automaton, in sorted order so a shared prefix is only run
+ *        once and a rejected one prunes every token that starts with it. Masks are cached per state,
+ *        and generating JSON revisits few states (inside a string at the same depth, after a value,
+ *        ...), so after the first tokens a step costs a hash lookup plus masking the logits.
+ *        One JsonGrammar can be shared by the JsonConstraints of many sequences.
+ */
+class JsonGrammar {
+public:
+    /**
+     * \param token_texts the text of each token id; tokens with an empty text are never allowed.
+     * \param eos         tokens that end generation, allowed once the value is complete; at least one.
+     *                    The first is returned by a JsonConstraint that allows no token.
+     * \param max_depth   the deepest nesting of objects and arrays.
+     * \param max_ws      the longest run of whitespace between tokens of the value.
+     */
+    JsonGrammar(const vector<std::string> &token_texts, vector<token_id_t> eos, int max_depth = 16, int max_ws = 16);
+
+    // advances \p state by \p text; false, with the state undefined, if the text does not fit
+    bool advance(JsonState &state, const std::string &text) const;
+    bool complete(const JsonState &state) const;
+    const vector<uint64_t> &mask(const JsonState &state);
+    const std::string &text(token_id_t token) const {
+        return texts_[token];
+    }
+    bool isEos(token_id_t token) const;
+    token_id_t eos() const {
+        return eos_.front();
+    }
+    size_t cachedStates() const {
+        return masks_.size();
+    }
+
+private:
+    bool step(JsonState &state, unsigned char c) const;
+    // a value ended, in its container or at the top level
+    static void valueDone(JsonState &state);
+
+    vector<std::string> texts_;
+    vector<token_id_t> eos_;
+    int max_depth_;
+    int max_ws_;
+    // the non-empty token ids sorted by text, and the common prefix of each with the one before
+    vector<token_id_t> sorted_;
+    vector<int> common_;
+    std::unordered_map<std::string, vector<uint64_t>> masks_;
+};
+
+/**
+ * \brief The TokenConstraint of one sequence generating JSON; see JsonGrammar.
+ */
+class JsonConstraint : public TokenConstraint {
+public:
+    explicit JsonConstraint(std::shared_ptr<JsonGrammar> grammar) :
+        grammar_(std::move(grammar)) {
+    }
+    const vector<uint64_t> &allowed() override {
+        return grammar_->mask(state_);
+    }
+    void accept(token_id_t token) override;
+    void reset() override {
+        state_ = JsonState();
+    }
+    bool complete() const {
+        return grammar_->complete(state_);
+    }
+    token_id_t eos() const override {
+        return grammar_->eos();
+    }
+
+private:
+    std::shared_ptr<JsonGrammar> grammar_;
+    JsonState state_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_GRAMMAR_HPP
@@ -2,6 +2,8 @@
 // Created by Rongjie Yi.
 //
 #include "Graph.hpp"
+#include <algorithm>
+#include <set>
 
 std::string intToStringWithLeadingZero(int num) {
     if (num < 10) {
@@ -120,6 +122,53 @@ void Graph::setUpTensors() {
 //            std::cout<<"op_name:"<<op_name<<" is not do"<<std::endl;
         }
     }
+    setUpInplace();
+}
+
+void Graph::setUpInplace() {
+    unordered_map<Tensor *, int> readers;
+    std::set<Tensor *> produced;
+    std::set<Tensor *> parts; // also reachable through an aggregated tensor
+    for (const auto &op_name : op_names_) {
+        for (auto &t : ops_input_tensors_[op_name]) {
+            readers[t.get()]++;
+        }
+        for (auto &t : ops_output_tensors_[op_name]) {
+            produced.insert(t.get());
+            for (auto &part : t->aggregated_tensors()) {
+                parts.insert(part.get());
+            }
+        }
+    }
+    auto plain = [&](const shared_ptr<Tensor> &t) {
+        auto it = tensors_.find(t->name());
+        return it != tensors_.end() && it->second == t && parts.find(t.get()) == parts.end()
+               && !t->aggregated() && t->masterTensor() == nullptr && t->childTensors().empty();
+    };
+    vector<string> in_place;
+    for (const auto &op_name : op_names_) {
+        if (!ops_not_inputs_empty_[op_name] || !ops_[op_name]->inPlace()) {
+            continue;
+        }
+        auto &input = ops_input_tensors_[op_name][0];
+        auto &output = ops_output_tensors_[op_name][0];
+        if (readers[input.get()] == 1 && produced.find(input.get()) != produced.end() && plain(input) && plain(output)) {
+            in_place.push_back(op_name);
+        }
+    }
+    // outputs aliased by an earlier setUp that no longer qualify get their own memory back
+    for (const auto &op_name : op_names_) {
+        const bool keep = std::find(in_place.begin(), in_place.end(), op_name) != in_place.end();
+        for (auto &output : ops_output_tensors_[op_name]) {
+            if (output->aliasSource() != nullptr && !(keep && output == ops_output_tensors_[op_name][0])) {
+                output->unalias();
+                output->alloc();
+            }
+        }
+    }
+    for (const auto &op_name : in_place) {
+        ops_output_tensors_[op_name][0]->aliasFrom(ops_input_tensors_[op_name][0].get());
+    }
 }
 
 void Graph::setUpOps(ParamLoader &loader) {
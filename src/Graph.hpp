@@ -36,6 +36,13 @@ public:
      */
     void setUpTensors();
 
+    /**
+     * \brief let every in-place Op (see Op::inPlace) that is the only reader of its graph-internal
+     *        input write its output over that input instead of into memory of its own.
+     *        Called by setUpTensors once all outputs are set up.
+     */
+    void setUpInplace();
+
     /**
      * \brief load the weights/bias of Ops in this graph.
      * \param loader A Paramloader
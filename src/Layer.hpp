@@ -86,6 +86,18 @@ private:
                 Tensor::gph_[name].addTensors(new_aggregated_tensors, Tensor::gph_[x_name].aggregated_dim());
             }
         }
+        // the renamed children were created after the input and are not yet views of it, e.g. the
+        // projection under a -view: relink them, so the producers write into the renamed input
+        auto &renamed = Tensor::gph_[name_X_to_num(input_name, saved_list_idx)];
+        const vector<Tensor *> children = renamed.childTensors();
+        for (auto *child : children) {
+            if (child->masterTensor() != &renamed) {
+                if (child->masterTensor() == nullptr) {
+                    child->free();
+                }
+                child->deepCopyFrom(&renamed, false);
+            }
+        }
     }
 
 protected:
@@ -98,6 +110,10 @@ protected:
         }
         return Module::doLoad;
     }
+    // record an INIT-pass call for Module::planInplace
+    void traceOp(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+        Module::traceStep(inputs, outputs, op_->inPlace() && !inputs.empty() && outputs.size() == 1);
+    }
     Tensor &_1I1O_OP(Tensor &input) {
         Module::runlistIdx = saved_list_idx;
         if (INIT_OP()) {
@@ -135,6 +151,7 @@ protected:
                 vector<shared_ptr<Tensor>> shared_outputs{std::shared_ptr<Tensor>(&Tensor::gph_[next_name], [](Tensor *) {})};
                 op_->reshape(shared_inputs, shared_outputs);
                 op_->setUp(shared_inputs, shared_outputs);
+                traceOp(shared_inputs, shared_outputs);
                 if (Tensor::gph_[next_name].aggregated() == false) {
                     assert(Tensor::gph_[next_name].hostPtr<float>() != nullptr);
                 }
@@ -201,6 +218,7 @@ protected:
                 vector<shared_ptr<Tensor>> shared_outputs{std::shared_ptr<Tensor>(&Tensor::gph_[next_name], [](Tensor *) {})};
                 op_->reshape(shared_inputs, shared_outputs);
                 op_->setUp(shared_inputs, shared_outputs);
+                traceOp(shared_inputs, shared_outputs);
                 assert(Tensor::gph_[next_name].hostPtr<float>() != nullptr);
                 break;
             }
@@ -276,6 +294,7 @@ protected:
                 vector<shared_ptr<Tensor>> shared_outputs{std::shared_ptr<Tensor>(&Tensor::gph_[next_name], [](Tensor *) {})};
                 op_->reshape(shared_inputs, shared_outputs);
                 op_->setUp(shared_inputs, shared_outputs);
+                traceOp(shared_inputs, shared_outputs);
                 assert(Tensor::gph_[next_name].hostPtr<float>() != nullptr);
                 break;
             }
@@ -320,6 +339,7 @@ protected:
                 vector<shared_ptr<Tensor>> shared_outputs{std::shared_ptr<Tensor>(&Tensor::gph_[next_name], [](Tensor *) {})};
                 op_->reshape(shared_inputs, shared_outputs);
                 op_->setUp(shared_inputs, shared_outputs);
+                traceOp(shared_inputs, shared_outputs);
                 if (Tensor::gph_[next_name].aggregated() == false) {
                     assert(Tensor::gph_[next_name].hostPtr<float>() != nullptr);
                 }
@@ -388,6 +408,7 @@ protected:
                 vector<shared_ptr<Tensor>> shared_inputs{std::shared_ptr<Tensor>(&Tensor::gph_[input.name()], [](Tensor *) {})};
                 op_->reshape(shared_inputs, shared_outputs);
                 op_->setUp(shared_inputs, shared_outputs);
+                traceOp(shared_inputs, shared_outputs);
                 break;
             }
             case TENSOR_STATIC_READY: {
@@ -422,6 +443,80 @@ protected:
             return output_result;
         }
     }
+    vector<Tensor> _2INO_OP(Tensor &input0, Tensor &input1, int N) {
+        Module::runlistIdx = saved_list_idx;
+        if (INIT_OP()) {
+            vector<Tensor> out;
+            for (int i = 0; i < N; ++i) {
+                out.push_back(input0);
+            }
+            return out;
+        } else {
+            if (Tensor::gph_.find(input0.name()) != Tensor::gph_.end()) {
+                Tensor::gph_[input0.name()].status() = input0.status();
+            }
+            if (Tensor::gph_.find(input1.name()) != Tensor::gph_.end()) {
+                Tensor::gph_[input1.name()].status() = input0.status();
+            }
+            vector<string> layer_next_names = {};
+            for (int i = 0; i < N; ++i) {
+                layer_next_names.push_back("out-" + op_->name() + "-" + std::to_string(i));
+            }
+            switch (input0.status()) {
+            case TENSOR_STATIC_INIT: {
+                if (Tensor::gph_.find(input0.name()) == Tensor::gph_.end() || input0.count() != Tensor::gph_[input0.name()].count()) {
+                    Tensor::gph_[input0.name()] = input0;
+                    Tensor::gph_[input0.name()].setName(input0.name());
+                }
+                if (Tensor::gph_.find(input1.name()) == Tensor::gph_.end() || input1.count() != Tensor::gph_[input1.name()].count()) {
+                    Tensor::gph_[input1.name()] = input1;
+                    Tensor::gph_[input1.name()].setName(input1.name());
+                }
+                vector<shared_ptr<Tensor>> shared_outputs = {};
+                for (const auto &layer_next_name : layer_next_names) {
+                    if (layername_2_tensorname.find(layer_next_name) == layername_2_tensorname.end()) {
+                        layername_2_tensorname[layer_next_name] = name_num_to_X(layer_next_name);
+                    }
+                    auto next_name = layername_2_tensorname[layer_next_name];
+                    if (Tensor::gph_.find(next_name) == Tensor::gph_.end()) {
+                        Tensor::gph_[next_name] = Tensor(backend_);
+                        Tensor::gph_[next_name].setName(next_name);
+                    }
+                    shared_outputs.push_back(std::shared_ptr<Tensor>(&Tensor::gph_[next_name], [](Tensor *) {}));
+                }
+                vector<shared_ptr<Tensor>> shared_inputs{
+                    std::shared_ptr<Tensor>(&Tensor::gph_[input0.name()], [](Tensor *) {}),
+                    std::shared_ptr<Tensor>(&Tensor::gph_[input1.name()], [](Tensor *) {})};
+                op_->reshape(shared_inputs, shared_outputs);
+                op_->setUp(shared_inputs, shared_outputs);
+                traceOp(shared_inputs, shared_outputs);
+                break;
+            }
+            case TENSOR_STATIC_READY: {
+                vector<shared_ptr<Tensor>> shared_outputs = {};
+                for (const auto &layer_next_name : layer_next_names) {
+                    auto next_name = layername_2_tensorname[layer_next_name];
+                    shared_outputs.push_back(std::shared_ptr<Tensor>(&Tensor::gph_[next_name], [](Tensor *) {}));
+                }
+                vector<shared_ptr<Tensor>> shared_inputs{
+                    std::shared_ptr<Tensor>(&Tensor::gph_[input0.name()], [](Tensor *) {}),
+                    std::shared_ptr<Tensor>(&Tensor::gph_[input1.name()], [](Tensor *) {})};
+                op_->execute(shared_inputs, shared_outputs);
+                break;
+            }
+            default: {
+                break;
+            }
+            }
+            vector<Tensor> output_result = {};
+            for (const auto &layer_next_name : layer_next_names) {
+                auto next_name = layername_2_tensorname[layer_next_name];
+                Tensor::gph_[next_name].status() = Tensor::gph_[input0.name()].status();
+                output_result.push_back(Tensor::gph_[next_name]);
+            }
+            return output_result;
+        }
+    }
 
     std::string name_;
     Op *op_ = nullptr;
@@ -444,6 +539,85 @@ public:
     }
 };
 
+/**
+ * \brief a Linear (e.g. an lm_head) that only returns its top_k largest outputs for the last input position:
+ * [batch, 1, 2, top_k] holding the token ids, best first, then their logits. The full output row is never
+ * written, which is all greedy or top-k decoding needs. It loads the same weights as Linear(name).
+ */
+class LinearTopK final : public Layer {
+public:
+    LinearTopK() = default;
+    explicit LinearTopK(int in_features, int out_features, int top_k, bool bias, std::string name) {
+        param_["in_features"] = in_features;
+        param_["out_features"] = out_features;
+        param_["bias"] = (float)bias;
+        param_["top_k"] = top_k;
+        init(std::move(name), OpType::LINEAR);
+    }
+    Tensor &operator()(Tensor &input) {
+        return _1I1O_OP(input);
+    }
+};
+
+/**
+ * \brief Linears that read the same input (e.g. q/k/v), run as one op.
+ * The weights keep their own names in the model file and are packed into one matrix at load time;
+ * each part still produces its own output tensor.
+ */
+class FusedLinear final : public Layer {
+public:
+    FusedLinear() = default;
+    explicit FusedLinear(int in_features, const vector<int> &out_features, bool bias, const vector<std::string> &names) {
+        assert(out_features.size() == names.size());
+        param_["in_features"] = in_features;
+        param_["fused_num"] = (float)out_features.size();
+        for (size_t i = 0; i < out_features.size(); ++i) {
+            param_["out_features_" + std::to_string(i)] = (float)out_features[i];
+        }
+        param_["bias"] = (float)bias;
+        // the op recovers the weight names by splitting its name at '+'
+        std::string name;
+        for (const auto &n : names) {
+            name += name.empty() ? n : "+" + n;
+        }
+        init(name, OpType::FUSEDLINEAR);
+    }
+    // q/k/v projection with RoPE applied to q and k (the first two outputs) in the matmul epilogue
+    explicit FusedLinear(int in_features, const vector<int> &out_features, bool bias, const vector<std::string> &names,
+                         RoPEType rope_type, int head_dim, float rope_theta, int max_position_embeddings,
+                         const RoPEScaling &rope_scaling = RoPEScaling()) :
+        FusedLinear(in_features, out_features, bias, names) {
+        param_["rope_type"] = rope_type;
+        param_["rope_head_dim"] = head_dim;
+        param_["rope_theta"] = rope_theta;
+        param_["max_position_embeddings"] = max_position_embeddings;
+        param_["rope_scaling_type"] = rope_scaling.type;
+        param_["rope_scaling_factor"] = rope_scaling.factor;
+        param_["original_max_position_embeddings"] = rope_scaling.original_max_position_embeddings;
+    }
+    vector<Tensor> operator()(Tensor &input) {
+        return _1INO_OP(input, (int)param_["fused_num"]);
+    }
+};
+
+class FusedGLU final : public Layer {
+public:
+    FusedGLU() = default;
+    explicit FusedGLU(int in_features, int out_features, const std::string &act_fn_type, const std::string &gate_name, const std::string &up_name) {
+        assert(act_fn_type == "SiLU" || act_fn_type == "GELU");
+        param_["in_features"] = in_features;
+        param_["fused_num"] = 2;
+        param_["out_features_0"] = out_features;
+        param_["out_features_1"] = out_features;
+        param_["bias"] = 0;
+        param_["glu"] = act_fn_type == "GELU" ? GLU_GELU : GLU_SILU;
+        init(gate_name + "+" + up_name, OpType::FUSEDLINEAR);
+    }
+    Tensor &operator()(Tensor &input) {
+        return _1I1O_OP(input);
+    }
+};
+
 class SiLU final : public Layer {
 public:
     SiLU() = default;
@@ -514,6 +688,13 @@ public:
         param_["axis"] = axis;
         init(std::move(name), OpType::SOFTMAX);
     }
+    // softmax(input * scale); with do_causal_mask the causal mask is applied here, not by a Causalmask layer
+    explicit Softmax(Chl axis, float scale, bool do_causal_mask, std::string name) {
+        param_["axis"] = axis;
+        param_["scale"] = scale;
+        param_["do_causal_mask"] = do_causal_mask;
+        init(std::move(name), OpType::SOFTMAX);
+    }
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
     }
@@ -564,6 +745,15 @@ public:
         param_["max_position_embeddings"] = max_position_embeddings;
         init(std::move(name), OpType::ROPE);
     }
+    explicit RoPE(int pose_type, float rope_theta, int max_position_embeddings, const RoPEScaling &scaling, std::string name) {
+        param_["pose_type"] = pose_type;
+        param_["rope_theta"] = rope_theta;
+        param_["max_position_embeddings"] = max_position_embeddings;
+        param_["rope_scaling_type"] = scaling.type;
+        param_["rope_scaling_factor"] = scaling.factor;
+        param_["original_max_position_embeddings"] = scaling.original_max_position_embeddings;
+        init(std::move(name), OpType::ROPE);
+    }
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
     }
@@ -588,6 +778,7 @@ public:
 
 class LayerNorm final : public Layer {
 public:
+    LayerNorm() = default;
     explicit LayerNorm(int norm_size, bool bias, float epsilon, std::string name) {
         param_["norm_size"] = norm_size;
         param_["epsilon"] = epsilon;
@@ -597,10 +788,15 @@ public:
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
     }
+    // fused residual add: returns {input + residual, norm(input + residual)}
+    vector<Tensor> operator()(Tensor &input, Tensor &residual) {
+        return _2INO_OP(input, residual, 2);
+    }
 };
 
 class RMSNorm final : public Layer {
 public:
+    RMSNorm() = default;
     explicit RMSNorm(int norm_size, float epsilon, std::string name) {
         param_["norm_size"] = norm_size;
         param_["epsilon"] = epsilon;
@@ -617,6 +813,10 @@ public:
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
     }
+    // fused residual add: returns {input + residual, norm(input + residual)}
+    vector<Tensor> operator()(Tensor &input, Tensor &residual) {
+        return _2INO_OP(input, residual, 2);
+    }
 };
 
 class Matmul final : public Layer {
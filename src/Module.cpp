@@ -3,6 +3,8 @@
 //
 
 #include "Module.hpp"
+#include <algorithm>
+#include <set>
 
 namespace mllm {
 
@@ -12,4 +14,122 @@ int Module::listIdx;
 int Module::runlistIdx;
 TensorStatus Module::tensor_status;
 bool Module::doLoad = false;
+size_t Module::memory_pool_size = 0;
+bool Module::inplace = true;
+bool Module::tracing = false;
+vector<Module::TraceStep> Module::trace;
+size_t Module::trace_pos = 0;
+bool Module::trace_changed = false;
+vector<int> Module::trace_shapes;
+
+// the tensor whose memory name ends up using
+static string inplace_root(const map<string, string> &alias, string name) {
+    for (auto it = alias.find(name); it != alias.end(); it = alias.find(name)) {
+        name = it->second;
+    }
+    return name;
+}
+
+// Replay the trace with every alias chain sharing one buffer. It is safe when each read still finds
+// the value last written under its own name, and a call only reads and writes the same buffer as
+// its in-place reads[0] -> writes[0].
+static bool inplace_valid(const vector<Module::TraceStep> &steps, const map<string, string> &alias) {
+    std::set<string> shared;
+    for (const auto &a : alias) {
+        shared.insert(inplace_root(alias, a.first));
+    }
+    map<string, string> owner; // buffer -> name whose value it holds
+    for (const auto &step : steps) {
+        for (const auto &r : step.reads) {
+            const auto buffer = inplace_root(alias, r);
+            if (shared.find(buffer) == shared.end()) {
+                continue;
+            }
+            auto it = owner.find(buffer);
+            if (it == owner.end() || it->second != r) {
+                return false;
+            }
+            for (const auto &w : step.writes) {
+                if (inplace_root(alias, w) == buffer && !(step.in_place && r == step.reads[0] && w == step.writes[0])) {
+                    return false;
+                }
+            }
+        }
+        for (const auto &w : step.writes) {
+            owner[inplace_root(alias, w)] = w;
+        }
+    }
+    return true;
+}
+
+void Module::planInplace(const vector<Tensor> &inputs) {
+    if (trace_pos != trace.size()) { // the pass made fewer calls than the last one
+        trace.resize(trace_pos);
+        trace_changed = true;
+    }
+    vector<int> shapes;
+    for (const auto &t : inputs) {
+        shapes.insert(shapes.end(), t.shape().begin(), t.shape().end());
+        shapes.push_back(-1);
+    }
+    shapes.push_back(inplace);
+    if (!trace_changed && shapes == trace_shapes) {
+        return;
+    }
+    trace_shapes = std::move(shapes);
+    // tensors also reachable under another name (views, aggregates) are left alone
+    std::set<string> parts;
+    for (auto &t : Tensor::gph_) {
+        for (const auto &part : t.second.aggregated_tensors()) {
+            parts.insert(part->name());
+        }
+    }
+    auto plain = [&](const string &name) {
+        auto it = Tensor::gph_.find(name);
+        return it != Tensor::gph_.end() && parts.find(name) == parts.end() && !it->second.aggregated()
+               && it->second.masterTensor() == nullptr && it->second.childTensors().empty();
+    };
+    map<string, string> alias; // output -> the input it is written over
+    vector<string> order;
+    std::set<std::pair<string, string>> tried;
+    for (const auto &step : trace) {
+        if (!inplace || !step.in_place) {
+            continue;
+        }
+        const auto &in = step.reads[0];
+        const auto &out = step.writes[0];
+        if (!tried.insert({in, out}).second || alias.find(out) != alias.end()
+            || inplace_root(alias, in) == out || !plain(in) || !plain(out)) {
+            continue;
+        }
+        alias[out] = in;
+        if (inplace_valid(trace, alias)) {
+            order.push_back(out);
+        } else {
+            alias.erase(out);
+        }
+    }
+    for (const auto &step : trace) {
+        for (const auto &name : step.writes) {
+            auto &t = Tensor::gph_[name];
+            if (t.aliasSource() != nullptr && alias.find(name) == alias.end()) {
+                t.unalias();
+                t.alloc();
+            }
+        }
+    }
+    // sources first, so each alias picks up its source's final pointer
+    auto depth = [&](string name) {
+        int d = 0;
+        for (auto it = alias.find(name); it != alias.end(); it = alias.find(name)) {
+            name = it->second;
+            ++d;
+        }
+        return d;
+    };
+    std::stable_sort(order.begin(), order.end(), [&](const string &a, const string &b) { return depth(a) < depth(b); });
+    for (const auto &out : order) {
+        Tensor::gph_[out].aliasFrom(&Tensor::gph_[alias[out]]);
+    }
+}
 } // namespace mllm
\ No newline at end of file
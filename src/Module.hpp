@@ -11,7 +11,9 @@
 #include "backends/cpu/CPUBackend.hpp"
 
 #include <any>
+#include <array>
 #include <memory/SystemMemoryManager.hpp>
+#include <memory/MemoryPoolManager.hpp>
 #include <utility>
 
 namespace mllm {
@@ -22,6 +24,17 @@ public:
     static ParamLoader *loader;
     static TensorStatus tensor_status;
     static bool doLoad;
+    /**
+     * \brief size in bytes of the MemoryPoolManager used by backends created in initBackend.
+     * 0 (default) selects the SystemMemoryManager. Must be set before the first initBackend call
+     * (tokenizers/processors call it in their constructors); requests beyond the pool fall back to malloc.
+     */
+    static size_t memory_pool_size;
+    /**
+     * \brief whether planInplace may alias outputs to inputs (default true). With false every op
+     * writes to memory of its own, e.g. as a reference to compare the in-place run with.
+     */
+    static bool inplace;
 
     Module() = default;
     virtual ~Module() = default;
@@ -31,7 +44,11 @@ public:
             switch (type) {
             case BackendType::MLLM_CPU: {
                 shared_ptr<MemoryManager> mm = nullptr;
-                mm = std::make_shared<SystemMemoryManager>();
+                if (memory_pool_size > 0) {
+                    mm = std::make_shared<MemoryPoolManager>(memory_pool_size, 64);
+                } else {
+                    mm = std::make_shared<SystemMemoryManager>();
+                }
                 backends[MLLM_CPU] = new CPUBackend(mm);
                 break;
             }
@@ -46,9 +63,19 @@ public:
     static void initLoader(string path) {
         loader = new ParamLoader(std::move(path));
     }
+    /**
+     * \brief tie the weight \p name to the weight \p source when this model is loaded (see
+     *        ParamLoader::tie), e.g. in the constructor of a model whose lm_head is the token embedding.
+     */
+    void tie(const string &name, const string &source) {
+        ties_[name] = source;
+    }
 
     void load(string path) {
         initLoader(path);
+        for (const auto &t : ties_) {
+            loader->tie(t.first, t.second);
+        }
         Module::doLoad = true;
         vector<Tensor> tmps;
         int max_in_size = 5;
@@ -60,6 +87,9 @@ public:
         operator()(tmps, tmpt);
         Module::doLoad = false;
         Tensor::gph_.clear();
+        // the trace names the tensors just dropped
+        trace.clear();
+        trace_pos = 0;
     }
 
     virtual vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) = 0;
@@ -78,13 +108,27 @@ public:
             for (auto &input : inputs) {
                 input.setTtype(TensorType::NORMAL_TENSOR);
                 input.status() = TENSOR_STATIC_INIT;
-                if(input.batch() == 0){
+                // a new input tensor of an unchanged size would otherwise leave the last one's data in gph_
+                auto registered = Tensor::gph_.find(input.name());
+                if (input.batch() == 0 || (registered != Tensor::gph_.end() && registered->second.hostPtr<void>() != input.hostPtr<void>())) {
                     Tensor::gph_[input.name()] = input;
                 }
             }
             tensor_status = TENSOR_STATIC_INIT;
 
-            Forward(inputs, anyArgs);
+            const bool top_level = !tracing;
+            if (top_level) {
+                trace_pos = 0;
+                trace_changed = false;
+                tracing = true;
+            }
+            auto init_outputs = Forward(inputs, anyArgs);
+            if (top_level) {
+                // the caller reads the outputs last
+                traceStep(init_outputs, std::array<Tensor *, 0>{}, false);
+                tracing = false;
+                planInplace(inputs);
+            }
             for (auto &input : inputs) {
                 input.status() = TENSOR_STATIC_READY;
             }
@@ -99,6 +143,56 @@ public:
     static int listIdx;
     static int runlistIdx;
 
+    /**
+     * \brief one op or tensor function call of the TENSOR_STATIC_INIT pass, by Tensor::gph_ name.
+     *        in_place: the call may write writes[0] over reads[0], see Op::inPlace().
+     */
+    struct TraceStep {
+        vector<string> reads;
+        vector<string> writes;
+        bool in_place;
+    };
+    static bool tracing;
+    // the calls of the last INIT pass; a pass that makes the same calls only compares names with it
+    static vector<TraceStep> trace;
+    static size_t trace_pos;
+    static bool trace_changed;
+    // the input shapes (and inplace) trace was planned for
+    static vector<int> trace_shapes;
+    template <typename Reads, typename Writes>
+    static void traceStep(const Reads &reads, const Writes &writes, bool in_place) {
+        if (!tracing) {
+            return;
+        }
+        if (trace_pos < trace.size()) {
+            const auto &last = trace[trace_pos];
+            if (last.in_place == in_place && sameNames(last.reads, reads) && sameNames(last.writes, writes)) {
+                trace_pos++;
+                return;
+            }
+            trace.resize(trace_pos);
+        }
+        TraceStep step{{}, {}, in_place};
+        for (const auto &t : reads) {
+            step.reads.push_back(traceName(t));
+        }
+        for (const auto &t : writes) {
+            step.writes.push_back(traceName(t));
+        }
+        trace.push_back(std::move(step));
+        trace_pos++;
+        trace_changed = true;
+    }
+    /**
+     * \brief run after the TENSOR_STATIC_INIT pass: every in-place call whose input is not read again
+     *        before it is overwritten gets its output aliased to the input (Tensor::aliasFrom), so the
+     *        READY pass writes over the input and the output needs no memory of its own.
+     *        Tensors aliased by an earlier pass but not this one get their own memory back.
+     *        The plan is kept while the trace and the input shapes stay the same, e.g. across decode steps.
+     * \param inputs the inputs of the pass; the trace ends with the read of its outputs, which must stay intact.
+     */
+    static void planInplace(const vector<Tensor> &inputs);
+
     template <typename T>
     static vector<T > List(int n) {
         static_assert(std::is_base_of<Module, T>::value, "T must be a subclass of Module");
@@ -136,6 +230,32 @@ public:
         listIdx = 0;
         return modules;
     }
+
+private:
+    map<string, string> ties_;
+
+    static const string &traceName(const Tensor &t) {
+        return t.name();
+    }
+    static const string &traceName(const Tensor *t) {
+        return t->name();
+    }
+    static const string &traceName(const shared_ptr<Tensor> &t) {
+        return t->name();
+    }
+    template <typename Tensors>
+    static bool sameNames(const vector<string> &names, const Tensors &tensors) {
+        if (names.size() != tensors.size()) {
+            return false;
+        }
+        size_t i = 0;
+        for (const auto &t : tensors) {
+            if (names[i++] != traceName(t)) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
 } // namespace mllm
@@ -80,9 +80,19 @@ public:
      * @return MLLM_NO_ERROR
      */
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+        backend_->advanceEpoch();
         return MLLM_NO_ERROR;
     }
 
+    /**
+     * @brief whether outputs[0] may share the memory of inputs[0] (see Tensor::aliasFrom). True only
+     *        for elementwise ops that read each element of inputs[0] before writing the output
+     *        element at the same index; the caller decides whether inputs[0] is free to be overwritten.
+     */
+    virtual bool inPlace() const {
+        return false;
+    }
+
     /**
      * @brief perform free.
      * @param inputs    input tensors
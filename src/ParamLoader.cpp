@@ -1,4 +1,5 @@
 #include "ParamLoader.hpp"
+#include <algorithm>
 #include "Types.hpp"
 #include <cstdint>
 #include <cstdio>
@@ -27,21 +28,37 @@
  * Weights File Structure
  */
 namespace mllm {
+std::string ParamLoader::resolve(const std::string &name) const {
+    auto it = ties_.find(name);
+    return it == ties_.end() ? name : it->second;
+}
+
 bool ParamLoader::load(mllm::Tensor *tensor) {
-    string name = tensor->name();
+    string name = resolve(tensor->name());
 #ifndef USE_MMAP
     if (offsets_.find(name) == offsets_.end()) { return false; }
+    const bool tied = name != tensor->name() || std::any_of(ties_.begin(), ties_.end(), [&](const auto &t) { return t.second == name; });
+    if (tied) {
+        auto it = loaded_.find(name);
+        if (it != loaded_.end() && it->second.second == tensor->cntSize()) {
+            auto memory = it->second.first.lock();
+            if (memory != nullptr) { // not freed with the Tensors it was loaded into
+                tensor->useMemory(std::move(memory));
+                return true;
+            }
+        }
+    }
     std::pair<uint64_t, uint64_t> offset = offsets_[name];
-    uint8_t *data = new uint8_t[offset.second];
     fseek(fp_, offset.first, SEEK_SET);
-    fread(data, sizeof(uint8_t), offset.second, fp_);
-    // TODO:Data?
-    //  tenor. = data;
-    auto *p = tensor->hostPtr<char>();
-    memcpy(static_cast<void *>(p), static_cast<void *>(data),
-           offset.second); // Cast pointers to void*
-    delete[] data;         // Free the memory allocated by new
+    fread(tensor->hostPtr<char>(), sizeof(uint8_t), offset.second, fp_);
+    if (tied && tensor->aliasSource() == nullptr) {
+        loaded_[name] = {tensor->shareMemory(), tensor->cntSize()};
+    }
     return true;
+#else
+    // the mmap loader reads no weights yet, so it cannot share them either
+    assert(ties_.empty());
+    return false;
 #endif
 }
 ParamLoader::~ParamLoader() {
@@ -122,6 +139,7 @@ std::tuple<uint8_t *, uint64_t> ParamLoader::load(string name) {
     return std::make_tuple(data, length);
 }
 DataType ParamLoader::getDataType(string name) {
+    name = resolve(name);
     if (data_type_.count(name) != 1) {
         std::cerr<<name<<" not found"<<std::endl;
         return DataType::MLLM_TYPE_COUNT;
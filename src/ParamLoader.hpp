@@ -2,6 +2,7 @@
 #define MLLM_ParamLoader_H
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include "Tensor.hpp"
@@ -72,6 +73,15 @@ public:
     vector<std::string> getParamNames();
     std::tuple<uint8_t *, uint64_t> load(string name);
     DataType getDataType(string name) override;
+    /**
+     * \brief tie the weight \p name to the weight \p source, e.g. an lm_head to the token embedding:
+     *        it is read from the file as \p source, and every Tensor either one is loaded into shares
+     *        the memory of the first (Tensor::shareMemory), so the weight is resident once.
+     *        Call it before the weights are loaded; Module::load passes on the ties of the model.
+     */
+    void tie(const string &name, const string &source) {
+        ties_[name] = source;
+    }
     bool isAvailible() const {
         return fp_ != nullptr&& !offsets_.empty();
     }
@@ -88,6 +98,10 @@ private:
     std::map<std::string, std::pair<uint64_t, uint64_t>> offsets_; // offsets,length
     std::map<std::string, int> data_type_;
     bool use_mmap_;
+    std::map<std::string, std::string> ties_; // weight name -> the weight it is tied to
+    // the memory each tied weight was loaded into, and its size in bytes; weak, so it is freed with the Tensors
+    std::map<std::string, std::pair<std::weak_ptr<void>, size_t>> loaded_;
+    std::string resolve(const std::string &name) const;
 };
 
 } // namespace mllm
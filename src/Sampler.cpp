@@ -0,0 +1,164 @@
+#include "Sampler.hpp"
+#include "Grammar.hpp"
+#include "backends/cpu/compute/Softmax.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace mllm {
+
+Sampler::Sampler(SamplingParams params) :
+    params_(params), rng_(params.seed) {
+}
+
+void Sampler::accept(const vector<token_id_t> &tokens) {
+    history_.insert(history_.end(), tokens.begin(), tokens.end());
+}
+
+void Sampler::reset() {
+    history_.clear();
+    rng_.seed(params_.seed);
+}
+
+// row (b, s) of logits, gathered into row if it is not contiguous
+static const float *sampler_row(Tensor &logits, int b, int s, vector<float> &row) {
+    assert(logits.dtype() == MLLM_TYPE_F32);
+    assert(logits.head() == 1);
+    if (s < 0) {
+        s = logits.sequence() - 1;
+    }
+    if (!logits.aggregated() && (logits.ctype() == BSHD || logits.ctype() == SBHD)) {
+        return logits.ptrAt<float>(b, 0, s, 0);
+    }
+    row.resize(logits.dimension());
+    for (int d = 0; d < logits.dimension(); ++d) {
+        row[d] = logits.dataAt<float>(b, 0, s, d);
+    }
+    return row.data();
+}
+
+token_id_t Sampler::greedy(const float *logits, int n) {
+    if (n <= 0) {
+        throw std::invalid_argument("Input vector is empty");
+    }
+    const float best = max_row_fp32(n, logits);
+    const float *it = std::find(logits, logits + n, best);
+    return it == logits + n ? 0 : (token_id_t)(it - logits);
+}
+
+token_id_t Sampler::greedy(Tensor &logits, int b, int s) {
+    vector<float> row;
+    return greedy(sampler_row(logits, b, s, row), logits.dimension());
+}
+
+token_id_t Sampler::sample(Tensor &logits, int b, int s) {
+    vector<float> gathered;
+    return sample(sampler_row(logits, b, s, gathered), logits.dimension());
+}
+
+double Sampler::uniform() {
+    // 53 random bits, the same on every standard library unlike std::uniform_real_distribution
+    return (double)(rng_() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void Sampler::candidates(const float *logits, int n) {
+    // min-p: p_i >= min_p * p_max  <=>  x_i >= x_max + T * ln(min_p)
+    float threshold = -INFINITY;
+    if (params_.min_p > 0) {
+        threshold = max_row_fp32(n, logits) + params_.temperature * std::log(params_.min_p);
+    }
+    ids_.clear();
+    for (int i = 0; i < n; ++i) {
+        if (logits[i] >= threshold && logits[i] != -INFINITY) {
+            ids_.push_back(i);
+        }
+    }
+    // ties go to the lower id, so a seed gives the same tokens whatever the partition order
+    auto better = [logits](int a, int b) {
+        return logits[a] > logits[b] || (logits[a] == logits[b] && a < b);
+    };
+    if (params_.top_k > 0 && params_.top_k < (int)ids_.size()) {
+        std::nth_element(ids_.begin(), ids_.begin() + params_.top_k, ids_.end(), better);
+        ids_.resize(params_.top_k);
+    }
+    // top-p walks the candidates from the most likely one
+    if (params_.top_p < 1) {
+        std::sort(ids_.begin(), ids_.end(), better);
+    }
+    logits_.resize(ids_.size());
+    for (size_t i = 0; i < ids_.size(); ++i) {
+        logits_[i] = logits[ids_[i]];
+    }
+}
+
+token_id_t Sampler::sample(const float *logits, int n) {
+    assert(n > 0);
+    const int last_n = std::min((int)history_.size(), params_.penalty_last_n);
+    const bool penalize = params_.repetition_penalty != 1 && last_n > 0;
+    if (penalize || constraint_ != nullptr) {
+        row_.assign(logits, logits + n);
+        logits = row_.data();
+    }
+    if (constraint_ != nullptr) {
+        const auto &allowed = constraint_->allowed();
+        // nothing left to draw: end the sequence instead of returning a token the constraint rejects
+        if (!any_allowed(allowed, n)) {
+            return constraint_->eos();
+        }
+        mask_logits(row_.data(), n, allowed);
+    }
+    if (penalize) {
+        vector<token_id_t> recent(history_.end() - last_n, history_.end());
+        std::sort(recent.begin(), recent.end());
+        recent.erase(std::unique(recent.begin(), recent.end()), recent.end());
+        for (auto id : recent) {
+            if ((int)id < n) {
+                float &x = row_[id];
+                x = x > 0 ? x / params_.repetition_penalty : x * params_.repetition_penalty;
+            }
+        }
+    }
+    token_id_t token;
+    if (params_.temperature > 0) {
+        candidates(logits, n);
+    }
+    if (params_.temperature <= 0 || ids_.empty()) { // no candidates if the logits are NaN
+        token = greedy(logits, n);
+    } else {
+        const int m = ids_.size();
+        probs_.resize(m);
+        softmax_row_fp32(m, logits_.data(), probs_.data(), 1.0f / params_.temperature, m);
+        int keep = m;
+        double mass = 0;
+        if (params_.top_p < 1) {
+            for (keep = 0; keep < m && mass < params_.top_p; ++keep) {
+                mass += probs_[keep];
+            }
+        } else {
+            for (int i = 0; i < m; ++i) {
+                mass += probs_[i];
+            }
+        }
+        const double target = uniform() * mass;
+        double cumulative = 0;
+        int chosen = keep - 1;
+        for (int i = 0; i < keep; ++i) {
+            cumulative += probs_[i];
+            if (target < cumulative) {
+                chosen = i;
+                break;
+            }
+        }
+        token = ids_[std::max(chosen, 0)];
+    }
+    if (constraint_ != nullptr) {
+        constraint_->accept(token);
+    }
+    history_.push_back(token);
+    if ((int)history_.size() > 2 * std::max(params_.penalty_last_n, 64)) {
+        history_.erase(history_.begin(), history_.end() - params_.penalty_last_n);
+    }
+    return token;
+}
+
+} // namespace mllm
@@ -0,0 +1,80 @@
+#ifndef MLLM_SAMPLER_HPP
+#define MLLM_SAMPLER_HPP
+
+#include "Tensor.hpp"
+#include "tokenizers/Tokenizer.hpp"
+
+#include <random>
+
+namespace mllm {
+
+class TokenConstraint;
+
+/**
+ * \brief How the next token is drawn from a row of logits. The defaults are greedy decoding.
+ */
+struct SamplingParams {
+    float temperature = 0;          // <= 0: greedy, the other fields but repetition_penalty are ignored
+    int top_k = 0;                  // keep the k most likely tokens, 0 for all
+    float top_p = 1;                // then the fewest tokens whose probability adds up to top_p
+    float min_p = 0;                // and only those at least min_p times as likely as the best one
+    float repetition_penalty = 1;   // > 1 makes the last penalty_last_n tokens less likely
+    int penalty_last_n = 64;
+    uint64_t seed = 0;
+};
+
+/**
+ * \brief Chooses tokens from the logits of a model, shared by the tokenizers' detokenize and the
+ *        BatchScheduler. It reads the logits row in place: greedy decoding is one vectorized max over
+ *        it, and sampling runs the top-k / min-p cut on the logits (quickselect, no sort of the vocab)
+ *        before the vectorized softmax, so only the candidates left are sorted for top-p.
+ *
+ *        A Sampler remembers the tokens it returned (and those given to accept) for the repetition
+ *        penalty; its RNG is seeded from params.seed, so a run is reproducible. With a
+ *        TokenConstraint (e.g. a JsonConstraint) it only draws the tokens the constraint allows, and
+ *        returns the constraint's eos() when it allows none.
+ */
+class Sampler {
+public:
+    explicit Sampler(SamplingParams params = {});
+
+    // the next token from row (b, s) of logits [batch, 1, seq, vocab], the last position for s < 0
+    token_id_t sample(Tensor &logits, int b = 0, int s = -1);
+    token_id_t sample(const float *logits, int n);
+    // tokens that precede the generated ones, e.g. the prompt, as far as the repetition penalty goes
+    void accept(const vector<token_id_t> &tokens);
+    // forget the history and reseed
+    void reset();
+    // not owned; nullptr for none
+    void setConstraint(TokenConstraint *constraint) {
+        constraint_ = constraint;
+    }
+
+    // the first best logit of row (b, s) of logits, the last position for s < 0
+    static token_id_t greedy(Tensor &logits, int b = 0, int s = -1);
+    static token_id_t greedy(const float *logits, int n);
+
+    const SamplingParams &params() const {
+        return params_;
+    }
+
+private:
+    // the candidates left by top-k and min-p, in ids_ / logits_
+    void candidates(const float *logits, int n);
+    // a uniform draw from [0, 1)
+    double uniform();
+
+    SamplingParams params_;
+    std::mt19937_64 rng_;
+    TokenConstraint *constraint_ = nullptr;
+    vector<token_id_t> history_;
+    // scratch reused across calls
+    vector<float> row_;
+    vector<int> ids_;
+    vector<float> logits_;
+    vector<float> probs_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_SAMPLER_HPP
@@ -46,6 +46,23 @@ void Tensor::alloc() {
     if (!shape_offset_.empty() & !shape_master_.empty()) {
         return;
     }
+    if (alias_source_ != nullptr) {
+        if (alias_source_->host_ptr_ != nullptr && alias_source_->shape_ == shape_
+            && alias_source_->ctype_ == ctype_ && alias_source_->dtype_ == dtype_) {
+            host_ptr_ = alias_source_->host_ptr_;
+            allocated_ = count_;
+            return;
+        }
+        unalias();
+    }
+    if (shared_memory_ != nullptr) {
+        if (allocated_ == count_) {
+            return;
+        }
+        // shared with other Tensors, which keep it: take memory of our own
+        shared_memory_ = nullptr;
+        host_ptr_ = nullptr;
+    }
     if (allocated_ != count_) {
         if (host_ptr_ != nullptr) {
             backend_->free(host_ptr_);
@@ -92,6 +109,7 @@ Tensor& Tensor::getFunc(const std::string& suffix, const TensorFuncType type, ve
             tensorPtrs.push_back(other_tensor);
         }
         func->setup(gph_[next_name], tensorPtrs, float_args);
+        Module::traceStep(tensorPtrs, std::array<Tensor *, 1>{&gph_[next_name]}, func->inPlace());
         break;
     }
     case TENSOR_STATIC_READY: {
@@ -100,6 +118,7 @@ Tensor& Tensor::getFunc(const std::string& suffix, const TensorFuncType type, ve
             tensorPtrs.push_back(other_tensor);
         }
         func->execute(gph_[next_name], tensorPtrs, float_args);
+        backend_->advanceEpoch();
         break;
     }
     default: {
@@ -238,10 +257,12 @@ Tensor& Tensor::getStaticFunc(const std::string& suffix, const TensorFuncType ty
             gph_[next_name].setName(next_name);
         }
         func->setup(gph_[next_name], other_tensors, float_args);
+        Module::traceStep(other_tensors, std::array<Tensor *, 1>{&gph_[next_name]}, false);
         break;
     }
     case TENSOR_STATIC_READY: {
         func->execute(gph_[next_name], other_tensors, float_args);
+        backend_h->advanceEpoch();
         break;
     }
     default: {
@@ -265,6 +286,11 @@ Tensor &Tensor::mm(Tensor &input0, Tensor &input1) {
     return getStaticFunc(next_name, FUNC_MM, {}, {&gph_[input0.name()], &gph_[input1.name()]});
 }
 
+Tensor &Tensor::mm(Tensor &input0, Tensor &input1, CausalMMType causal) {
+    const std::string next_name = input0.name() + "-mm-" + input1.name();
+    return getStaticFunc(next_name, FUNC_MM, {(float)causal}, {&gph_[input0.name()], &gph_[input1.name()]});
+}
+
 Tensor &Tensor::range(int start, int end) {
     const std::string next_name = "range-" + std::to_string(start) + "-" + std::to_string(end);
     return getStaticFunc(next_name, FUNC_RANGE, {(float)start, (float)end});
@@ -63,7 +63,7 @@ public:
         backend_(bn), host_ptr_(), capacity_(0), dtype_(MLLM_TYPE_F32) {
     }
     ~Tensor() {
-        if (host_ptr_ != nullptr && masterTensor() == nullptr && !aggregated_&& gph_.find(name_) == gph_.end()) {
+        if (host_ptr_ != nullptr && masterTensor() == nullptr && !aggregated_ && alias_source_ == nullptr && shared_memory_ == nullptr && gph_.find(name_) == gph_.end()) {
             backend_->free(host_ptr_);
             host_ptr_ = nullptr;
         }
@@ -106,6 +106,11 @@ private:
     Chl aggregated_dim_;
     vector<int> aggregated_dims_;
 
+    // used for in-place outputs: the memory belongs to alias_source_
+    Tensor *alias_source_ = nullptr;
+    // set once the memory is shared with other Tensors, which free it with the last of them (shareMemory)
+    shared_ptr<void> shared_memory_;
+
 public:
     /**
      * \brief build 4-D Tensor with four dimensions: [batch, head, sequence, dimension].
@@ -150,6 +155,16 @@ public:
      */
     void free() {
         if (aggregated_) { return; }
+        if (alias_source_ != nullptr) {
+            unalias();
+            return;
+        }
+        if (shared_memory_ != nullptr) {
+            shared_memory_ = nullptr;
+            host_ptr_ = nullptr;
+            allocated_ = 0;
+            return;
+        }
         if (host_ptr_ != nullptr && masterTensor() == nullptr) {
             backend_->free(host_ptr_);
             host_ptr_ = nullptr;
@@ -548,7 +563,7 @@ public:
     void setName(string name) {
         name_ = name;
     }
-    string name() const {
+    const string &name() const {
         return name_;
     }
     int allocted() const {
@@ -732,6 +747,8 @@ public:
     Tensor &clip(Chl keep_axis, vector<int> b, vector<int> h, vector<int> s, vector<int> d);
     static Tensor& cat(vector<Tensor> input_tensors, Chl dims);;
     static Tensor& mm(Tensor& input0, Tensor& input1);
+    // attention matmul that only computes the causally visible part, see CausalMMType
+    static Tensor& mm(Tensor& input0, Tensor& input1, CausalMMType causal);
     Tensor& norm(int L_n);
     Tensor& where(float value, Chl axis);
     static Tensor& range(int start, int end);
@@ -958,6 +975,67 @@ public:
         return aggregated_dim_;
     }
 
+    /* Functions used for in-place outputs and shared memory:
+     * - aliasFrom
+     * - unalias
+     * - aliasSource
+     * - shareMemory
+     * - useMemory
+     */
+
+    /**
+     * \brief let this Tensor use the memory of source instead of its own, so an op whose output is
+     *        this Tensor runs in place over source. Unlike a ChildTensor it stays a plain Tensor
+     *        for the kernels; it never frees the memory, and alloc() re-reads source's pointer, or
+     *        falls back to allocating when shape, layout or dtype no longer match.
+     * \param source the Tensor whose memory is reused, normally the op's inputs[0].
+     */
+    void aliasFrom(Tensor *source) {
+        assert(masterTensor() == nullptr && !aggregated_);
+        free();
+        alias_source_ = source;
+        host_ptr_ = nullptr;
+        allocated_ = 0;
+        alloc();
+    }
+    /**
+     * \brief let other Tensors share the memory of this allocated Tensor (useMemory), e.g. a weight
+     *        tied to another one. From then on the memory is freed with the last Tensor using it.
+     * \return the memory, which frees itself through the backend.
+     */
+    shared_ptr<void> shareMemory() {
+        assert(masterTensor() == nullptr && !aggregated_ && alias_source_ == nullptr && host_ptr_ != nullptr);
+        if (shared_memory_ == nullptr) {
+            auto *backend = backend_;
+            shared_memory_ = shared_ptr<void>(host_ptr_, [backend](void *ptr) { backend->free(ptr); });
+        }
+        return shared_memory_;
+    }
+    /**
+     * \brief use \p memory from shareMemory() instead of memory of its own; it must hold cntSize() bytes.
+     */
+    void useMemory(shared_ptr<void> memory) {
+        assert(masterTensor() == nullptr && !aggregated_);
+        if (memory == shared_memory_) {
+            return;
+        }
+        free();
+        host_ptr_ = memory.get();
+        shared_memory_ = std::move(memory);
+        allocated_ = count_;
+    }
+    /**
+     * \brief stop sharing the memory of aliasSource(); the Tensor must be alloc()ed again.
+     */
+    void unalias() {
+        alias_source_ = nullptr;
+        host_ptr_ = nullptr;
+        allocated_ = 0;
+    }
+    Tensor *aliasSource() const {
+        return alias_source_;
+    }
+
     /* Functions used for 5-D Tensor:
      * - reshape
      * - channel
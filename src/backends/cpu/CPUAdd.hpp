@@ -12,6 +12,9 @@ public:
     virtual ~CPUAdd() = default;
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual bool inPlace() const override {
+        return true;
+    }
 
 
 private:
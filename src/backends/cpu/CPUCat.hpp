@@ -21,7 +21,6 @@ private:
     int thread_count = 4;
     Chl axis_;
     int expd_batch_;
-    int expd_batch_input_idx;
 };
 
 class CPUCatCreator : public CPUBackend::Creator {
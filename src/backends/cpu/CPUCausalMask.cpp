@@ -1,5 +1,7 @@
 
 #include "CPUCausalMask.hpp"
+#include "compute/Parallel.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace mllm {
@@ -18,43 +20,35 @@ ErrorCode CPUCausalMask::reshape(vector<shared_ptr<Tensor>> inputs, vector<share
 }
 
 ErrorCode CPUCausalMask::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    if(inputs[0]->sequence() >1 ) {
+    // run in place: only the masked entries need writing
+    const bool in_place = outputs[0]->hostPtr<float>() == inputs[0]->hostPtr<float>();
+    // a batch of sequences of different lengths: row n has its own keys, the rest is padding
+    const auto &batch = backend()->sequenceBatch();
+    if (inputs[0]->sequence() > 1 || batch.active()) {
         int batch_size = inputs[0]->batch();
         int head_num = inputs[0]->head();
         int sequence = inputs[0]->sequence();
         int dimension = inputs[0]->dimension();
-        int old_dim = dimension - sequence;
+        const vector<int> k_lens = batch.active() ? batch.keyLengths(sequence) : vector<int>(batch_size, dimension);
         for (int n = 0; n < batch_size; ++n) {
+            const int old_dim = std::min(k_lens[n], dimension) - sequence;
             for (int h = 0; h < head_num; ++h) {
                 for (int s = 0; s < sequence; ++s) {
-                    #pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dimension; ++d) {
+                    parallel_for(dimension, thread_count, [&](int d) {
                         if (d > s + old_dim) {
                             outputs[0]->setDataAt<float>({n, h, s, d}, -INFINITY);
                         }
-                        else{
+                        else if (!in_place) {
                             outputs[0]->setDataAt<float>({n, h, s, d}, inputs[0]->dataAt<float>(n, h, s, d));
                         }
-                    }
+                    });
                 }
             }
         }
     }
-    else{
+    else if (!in_place) {
         outputs[0]->copyFrom(inputs[0]);
     }
     return Op::execute(inputs, outputs);
 }
-
-ErrorCode CPUCausalMask::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    assert(inputs.size() == 1);
-    assert(outputs.size() == 1);
-    if(inputs[0]->masterTensor() == nullptr) {
-        inputs[0]->free(); // TODO remove
-    }
-    outputs[0]->setDtype(activation_dtype());
-    outputs[0]->alloc();
-    inputs[0]->deepCopyFrom(outputs[0].get(), false);
-    return MLLM_NO_ERROR;
-}
 } // namespace mllm
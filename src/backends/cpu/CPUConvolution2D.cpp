@@ -16,6 +16,8 @@ Op(bn, opName) {
     support_bias_ = bias;
     weight_.setBackend(bn);
     bias_.setBackend(bn);
+    kernel_.setBackend(bn);
+    workspace_.setBackend(bn);
 }
 
 ErrorCode CPUConvolution2D::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -53,11 +55,11 @@ ErrorCode CPUConvolution2D::load(AbstructLoader &loader) {
         weight_.setDtype(loader.getDataType(weight_.name()));
         weight_.alloc();
         loader.load(&weight_);
-        kernal_ = reshape_conv2d_kernal_fp32(&weight_);
+        conv2d_kernel_fp32(&weight_, &kernel_);
     } else {
         weight_.setDtype(MLLM_TYPE_F32);
         weight_.alloc();
-        kernal_ = reshape_conv2d_kernal_fp32(&weight_);
+        conv2d_kernel_fp32(&weight_, &kernel_);
     }
     if (support_bias_) {
         bias_.setName(name() + ".bias");
@@ -78,11 +80,11 @@ ErrorCode CPUConvolution2D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
 
     switch (padding_type_) {
     case SAME:{
-        conv2d_fp32_SAME(inputs[0].get(), outputs[0].get(), kernal_, kernel_size_[0], kernel_size_[1], support_bias_, &bias_, stride_[0], stride_[1], padding_h_, padding_w_, thread_count);
+        conv2d_fp32_SAME(inputs[0].get(), outputs[0].get(), &kernel_, kernel_size_[0], kernel_size_[1], support_bias_, &bias_, stride_[0], stride_[1], padding_h_, padding_w_, thread_count, &workspace_);
         break;
     }
     case VALID: {
-        conv2d_fp32_VALID(inputs[0].get(), outputs[0].get(),  kernal_, kernel_size_[0], kernel_size_[1], support_bias_, &bias_,stride_[0], stride_[1], thread_count);
+        conv2d_fp32_VALID(inputs[0].get(), outputs[0].get(), &kernel_, kernel_size_[0], kernel_size_[1], support_bias_, &bias_, stride_[0], stride_[1], thread_count, &workspace_);
         break;
     }
     }
@@ -92,6 +94,8 @@ ErrorCode CPUConvolution2D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
 ErrorCode CPUConvolution2D::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
 
     weight_.free();
+    kernel_.free();
+    workspace_.free();
     return Op::free(inputs, outputs);
 }
 
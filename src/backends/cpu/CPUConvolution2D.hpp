@@ -34,7 +34,8 @@ private:
     Tensor weight_;
     Tensor bias_;
 
-    float ** kernal_;
+    Tensor kernel_;    // weight_ repacked to one row per output channel, see conv2d_kernel_fp32
+    Tensor workspace_; // the receptive fields of the input, one per row, reused across calls
     bool support_bias_;
 
 };
@@ -18,6 +18,8 @@ Op(bn, opName) {
     support_bias_ = bias;
     weight_.setBackend(bn);
     bias_.setBackend(bn);
+    kernel_.setBackend(bn);
+    workspace_.setBackend(bn);
 }
 
 ErrorCode CPUConvolution3D::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -60,11 +62,11 @@ ErrorCode CPUConvolution3D::load(AbstructLoader &loader) {
         weight_.setDtype(loader.getDataType(weight_.name()));
         weight_.alloc();
         loader.load(&weight_);
-        kernal_ = reshape_conv3d_kernal_fp32(&weight_);
+        conv3d_kernel_fp32(&weight_, &kernel_);
     } else {
         weight_.setDtype(MLLM_TYPE_F32);
         weight_.alloc();
-        kernal_ = reshape_conv3d_kernal_fp32(&weight_);
+        conv3d_kernel_fp32(&weight_, &kernel_);
     }
     if (support_bias_) {
         bias_.setName(name() + ".bias");
@@ -91,7 +93,7 @@ ErrorCode CPUConvolution3D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
     }
     case VALID: {
         // conv3d_fp32_VALID(inputs[0].get(), outputs[0].get(), &weight_, support_bias_, &bias_,stride_[0], stride_[1], stride_[2], thread_count);
-        conv3d_fp32_VALID(inputs[0].get(), outputs[0].get(),   kernal_, kernel_size_[0], kernel_size_[1],  kernel_size_[2], support_bias_, &bias_,stride_[0], stride_[1], stride_[2], thread_count);
+        conv3d_fp32_VALID(inputs[0].get(), outputs[0].get(), &kernel_, kernel_size_[0], kernel_size_[1], kernel_size_[2], support_bias_, &bias_, stride_[0], stride_[1], stride_[2], thread_count, &workspace_);
         break;
     }
     }
@@ -101,6 +103,8 @@ ErrorCode CPUConvolution3D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
 ErrorCode CPUConvolution3D::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
 
     weight_.free();
+    kernel_.free();
+    workspace_.free();
     return Op::free(inputs, outputs);
 }
 
@@ -35,7 +35,8 @@ private:
     Tensor weight_;
     Tensor bias_;
 
-    float ** kernal_;
+    Tensor kernel_;    // weight_ repacked to one row per output channel, see conv3d_kernel_fp32
+    Tensor workspace_; // the receptive fields of the input, one per row, reused across calls
     bool support_bias_;
 
 };
@@ -1,7 +1,6 @@
 #include "CPUEmbedding.hpp"
 #include "ParamLoader.hpp"
-#include "quantize/QuantizeQ4.hpp"
-#include "quantize/QuantizeQ8.hpp"
+#include "compute/Embedding.hpp"
 
 namespace mllm {
 CPUEmbedding::CPUEmbedding(Backend *bn,  string opName, int hiddenSize, int vocabSize, int threadCount) : thread_count(threadCount),
@@ -39,84 +38,8 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
 
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
-    auto &input = inputs[0];
-    auto &output = outputs[0];
-    switch (weight_.dtype()) {
-    case MLLM_TYPE_F32: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) { // NOLINT(*-use-default-none)
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    memcpy(output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                           weight_.hostPtr<float>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0),
-                           weight_.dtypeSize() * hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_Q4_0: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-            #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q4_0(weight_.hostPtr<block_q4_0>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0)/(QK4_0),
-                                        output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_Q4_K: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q4_K(weight_.hostPtr<block_q4_K>() + weight_.offset(0, 0, (int)inputs[0]->dataAt<float>(batch, head, seq, 0), 0)/(QK_K),
-                                        outputs[0]->hostPtr<float>() + outputs[0]->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_Q8_0: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q8_0(weight_.hostPtr<block_q8_0>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0)/(QK8_0),
-                                        output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_Q8_K: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q8_K(weight_.hostPtr<block_q8_K>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0)/(QK_K),
-                                        output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_F16: break;
-    case MLLM_TYPE_Q4_1: break;
-    case MLLM_TYPE_Q8_1: break;
-    case MLLM_TYPE_Q6_K: break;
-    case MLLM_TYPE_I8: break;
-    case MLLM_TYPE_I16: break;
-    case MLLM_TYPE_I32: break;
-    case MLLM_TYPE_COUNT: break;
-    }
-    return MLLM_NO_ERROR;
+    embedding_fp32(&weight_, inputs[0].get(), outputs[0].get(), thread_count);
+    return Op::execute(inputs, outputs);
 }
 ErrorCode CPUEmbedding::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     weight_.free();
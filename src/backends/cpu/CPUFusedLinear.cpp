@@ -0,0 +1,238 @@
+
+#include "CPUFusedLinear.hpp"
+#include "compute/Parallel.hpp"
+#include "quantize/Quantize.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace mllm {
+
+CPUFusedLinear::CPUFusedLinear(Backend *bn, string opName, int in_features, vector<int> out_features, bool bias, GLUType glu,
+                               RoPEType rope_type, int rope_head_dim, float rope_theta, int rope_pos_max, RoPEScaling rope_scaling, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    in_features_ = in_features;
+    out_features_ = std::move(out_features);
+    support_bias_ = bias;
+    glu_ = glu;
+    rope_type_ = rope_type;
+    rope_head_dim_ = rope_head_dim;
+    rope_theta_ = rope_theta;
+    rope_scaling_ = rope_scaling;
+    rope_pos_max_ = rope_type_ == NONE ? rope_pos_max : rope_resolve_scaling(rope_scaling_, rope_pos_max);
+    std::stringstream names(opName);
+    string part;
+    while (std::getline(names, part, '+')) {
+        part_names_.push_back(part);
+    }
+    assert(part_names_.size() == out_features_.size());
+    assert(glu_ == GLU_NONE || (out_features_.size() == 2 && out_features_[0] == out_features_[1] && !support_bias_));
+    assert(rope_type_ == NONE || (glu_ == GLU_NONE && out_features_.size() >= 2 && rope_head_dim_ > 0));
+    weight_.setBackend(bn);
+    bias_.setBackend(bn);
+    workspace_.setBackend(bn);
+}
+
+ErrorCode CPUFusedLinear::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 1);
+    assert(outputs.size() == (glu_ == GLU_NONE ? out_features_.size() : 1));
+    if (inputs[0]->count() == 0) {
+        for (auto &output : outputs) {
+            output->reshape(0, 0, 0, 0);
+        }
+        return Op::reshape(inputs, outputs);
+    }
+    // the RoPE epilogue splits a row [1, heads * head_dim] into heads
+    assert(inputs[0]->head() == 1 || rope_type_ == NONE);
+    assert(in_features_ == inputs[0]->dimension());
+    if (glu_ != GLU_NONE) {
+        outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), out_features_[0]);
+        return Op::reshape(inputs, outputs);
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        outputs[i]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), out_features_[i]);
+    }
+    if (rope_type_ != NONE) {
+        const auto &batch = backend()->sequenceBatch();
+        const int pos_end = batch.active() ? *std::max_element(batch.positions.begin(), batch.positions.end()) : rope_pos_;
+        rope_table_ = rope_table(rope_type_, rope_head_dim_, rope_theta_, rope_pos_max_, rope_scaling_, pos_end + inputs[0]->sequence());
+    }
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPUFusedLinear::load(AbstructLoader &loader) {
+    int out_total = 0;
+    DataType dtype = loader.getDataType(part_names_[0] + ".weight");
+    for (size_t i = 0; i < part_names_.size(); ++i) {
+        out_total += out_features_[i];
+        if (loader.getDataType(part_names_[i] + ".weight") != dtype) {
+            dtype = MLLM_TYPE_COUNT;
+        }
+        // the packed bias is F32; a part bias is copied, or converted from F16
+        const DataType bias_dtype = support_bias_ ? loader.getDataType(part_names_[i] + ".bias") : MLLM_TYPE_F32;
+        if (bias_dtype != MLLM_TYPE_F32 && bias_dtype != MLLM_TYPE_F16 && bias_dtype != MLLM_TYPE_COUNT) {
+            dtype = MLLM_TYPE_COUNT;
+        }
+    }
+    packed_ = dtype != MLLM_TYPE_COUNT;
+    // parts are loaded one by one; when packing they are then copied row-aligned into weight_
+    part_weight_.clear();
+    part_bias_.clear();
+    for (size_t i = 0; i < part_names_.size(); ++i) {
+        auto w = std::make_shared<Tensor>(backend());
+        w->setName(part_names_[i] + ".weight");
+        w->reshape(1, 1, out_features_[i], in_features_);
+        if (loader.getDataType(w->name()) != MLLM_TYPE_COUNT) {
+            w->setDtype(loader.getDataType(w->name()));
+            w->alloc();
+            loader.load(w.get());
+        } else {
+            w->setDtype(MLLM_TYPE_F32);
+            w->alloc();
+        }
+        part_weight_.push_back(w);
+        if (support_bias_) {
+            auto b = std::make_shared<Tensor>(backend());
+            b->setName(part_names_[i] + ".bias");
+            b->reshape(1, 1, 1, out_features_[i]);
+            if (loader.getDataType(b->name()) != MLLM_TYPE_COUNT) {
+                b->setDtype(loader.getDataType(b->name()));
+                b->alloc();
+                loader.load(b.get());
+            } else {
+                b->setDtype(MLLM_TYPE_F32);
+                b->alloc();
+            }
+            part_bias_.push_back(b);
+        }
+    }
+    if (packed_) {
+        weight_.setName(name() + ".weight");
+        weight_.reshape(1, 1, out_total, in_features_);
+        weight_.setDtype(dtype);
+        weight_.alloc();
+        size_t offset = 0;
+        for (auto &w : part_weight_) {
+            memcpy(weight_.hostPtr<char>() + offset, w->hostPtr<char>(), w->cntSize());
+            offset += w->cntSize();
+            w->free();
+        }
+        part_weight_.clear();
+        if (support_bias_) {
+            bias_.setName(name() + ".bias");
+            bias_.reshape(1, 1, 1, out_total);
+            bias_.setDtype(MLLM_TYPE_F32);
+            bias_.alloc();
+            int n = 0;
+            for (auto &b : part_bias_) {
+                if (b->dtype() == MLLM_TYPE_F16) {
+                    mllm_fp16_to_fp32_row(b->hostPtr<mllm_fp16_t>(), bias_.hostPtr<float>() + n, b->dimension());
+                } else {
+                    memcpy(bias_.hostPtr<float>() + n, b->hostPtr<float>(), b->cntSize());
+                }
+                n += b->dimension();
+                b->free();
+            }
+            part_bias_.clear();
+        }
+    }
+    return Op::load(loader);
+}
+
+ErrorCode CPUFusedLinear::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto vec_dot_type = mat_mul_vec_dot_type(packed_ ? weight_.dtype() : part_weight_[0]->dtype());
+    if (inputs[0]->count() != 0 && vec_dot_type != MLLM_TYPE_F32) {
+        mat_mul_workspace(&workspace_, inputs[0].get(), vec_dot_type);
+    }
+    if (glu_ != GLU_NONE && !packed_) {
+        glu_parts_.resize(2);
+        for (auto &part : glu_parts_) {
+            if (part == nullptr) {
+                part = std::make_shared<Tensor>(backend());
+            }
+            part->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), out_features_[0]);
+            part->setDtype(MLLM_TYPE_F32);
+            part->alloc();
+        }
+    }
+    return Op::setUp(inputs, outputs);
+}
+
+ErrorCode CPUFusedLinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    if (inputs[0]->count() == 0) {
+        return Op::execute(inputs, outputs);
+    }
+    if (glu_ != GLU_NONE && packed_) {
+        mat_mul_fp32_glu(inputs[0].get(), &weight_, outputs[0].get(), glu_, thread_count, &workspace_);
+        return Op::execute(inputs, outputs);
+    }
+    vector<Tensor *> dsts;
+    if (glu_ != GLU_NONE) {
+        dsts = {glu_parts_[0].get(), glu_parts_[1].get()};
+    } else {
+        for (auto &output : outputs) {
+            dsts.push_back(output.get());
+        }
+    }
+    if (packed_) {
+        mat_mul_fp32_multi_dst(inputs[0].get(), &weight_, dsts, support_bias_, &bias_, thread_count, &workspace_);
+    } else {
+        Tensor *src0 = inputs[0].get();
+        for (size_t i = 0; i < dsts.size(); ++i) {
+            auto vec_dot_type = mat_mul_vec_dot_type(part_weight_[i]->dtype());
+            // parts with the same vec_dot type reuse the converted input
+            if (src0->dtype() != vec_dot_type) {
+                src0 = mat_mul_src0_as(inputs[0].get(), vec_dot_type, &workspace_, thread_count);
+            }
+            mat_mul_fp32_multi_dst(src0, part_weight_[i].get(), {dsts[i]}, support_bias_,
+                                   support_bias_ ? part_bias_[i].get() : nullptr, thread_count, &workspace_);
+        }
+    }
+    if (glu_ != GLU_NONE) {
+        // row by row, since the output may be a slice of a larger tensor (see cat_bind_inputs)
+        auto &out = outputs[0];
+        const int dim = out->dimension();
+        parallel_for(out->batch(), out->head(), out->sequence(), thread_count, [&](int b, int h, int s) {
+            const float *gate = glu_parts_[0]->ptrAt<float>(b, h, s, 0);
+            const float *up = glu_parts_[1]->ptrAt<float>(b, h, s, 0);
+            float *y = out->ptrAt<float>(b, h, s, 0);
+            for (int d = 0; d < dim; ++d) {
+                y[d] = (glu_ == GLU_GELU ? mllm_gelu_f32(gate[d]) : mllm_silu_f32(gate[d])) * up[d];
+            }
+        });
+    }
+    if (rope_type_ != NONE) {
+        // rotate q and k while their rows are still in cache
+        const auto &batch = backend()->sequenceBatch();
+        if (batch.active()) { // each row at the position of its own sequence
+            rope_heads_fp32(outputs[0].get(), rope_head_dim_, *rope_table_, batch.positions, thread_count);
+            rope_heads_fp32(outputs[1].get(), rope_head_dim_, *rope_table_, batch.positions, thread_count);
+            return Op::execute(inputs, outputs);
+        }
+        rope_heads_fp32(outputs[0].get(), rope_head_dim_, *rope_table_, rope_pos_, thread_count);
+        rope_heads_fp32(outputs[1].get(), rope_head_dim_, *rope_table_, rope_pos_, thread_count);
+        rope_pos_ += inputs[0]->sequence();
+        if (rope_pos_ > rope_pos_max_) {
+            rope_pos_ = 0;
+        }
+    }
+    return Op::execute(inputs, outputs);
+}
+
+ErrorCode CPUFusedLinear::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    weight_.free();
+    bias_.free();
+    for (auto &w : part_weight_) {
+        w->free();
+    }
+    for (auto &b : part_bias_) {
+        b->free();
+    }
+    for (auto &part : glu_parts_) {
+        part->free();
+    }
+    workspace_.free();
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
@@ -0,0 +1,90 @@
+#ifndef MLLM_CPUFUSEDLINEAR_H
+#define MLLM_CPUFUSEDLINEAR_H
+
+#include "Op.hpp"
+#include "CPUBackend.hpp"
+#include "compute/Matmul.hpp"
+#include "compute/RoPE.hpp"
+
+namespace mllm {
+
+class Tensor;
+/**
+ * \brief Several Linears over one input (q/k/v, gate/up) computed in one pass.
+ * The op name is the '+'-joined list of the Linears' names; their weights (and biases) are
+ * concatenated along out_features into weight_ at load time. Rows never straddle a quant block,
+ * so packing is a plain byte concatenation as long as all parts share a dtype; otherwise each
+ * part keeps its own weight and is multiplied separately (still with one input conversion).
+ * With a GLU type set, the op takes exactly two parts (gate, up) and has a single output
+ * act(gate) * up, computed in the matmul epilogue (SwiGLU / GeGLU MLPs).
+ * With a RoPE type set, the first two outputs (q, k) are rotated in place right after the matmul,
+ * per head of rope_head_dim, and the op keeps the position counter a RoPE op would.
+ */
+class CPUFusedLinear final : public Op {
+public:
+    CPUFusedLinear(Backend *bn, string opName, int in_features, vector<int> out_features, bool bias, GLUType glu,
+                   RoPEType rope_type, int rope_head_dim, float rope_theta, int rope_pos_max, RoPEScaling rope_scaling, int threadCount);
+    virtual ~CPUFusedLinear() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+    Tensor &weight() {
+        return weight_;
+    }
+    bool packed() const {
+        return packed_;
+    }
+
+private:
+    int in_features_;
+    vector<int> out_features_;
+    vector<string> part_names_;
+    bool support_bias_;
+    GLUType glu_;
+    RoPEType rope_type_;
+    int rope_head_dim_;
+    float rope_theta_;
+    int rope_pos_max_;
+    RoPEScaling rope_scaling_;
+    int rope_pos_ = 0;
+    shared_ptr<const RoPETable> rope_table_;
+    int thread_count = 4;
+    bool packed_ = false;
+    Tensor weight_;                          // packed [1, 1, sum(out_features), in_features]
+    Tensor bias_;                            // packed [1, 1, 1, sum(out_features)]
+    vector<shared_ptr<Tensor>> part_weight_; // used when the parts have different dtypes
+    vector<shared_ptr<Tensor>> part_bias_;
+    vector<shared_ptr<Tensor>> glu_parts_; // gate/up outputs when a GLU runs on unpacked parts
+    Tensor workspace_;
+};
+
+class CPUFusedLinearCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int in_features = op_param["in_features"];
+        int fused_num = op_param["fused_num"];
+        vector<int> out_features;
+        for (int i = 0; i < fused_num; ++i) {
+            out_features.push_back((int)op_param["out_features_" + std::to_string(i)]);
+        }
+        int bias = op_param["bias"];
+        GLUType glu = (GLUType)op_param["glu"];
+        RoPEType rope_type = (RoPEType)op_param["rope_type"];
+        int rope_head_dim = op_param["rope_head_dim"];
+        float rope_theta = op_param["rope_theta"];
+        int rope_pos_max = op_param["max_position_embeddings"];
+        RoPEScaling rope_scaling;
+        rope_scaling.type = (RoPEScalingType)op_param["rope_scaling_type"];
+        rope_scaling.factor = op_param["rope_scaling_factor"];
+        rope_scaling.original_max_position_embeddings = op_param["original_max_position_embeddings"];
+        return new CPUFusedLinear(bn, name, in_features, out_features, (bool)bias, glu,
+                                  rope_type, rope_head_dim, rope_theta, rope_pos_max, rope_scaling, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUFUSEDLINEAR_H
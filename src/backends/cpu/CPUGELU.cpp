@@ -1,4 +1,5 @@
 #include "CPUGELU.hpp"
+#include "compute/Parallel.hpp"
 
 #include <cmath>
 #include <utility>
@@ -25,21 +26,16 @@ ErrorCode CPUGELU::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     int head = input->head();
     int seq = input->sequence();
     int dim = input->dimension();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int b = 0; b <batch ; ++b) {
-        for (int h = 0; h < head; ++h) {
-            for (int s = 0; s < seq; ++s) {
+    parallel_for(batch , head, seq, thread_count, [&](int b, int h, int s) {
 //                for (int d = 0; d < dim; ++d) {
 //                    float value = input->dataAt<float>(b, h, s, d);
 //                    // output->setDataAt<float>(b, h, s, d, 0.5 * value * (1 + std::tanh(std::sqrt(2 / M_PI) * (value + 0.044715 * std::pow(value, 3)))));
 //                    output->setDataAt<float>(b, h, s, d, 0.5 * value * (1 + std::tanh(std::sqrt(2 / M_PI) * (0.7978845608 * (value + 0.044715 * std::pow(value, 3))))));
 //;
 //                }
-                mllm_vec_gelu_f32(dim,  outputs[0]->ptrAt<float>(b, h, s,0),
-                            inputs[0]->ptrAt<float>(b, h, s,0));
-            }
-        }
-    }
+        mllm_vec_gelu_f32(dim,  outputs[0]->ptrAt<float>(b, h, s,0),
+                    inputs[0]->ptrAt<float>(b, h, s,0));
+    });
     return Op::execute(inputs, outputs);
 }
 
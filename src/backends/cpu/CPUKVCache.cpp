@@ -1,7 +1,10 @@
 
 
 #include "CPUKVCache.hpp"
+#include "compute/Parallel.hpp"
 #include "ParamLoader.hpp"
+#include "quantize/Quantize.hpp"
+#include <algorithm>
 
 namespace mllm {
 CPUKVCache::CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max, int threadCount) : thread_count(threadCount),
@@ -16,6 +19,10 @@ ErrorCode CPUKVCache::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_p
 
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
+    const auto &batch = backend()->sequenceBatch();
+    if (batch.active()) {
+        return reshapeSlots(inputs, outputs);
+    }
     if(cache_seq_len_ < 0) {
         cache_.reshape(inputs[0]->batch(), inputs[0]->head()*n_rep_, cache_limit_, inputs[0]->dimension());
         cache_.setName(name() + ".Cache");
@@ -34,12 +41,61 @@ ErrorCode CPUKVCache::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_p
     return Op::reshape(inputs, outputs);
 }
 
+ErrorCode CPUKVCache::reshapeSlots(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    const auto &batch = backend()->sequenceBatch();
+    assert(batch.first_slot + inputs[0]->batch() <= batch.slots);
+    if (cache_seq_len_ < 0 || cache_.batch() != batch.slots) {
+        cache_.reshape(batch.slots, inputs[0]->head() * n_rep_, cache_limit_, inputs[0]->dimension());
+        cache_.setName(name() + ".Cache");
+        cache_.alloc();
+        // rows shorter than the batch's longest are padded with whatever their slot holds, which the
+        // attention matmuls read with zero weight: start from zeros, not NaNs
+        memset(cache_.hostPtr<char>(), 0, cache_.cntSize());
+        cache_seq_len_ = 0;
+    }
+    const int len = *std::max_element(batch.positions.begin(), batch.positions.end()) + inputs[0]->sequence();
+    if (len > cache_limit_) {
+        std::cerr << "\n[ERROR]: Current tokens exceed cache limit: " << len << ">" << cache_limit_ << ";";
+        std::cerr << "\n         Please set args `--limits` >" << cache_limit_ << std::endl;
+        exit(1);
+    }
+    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head() * n_rep_, len, inputs[0]->dimension());
+    return Op::reshape(inputs, outputs);
+}
+
 ErrorCode CPUKVCache::load(AbstructLoader &loader) {
 
     return Op::load(loader);
 }
 
 ErrorCode CPUKVCache::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    const auto &batch = backend()->sequenceBatch();
+    if (batch.active()) {
+        // row b goes to its slot, after the positions[b] tokens its sequence already has
+        auto &input = inputs[0];
+        const int dim = input->dimension();
+        const bool rows = input->ctype() == BSHD && cache_.ctype() == BSHD;
+        parallel_for(input->batch(), input->head() * n_rep_, input->sequence(), thread_count, [&](int b, int cache_head, int s) {
+            const int h = cache_head / n_rep_;
+            const int slot = batch.first_slot + b;
+            const int pos = batch.positions[b] + s;
+            if (rows && input->dtype() == MLLM_TYPE_F32 && cache_.dtype() == MLLM_TYPE_F16) {
+                mllm_fp32_to_fp16_row(input->ptrAt<float>(b, h, s, 0), cache_.ptrAt<mllm_fp16_t>(slot, cache_head, pos, 0), dim);
+            } else if (rows && input->dtype() == MLLM_TYPE_F16 && cache_.dtype() == MLLM_TYPE_F16) {
+                memcpy(cache_.ptrAt<mllm_fp16_t>(slot, cache_head, pos, 0), input->ptrAt<mllm_fp16_t>(b, h, s, 0), dim * sizeof(mllm_fp16_t));
+            } else {
+                for (int d = 0; d < dim; ++d) {
+                    const float value = input->dtype() == MLLM_TYPE_F16 ? MLLM_FP16_TO_FP32(*input->ptrAt<mllm_fp16_t>(b, h, s, d)) : input->dataAt<float>(b, h, s, d);
+                    if (cache_.dtype() == MLLM_TYPE_F16) {
+                        *cache_.ptrAt<mllm_fp16_t>(slot, cache_head, pos, d) = MLLM_FP32_TO_FP16(value);
+                    } else {
+                        cache_.setDataAt<float>(slot, cache_head, pos, d, value);
+                    }
+                }
+            }
+        });
+        return Op::execute(inputs, outputs);
+    }
 
     int cache_seq_len_old = cache_seq_len_;
     cache_seq_len_ += inputs[0]->sequence();
@@ -47,45 +103,40 @@ ErrorCode CPUKVCache::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_p
         if(cache_.ctype() == BSHD) {
             for (int b = 0; b < cache_.batch(); ++b) {
                 for (int h = inputs[0]->head()-1; h >= 0; --h) {
-#pragma omp parallel for collapse(2) num_threads(thread_count)
-                    for (int seq = cache_seq_len_old; seq < cache_seq_len_; ++seq) {
-                        for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
-                            auto cache_head = h * n_rep_ + i_rep;
-                            if(cache_.dtype() == MLLM_TYPE_F32) {
-                                auto src_ptr = inputs[0]->ptrAt<float>(b, h, seq-cache_seq_len_old, 0);
-                                auto dest_ptr = cache_.ptrAt<float>(b, cache_head, seq, 0);
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
-                            }else if(cache_.dtype() == MLLM_TYPE_F16) {
-                                auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, seq-cache_seq_len_old, 0);
-                                auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, seq, 0);
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
-                            }
+                    parallel_for(cache_seq_len_ - cache_seq_len_old, n_rep_, thread_count, [&](int s, int i_rep) {
+                        const int seq = cache_seq_len_old + s;
+                        auto cache_head = h * n_rep_ + i_rep;
+                        if(cache_.dtype() == MLLM_TYPE_F32) {
+                            auto src_ptr = inputs[0]->ptrAt<float>(b, h, seq-cache_seq_len_old, 0);
+                            auto dest_ptr = cache_.ptrAt<float>(b, cache_head, seq, 0);
+                            int copy_size = cache_.dimension();
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
+                        }else if(cache_.dtype() == MLLM_TYPE_F16) {
+                            auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, seq-cache_seq_len_old, 0);
+                            auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, seq, 0);
+                            int copy_size = cache_.dimension();
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
                         }
-                    }
+                    });
                 }
             }
         }else if(cache_.ctype() == BHDS) {
             for (int b = 0; b < cache_.batch(); ++b) {
                 for (int h = inputs[0]->head() - 1; h >= 0; --h) {
-#pragma omp parallel for collapse(2) num_threads(thread_count)
-                    for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                        for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
-                            auto cache_head = h * n_rep_ + i_rep;
-                            if (cache_.dtype() == MLLM_TYPE_F32) {
-                                auto src_ptr = inputs[0]->ptrAt<float>(b, h, 0, d);
-                                auto dest_ptr = cache_.ptrAt<float>(b, cache_head, cache_seq_len_old, d);
-                                int copy_size = cache_seq_len_ - cache_seq_len_old;
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
-                            } else if (cache_.dtype() == MLLM_TYPE_F16) {
-                                auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, 0, d);
-                                auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, cache_seq_len_old, d);
-                                int copy_size = cache_seq_len_ - cache_seq_len_old;
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
-                            }
+                    parallel_for(inputs[0]->dimension(), n_rep_, thread_count, [&](int d, int i_rep) {
+                        auto cache_head = h * n_rep_ + i_rep;
+                        if (cache_.dtype() == MLLM_TYPE_F32) {
+                            auto src_ptr = inputs[0]->ptrAt<float>(b, h, 0, d);
+                            auto dest_ptr = cache_.ptrAt<float>(b, cache_head, cache_seq_len_old, d);
+                            int copy_size = cache_seq_len_ - cache_seq_len_old;
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
+                        } else if (cache_.dtype() == MLLM_TYPE_F16) {
+                            auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, 0, d);
+                            auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, cache_seq_len_old, d);
+                            int copy_size = cache_seq_len_ - cache_seq_len_old;
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
                         }
-                    }
+                    });
                 }
             }
         }else {
@@ -105,6 +156,13 @@ ErrorCode CPUKVCache::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
     outputs[0]->setDtype(cache_.dtype());
+    const auto &batch = backend()->sequenceBatch();
+    if (batch.active()) {
+        // the output views the batch's slots; the input keeps its own memory, as its rows are
+        // copied to different positions
+        outputs[0]->deepCopyFrom(cache_, false, {batch.first_slot, 0, 0, 0});
+        return MLLM_NO_ERROR;
+    }
     outputs[0]->deepCopyFrom(cache_, false, {0,0,cache_seq_len_/cache_limit_,0});
     if(inputs[0]->sequence() + cache_seq_len_ >cache_limit_) {
         outputs[0]->deepCopyFrom(cache_, false, {0,0,cache_seq_len_%cache_limit_ +1,0});
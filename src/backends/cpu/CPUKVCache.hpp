@@ -21,6 +21,9 @@ public:
     Tensor cache_;
 
 private:
+    // reshape when the backend's SequenceBatch is active: one cache row per slot
+    ErrorCode reshapeSlots(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs);
+
     int thread_count = 4;
 
     int cache_seq_len_= -999;
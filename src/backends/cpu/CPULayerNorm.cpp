@@ -3,6 +3,7 @@
 //
 
 #include "CPULayerNorm.hpp"
+#include "compute/Norm.hpp"
 
 namespace mllm {
 CPULayerNorm::CPULayerNorm(Backend *bn, string opName,int normSize,bool bias, float epsilon, int threadCount) : thread_count(threadCount),
@@ -41,50 +42,22 @@ ErrorCode CPULayerNorm::load(AbstructLoader &loader) {
     return Op::load(loader);
 }
 ErrorCode CPULayerNorm::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    // with two inputs the op is a fused residual add: outputs are {input + residual, norm(input + residual)}
     assert(normSize_ == inputs[0]->dimension());
-    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
+    assert(outputs.size() == inputs.size());
+    for (auto &output : outputs) {
+        output->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
+    }
     return Op::reshape(inputs, outputs);
 }
 
 ErrorCode CPULayerNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    auto input = inputs[0];
-    auto output = outputs[0];
-    int batch = input->batch();
-    int dim = input->dimension();
-    int seq = input->sequence();
-    int head = input->head();
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                float sum_squares = 0.0F;
-                float sum = 0.0F;
-// sum
-// #pragma omp parallel for reduction(+ : sum_squares) reduction(+ : sum) num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum += value;
-                }
-                float mean = sum / dim;
-// #pragma omp parallel for reduction(+ : sum_squares) num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum_squares += (value - mean) * (value - mean);
-                    output->setDataAt(n, h, s, d, value - mean);
-                }
-                float rms = std::sqrt(sum_squares / dim + epsilon_);
-#pragma omp parallel for num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = output->dataAt<float>(n, h, s, d);
-                    if (bias) {
-                        output->setDataAt<float>(n, h, s, d, weight_.dataAt<float>(0, 0, 0, d) * value / rms + bias_.dataAt<float>(0, 0, 0, d));
-                    } else {
-                        output->setDataAt<float>(n, h, s, d, weight_.dataAt<float>(0, 0, 0, d) * value / rms);
-                    }
-                }
-            }
-        }
+    Tensor *bias_ptr = bias ? &bias_ : nullptr;
+    if (inputs.size() == 2) {
+        layernorm_fp32(inputs[0].get(), inputs[1].get(), outputs[0].get(), outputs[1].get(), &weight_, bias_ptr, epsilon_, thread_count);
+    } else {
+        layernorm_fp32(inputs[0].get(), nullptr, nullptr, outputs[0].get(), &weight_, bias_ptr, epsilon_, thread_count);
     }
-
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPULayerNorm::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -3,14 +3,24 @@
 
 namespace mllm {
 
-CPULinear::CPULinear(Backend *bn, string opName, int in_features, int out_features, bool bias, int threadCount) : thread_count(threadCount),
+CPULinear::SharedInput CPULinear::shared_input_;
+
+CPULinear::CPULinear(Backend *bn, string opName, int in_features, int out_features, bool bias, int threadCount, int top_k) : thread_count(threadCount),
     Op(bn, opName) {
     in_features_ = in_features;
     out_features_ = out_features;
     support_bias_ = bias;
+    top_k_ = top_k;
     thread_count = threadCount;
     weight_.setBackend(bn);
     bias_.setBackend(bn);
+    workspace_.setBackend(bn);
+}
+
+CPULinear::~CPULinear() {
+    if (shared_input_.converted == &workspace_) {
+        shared_input_ = SharedInput();
+    }
 }
 
 ErrorCode CPULinear::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -31,8 +41,12 @@ ErrorCode CPULinear::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     // -----------------------------------------------
     // batch |out_channel | seq_len               |  1
     //       |out_features|  inputs[0]->sequence()  |
-    assert(inputs[0]->head() == 1);
+    // every (batch, head, sequence) row is projected, so heads may be folded into the batch
     assert(in_features_ == inputs[0]->dimension());
+    if (top_k_ > 0) {
+        outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), 2, top_k_);
+        return Op::reshape(inputs, outputs);
+    }
     outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), out_features_);
     //outputs[0]->setDtype(activationDtype());
     return Op::reshape(inputs, outputs);
@@ -65,39 +79,82 @@ ErrorCode CPULinear::load(AbstructLoader &loader) {
     return Op::load(loader);
 }
 
+ErrorCode CPULinear::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto vec_dot_type = mat_mul_vec_dot_type(weight_.dtype());
+    if (inputs[0]->count() != 0 && vec_dot_type != MLLM_TYPE_F32) {
+        mat_mul_workspace(&workspace_, inputs[0].get(), vec_dot_type);
+    }
+    return Op::setUp(inputs, outputs);
+}
+
+Tensor *CPULinear::convertedInput(Tensor *input, DataType vec_dot_type) {
+    auto &shared = shared_input_;
+    const void *src = input->ptrAt<float>(0, 0, 0, 0);
+    if (shared.converted != nullptr && shared.src == src
+        && shared.epoch == backend()->executionEpoch() && shared.converted->dtype() == vec_dot_type
+        && shared.converted->batch() == input->batch() && shared.converted->head() == input->head()
+        && shared.converted->sequence() == input->sequence() && shared.converted->dimension() == input->dimension()) {
+        return shared.converted;
+    }
+    auto *converted = mat_mul_src0_as(input, vec_dot_type, &workspace_, thread_count);
+    shared.src = src;
+    shared.buffer = input->hostPtr<void>();
+    shared.converted = converted;
+    return converted;
+}
+
 ErrorCode CPULinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     if(inputs[0]->count() == 0) {
         return Op::execute(inputs, outputs);
     }
     // std::cout << name() << "  CPULinear()" << std::endl;
-    switch (weight_.dtype()) {
-    case MLLM_TYPE_F32: {
-        mat_mul_fp32(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, false, true, thread_count);
-        break;
-    }
-    case MLLM_TYPE_F16: break;
-    case MLLM_TYPE_Q4_0: {
-        mat_mul_fp32_q4_0(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, thread_count);
-        break;
+    Tensor *src0 = inputs[0].get();
+    auto vec_dot_type = mat_mul_vec_dot_type(weight_.dtype());
+    // the top-k product converts only the last row itself, so it skips the shared conversion
+    if (top_k_ == 0 && vec_dot_type != MLLM_TYPE_F32 && vec_dot_type != MLLM_TYPE_F16) {
+        src0 = convertedInput(inputs[0].get(), vec_dot_type);
     }
-    case MLLM_TYPE_Q4_K: {
-        mat_mul_fp32_q4_K(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, thread_count);
-        break;
+    if (top_k_ > 0) {
+        mat_mul_fp32_top_k(src0, &weight_, outputs[0].get(), top_k_, support_bias_, &bias_, thread_count, &workspace_);
+    } else {
+        switch (weight_.dtype()) {
+        case MLLM_TYPE_F32: {
+            mat_mul_fp32(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, false, true, thread_count);
+            break;
+        }
+        case MLLM_TYPE_F16: break;
+        case MLLM_TYPE_Q4_0: {
+            mat_mul_fp32_q4_0(src0, &weight_, outputs[0].get(), support_bias_, &bias_, thread_count, &workspace_);
+            break;
+        }
+        case MLLM_TYPE_Q4_K: {
+            mat_mul_fp32_q4_K(src0, &weight_, outputs[0].get(), support_bias_, &bias_, thread_count, &workspace_);
+            break;
+        }
+        case MLLM_TYPE_Q6_K: {
+            mat_mul_fp32_q6_K(src0, &weight_, outputs[0].get(), support_bias_, &bias_, thread_count, &workspace_);
+            break;
+        }
+        default:
+            break;
+        }
     }
-    case MLLM_TYPE_Q6_K: {
-        mat_mul_fp32_q6_K(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, thread_count);
-        break;
+    if (shared_input_.buffer == outputs[0]->hostPtr<void>()) {
+        shared_input_ = SharedInput();
     }
-    default:
-        break;
+    auto ret = Op::execute(inputs, outputs);
+    if (src0 != inputs[0].get()) {
+        // this Linear only wrote its output, so the converted input stays valid for the next sibling
+        shared_input_.epoch = backend()->executionEpoch();
     }
-    return Op::execute(inputs, outputs);
+    return ret;
 }
 ErrorCode CPULinear::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     weight_.free();
     if (support_bias_) {
         bias_.free();
     }
+    workspace_.free();
     return Op::free(inputs, outputs);
 }
 
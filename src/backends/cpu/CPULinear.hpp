@@ -10,10 +10,15 @@ namespace mllm {
 class Tensor;
 class CPULinear final : public Op {
 public:
-    CPULinear(Backend *bn, string opName, int in_features, int out_features, bool bias, int threadCount);
-    virtual ~CPULinear() = default;
+    /**
+     * With \p top_k > 0 only the top_k largest outputs of the last input position are kept (see
+     * mat_mul_fp32_top_k): the output is [batch, head, 2, top_k], token ids then their values.
+     */
+    CPULinear(Backend *bn, string opName, int in_features, int out_features, bool bias, int threadCount, int top_k = 0);
+    virtual ~CPULinear();
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
@@ -28,9 +33,25 @@ private:
     int in_features_;
     int out_features_;
     bool support_bias_;
+    int top_k_;
     int thread_count = 4;
     Tensor weight_;
     Tensor bias_;
+    Tensor workspace_; // inputs[0] converted to the vec_dot type of weight_, reused across calls
+
+    /**
+     * The last quantized input, shared by sibling Linears reading the same activation (q/k/v, gate/up).
+     * It is valid while the backend's execution epoch has only been advanced by Linears since.
+     */
+    struct SharedInput {
+        const void *src = nullptr;    // first element of the input, which tells apart slices of one buffer
+        const void *buffer = nullptr; // the input's whole buffer
+
+        Tensor *converted = nullptr;
+        uint64_t epoch = 0;
+    };
+    static SharedInput shared_input_;
+    Tensor *convertedInput(Tensor *input, DataType vec_dot_type);
 };
 
 class CPULinearCreator : public CPUBackend::Creator {
@@ -39,7 +60,8 @@ public:
         int in_features = op_param["in_features"];
         int out_features = op_param["out_features"];
         int bias = op_param["bias"];
-        return new CPULinear(bn, name, in_features, out_features, (bool)bias, threadCount);
+        int top_k = (op_param.find("top_k") == op_param.end()) ? 0 : (int)op_param["top_k"];
+        return new CPULinear(bn, name, in_features, out_features, (bool)bias, threadCount, top_k);
     }
 };
 
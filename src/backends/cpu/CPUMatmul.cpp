@@ -8,6 +8,7 @@ CPUMatmul::CPUMatmul(Backend *bn, string opName, bool transpose0, bool transpose
     transpose0_ = transpose0;
     transpose1_ = transpose1;
     thread_count = threadCount;
+    workspace_.setBackend(bn);
 }
 
 ErrorCode CPUMatmul::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -28,7 +29,6 @@ ErrorCode CPUMatmul::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
          batch |out_channel | seq_len               |  1
          */
         assert(inputs[0]->dimension() == inputs[1]->sequence());
-        inputs[1]->transShape(SEQUENCE, DIMENSION);
         outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[1]->dimension());
     } else if (transpose1_) {
         /*
@@ -71,7 +71,7 @@ ErrorCode CPUMatmul::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
         break;
     }
     case MLLM_TYPE_F16: {
-        mat_mul_fp32_fp16(inputs[0].get(), inputs[1].get(), outputs[0].get(), false, nullptr, transpose0_, transpose1_, thread_count);
+        mat_mul_fp32_fp16(inputs[0].get(), inputs[1].get(), outputs[0].get(), false, nullptr, transpose0_, transpose1_, thread_count, &workspace_);
         break;
     }
     default:
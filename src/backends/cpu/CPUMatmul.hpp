@@ -19,6 +19,7 @@ private:
     bool transpose0_;
     bool transpose1_;
     int thread_count = 4;
+    Tensor workspace_;
 };
 
 class CPUMatmulCreator : public CPUBackend::Creator {
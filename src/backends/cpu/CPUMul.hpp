@@ -15,6 +15,9 @@ public:
     virtual ~CPUMul() = default;
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual bool inPlace() const override {
+        return true;
+    }
 
 private:
     int thread_count = 4;
@@ -1,5 +1,6 @@
 
 #include "CPUNorm.hpp"
+#include "compute/Parallel.hpp"
 #include <cmath>
 
 namespace mllm {
@@ -41,10 +42,9 @@ ErrorCode CPUNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
                     float l2_norm = std::sqrt(sum_of_squares);
 
                     // Use the L2 norm in your code...
-#pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dim; d++) {
+                    parallel_for(dim, thread_count, [&](int d) {
                         outputs[0]->setDataAt<float>(n, h, s,d, l2_norm);
-                    }
+                    });
                 } else {
                     float sum_of_abs_values = 0.0f;
 
@@ -52,10 +52,9 @@ ErrorCode CPUNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
                     for (int d = 0; d < inputs[0]->dimension(); ++d) {
                         sum_of_abs_values += std::abs(inputs[0]->dataAt<float>(n, h, s,d));
                     }
-#pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dim; d++) {
+                    parallel_for(dim, thread_count, [&](int d) {
                         outputs[0]->setDataAt<float>(n, h, s,d, sum_of_abs_values);
-                    }
+                    });
 
                 }
             }
@@ -1,5 +1,6 @@
 
 #include "CPUQuickGELU.hpp"
+#include "compute/Parallel.hpp"
 
 namespace mllm {
 
@@ -26,19 +27,14 @@ ErrorCode CPUQuickGELU::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     int head = input->head();
     int seq = input->sequence();
     int dim = input->dimension();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int b = 0; b <batch ; ++b) {
-        for (int h = 0; h < head; ++h) {
-            for (int s = 0; s < seq; ++s) {
+    parallel_for(batch , head, seq, thread_count, [&](int b, int h, int s) {
 //                for (int d = 0; d < dim; ++d) {
 //                    float value = input->dataAt<float>(b, h, s, d);
 //                    output->setDataAt<float>(b, h, s, d, value * (1 / (1 + std::exp(-1.702 * value))));
 //                }
-                mllm_vec_gelu_quick_f32(dim,  outputs[0]->ptrAt<float>(b, h, s,0),
-                                  inputs[0]->ptrAt<float>(b, h, s,0));
-            }
-        }
-    }
+        mllm_vec_gelu_quick_f32(dim,  outputs[0]->ptrAt<float>(b, h, s,0),
+                          inputs[0]->ptrAt<float>(b, h, s,0));
+    });
     return Op::execute(inputs, outputs);
 }
 
@@ -1,6 +1,7 @@
 #include <cmath>
 #include "CPURMSNorm.hpp"
 #include "Tensor.hpp"
+#include "compute/Norm.hpp"
 
 namespace mllm {
 
@@ -18,52 +19,21 @@ CPURMSNorm::CPURMSNorm(Backend *bn, string opName, int normSize, float epsilon,
 
 ErrorCode CPURMSNorm::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     // RMSNorm is similar to LayerNorm which operates on the channel dimension.
+    // with two inputs the op is a fused residual add: outputs are {input + residual, norm(input + residual)}
     assert(normSize_ == inputs[0]->dimension());
-    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
-    // outputs[0]->setDtype(activationDtype());
-    // std::cout << name() << "  CPURMSNorm  reshape" << std::endl;
+    assert(outputs.size() == inputs.size());
+    for (auto &output : outputs) {
+        output->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
+    }
     return Op::reshape(inputs, outputs);
 }
 
 ErrorCode CPURMSNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    auto input = inputs[0];
-    int batch = input->batch();
-    int dim = input->dimension();
-    int seq = input->sequence();
-    int head = input->head();
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                double sum_squares = 0.0F;
-                // sum
-                // #pragma omp parallel for reduction(+ : sum_squares) num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum_squares += (double)value * value;
-                }
-                const float mean = sum_squares / dim;
-                const float rms = 1.0f / sqrtf(mean + epsilon_);
-// use memset to set the value of the memory block
-#pragma omp parallel for num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    float weight = weight_.dataAt<float>(0, 0, 0, d);
-                    float output = value * rms;
-                    if (add_unit_offset_) {
-                        output = output * (1 + weight);
-                    } else {
-                        output = output * weight;
-                    }
-                    outputs[0]->setDataAt<float>(n, h, s, d, output);
-                }
-            }
-        }
+    if (inputs.size() == 2) {
+        rmsnorm_fp32(inputs[0].get(), inputs[1].get(), outputs[0].get(), outputs[1].get(), &weight_, epsilon_, add_unit_offset_, thread_count);
+    } else {
+        rmsnorm_fp32(inputs[0].get(), nullptr, nullptr, outputs[0].get(), &weight_, epsilon_, add_unit_offset_, thread_count);
     }
-    //    input->printData<float>();
-    //    weight_.printData<float>();
-    //    outputs[0]->printData<float>();
-
-    // std::cout << name() << "  CPURMSNorm()" << std::endl;
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPURMSNorm::load(AbstructLoader &loader) {
@@ -3,6 +3,7 @@
 //
 
 #include "CPUReLU2.hpp"
+#include "compute/Parallel.hpp"
 
 namespace mllm {
 
@@ -21,22 +22,17 @@ ErrorCode CPUReLU2::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
     int head = input->head();
     int seq = input->sequence();
     int dim = input->dimension();
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int b = 0; b <batch ; ++b) {
-        for (int h = 0; h < head; ++h) {
-            for (int s = 0; s < seq; ++s) {
-                for (int d = 0; d < dim; ++d) {
-                    float value = input->dataAt<float>(b, h, s, d);
-                    if (value < 0) {
-                        value = 0;
-                    }
-                    //Square
-                    value = std::pow(value, 2);
-                    output->setDataAt<float>(b, h, s, d, value);
-                }
+    parallel_for(batch , head, seq, thread_count, [&](int b, int h, int s) {
+        for (int d = 0; d < dim; ++d) {
+            float value = input->dataAt<float>(b, h, s, d);
+            if (value < 0) {
+                value = 0;
             }
+            //Square
+            value = std::pow(value, 2);
+            output->setDataAt<float>(b, h, s, d, value);
         }
-    }
+    });
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPUReLU2::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -3,6 +3,7 @@
 
 #include "Op.hpp"
 #include "CPUBackend.hpp"
+#include "compute/RoPE.hpp"
 
 namespace mllm {
 
@@ -10,6 +11,7 @@ class CPURoPE final : public Op {
 public:
     CPURoPE(Backend *bn, string opName, int pose_type, int threadCount);
     CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, int max_position_embeddings, int threadCount);
+    CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, int max_position_embeddings, RoPEScaling scaling, int threadCount);
     virtual ~CPURoPE() = default;
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
@@ -17,13 +19,8 @@ public:
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
 private:
-    //    Tensor freq_;
-    // static Tensor sin_;
-    // static Tensor cos_;
-    static vector<vector<float>> sin_;
-    static vector<vector<float>> cos_;
-    static int global_pose_type_;
-    static int ishape_old;
+    shared_ptr<const RoPETable> table_; // shared with every RoPE op of the same configuration
+    RoPEScaling scaling_;
     int rope_theta_ = 10000;
     int h_cnt_ = 0;
     int pos_max_ = 16384;
@@ -41,7 +38,14 @@ public:
         }
         float rope_theta = op_param["rope_theta"];
         int max_position_embeddings = op_param["max_position_embeddings"];
-        return new CPURoPE(bn, name, pose_type, rope_theta, max_position_embeddings, threadCount);
+        if (op_param.find("rope_scaling_type") == op_param.end()) {
+            return new CPURoPE(bn, name, pose_type, rope_theta, max_position_embeddings, threadCount);
+        }
+        RoPEScaling scaling;
+        scaling.type = (RoPEScalingType)op_param["rope_scaling_type"];
+        scaling.factor = op_param["rope_scaling_factor"];
+        scaling.original_max_position_embeddings = op_param["original_max_position_embeddings"];
+        return new CPURoPE(bn, name, pose_type, rope_theta, max_position_embeddings, scaling, threadCount);
     }
 };
 } // namespace mllm
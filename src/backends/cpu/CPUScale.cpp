@@ -1,5 +1,6 @@
 
 #include "CPUScale.hpp"
+#include "compute/Parallel.hpp"
 
 namespace mllm {
 
@@ -30,20 +31,18 @@ ErrorCode CPUScale::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
         auto copy_size = input->batch() * input->head() * input->sequence() * input->dimension();
         auto in_ptr = inputs[0]->hostPtr<float>();
         auto out_ptr = outputs[0]->hostPtr<float>();
-#pragma omp parallel for num_threads(thread_count)
-        for (int is = 0; is < copy_size; ++is) {
+        parallel_for(copy_size, thread_count, [&](int is) {
             if(bias_after_scale_) {
                 out_ptr[is] = in_ptr[is] * scale_ + bias_;
             }else{
                 out_ptr[is] = (in_ptr[is] + bias_) * scale_;
             }
-        }
+        });
     }else {
         for(int n = 0; n<input->batch(); ++n){
             for(int c = 0; c<input->head(); ++c){
                 for(int h = 0; h<input->sequence(); ++h){
-#pragma omp parallel for num_threads(thread_count)
-                    for(int w = 0; w<input->dimension(); ++w){
+                    parallel_for(input->dimension(), thread_count, [&](int w) {
                         float value = input->dataAt<float>(n, c, h, w);
                         if(bias_after_scale_){
                             value = value * scale_ + bias_;
@@ -51,7 +50,7 @@ ErrorCode CPUScale::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
                             value = (value + bias_) * scale_;
                         }
                         output->setDataAt<float>(n, c, h, w, value);
-                    }
+                    });
                 }
             }
         }
@@ -62,14 +61,11 @@ ErrorCode CPUScale::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
 ErrorCode CPUScale::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
-    // outputs[0]->deepCopyFrom(inputs[0]);
-    if(inputs[0]->masterTensor() == nullptr) {
-        inputs[0]->free();
+    Op::setUp(inputs, outputs);
+    // an op driven on its own may get an input nobody allocated: it then shares the output's memory
+    if (inputs[0]->hostPtr<void>() == nullptr && inputs[0]->masterTensor() == nullptr && !inputs[0]->aggregated()) {
+        inputs[0]->aliasFrom(outputs[0].get());
     }
-    outputs[0]->setDtype(activation_dtype());
-    outputs[0]->alloc();
-    inputs[0]->deepCopyFrom(outputs[0].get(), false);
-
     return MLLM_NO_ERROR;
 }
 
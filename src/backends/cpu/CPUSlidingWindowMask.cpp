@@ -8,6 +8,8 @@
  *
  */
 #include "CPUSlidingWindowMask.hpp"
+#include "compute/Parallel.hpp"
+#include <algorithm>
 #include <limits>
 
 namespace mllm {
@@ -26,24 +28,26 @@ ErrorCode CPUSlidingWindowMask::reshape(vector<shared_ptr<Tensor>> inputs, vecto
 }
 
 ErrorCode CPUSlidingWindowMask::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    if (inputs[0]->sequence() > 1) {
+    // a batch of sequences of different lengths: row n has its own keys, the rest is padding
+    const auto &batch = backend()->sequenceBatch();
+    if (inputs[0]->sequence() > 1 || batch.active()) {
         int batch_size = inputs[0]->batch();
         int head_num = inputs[0]->head();
         int sequence = inputs[0]->sequence();
         int dimension = inputs[0]->dimension();
-        int old_dim = dimension - sequence;
         int _t_window_size = winodw_size - 1;
+        const vector<int> k_lens = batch.active() ? batch.keyLengths(sequence) : vector<int>(batch_size, dimension);
         for (int n = 0; n < batch_size; ++n) {
+            const int old_dim = std::min(k_lens[n], dimension) - sequence;
             for (int h = 0; h < head_num; ++h) {
                 for (int s = 0; s < sequence; ++s) {
-#pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dimension; ++d) {
+                    parallel_for(dimension, thread_count, [&](int d) {
                         if (/*right bound of window*/ d > s + old_dim || /*left bound of window*/ d < s - _t_window_size) {
                             outputs[0]->setDataAt<float>({n, h, s, d}, std::numeric_limits<float>::lowest());
                         } else {
                             outputs[0]->setDataAt<float>({n, h, s, d}, inputs[0]->dataAt<float>(n, h, s, d));
                         }
-                    }
+                    });
                 }
             }
         }
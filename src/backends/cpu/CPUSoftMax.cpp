@@ -3,6 +3,7 @@
 #include <cmath>
 #include "quantize/Quantize.hpp"
 #include "compute/VecDot.hpp"
+#include "compute/Softmax.hpp"
 namespace mllm {
 
 //static mllm_fp16_t table_exp_f16[1 << 16];
@@ -29,6 +30,14 @@ CPUSoftMax::CPUSoftMax(Backend *bn, string opName, int axis, int threadCount) :
     }
 }
 
+CPUSoftMax::CPUSoftMax(Backend *bn, string opName, int axis, float scale, bool do_causal_mask, int threadCount) :
+    CPUSoftMax(bn, opName, axis, threadCount) {
+    // the fused scale and mask are only implemented along the dimension axis
+    assert(axis == DIMENSION || (scale == 1.0f && !do_causal_mask));
+    scale_ = scale;
+    do_causal_mask_ = do_causal_mask;
+}
+
 ErrorCode CPUSoftMax::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     // std::cout << name() << "  CPUSoftMax  reshape" << std::endl;
     assert(inputs.size() == 1);
@@ -36,67 +45,18 @@ ErrorCode CPUSoftMax::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_p
     // outputs[0]->setDtype(activationDtype());
     return Op::reshape(inputs, outputs);
 }
-inline static void vec_scale_f32(const int n, float *y, const float v) {
-    const int np = (n & ~(MLLM_F32_STEP - 1));
-
-    MLLM_F32_VEC vx = MLLM_F32_VEC_SET1(v);
-
-    MLLM_F32_VEC ay[MLLM_F32_ARR];
-
-    for (int i = 0; i < np; i += MLLM_F32_STEP) {
-        for (int j = 0; j < MLLM_F32_ARR; j++) {
-            ay[j] = MLLM_F32_VEC_LOAD(y + i + j * MLLM_F32_EPR);
-            ay[j] = MLLM_F32_VEC_MUL(ay[j], vx);
-
-            MLLM_F32_VEC_STORE(y + i + j * MLLM_F32_EPR, ay[j]);
-        }
-    }
-
-    // leftovers
-    for (int i = np; i < n; ++i) {
-        y[i] *= v;
-    }
-
-    //    for (int i = 0; i < n; ++i) {
-    //        y[i] *= v;
-    //    }
-}
-
 ErrorCode CPUSoftMax::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     // std::cout << name() << "  CPUSoftMax()" << std::endl;
     auto &input = inputs[0];
     auto &output = outputs[0];
 
     if (axis_ == DIMENSION) {
-        for (int n = 0; n < input->batch(); ++n) {
-            #pragma omp parallel for num_threads(thread_count)
-            for (int h = 0; h < input->head(); ++h) {
-                for (int s = 0; s < input->sequence(); ++s) {
-                    int num_classes = input->dimension(); // 获取类别数量
-                    float max = -INFINITY;
-                    // #pragma omp parallel for num_threads(thread_count)
-                    for (int j = 0; j < num_classes; ++j) {
-                        max = MAX(max, input->dataAt<float>(n, h, s, j));
-                    }
-                    float *dp = output->ptrAt<float>(n, h, s, 0);
-                    double sum = 0.0;
-                    uint16_t scvt;
-                    for (int i = 0; i < num_classes; i++) {
-                        if (input->dataAt<float>(n, h, s, i) == -INFINITY) {
-                            dp[i] = 0.0F;
-                        } else {
-                            mllm_fp16_t tmp = MLLM_FP32_TO_FP16(input->dataAt<float>(n, h, s, i) - max);
-                            memcpy(&scvt, &tmp, sizeof(scvt));
-                            const float val = MLLM_FP16_TO_FP32(table_exp_f16[scvt]);
-                            sum += (double)val;
-                            dp[i] = val;
-                        }
-                    }
-
-                    sum = 1.0 / sum;
-                    vec_scale_f32(num_classes, dp, sum);
-                }
-            }
+        const auto &batch = backend()->sequenceBatch();
+        if (do_causal_mask_ && batch.active()) {
+            // attention over sequences of different lengths: row n has positions[n] keys before this step's
+            softmax_fp32(input.get(), output.get(), scale_, true, thread_count, batch.keyLengths(input->sequence()));
+        } else {
+            softmax_fp32(input.get(), output.get(), scale_, do_causal_mask_, thread_count);
         }
     } else {
         for (int n = 0; n < input->batch(); ++n) {
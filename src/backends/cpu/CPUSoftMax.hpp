@@ -9,12 +9,15 @@ namespace mllm {
 class CPUSoftMax final : public Op {
 public:
     CPUSoftMax(Backend *bn, string opName, int axis, int threadCount);
+    CPUSoftMax(Backend *bn, string opName, int axis, float scale, bool do_causal_mask, int threadCount);
     virtual ~CPUSoftMax() = default;
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
 private:
     int axis_ = 0;
+    float scale_ = 1.0; // applied to the input before the softmax
+    bool do_causal_mask_ = false;
     int thread_count = 4;
 };
 
@@ -22,7 +25,12 @@ class CPUSoftMaxCreator : public CPUBackend::Creator {
 public:
     virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
         int axis = op_param["axis"];
-        return new CPUSoftMax(bn, name, axis, threadCount);
+        if (op_param.find("scale") == op_param.end()) {
+            return new CPUSoftMax(bn, name, axis, threadCount);
+        }
+        float scale = op_param["scale"];
+        bool do_causal_mask = op_param["do_causal_mask"];
+        return new CPUSoftMax(bn, name, axis, scale, do_causal_mask, threadCount);
     }
 };
 } // namespace mllm
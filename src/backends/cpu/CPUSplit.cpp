@@ -74,7 +74,7 @@ ErrorCode CPUSplit::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
             {
                 int dimension_sum = 0;
                 for (auto item : each_dims_) dimension_sum += item;
-                assert(dimension_sum == inputs[0]->sequence() && "sum(each_dims_) miss match inputs[0]'s dimension dim");
+                assert(dimension_sum == inputs[0]->dimension() && "sum(each_dims_) miss match inputs[0]'s dimension dim");
             }
             assert(outputs.size() == each_dims_.size() && "outputs size miss match each_dims_ size");
 
@@ -8,6 +8,9 @@
 #include "Tensor.hpp"
 #include "Types.hpp"
 #include "compute/Matmul.hpp"
+#include "compute/Elementwise.hpp"
+#include "compute/Cat.hpp"
+#include "compute/Parallel.hpp"
 
 // #include <Layer.hpp>
 #include <iostream>
@@ -17,63 +20,28 @@ namespace mllm {
 class Tensor;
 
 class CPUmmFunction: public TensorFunction {
-    static void tranTensorChl(Tensor &input) {
-        assert(input.ctype() == BSHD);
-        auto b = input.batch();
-        auto h = input.head();
-        auto d = input.dimension();
-        auto s = input.sequence();
-        auto ori_seq_idx = input.chls()[SEQUENCE];
-        auto ori_head_idx = input.chls()[HEAD];
-        auto ori_dim_idx = input.chls()[DIMENSION];
-        input.chls()[HEAD] = ori_seq_idx;
-        input.chls()[DIMENSION] = ori_head_idx;
-        input.chls()[SEQUENCE] = ori_dim_idx;
-        input.changeCtype();
-        input.reshape(b, h, s, d);
-        input.transed() = true;
-        input.undiffusion() = false;
-        // if no TENSOR_STATIC_SHAPED
-        if (input.masterTensor() != nullptr) {
-            auto b = input.masterTensor()->batch();
-            auto h = input.masterTensor()->head();
-            auto d = input.masterTensor()->dimension();
-            auto s = input.masterTensor()->sequence();
-            input.masterTensor()->chls() = input.chls();
-            input.masterTensor()->changeCtype();
-            input.masterTensor()->reshape(b, h, s, d);
-            for (auto child : input.masterTensor()->childTensors()) {
-                auto b = child->batch();
-                auto h = child->head();
-                auto d = child->dimension();
-                auto s = child->sequence();
-                child->chls() = input.chls();
-                child->changeCtype();
-                child->reshape(b, h, s, d);
-            }
-        }
-    }
+    Tensor workspace_; // grows to the largest fp16 activation seen, shared by every mm call
 
 public:
+    // input1 is used in the layout it has: a transposed view of K or V as the KV cache stores it
     void setup(Tensor &output, Tensor &input0, Tensor &input1) {
-        if (input1.chls()[SEQUENCE] != 3) {
-            tranTensorChl(input1);
-        }
         assert(input0.dimension() == input1.sequence());
         output.reshape(input0.batch(), input0.head(), input0.sequence(), input1.dimension());
         output.setDtype(input0.dtype());
         output.alloc();
     }
-    void execute(Tensor &output, Tensor &input0, Tensor &input1) {
-        bool isSame = std::equal(input0.chls().begin(), input0.chls().end(), input1.chls().begin());
+    void execute(Tensor &output, Tensor &input0, Tensor &input1, CausalMMType causal = CAUSAL_MM_NONE) {
         assert(input0.dtype() == MLLM_TYPE_F32);
+        // a batch of sequences of different lengths: each row stops at its own last key
+        const auto &batch = input0.backend()->sequenceBatch();
+        const vector<int> k_lens = causal != CAUSAL_MM_NONE && batch.active() ? batch.keyLengths(input0.sequence()) : vector<int>();
         switch (input1.dtype()) {
         case MLLM_TYPE_F32: {
-            mat_mul_fp32(&input0, &input1, &output, false, nullptr, false, isSame, CPUBackend::cpu_threads);
+            mat_mul_fp32(&input0, &input1, &output, false, nullptr, false, false, CPUBackend::cpu_threads, causal, k_lens);
             break;
         }
         case MLLM_TYPE_F16: {
-            mat_mul_fp32_fp16(&input0, &input1, &output, false, nullptr, false, isSame, CPUBackend::cpu_threads);
+            mat_mul_fp32_fp16(&input0, &input1, &output, false, nullptr, false, false, CPUBackend::cpu_threads, &workspace_, causal, k_lens);
             break;
         }
         default:
@@ -84,7 +52,7 @@ public:
         setup(output, *inputs[0], *inputs[1]);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(output, *inputs[0], *inputs[1]);
+        execute(output, *inputs[0], *inputs[1], args.empty() ? CAUSAL_MM_NONE : (CausalMMType)args[0]);
     }
     
 };
@@ -106,19 +74,17 @@ public:
                             sum_of_squares += input.dataAt<float>(n, h, s, d) * input.dataAt<float>(n, h, s, d);
                         }
                         float l2_norm = std::sqrt(sum_of_squares);
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int d = 0; d < input.dimension(); d++) {
+                        parallel_for(input.dimension(), CPUBackend::cpu_threads, [&](int d) {
                             output.setDataAt<float>(n, h, s, d, l2_norm);
-                        }
+                        });
                     } else {
                         float sum_of_abs_values = 0.0f;
                         for (int d = 0; d < input.dimension(); ++d) {
                             sum_of_abs_values += std::abs(input.dataAt<float>(n, h, s, d));
                         }
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int d = 0; d < input.dimension(); d++) {
+                        parallel_for(input.dimension(), CPUBackend::cpu_threads, [&](int d) {
                             output.setDataAt<float>(n, h, s, d, sum_of_abs_values);
-                        }
+                        });
                     }
                 }
             }
@@ -134,195 +100,124 @@ public:
 
 class CPUbinaryFunction {
 public:
-    template <typename Func>
-    void setup(Tensor &input, Tensor &output, Func operation, float data) {
+    void setup(Tensor &input, Tensor &output, ElementwiseOp op, float data) {
         output.reshape(input.batch(), input.head(), input.sequence(), input.dimension());
         output.setDtype(input.dtype());
         output.alloc();
     }
-    template <typename Func>
-    void execute(Tensor &input, Tensor &output, Func operation, float data) {
-        if (input.masterTensor() == nullptr && output.masterTensor() == nullptr && input.ctype() == output.ctype()) {
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-            for (int is = 0; is < input.batch() * input.head() * input.sequence() * input.dimension(); ++is) {
-                output.hostPtr<float>()[is] = operation(input.hostPtr<float>()[is], data);
-            }
-        } else {
-            for (int n = 0; n < input.batch(); ++n) {
-                for (int c = 0; c < input.head(); ++c) {
-                    for (int h = 0; h < input.sequence(); ++h) {
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int w = 0; w < input.dimension(); ++w) {
-                            output.ptrAt<float>(n, c, h, w)[0] =
-                                operation(input.ptrAt<float>(n, c, h, w)[0],
-                                          data);
-                        }
-                    }
-                }
-            }
-        }
+    void execute(Tensor &input, Tensor &output, ElementwiseOp op, float data) {
+        elementwise_scalar_fp32(op, &input, data, &output, CPUBackend::cpu_threads);
     }
 };
 
 class CPUaddFunction: public TensorFunction, public CPUbinaryFunction {
 public:
-    void setup(Tensor &input, Tensor &output, float data) {
-        CPUbinaryFunction::setup( input, output, std::plus<float>(), data);
-    };
-    void execute(Tensor &input, Tensor &output,float data) {
-        CPUbinaryFunction::execute( input, output, std::plus<float>(), data);
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::setup(*inputs[0], output, ELEMENTWISE_ADD, args[0]);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::execute(*inputs[0], output, ELEMENTWISE_ADD, args[0]);
     }
 };
 class CPUsubFunction: public TensorFunction, public CPUbinaryFunction {
 public:
-    void setup(Tensor &input, Tensor &output, float data) {
-        CPUbinaryFunction::setup( input, output, std::minus<float>(), data);
-    };
-    void execute(Tensor &input, Tensor &output,float data) {
-        CPUbinaryFunction::execute( input, output, std::minus<float>(), data);
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::setup(*inputs[0], output, ELEMENTWISE_SUB, args[0]);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::execute(*inputs[0], output, ELEMENTWISE_SUB, args[0]);
     }
 };
 class CPUmulFunction: public TensorFunction, public CPUbinaryFunction {
 public:
-    void setup(Tensor &input, Tensor &output, float data) {
-        CPUbinaryFunction::setup( input, output, std::multiplies<float>(), data);
-    };
-    void execute(Tensor &input, Tensor &output,float data) {
-        CPUbinaryFunction::execute( input, output, std::multiplies<float>(), data);
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::setup(*inputs[0], output, ELEMENTWISE_MUL, args[0]);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::execute(*inputs[0], output, ELEMENTWISE_MUL, args[0]);
     }
 };
 class CPUdivFunction: public TensorFunction, public CPUbinaryFunction {
 public:
-    void setup(Tensor &input, Tensor &output, float data) {
-        CPUbinaryFunction::setup( input, output, std::divides<float>(), data);
-    };
-    void execute(Tensor &input, Tensor &output,float data) {
-        CPUbinaryFunction::execute( input, output, std::divides<float>(), data);
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::setup(*inputs[0], output, ELEMENTWISE_DIV, args[0]);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output,(float)args[0]);
+        CPUbinaryFunction::execute(*inputs[0], output, ELEMENTWISE_DIV, args[0]);
     }
 };
 
+// every axis of size 1 on either side is broadcast, see elementwise_broadcast_shape()
 class CPUbinaryTwoFunction {
 public:
-    template <typename Func>
-    void setup(Tensor &input0, Tensor &output, Tensor &input1, Func operation) {
-        output.reshape(std::max(input0.batch(), input1.batch()), input0.head(), input0.sequence(), input0.dimension());
+    void setup(Tensor &input0, Tensor &output, Tensor &input1, ElementwiseOp op) {
+        auto shape = elementwise_broadcast_shape(&input0, &input1);
+        output.reshape(shape[0], shape[1], shape[2], shape[3]);
         output.setDtype(input0.dtype());
         output.alloc();
     }
-    template <typename Func>
-    void execute(Tensor &input0, Tensor &output, Tensor &input1, Func operation) {
-        int batch_ = std::max(input0.batch(), input1.batch());
-        if (input0.masterTensor() == nullptr && output.masterTensor() == nullptr && input0.ctype() == output.ctype()) {
-            for (int n = 0; n < batch_; ++n) {
-                auto n_0 = std::min(n, input0.batch() - 1);
-                auto n_1 = std::min(n, input1.batch() - 1);
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                for (int is = 0; is < input0.head() * input0.sequence() * input0.dimension(); ++is) {
-                    output.ptrAt<float>(n, 0, 0, 0)[is] =
-                        operation(input0.ptrAt<float>(n_0, 0, 0, 0)[is],
-                                  input1.ptrAt<float>(n_1, 0, 0, 0)[is]);
-                }
-            }
-        } else {
-            for (int n = 0; n < batch_; ++n) {
-                auto n_0 = std::min(n, input0.batch() - 1);
-                auto n_1 = std::min(n, input1.batch() - 1);
-                for (int c = 0; c < input0.head(); ++c) {
-                    for (int h = 0; h < input0.sequence(); ++h) {
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int w = 0; w < input0.dimension(); ++w) {
-                            output.ptrAt<float>(n, c, h, w)[0] =
-                                operation(input0.ptrAt<float>(n_0, c, h, w)[0],
-                                          input1.ptrAt<float>(n_1, c, h, w)[0]);
-                        }
-                    }
-                }
-            }
-        }
+    void execute(Tensor &input0, Tensor &output, Tensor &input1, ElementwiseOp op) {
+        elementwise_fp32(op, &input0, &input1, &output, CPUBackend::cpu_threads);
     }
 };
 class CPUaddTwoFunction: public TensorFunction, public CPUbinaryTwoFunction {
 public:
-    void setup(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::setup( input0, output, input1, std::plus<float>());
-    };
-    void execute(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::execute( input0, output, input1, std::plus<float>());
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::setup(*inputs[0], output, *inputs[1], ELEMENTWISE_ADD);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::execute(*inputs[0], output, *inputs[1], ELEMENTWISE_ADD);
     }
 };
 class CPUsubTwoFunction: public TensorFunction, public CPUbinaryTwoFunction {
 public:
-    void setup(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::setup( input0, output, input1, std::minus<float>());
-    };
-    void execute(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::execute( input0, output, input1, std::minus<float>());
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::setup(*inputs[0], output, *inputs[1], ELEMENTWISE_SUB);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::execute(*inputs[0], output, *inputs[1], ELEMENTWISE_SUB);
     }
 };
 class CPUmulTwoFunction: public TensorFunction, public CPUbinaryTwoFunction {
 public:
-    void setup(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::setup( input0, output, input1, std::multiplies<float>());
-    };
-    void execute(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::execute( input0, output, input1, std::multiplies<float>());
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::setup(*inputs[0], output, *inputs[1], ELEMENTWISE_MUL);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::execute(*inputs[0], output, *inputs[1], ELEMENTWISE_MUL);
     }
 };
 class CPUdivTwoFunction: public TensorFunction, public CPUbinaryTwoFunction {
 public:
-    void setup(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::setup( input0, output, input1, std::divides<float>());
-    };
-    void execute(Tensor &input0, Tensor &output, Tensor &input1) {
-        CPUbinaryTwoFunction::execute( input0, output, input1, std::divides<float>());
-    };
+    bool inPlace() const override {
+        return true;
+    }
     void setup(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        setup( *inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::setup(*inputs[0], output, *inputs[1], ELEMENTWISE_DIV);
     }
     void execute(Tensor &output, vector<Tensor*> &inputs, vector<float> args) override {
-        execute(*inputs[0], output, *inputs[1]);
+        CPUbinaryTwoFunction::execute(*inputs[0], output, *inputs[1], ELEMENTWISE_DIV);
     }
 };
 
@@ -572,7 +467,9 @@ public:
 class CPUtransposeFunction : public TensorFunction {
 public:
     void setup(Tensor &input, Tensor &output, vector<std::pair<Chl, Chl>> axiss) {
-        if (output.count() <= 0 || output.shape() != input.shape()) {
+        // a view into part of its master (e.g. some slots of a KV cache) may move between calls
+        const bool part_view = input.masterTensor() != nullptr && !input.shape_offset().empty();
+        if (output.count() <= 0 || output.shape() != input.shape() || part_view) {
             output.trans_copy_shape(input.shape());
             std::map<Chl, int> origin_chls = {{BATCH, 0}, {SEQUENCE, 1}, {HEAD, 2}, {DIMENSION, 3}, {CHANNLE, 1}, {TIME, 2}, {HEIGHT, 3}, {WIDTH, 4}};
             if (std::equal(output.chls().begin(), output.chls().end(), origin_chls.begin())) {
@@ -588,7 +485,10 @@ public:
                 output.changeCtype(input.shape().size());
                 output.undiffusion() = true;
             }
-            if (input.masterTensor() != nullptr) {
+            if (part_view) {
+                output.setDtype(input.dtype());
+                output.deepCopyFrom(input.masterTensor(), false, input.shape_offset());
+            } else if (input.masterTensor() != nullptr) {
                 if (output.masterTensor() == nullptr) {
                     output.setDtype(input.dtype());
                     output.deepCopyFrom(input, false);
@@ -860,74 +760,11 @@ public:
         output.reshape(dim_b, dim_h, dim_s, dim_d);
         output.setDtype(inputs[0]->dtype());
         output.alloc();
-        if (axis == SEQUENCE && inputs[0]->head() != 1) {
-            int cbatch = 0;
-            int chead = 0;
-            int cseq = 0;
-            int cdim = 0;
-            for (int idx = 0; idx < inputs.size(); idx++) {
-                if (inputs[idx]->masterTensor() == nullptr) {
-                    inputs[idx]->free();
-                }
-                if (idx > 0) {
-                    cseq += inputs[idx - 1]->sequence();
-                }
-                inputs[idx]->deepCopyFrom(output, false, {cbatch, chead, cseq, cdim}); // b,h,s,d
-            }
-        }
+        // inputs that can be are written by their producers straight into the output
+        cat_bind_inputs(inputs, &output, axis);
     }
     void execute(Tensor &output, vector<Tensor *> inputs, Chl axis) {
-        int expd_batch_ = inputs[0]->batch();
-        int expd_batch_input_idx = 0;
-        for (int ii = 0; ii < inputs.size(); ++ii) {
-            auto input = inputs[ii];
-            if (input->batch() > expd_batch_) {
-                expd_batch_ = input->batch();
-                expd_batch_input_idx = ii;
-            }
-        }
-        if (axis == BATCH) {
-            for (int n = 0; n < inputs.size(); ++n) {
-                auto copysize = inputs[0]->batch() * inputs[0]->head() * inputs[0]->sequence() * inputs[0]->dimension();
-                memcpy(output.ptrAt<float>(n * inputs[0]->batch(), 0, 0, 0),
-                       inputs[n]->ptrAt<float>(0, 0, 0, 0),
-                       sizeof(float) * copysize);
-            }
-        } else if (axis == DIMENSION) {
-            for (int n = 0; n < expd_batch_; ++n) {
-                for (int c = 0; c < inputs[0]->head(); ++c) {
-                    for (int h = 0; h < inputs[0]->sequence(); ++h) {
-                        int w = 0;
-                        for (int idx = 0; idx < inputs.size(); idx++) {
-                            int dim_size = inputs[idx]->dimension();
-                            auto n_ = n;
-                            if (idx != expd_batch_input_idx) {
-                                n_ = 0;
-                            }
-                            memcpy(output.ptrAt<float>(n, c, h, w),
-                                   inputs[idx]->ptrAt<float>(n_, c, h, 0),
-                                   sizeof(float) * (dim_size));
-                            w += dim_size;
-                        }
-                    }
-                }
-            }
-        } else if ((axis == SEQUENCE) && inputs[0]->head() != 1) {
-        } else if ((axis == SEQUENCE) && inputs[0]->head() == 1) {
-            for (int n = 0; n < expd_batch_; ++n) {
-                int h = 0;
-                for (int idx = 0; idx < inputs.size(); idx++) {
-                    auto n_ = n;
-                    if (idx != expd_batch_input_idx) {
-                        n_ = 0;
-                    }
-                    memcpy(output.ptrAt<float>(n, 0, h, 0),
-                           inputs[idx]->ptrAt<float>(n_, 0, 0, 0),
-                           sizeof(float) * (inputs[idx]->sequence() * inputs[idx]->dimension()));
-                    h += inputs[idx]->sequence();
-                }
-            }
-        }
+        cat_copy_inputs(inputs, &output, axis, CPUBackend::cpu_threads);
     }
     void setup(Tensor &output, vector<Tensor *> &inputs, vector<float> args) override {
         setup( output, inputs, (Chl)args[0]);
@@ -946,7 +783,7 @@ public:
         vector<float> s_vec = {};
         vector<float> h_vec = {};
         vector<float> d_vec = {};
-#pragma omp parallel for collapse(4) num_threads(CPUBackend::cpu_threads)
+        // serial: the matches are appended in order
         for (int b = 0; b < input.batch(); b++) {
             for (auto s = 0; s < input.sequence(); s++) {
                 for (auto h = 0; h < input.head(); h++) {
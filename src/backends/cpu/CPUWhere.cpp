@@ -1,5 +1,6 @@
 
 #include "CPUWhere.hpp"
+#include "compute/Parallel.hpp"
 
 namespace mllm {
 
@@ -19,21 +20,16 @@ ErrorCode CPUWhere::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
     vector<float> s_vec = {};
     vector<float> h_vec = {};
     vector<float> d_vec = {};
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int b = 0; b < inputs[0]->batch(); b++) {
-        for (auto s = 0; s < inputs[0]->sequence(); s++) {
-            for (auto h = 0; h < inputs[0]->head(); h++) {
-                for (auto d = 0; d < inputs[0]->dimension(); d++) {
-                    if (inputs[0]->dataAt<float>(b, h, h, s) == data_) {
-                        b_vec.push_back(b);
-                        s_vec.push_back(s);
-                        h_vec.push_back(h);
-                        d_vec.push_back(d);
-                    }
-                }
+    parallel_for(inputs[0]->batch(), inputs[0]->sequence(), inputs[0]->head(), thread_count, [&](int b, int s, int h) {
+        for (auto d = 0; d < inputs[0]->dimension(); d++) {
+            if (inputs[0]->dataAt<float>(b, h, h, s) == data_) {
+                b_vec.push_back(b);
+                s_vec.push_back(s);
+                h_vec.push_back(h);
+                d_vec.push_back(d);
             }
         }
-    }
+    });
     int num = b_vec.size();
     if ((int)axis_ == -1) {
         outputs[0]->reshape(1, 1, 4, num);
@@ -0,0 +1,129 @@
+#include "Cat.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cstring>
+
+// size of t along axis, and the index of axis in a {batch, head, sequence, dimension} offset
+static int cat_size(Tensor *t, Chl axis) {
+    switch (axis) {
+    case BATCH: return t->batch();
+    case HEAD: return t->head();
+    case SEQUENCE: return t->sequence();
+    default: return t->dimension();
+    }
+}
+
+static int cat_offset_index(Chl axis) {
+    switch (axis) {
+    case BATCH: return 0;
+    case HEAD: return 1;
+    case SEQUENCE: return 2;
+    default: return 3;
+    }
+}
+
+// the input's slice of the output is one contiguous block: every axis laid out outside \p axis has
+// size 1. Producers may then write rows or whole blocks from ptrAt / offset, as they do on their
+// own memory, without running into the neighbouring inputs' slices.
+static bool cat_contiguous(Tensor *input, Chl axis) {
+    vector<Chl> order;
+    switch (input->ctype()) {
+    case BSHD: order = {BATCH, SEQUENCE, HEAD, DIMENSION}; break;
+    case BHDS: order = {BATCH, HEAD, DIMENSION, SEQUENCE}; break;
+    case BDHS: order = {BATCH, DIMENSION, HEAD, SEQUENCE}; break;
+    case SBHD: order = {SEQUENCE, BATCH, HEAD, DIMENSION}; break;
+    case DBHS: order = {DIMENSION, BATCH, HEAD, SEQUENCE}; break;
+    default: return false;
+    }
+    for (auto outer : order) {
+        if (outer == axis) {
+            return true;
+        }
+        if (cat_size(input, outer) != 1) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool cat_bindable(Tensor *input, Tensor *output, Chl axis, const vector<Tensor *> &inputs) {
+    if (input->masterTensor() == output) { // bound by an earlier pass
+        return true;
+    }
+    if (input == output || std::count(inputs.begin(), inputs.end(), input) != 1) {
+        return false;
+    }
+    if (output->aggregated() || output->masterTensor() != nullptr || input->aggregated() || input->masterTensor() != nullptr) {
+        return false;
+    }
+    if (input->dtype() != output->dtype() || input->ctype() != output->ctype() || input->batch() != output->batch()
+        || input->ctype() == BCTHW || input->ctype() == BTHWC) {
+        return false;
+    }
+    // deepCopyFrom folds the heads of a master into the dimension of a single-head ChildTensor
+    if (axis == HEAD && input->head() == 1) {
+        return false;
+    }
+    if (!cat_contiguous(input, axis)) {
+        return false;
+    }
+    // views of the input are rebound with it, which is only right when they cover all of it
+    for (auto *child : input->childTensors()) {
+        if (!child->shape_offset().empty() || child->ctype() != input->ctype()
+            || (child->head() != input->head() && axis != SEQUENCE && axis != BATCH)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void cat_bind_inputs(vector<Tensor *> inputs, Tensor *output, Chl axis) {
+    vector<int> offset = {0, 0, 0, 0};
+    for (auto *input : inputs) {
+        if (cat_bindable(input, output, axis, inputs)) {
+            if (input->masterTensor() == nullptr) {
+                input->free();
+            }
+            input->deepCopyFrom(output, false, offset);
+        }
+        offset[cat_offset_index(axis)] += cat_size(input, axis);
+    }
+}
+
+// each (batch, head, sequence) row is contiguous along the dimension axis
+static bool cat_row_direct(Tensor *t) {
+    return !t->aggregated() && (t->ctype() == BSHD || t->ctype() == SBHD);
+}
+
+template <typename T>
+static void cat_copy(Tensor *input, Tensor *output, Chl axis, const vector<int> &offset, int thread_count) {
+    const int batch = axis == BATCH ? input->batch() : output->batch();
+    const int dim = input->dimension();
+    const bool rows = cat_row_direct(input) && cat_row_direct(output);
+    parallel_for(batch, input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        const int n_in = input->batch() == 1 ? 0 : n;
+        if (rows) {
+            memcpy(output->ptrAt<T>(n + offset[0], h + offset[1], s + offset[2], offset[3]),
+                   input->ptrAt<T>(n_in, h, s, 0), sizeof(T) * dim);
+            return;
+        }
+        for (int d = 0; d < dim; ++d) {
+            *output->ptrAt<T>(n + offset[0], h + offset[1], s + offset[2], d + offset[3]) = *input->ptrAt<T>(n_in, h, s, d);
+        }
+    });
+}
+
+void cat_copy_inputs(vector<Tensor *> inputs, Tensor *output, Chl axis, int thread_count) {
+    vector<int> offset = {0, 0, 0, 0};
+    for (auto *input : inputs) {
+        if (input->masterTensor() != output) {
+            assert(input->dtype() == output->dtype());
+            if (output->dtype() == MLLM_TYPE_F16) {
+                cat_copy<mllm_fp16_t>(input, output, axis, offset, thread_count);
+            } else {
+                cat_copy<float>(input, output, axis, offset, thread_count);
+            }
+        }
+        offset[cat_offset_index(axis)] += cat_size(input, axis);
+    }
+}
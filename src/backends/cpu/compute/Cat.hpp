@@ -0,0 +1,24 @@
+#ifndef MLLM_CAT_HPP
+#define MLLM_CAT_HPP
+
+#include "VecDot.hpp"
+using namespace mllm;
+
+/**
+ * \brief Plan a concat along \p axis at setup: every input that can be is freed and rebound as a
+ *        ChildTensor of \p output at its offset, so its producer writes straight into the output and
+ *        nothing is copied. \p output must already be reshaped and allocated. Only inputs whose slice is
+ *        one contiguous block of the output are bound, e.g. along SEQUENCE in BSHD when the batch is 1,
+ *        so a producer writing blocks of rows stays inside its slice. An input also stays on its own
+ *        memory when it is broadcast along the batch, has another dtype or layout, is a view of
+ *        another tensor, or is aggregated; cat_copy_inputs() copies those.
+ */
+void cat_bind_inputs(vector<Tensor *> inputs, Tensor *output, Chl axis);
+
+/**
+ * \brief Copy into \p output the inputs of a concat along \p axis that cat_bind_inputs() left on
+ *        their own memory; inputs of batch 1 are broadcast to the output's batch. F32 and F16.
+ */
+void cat_copy_inputs(vector<Tensor *> inputs, Tensor *output, Chl axis, int thread_count = 4);
+
+#endif // MLLM_CAT_HPP
@@ -3,230 +3,207 @@
 //
 
 #include "Convolution.hpp"
-
-float **reshape_conv2d_kernal_fp32(Tensor *kernel) {
-    int in_channel = kernel->sequence();
-    int kernel_h = kernel->head();
-    int kernel_w = kernel->dimension();
-    int out_channel = kernel->batch();
-
-    // convert the kernel to a new layout
-    float **k_new = new float *[out_channel];
-    for (int i = 0; i < out_channel; i++) {
-        k_new[i] = new float[in_channel * kernel_h * kernel_w];
-    }
-
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cstring>
+
+void conv2d_kernel_fp32(Tensor *weight, Tensor *kernel) {
+    const int in_channel = weight->sequence();
+    const int kernel_h = weight->head();
+    const int kernel_w = weight->dimension();
+    const int out_channel = weight->batch();
+    kernel->reshape(1, 1, out_channel, in_channel * kernel_h * kernel_w);
+    kernel->setDtype(MLLM_TYPE_F32);
+    kernel->alloc();
     for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
-        // re-layout the filter
+        // put all the filters of an output channel in one row
+        float *k_p = kernel->ptrAt<float>(0, 0, out_ch, 0);
         for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
             for (int k_h = 0; k_h < kernel_h; ++k_h) {
-                float *kernel_p = kernel->ptrAt<float>(out_ch, k_h, in_ch, 0);
-                // put all the filters in one row
-                for (int i = 0; i < kernel_w; i++) {
-                    k_new[out_ch][i + k_h * kernel_w + in_ch * kernel_h * kernel_w] = kernel_p[i];
-                }
+                memcpy(k_p + (in_ch * kernel_h + k_h) * kernel_w, weight->ptrAt<float>(out_ch, k_h, in_ch, 0), sizeof(float) * kernel_w);
             }
         }
     }
-    return k_new;
 }
 
-void conv2d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int thread_count) {
-    int in_channel = input->sequence();
-    int out_height = output->head();
-    int out_width = output->dimension();
-    int out_channel = output->sequence();
-
-    // convert the receptive field to a new layout
-    float **i_new = new float *[out_height * out_width];
-    for (int i = 0; i < out_width * out_height; i++) {
-        i_new[i] = new float[in_channel * kernel_h * kernel_w];
-    }
-
-    for (int b = 0; b < input->batch(); ++b) {
-        // re-layout the receptive field
-        for (int out_h = 0; out_h < out_height; ++out_h) {
-            for (int out_w = 0; out_w < out_width; ++out_w) {
-                int blk_h = out_h * stride_h;
-                int blk_w = out_w * stride_w;
-
-                // put all the receptive field in one row
-                for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
-                    for (int k_h = 0; k_h < kernel_h; ++k_h) {
-                        float *i_p = input->ptrAt<float>(b, blk_h + k_h, in_ch, blk_w + 0);
-                        for (int i = 0; i < kernel_w; i++) {
-                            i_new[out_w + out_h * out_width][i + k_h * kernel_w + in_ch * kernel_h * kernel_w] = i_p[i];
-                        }
-                    }
-                }
-            }
-        }
-
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
-            for (int out_h = 0; out_h < out_height; ++out_h) {
-                for (int out_w = 0; out_w < out_width; ++out_w) {
-                    // set value;
-                    float value = 0;
-
-                    vec_dot_fp32(in_channel * kernel_h * kernel_w, &value, k_new[out_ch], i_new[out_w + out_h * out_width]);
-                    if (support_bias) {
-                        value += *bias->ptrAt<float>(0, 0, 0, out_ch);
-                    }
-                    *output->ptrAt<float>(b, out_h, out_ch, out_w) = value;
+void conv3d_kernel_fp32(Tensor *weight, Tensor *kernel) {
+    assert(weight->ctype() == BCTHW);
+    const int in_channel = weight->channel();
+    const int kernel_t = weight->time();
+    const int kernel_h = weight->height();
+    const int kernel_w = weight->width();
+    const int out_channel = weight->batch();
+    kernel->reshape(1, 1, out_channel, in_channel * kernel_t * kernel_h * kernel_w);
+    kernel->setDtype(MLLM_TYPE_F32);
+    kernel->alloc();
+    for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        float *k_p = kernel->ptrAt<float>(0, 0, out_ch, 0);
+        for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
+            for (int k_t = 0; k_t < kernel_t; ++k_t) {
+                for (int k_h = 0; k_h < kernel_h; ++k_h) {
+                    memcpy(k_p + ((in_ch * kernel_t + k_t) * kernel_h + k_h) * kernel_w, weight->ptrAt<float>(out_ch, in_ch, k_t, k_h, 0), sizeof(float) * kernel_w);
                 }
             }
         }
     }
 }
 
-void conv2d_fp32_SAME(Tensor *input, Tensor *output, float **k_new, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int padding_h, int padding_w, int thread_count) {
-    int padding_top = padding_h;
-    int padding_left = padding_w;
+// one receptive field per row: [1, 1, patches, row]
+static Tensor *conv_patches(Tensor *input, Tensor *workspace, Tensor *local, int patches, int row) {
+    Tensor *t = workspace != nullptr ? workspace : local;
+    t->setDtype(MLLM_TYPE_F32);
+    t->reshape(1, 1, patches, row);
+    t->alloc();
+    return t;
+}
 
-    int in_height = input->head();
-    int in_width = input->dimension();
-    int in_channel = input->sequence();
-    int out_height = output->head();
-    int out_width = output->dimension();
-    int out_channel = output->sequence();
+#if defined(__AVX2__) || defined(__ARM_NEON)
+#define MLLM_CONV_SIMD
+#endif
 
-    // 改变布局的感受野
-    float **i_new = new float *[out_height * out_width];
-    for (int i = 0; i < out_width * out_height; i++) {
-        i_new[i] = new float[in_channel * kernel_h * kernel_w];
+// s[r] = k[r] . x for four kernel rows at once, so every load of the patch row feeds four FMAs
+static inline void conv_dot4(int n, float *s, const float *x, const float *const *k) {
+    int i = 0;
+    for (int r = 0; r < 4; ++r) {
+        s[r] = 0;
     }
-
-    for (int b = 0; b < input->batch(); ++b) {
-        // 将每个感受野作为一行重新布局
-        for (int out_h = 0; out_h < out_height; ++out_h) {
-            for (int out_w = 0; out_w < out_width; ++out_w) {
-                int blk_h = out_h * stride_h - padding_top;
-                int blk_w = out_w * stride_w - padding_left;
-
-                for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
-                    for (int k_h = 0; k_h < kernel_h; ++k_h) {
-                        if (blk_h + k_h < 0 || blk_h + k_h >= in_height) {
-                            for (int i = 0; i < kernel_w; i++) {
-                                i_new[out_w + out_h * out_width][i + k_h * kernel_w + in_ch * kernel_h * kernel_w] = 0;
-                            }
-                        }
-
-                        else {
-                            for (int i = 0; i < kernel_w; i++) {
-                                if ((blk_w + i) < 0 || (blk_w + i) >= in_width) {
-                                    i_new[out_w + out_h * out_width][i + k_h * kernel_w + in_ch * kernel_h * kernel_w] = 0;
-
-                                } else {
-                                    float *i_p = input->ptrAt<float>(b, blk_h + k_h, in_ch, blk_w + i);
-                                    i_new[out_w + out_h * out_width][i + k_h * kernel_w + in_ch * kernel_h * kernel_w] = (*i_p);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+#ifdef MLLM_CONV_SIMD
+    const int np = n & ~(MLLM_F32_EPR - 1);
+    MLLM_F32_VEC acc[4][MLLM_F32_ARR];
+    for (int r = 0; r < 4; ++r) {
+        for (int j = 0; j < MLLM_F32_ARR; ++j) {
+            acc[r][j] = MLLM_F32_VEC_ZERO;
+        }
+    }
+    for (; i < np; i += MLLM_F32_EPR) {
+        const MLLM_F32_VEC vx = MLLM_F32_VEC_LOAD(x + i);
+        for (int r = 0; r < 4; ++r) {
+            acc[r][0] = MLLM_F32_VEC_FMA(acc[r][0], MLLM_F32_VEC_LOAD(k[r] + i), vx);
+        }
+    }
+    for (int r = 0; r < 4; ++r) {
+        MLLM_F32_VEC_REDUCE(s[r], acc[r]);
+    }
+#endif
+    for (; i < n; ++i) {
+        for (int r = 0; r < 4; ++r) {
+            s[r] += k[r][i] * x[i];
         }
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
-            for (int out_h = 0; out_h < out_height; ++out_h) {
-                for (int out_w = 0; out_w < out_width; ++out_w) {
-                    float value = 0;
-                    vec_dot_fp32(in_channel * kernel_h * kernel_w, &value, k_new[out_ch], i_new[out_w + out_h * out_width]);
+    }
+}
 
-                    if (support_bias) {
-                        value += *bias->ptrAt<float>(0, 0, 0, out_ch);
+// store(p, out_ch, value) receives kernel row out_ch . patch row p (+ bias). The work is tiled so that a
+// block of kernel rows is reused across a block of patches while both stay in cache.
+template <typename Store>
+static void conv_gemm(Tensor *patches, Tensor *kernel, bool support_bias, Tensor *bias, int thread_count, Store store) {
+    const int num_patches = patches->sequence();
+    const int out_channel = kernel->sequence();
+    const int row = kernel->dimension();
+    assert(patches->dimension() == row);
+    const int blck = 16;
+    const int p_blocks = (num_patches + blck - 1) / blck;
+    const int c_blocks = (out_channel + blck - 1) / blck;
+    parallel_for(p_blocks, c_blocks, thread_count, [&](int p_block, int c_block) {
+        const int p_end = std::min(num_patches, (p_block + 1) * blck);
+        const int c_end = std::min(out_channel, (c_block + 1) * blck);
+        for (int p = p_block * blck; p < p_end; ++p) {
+            const float *x = patches->ptrAt<float>(0, 0, p, 0);
+            for (int out_ch = c_block * blck; out_ch < c_end; out_ch += 4) {
+                float values[4];
+                const int n_ch = std::min(4, c_end - out_ch);
+                if (n_ch == 4) {
+                    const float *k[4];
+                    for (int r = 0; r < 4; ++r) {
+                        k[r] = kernel->ptrAt<float>(0, 0, out_ch + r, 0);
+                    }
+                    conv_dot4(row, values, x, k);
+                } else {
+                    for (int r = 0; r < n_ch; ++r) {
+                        vec_dot_fp32(row, values + r, kernel->ptrAt<float>(0, 0, out_ch + r, 0), x);
                     }
-                    *output->ptrAt<float>(b, out_h, out_ch, out_w) = value;
+                }
+                for (int r = 0; r < n_ch; ++r) {
+                    store(p, out_ch + r, support_bias ? values[r] + bias->hostPtr<float>()[out_ch + r] : values[r]);
                 }
             }
         }
-    }
+    });
 }
 
-float **reshape_conv3d_kernal_fp32(Tensor *kernel) {
-    assert(kernel->ctype() == BCTHW);
-    const int in_channel = kernel->channel();
-    const int kernel_h = kernel->height();
-    const int kernel_w = kernel->width();
-    const int kernel_t = kernel->time();
-    const int out_channel = kernel->batch();
-
-    float **k_new = new float *[out_channel];
-    for (int i = 0; i < out_channel; i++) {
-        k_new[i] = new float[in_channel * kernel_t * kernel_h * kernel_w];
-    }
-
-    for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
-        // 将过滤器重新布局
-        for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
-            for (int k_t = 0; k_t < kernel_t; ++k_t) {
+static void conv2d_fp32(Tensor *input, Tensor *output, Tensor *kernel, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int padding_h, int padding_w, int thread_count, Tensor *workspace) {
+    const int in_height = input->head();
+    const int in_width = input->dimension();
+    const int in_channel = input->sequence();
+    const int out_height = output->head();
+    const int out_width = output->dimension();
+    const int row = in_channel * kernel_h * kernel_w;
+    assert(kernel->dimension() == row && kernel->sequence() == output->sequence());
+    Tensor local(input->backend());
+    Tensor *patches = conv_patches(input, workspace, &local, out_height * out_width, row);
+    for (int b = 0; b < input->batch(); ++b) {
+        // re-layout the receptive fields, zero outside the input
+        parallel_for(out_height, out_width, thread_count, [&](int out_h, int out_w) {
+            const int blk_h = out_h * stride_h - padding_h;
+            const int blk_w = out_w * stride_w - padding_w;
+            float *p_p = patches->ptrAt<float>(0, 0, out_h * out_width + out_w, 0);
+            for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
                 for (int k_h = 0; k_h < kernel_h; ++k_h) {
-                    float *kernel_p = kernel->ptrAt<float>(out_ch, in_ch, k_t, k_h, 0);
-                    for (int i = 0; i < kernel_w; i++) {
-                        k_new[out_ch][i + k_h * kernel_w + k_t * kernel_h * kernel_w + in_ch * kernel_t * kernel_w * kernel_h] = kernel_p[i];
+                    float *dst = p_p + (in_ch * kernel_h + k_h) * kernel_w;
+                    const int i_h = blk_h + k_h;
+                    if (i_h < 0 || i_h >= in_height) {
+                        memset(dst, 0, sizeof(float) * kernel_w);
+                    } else if (blk_w >= 0 && blk_w + kernel_w <= in_width) {
+                        memcpy(dst, input->ptrAt<float>(b, i_h, in_ch, blk_w), sizeof(float) * kernel_w);
+                    } else {
+                        for (int i = 0; i < kernel_w; i++) {
+                            const int i_w = blk_w + i;
+                            dst[i] = (i_w < 0 || i_w >= in_width) ? 0 : input->dataAt<float>(b, i_h, in_ch, i_w);
+                        }
                     }
                 }
             }
-        }
+        });
+        conv_gemm(patches, kernel, support_bias, bias, thread_count, [&](int p, int out_ch, float value) {
+            *output->ptrAt<float>(b, p / out_width, out_ch, p % out_width) = value;
+        });
     }
-    return k_new;
 }
 
-void conv3d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_t, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_t, int stride_h, int stride_w, int thread_count) {
+void conv2d_fp32_VALID(Tensor *input, Tensor *output, Tensor *kernel, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int thread_count, Tensor *workspace) {
+    conv2d_fp32(input, output, kernel, kernel_h, kernel_w, support_bias, bias, stride_h, stride_w, 0, 0, thread_count, workspace);
+}
+
+void conv2d_fp32_SAME(Tensor *input, Tensor *output, Tensor *kernel, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int padding_h, int padding_w, int thread_count, Tensor *workspace) {
+    conv2d_fp32(input, output, kernel, kernel_h, kernel_w, support_bias, bias, stride_h, stride_w, padding_h, padding_w, thread_count, workspace);
+}
+
+void conv3d_fp32_VALID(Tensor *input, Tensor *output, Tensor *kernel, int kernel_t, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_t, int stride_h, int stride_w, int thread_count, Tensor *workspace) {
     assert(input->ctype() == BCTHW);
-    const int in_channel = input->channel();
     assert((output->ctype() == BCTHW || output->ctype() == BTHWC));
+    const int in_channel = input->channel();
+    const int out_time = output->time();
     const int out_height = output->height();
     const int out_width = output->width();
-    const int out_time = output->time();
-    const int out_channel = output->channel();
-
-    // 改变布局的感受野
-    float **i_new = new float *[out_time * out_height * out_width];
-    for (int i = 0; i < out_time * out_width * out_height; i++) {
-        i_new[i] = new float[in_channel * kernel_t * kernel_h * kernel_w];
-    }
-
+    const int row = in_channel * kernel_t * kernel_h * kernel_w;
+    assert(kernel->dimension() == row && kernel->sequence() == output->channel());
+    Tensor local(input->backend());
+    Tensor *patches = conv_patches(input, workspace, &local, out_time * out_height * out_width, row);
     for (int b = 0; b < input->batch(); ++b) {
-        // 将不同的感受野重新布局
-        for (int out_t = 0; out_t < out_time; ++out_t) {
-            for (int out_h = 0; out_h < out_height; ++out_h) {
-                for (int out_w = 0; out_w < out_width; ++out_w) {
-                    int blk_t = out_t * stride_t;
-                    int blk_h = out_h * stride_h;
-                    int blk_w = out_w * stride_w;
-
-                    // 将所有通道的感受野全都放在一行
-                    for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
-                        for (int k_t = 0; k_t < kernel_t; ++k_t) {
-                            for (int k_h = 0; k_h < kernel_h; ++k_h) {
-                                float *i_p = input->ptrAt<float>(b, in_ch, blk_t + k_t, blk_h + k_h, blk_w + 0);
-                                for (int i = 0; i < kernel_w; i++) {
-                                    i_new[out_w + out_h * out_width + out_t * out_width * out_height][i + k_h * kernel_w + k_t * kernel_h * kernel_w + in_ch * kernel_t * kernel_h * kernel_w] = i_p[i];
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
-            for (int out_t = 0; out_t < out_time; ++out_t) {
-                for (int out_h = 0; out_h < out_height; ++out_h) {
-                    for (int out_w = 0; out_w < out_width; ++out_w) {
-                        // set value;
-                        float value = 0;
-                        vec_dot_fp32(in_channel * kernel_t * kernel_h * kernel_w, &value, k_new[out_ch], i_new[out_w + out_h * out_width + out_t * out_width * out_height]);
-                        if (support_bias) {
-                            value += *bias->ptrAt<float>(0, 0, 0, 0, out_ch);
-                        }
-                        *output->ptrAt<float>(b, out_ch, out_t, out_h, out_w) = value;
+        parallel_for(out_time, out_height, out_width, thread_count, [&](int out_t, int out_h, int out_w) {
+            float *p_p = patches->ptrAt<float>(0, 0, (out_t * out_height + out_h) * out_width + out_w, 0);
+            for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
+                for (int k_t = 0; k_t < kernel_t; ++k_t) {
+                    for (int k_h = 0; k_h < kernel_h; ++k_h) {
+                        memcpy(p_p + ((in_ch * kernel_t + k_t) * kernel_h + k_h) * kernel_w,
+                               input->ptrAt<float>(b, in_ch, out_t * stride_t + k_t, out_h * stride_h + k_h, out_w * stride_w),
+                               sizeof(float) * kernel_w);
                     }
                 }
             }
-        }
+        });
+        const int plane = out_height * out_width;
+        conv_gemm(patches, kernel, support_bias, bias, thread_count, [&](int p, int out_ch, float value) {
+            *output->ptrAt<float>(b, out_ch, p / plane, p % plane / out_width, p % out_width) = value;
+        });
     }
-}
\ No newline at end of file
+}
@@ -10,14 +10,29 @@
 #include "VecDot.hpp"
 using namespace mllm;
 
-float ** reshape_conv2d_kernal_fp32(Tensor* kernel);
-
-void conv2d_fp32_VALID(Tensor* input, Tensor* output, float** k_new, int kernel_h, int kernel_w, bool support_bias, Tensor* bias, int stride_h, int stride_w, int thread_count=4);
-void conv2d_fp32_SAME(Tensor* input, Tensor* output, float** k_new, int kernel_h, int kernel_w, bool support_bias, Tensor* bias, int stride_h, int stride_w, int padding_h, int padding_w, int thread_count=4);
-
-
-float **reshape_conv3d_kernal_fp32(Tensor *kernel);
-
-void conv3d_fp32_VALID(Tensor* input, Tensor *output, float** k_new, int kernel_t, int kernel_h, int kernel_w, bool support_bias, Tensor* bias,  int stride_t, int stride_h, int stride_w, int thread_count=4);
+/**
+ * Convolutions run as a GEMM between the repacked kernel, one row of in_channel * kernel size weights per
+ * output channel, and the receptive fields of the input gathered into rows of the same order. Both live in
+ * contiguous Tensors: the kernel is repacked once at load time, and the gathered input goes to a per-op
+ * \p workspace that only grows (with nullptr a temporary Tensor is allocated on every call). For the
+ * patch embeddings of ViT/CLIP/ImageBind (stride == kernel, VALID) the receptive fields do not overlap,
+ * so the gather is a plain re-layout of the input, copied a kernel row at a time.
+ */
+
+/**
+ * \brief repack \p weight [out_channel, kernel_h, in_channel, kernel_w] into \p kernel [1, 1, out_channel, in_channel * kernel_h * kernel_w].
+ */
+void conv2d_kernel_fp32(Tensor *weight, Tensor *kernel);
+
+void conv2d_fp32_VALID(Tensor *input, Tensor *output, Tensor *kernel, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int thread_count = 4, Tensor *workspace = nullptr);
+void conv2d_fp32_SAME(Tensor *input, Tensor *output, Tensor *kernel, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_h, int stride_w, int padding_h, int padding_w, int thread_count = 4, Tensor *workspace = nullptr);
+
+/**
+ * \brief repack \p weight (BCTHW, [out_channel, in_channel, kernel_t, kernel_h, kernel_w]) into
+ *        \p kernel [1, 1, out_channel, in_channel * kernel_t * kernel_h * kernel_w].
+ */
+void conv3d_kernel_fp32(Tensor *weight, Tensor *kernel);
+
+void conv3d_fp32_VALID(Tensor *input, Tensor *output, Tensor *kernel, int kernel_t, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_t, int stride_h, int stride_w, int thread_count = 4, Tensor *workspace = nullptr);
 
 #endif //CONVOLUTION2D_HPP
@@ -0,0 +1,207 @@
+#include "Elementwise.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#define MLLM_EW_SIMD
+#define MLLM_EW_EPR 8
+typedef __m256 ew_vec;
+static inline ew_vec ew_load(const float *p) { return _mm256_loadu_ps(p); }
+static inline ew_vec ew_set1(float x) { return _mm256_set1_ps(x); }
+static inline void ew_store(float *p, ew_vec v) { _mm256_storeu_ps(p, v); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define MLLM_EW_SIMD
+#define MLLM_EW_EPR 4
+typedef float32x4_t ew_vec;
+static inline ew_vec ew_load(const float *p) { return vld1q_f32(p); }
+static inline ew_vec ew_set1(float x) { return vdupq_n_f32(x); }
+static inline void ew_store(float *p, ew_vec v) { vst1q_f32(p, v); }
+#endif
+
+// flat (fully contiguous) work is handed to threads in chunks of this many floats
+#define MLLM_EW_CHUNK 4096
+
+template <ElementwiseOp OP>
+static inline float ew_apply(float a, float b) {
+    switch (OP) {
+    case ELEMENTWISE_ADD: return a + b;
+    case ELEMENTWISE_SUB: return a - b;
+    case ELEMENTWISE_MUL: return a * b;
+    default: return a / b;
+    }
+}
+
+#ifdef MLLM_EW_SIMD
+template <ElementwiseOp OP>
+static inline ew_vec ew_apply(ew_vec a, ew_vec b) {
+#if defined(__AVX2__)
+    switch (OP) {
+    case ELEMENTWISE_ADD: return _mm256_add_ps(a, b);
+    case ELEMENTWISE_SUB: return _mm256_sub_ps(a, b);
+    case ELEMENTWISE_MUL: return _mm256_mul_ps(a, b);
+    default: return _mm256_div_ps(a, b);
+    }
+#else
+    switch (OP) {
+    case ELEMENTWISE_ADD: return vaddq_f32(a, b);
+    case ELEMENTWISE_SUB: return vsubq_f32(a, b);
+    case ELEMENTWISE_MUL: return vmulq_f32(a, b);
+    default: return vdivq_f32(a, b);
+    }
+#endif
+}
+#endif
+
+// y = a op b where A_ROW / B_ROW say whether the operand is a row (stride 1) or a single value
+template <ElementwiseOp OP, bool A_ROW, bool B_ROW>
+static void ew_row(int n, const float *a, const float *b, float *y) {
+    int i = 0;
+#ifdef MLLM_EW_SIMD
+    const ew_vec av = ew_set1(A_ROW ? 0.0f : a[0]);
+    const ew_vec bv = ew_set1(B_ROW ? 0.0f : b[0]);
+    for (; i + MLLM_EW_EPR <= n; i += MLLM_EW_EPR) {
+        ew_store(y + i, ew_apply<OP>(A_ROW ? ew_load(a + i) : av, B_ROW ? ew_load(b + i) : bv));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = ew_apply<OP>(A_ROW ? a[i] : a[0], B_ROW ? b[i] : b[0]);
+    }
+}
+
+template <bool A_ROW, bool B_ROW>
+static void ew_row_dispatch(ElementwiseOp op, int n, const float *a, const float *b, float *y) {
+    switch (op) {
+    case ELEMENTWISE_ADD: ew_row<ELEMENTWISE_ADD, A_ROW, B_ROW>(n, a, b, y); break;
+    case ELEMENTWISE_SUB: ew_row<ELEMENTWISE_SUB, A_ROW, B_ROW>(n, a, b, y); break;
+    case ELEMENTWISE_MUL: ew_row<ELEMENTWISE_MUL, A_ROW, B_ROW>(n, a, b, y); break;
+    case ELEMENTWISE_DIV: ew_row<ELEMENTWISE_DIV, A_ROW, B_ROW>(n, a, b, y); break;
+    }
+}
+
+void elementwise_row_fp32(ElementwiseOp op, int n, const float *a, const float *b, float *y) {
+    ew_row_dispatch<true, true>(op, n, a, b, y);
+}
+
+void elementwise_row_scalar_fp32(ElementwiseOp op, int n, const float *a, float b, float *y) {
+    ew_row_dispatch<true, false>(op, n, a, &b, y);
+}
+
+vector<int> elementwise_broadcast_shape(Tensor *input0, Tensor *input1) {
+    const vector<int> s0 = {input0->batch(), input0->head(), input0->sequence(), input0->dimension()};
+    const vector<int> s1 = {input1->batch(), input1->head(), input1->sequence(), input1->dimension()};
+    vector<int> shape(4);
+    for (int i = 0; i < 4; ++i) {
+        assert(s0[i] == s1[i] || s0[i] == 1 || s1[i] == 1);
+        shape[i] = std::max(s0[i], s1[i]);
+    }
+    return shape;
+}
+
+// the whole tensor is one array in (batch, head, sequence, dimension) order of its own layout
+static bool ew_flat(Tensor *t) {
+    return t->masterTensor() == nullptr && !t->aggregated();
+}
+
+static bool ew_same_layout(Tensor *a, Tensor *b) {
+    return a->ctype() == b->ctype() && a->batch() == b->batch() && a->head() == b->head()
+           && a->sequence() == b->sequence() && a->dimension() == b->dimension();
+}
+
+// each (batch, head, sequence) row is contiguous along the dimension axis
+static bool ew_row_direct(Tensor *t) {
+    return !t->aggregated() && (t->ctype() == BSHD || t->ctype() == SBHD);
+}
+
+// pointer to the row of t at (n, h, s), gathered into buf when it is not contiguous;
+// size-1 axes of t are broadcast
+static const float *ew_read_row(Tensor *t, int n, int h, int s, vector<float> &buf) {
+    n = t->batch() == 1 ? 0 : n;
+    h = t->head() == 1 ? 0 : h;
+    s = t->sequence() == 1 ? 0 : s;
+    if (ew_row_direct(t) || t->dimension() == 1) {
+        return t->ptrAt<float>(n, h, s, 0);
+    }
+    buf.resize(t->dimension());
+    for (int d = 0; d < t->dimension(); ++d) {
+        buf[d] = *t->ptrAt<float>(n, h, s, d);
+    }
+    return buf.data();
+}
+
+void elementwise_fp32(ElementwiseOp op, Tensor *input0, Tensor *input1, Tensor *output, int thread_count) {
+    assert(elementwise_broadcast_shape(input0, input1) == vector<int>({output->batch(), output->head(), output->sequence(), output->dimension()}));
+    if (input1->count() == 1 && ew_flat(input1)) {
+        elementwise_scalar_fp32(op, input0, input1->hostPtr<float>()[0], output, thread_count);
+        return;
+    }
+    if (ew_flat(input0) && ew_flat(input1) && ew_flat(output)
+        && ew_same_layout(input0, output) && ew_same_layout(input1, output)) {
+        const int count = output->count();
+        const float *a = input0->hostPtr<float>();
+        const float *b = input1->hostPtr<float>();
+        float *y = output->hostPtr<float>();
+        parallel_for((count + MLLM_EW_CHUNK - 1) / MLLM_EW_CHUNK, thread_count, [&](int chunk) {
+            const int c = chunk * MLLM_EW_CHUNK;
+            elementwise_row_fp32(op, std::min(MLLM_EW_CHUNK, count - c), a + c, b + c, y + c);
+        });
+        return;
+    }
+    const int dim = output->dimension();
+    const bool a_row = input0->dimension() == dim;
+    const bool b_row = input1->dimension() == dim;
+    const bool out_direct = ew_row_direct(output);
+    parallel_for(output->batch(), output->head(), output->sequence(), thread_count, [&](int n, int h, int s) {
+        static thread_local vector<float> a_buf, b_buf, y_buf;
+        const float *a = ew_read_row(input0, n, h, s, a_buf);
+        const float *b = ew_read_row(input1, n, h, s, b_buf);
+        float *y = output->ptrAt<float>(n, h, s, 0);
+        if (!out_direct) {
+            y_buf.resize(dim);
+            y = y_buf.data();
+        }
+        if (a_row && b_row) {
+            ew_row_dispatch<true, true>(op, dim, a, b, y);
+        } else if (a_row) {
+            ew_row_dispatch<true, false>(op, dim, a, b, y);
+        } else if (b_row) {
+            ew_row_dispatch<false, true>(op, dim, a, b, y);
+        } else {
+            ew_row_dispatch<false, false>(op, dim, a, b, y);
+        }
+        if (!out_direct) {
+            for (int d = 0; d < dim; ++d) {
+                *output->ptrAt<float>(n, h, s, d) = y[d];
+            }
+        }
+    });
+}
+
+void elementwise_scalar_fp32(ElementwiseOp op, Tensor *input, float value, Tensor *output, int thread_count) {
+    if (ew_flat(input) && ew_flat(output) && ew_same_layout(input, output)) {
+        const int count = output->count();
+        const float *a = input->hostPtr<float>();
+        float *y = output->hostPtr<float>();
+        parallel_for((count + MLLM_EW_CHUNK - 1) / MLLM_EW_CHUNK, thread_count, [&](int chunk) {
+            const int c = chunk * MLLM_EW_CHUNK;
+            elementwise_row_scalar_fp32(op, std::min(MLLM_EW_CHUNK, count - c), a + c, value, y + c);
+        });
+        return;
+    }
+    const int dim = output->dimension();
+    const bool out_direct = ew_row_direct(output);
+    parallel_for(output->batch(), output->head(), output->sequence(), thread_count, [&](int n, int h, int s) {
+        static thread_local vector<float> a_buf, y_buf;
+        const float *a = ew_read_row(input, n, h, s, a_buf);
+        float *y = output->ptrAt<float>(n, h, s, 0);
+        if (!out_direct) {
+            y_buf.resize(dim);
+            y = y_buf.data();
+        }
+        elementwise_row_scalar_fp32(op, dim, a, value, y);
+        if (!out_direct) {
+            for (int d = 0; d < dim; ++d) {
+                *output->ptrAt<float>(n, h, s, d) = y[d];
+            }
+        }
+    });
+}
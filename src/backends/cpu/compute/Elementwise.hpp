@@ -0,0 +1,42 @@
+#ifndef MLLM_ELEMENTWISE_HPP
+#define MLLM_ELEMENTWISE_HPP
+
+#include "VecDot.hpp"
+using namespace mllm;
+
+enum ElementwiseOp {
+    ELEMENTWISE_ADD,
+    ELEMENTWISE_SUB,
+    ELEMENTWISE_MUL,
+    ELEMENTWISE_DIV,
+};
+
+/**
+ * \brief y[i] = a[i] op b[i] over \p n floats. \p y may alias \p a or \p b.
+ */
+void elementwise_row_fp32(ElementwiseOp op, int n, const float *a, const float *b, float *y);
+
+/**
+ * \brief y[i] = a[i] op b over \p n floats. \p y may alias \p a.
+ */
+void elementwise_row_scalar_fp32(ElementwiseOp op, int n, const float *a, float b, float *y);
+
+/**
+ * \brief Shape {batch, head, sequence, dimension} of input0 op input1: on every axis the sizes
+ *        must match or one of them must be 1, which is broadcast.
+ */
+vector<int> elementwise_broadcast_shape(Tensor *input0, Tensor *input1);
+
+/**
+ * \brief output = input0 op input1 with broadcasting, see elementwise_broadcast_shape(); \p output
+ *        must already have the broadcast shape. An input of the output's shape may be the output
+ *        itself, which makes the op in place.
+ */
+void elementwise_fp32(ElementwiseOp op, Tensor *input0, Tensor *input1, Tensor *output, int thread_count = 4);
+
+/**
+ * \brief output = input op value. \p output has the input's shape and may be the input.
+ */
+void elementwise_scalar_fp32(ElementwiseOp op, Tensor *input, float value, Tensor *output, int thread_count = 4);
+
+#endif // MLLM_ELEMENTWISE_HPP
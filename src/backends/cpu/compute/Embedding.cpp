@@ -0,0 +1,125 @@
+#include "Embedding.hpp"
+#include "Parallel.hpp"
+#include "../quantize/QuantizeQ6.hpp"
+#include <cstring>
+#include <unordered_map>
+
+int embedding_token_id(Tensor *ids, int b, int h, int s) {
+    if (ids->dtype() == MLLM_TYPE_I32) {
+        return *ids->ptrAt<int32_t>(b, h, s, 0);
+    }
+    return (int)ids->dataAt<float>(b, h, s, 0);
+}
+
+// y[0..16) = q[0..16) * d
+#if defined(__ARM_NEON) && defined(__aarch64__)
+static inline void embedding_store_s8x16(int8x16_t q, float d, float *y) {
+    const int16x8_t lo = vmovl_s8(vget_low_s8(q));
+    const int16x8_t hi = vmovl_high_s8(q);
+    vst1q_f32(y + 0, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), d));
+    vst1q_f32(y + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(lo)), d));
+    vst1q_f32(y + 8, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), d));
+    vst1q_f32(y + 12, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(hi)), d));
+}
+#endif
+
+// the Q8_0 and Q4_0 rows dequantized a vector at a time; same results as dequantize_row_q8_0/q4_0
+static void embedding_row_q8_0(const block_q8_0 *x, float *y, int k) {
+#if defined(__AVX2__)
+    for (int i = 0; i < k / QK8_0; ++i) {
+        const __m256 d = _mm256_set1_ps(MLLM_FP16_TO_FP32(x[i].d));
+        for (int j = 0; j < QK8_0; j += 8) {
+            const __m256i q = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(x[i].qs + j)));
+            _mm256_storeu_ps(y + i * QK8_0 + j, _mm256_mul_ps(_mm256_cvtepi32_ps(q), d));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (int i = 0; i < k / QK8_0; ++i) {
+        const float d = MLLM_FP16_TO_FP32(x[i].d);
+        for (int j = 0; j < QK8_0; j += 16) {
+            embedding_store_s8x16(vld1q_s8(x[i].qs + j), d, y + i * QK8_0 + j);
+        }
+    }
+#else
+    dequantize_row_q8_0(x, y, k);
+#endif
+}
+
+static void embedding_row_q4_0(const block_q4_0 *x, float *y, int k) {
+#if defined(__AVX2__)
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m256i zero = _mm256_set1_epi32(8);
+    for (int i = 0; i < k / QK4_0; ++i) {
+        const __m256 d = _mm256_set1_ps(MLLM_FP16_TO_FP32(x[i].d));
+        const __m128i qs = _mm_loadu_si128((const __m128i *)x[i].qs);
+        const __m128i lo = _mm_and_si128(qs, mask);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(qs, 4), mask);
+        const __m128i parts[4] = {lo, _mm_srli_si128(lo, 8), hi, _mm_srli_si128(hi, 8)};
+        for (int j = 0; j < 4; ++j) {
+            const __m256i q = _mm256_sub_epi32(_mm256_cvtepu8_epi32(parts[j]), zero);
+            _mm256_storeu_ps(y + i * QK4_0 + j * 8, _mm256_mul_ps(_mm256_cvtepi32_ps(q), d));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (int i = 0; i < k / QK4_0; ++i) {
+        const float d = MLLM_FP16_TO_FP32(x[i].d);
+        const uint8x16_t qs = vld1q_u8(x[i].qs);
+        const int8x16_t lo = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(qs, vdupq_n_u8(0x0F))), vdupq_n_s8(8));
+        const int8x16_t hi = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(qs, 4)), vdupq_n_s8(8));
+        embedding_store_s8x16(lo, d, y + i * QK4_0);
+        embedding_store_s8x16(hi, d, y + i * QK4_0 + 16);
+    }
+#else
+    dequantize_row_q4_0(x, y, k);
+#endif
+}
+
+static void embedding_row(Tensor *weight, int id, float *y) {
+    const int hidden = weight->dimension();
+    // rows are addressed in bytes: id * hidden overflows int for large vocabularies
+    const char *row = weight->hostPtr<char>() + (size_t)id * DataTypeSize(weight->dtype(), hidden);
+    switch (weight->dtype()) {
+    case MLLM_TYPE_F32: memcpy(y, row, sizeof(float) * hidden); break;
+    case MLLM_TYPE_F16: mllm_fp16_to_fp32_row((const mllm_fp16_t *)row, y, hidden); break;
+    case MLLM_TYPE_Q4_0: embedding_row_q4_0((const block_q4_0 *)row, y, hidden); break;
+    case MLLM_TYPE_Q4_K: dequantize_row_q4_K((const block_q4_K *)row, y, hidden); break;
+    case MLLM_TYPE_Q6_K: dequantize_row_q6_K((const block_q6_K *)row, y, hidden); break;
+    case MLLM_TYPE_Q8_0: embedding_row_q8_0((const block_q8_0 *)row, y, hidden); break;
+    case MLLM_TYPE_Q8_K: dequantize_row_q8_K((const block_q8_K *)row, y, hidden); break;
+    default: std::cout << "embedding of " << DataTypeName(weight->dtype()) << " weights is not supported" << std::endl; break;
+    }
+}
+
+void embedding_fp32(Tensor *weight, Tensor *ids, Tensor *output, int thread_count) {
+    const int hidden = weight->dimension();
+    assert(output->dimension() == hidden);
+    // every (batch, head, sequence) row, and for each the first row with the same id
+    vector<int> b_of, h_of, s_of, id_of, first;
+    std::unordered_map<int, int> seen;
+    for (int b = 0; b < ids->batch(); ++b) {
+        for (int h = 0; h < ids->head(); ++h) {
+            for (int s = 0; s < ids->sequence(); ++s) {
+                const int id = embedding_token_id(ids, b, h, s);
+                assert(id >= 0 && id < weight->sequence());
+                first.push_back(seen.emplace(id, (int)id_of.size()).first->second);
+                b_of.push_back(b);
+                h_of.push_back(h);
+                s_of.push_back(s);
+                id_of.push_back(id);
+            }
+        }
+    }
+    const int rows = id_of.size();
+    parallel_for(rows, thread_count, [&](int r) {
+        if (first[r] == r) {
+            embedding_row(weight, id_of[r], output->ptrAt<float>(b_of[r], h_of[r], s_of[r], 0));
+        }
+    });
+    parallel_for(rows, thread_count, [&](int r) {
+        const int f = first[r];
+        if (f != r) {
+            memcpy(output->ptrAt<float>(b_of[r], h_of[r], s_of[r], 0),
+                   output->ptrAt<float>(b_of[f], h_of[f], s_of[f], 0), sizeof(float) * hidden);
+        }
+    });
+}
@@ -0,0 +1,20 @@
+#ifndef MLLM_EMBEDDING_HPP
+#define MLLM_EMBEDDING_HPP
+
+#include "VecDot.hpp"
+using namespace mllm;
+
+/**
+ * \brief Token id at (b, h, s) of \p ids, stored as I32 or, as the tokenizers emit them, as F32.
+ */
+int embedding_token_id(Tensor *ids, int b, int h, int s);
+
+/**
+ * \brief output[b, h, s, :] = row ids[b, h, s] of \p weight [1, 1, vocab, hidden], dequantized to F32.
+ *        The rows of a whole batch are gathered in one pass and each distinct id is dequantized once,
+ *        so tokens repeated in a prompt cost a copy. Weights may be F32, F16, Q4_0, Q4_K, Q6_K, Q8_0
+ *        or Q8_K, so the table stays quantized in memory.
+ */
+void embedding_fp32(Tensor *weight, Tensor *ids, Tensor *output, int thread_count = 4);
+
+#endif // MLLM_EMBEDDING_HPP
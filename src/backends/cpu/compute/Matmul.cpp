@@ -3,9 +3,122 @@
 //
 
 #include "Matmul.hpp"
+#include "Parallel.hpp"
 #include <pthread.h>
+#include <algorithm>
 
-ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, bool transpose0, bool transpose1, int thread_count) {
+// key positions visible to query row m of M when there are k_len keys
+static inline int mat_mul_causal_len(int m, int M, int k_len) {
+    return std::min(k_len, std::max(m + k_len - M + 1, 0));
+}
+
+// keys of batch row b: all \p len of them, or its own k_lens[b] when the rows are sequences of
+// different lengths padded to the longest
+static inline int mat_mul_row_keys(const vector<int> &k_lens, int b, int len) {
+    return k_lens.empty() ? len : std::min(k_lens[b], len);
+}
+
+// the axis of t whose consecutive elements are adjacent in memory
+static inline Chl mat_mul_inner_axis(Tensor *t) {
+    switch (t->ctype()) {
+    case BHDS:
+    case BDHS:
+    case DBHS:
+        return SEQUENCE;
+    default:
+        return DIMENSION;
+    }
+}
+
+// whether src0 rows and src1 columns can be handed to vec_dot as they are stored
+static inline bool mat_mul_k_contiguous(Tensor *src0, Tensor *src1, bool transpose0, bool transpose1) {
+    return mat_mul_inner_axis(src0) == (transpose0 ? SEQUENCE : DIMENSION)
+           && mat_mul_inner_axis(src1) == (transpose1 ? DIMENSION : SEQUENCE);
+}
+
+static inline void mat_mul_mad(int n, float *y, const float *x, float v) {
+    vec_mad_fp32(n, y, x, v);
+}
+static inline void mat_mul_mad(int n, float *y, const mllm_fp16_t *x, float v) {
+    vec_mad_fp16(n, y, x, v);
+}
+
+/*
+ * dst = src0 x src1 one output row at a time, as the sum over k of src0[m, k] * src1[k, :]. This
+ * is the layout the dot-product kernels cannot take: src1 stored along N, like V in (batch,
+ * sequence, head, dimension) order. Its rows are read where they are, so neither the operand nor
+ * the tensor it is a view of (e.g. a KV cache) has to be laid out along K. Operands stored along
+ * neither axis are gathered row by row.
+ */
+template <typename Dtype>
+static void mat_mul_rows(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, bool transpose0, bool transpose1, int thread_count, CausalMMType causal,
+                         const vector<int> &k_lens) {
+    const int M = transpose0 ? src0->dimension() : src0->sequence();
+    const int K = transpose0 ? src0->sequence() : src0->dimension();
+    const int N = transpose1 ? src1->sequence() : src1->dimension();
+    const bool src0_direct = mat_mul_inner_axis(src0) == (transpose0 ? SEQUENCE : DIMENSION);
+    const bool src1_direct = mat_mul_inner_axis(src1) == (transpose1 ? SEQUENCE : DIMENSION);
+    const bool dst_direct = dst->dtype() == MLLM_TYPE_F32 && mat_mul_inner_axis(dst) == DIMENSION;
+    parallel_for(src0->batch(), src0->head(), M, thread_count, [&](int b, int h, int m) {
+        static thread_local vector<float> src0_buf, dst_buf;
+        static thread_local vector<Dtype> src1_buf;
+        const int b_1 = (src1->batch() == 1 && src1->head() == 1) ? 0 : b;
+        const int h_1 = (src1->batch() == 1 && src1->head() == 1) ? 0 : h;
+        const int N_m = causal == CAUSAL_MM_OUTPUT ? mat_mul_causal_len(m, M, mat_mul_row_keys(k_lens, b, N)) : N;
+        const int K_m = causal == CAUSAL_MM_INPUT0 ? mat_mul_causal_len(m, M, mat_mul_row_keys(k_lens, b, K)) : K;
+        const float *x = nullptr;
+        if (src0_direct) {
+            x = src0->ptrAt<float>(b, h, transpose0 ? 0 : m, transpose0 ? m : 0);
+        } else {
+            src0_buf.resize(K_m);
+            for (int k = 0; k < K_m; k++) {
+                src0_buf[k] = transpose0 ? src0->dataAt<float>(b, h, k, m) : src0->dataAt<float>(b, h, m, k);
+            }
+            x = src0_buf.data();
+        }
+        float *y = dst_direct ? dst->ptrAt<float>(b, h, m, 0) : nullptr;
+        if (!dst_direct) {
+            dst_buf.resize(N_m);
+            y = dst_buf.data();
+        }
+        std::fill(y, y + N_m, 0.0f);
+        for (int k = 0; k < K_m; k++) {
+            const Dtype *row = nullptr;
+            if (src1_direct) {
+                row = src1->ptrAt<Dtype>(b_1, h_1, transpose1 ? 0 : k, transpose1 ? k : 0);
+            } else {
+                src1_buf.resize(N_m);
+                for (int n = 0; n < N_m; n++) {
+                    src1_buf[n] = transpose1 ? src1->dataAt<Dtype>(b_1, h_1, n, k) : src1->dataAt<Dtype>(b_1, h_1, k, n);
+                }
+                row = src1_buf.data();
+            }
+            mat_mul_mad(N_m, y, row, x[k]);
+        }
+        if (support_bias) {
+            for (int n = 0; n < N_m; n++) {
+                y[n] += bias->dataAt<float>(0, 0, 0, n);
+            }
+        }
+        if (!dst_direct) {
+            for (int n = 0; n < N_m; n++) {
+                if (dst->dtype() == MLLM_TYPE_F32) {
+                    *dst->ptrAt<float>(b, h, m, n) = y[n];
+                } else {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(y[n]);
+                }
+            }
+        }
+    });
+}
+
+ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, bool transpose0, bool transpose1, int thread_count, CausalMMType causal,
+                       const vector<int> &k_lens) {
+    assert(k_lens.empty() || (int)k_lens.size() == src0->batch());
+    if (!mat_mul_k_contiguous(src0, src1, transpose0, transpose1)) {
+        mat_mul_rows<float>(src0, src1, dst, support_bias, bias, transpose0, transpose1, thread_count, causal, k_lens);
+        return MLLM_NO_ERROR;
+    }
     const int M = transpose0 ? src0->dimension() : src0->sequence();
     const int K = transpose0 ? src0->sequence() : src0->dimension();
     const int N = transpose1 ? src1->sequence() : src1->dimension();
@@ -17,22 +130,18 @@ ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bia
             const int b_1 = (src1->batch() == 1 && src1->head() == 1) ? 0 : b;
             const int h_1 = (src1->batch() == 1 && src1->head() == 1) ? 0 : h;
             for (int m = 0; m < M; m++) {
-                const int num_blocks = N / blck_0;
-                const int remainder = N % blck_0;
-#pragma omp parallel for num_threads(thread_count)
-                for (int block = 0; block < num_blocks + 1; block++) {
+                const int N_m = causal == CAUSAL_MM_OUTPUT ? mat_mul_causal_len(m, M, mat_mul_row_keys(k_lens, b, N)) : N;
+                const int K_m = causal == CAUSAL_MM_INPUT0 ? mat_mul_causal_len(m, M, mat_mul_row_keys(k_lens, b, K)) : K;
+                const int num_blocks = N_m / blck_0;
+                const int remainder = N_m % blck_0;
+                parallel_for(num_blocks + 1, thread_count, [&](int block) {
                     for (int n = block * blck_0; n < (block + 1) * blck_0 & n < num_blocks * blck_0 + remainder; n++) {
-                        int s_1, d_1;
-                        int s_0, d_0;
-                        if (!transpose0 && transpose1) {
-                            s_1 = n; d_1 = 0; s_0 = m; d_0 = 0;
-                        } else if (!transpose0 && !transpose1) {
-                            s_1 = 0; d_1 = n; s_0 = m; d_0 = 0;
-                        } else {
-                            s_1 = 0; d_1 = n; s_0 = 0; d_0 = m;
-                        }
+                        const int s_1 = transpose1 ? n : 0;
+                        const int d_1 = transpose1 ? 0 : n;
+                        const int s_0 = transpose0 ? 0 : m;
+                        const int d_0 = transpose0 ? m : 0;
                         if(dst->dtypeAt(n,h,m,n) == MLLM_TYPE_F32) {
-                            vec_dot_fp32(K, dst->ptrAt<float>(b, h, m, n),
+                            vec_dot_fp32(K_m, dst->ptrAt<float>(b, h, m, n),
                                          src1_cal->hostPtr<float>() + src1_cal->offset(b_1, h_1, s_1, d_1),
                                          src0_cal->hostPtr<float>() + src0_cal->offset(b, h, s_0, d_0));
                             if (support_bias) {
@@ -40,7 +149,7 @@ ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bia
                             }
                         }else if (dst->dtypeAt(n,h,m,n) == MLLM_TYPE_F16) {
                             float tmp = 0;
-                            vec_dot_fp32(K, &tmp,
+                            vec_dot_fp32(K_m, &tmp,
                                          src1_cal->hostPtr<float>() + src1_cal->offset(b_1, h_1, s_1, d_1),
                                          src0_cal->hostPtr<float>() + src0_cal->offset(b, h, s_0, d_0));
                             if (support_bias) {
@@ -50,31 +159,24 @@ ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bia
                             }
                         }else{std::cout<<"Not support type [Matmul]"<<std::endl;}
                     }
-                }
+                });
             }
         }
     }
     return MLLM_NO_ERROR;
 }
 
-ErrorCode mat_mul_fp32_fp16(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, bool transpose0, bool transpose1, int thread_count) {
+ErrorCode mat_mul_fp32_fp16(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, bool transpose0, bool transpose1, int thread_count, Tensor *workspace, CausalMMType causal,
+                            const vector<int> &k_lens) {
     assert(src1->dtype() == MLLM_TYPE_F16);
-    assert(src0_->dtype() == MLLM_TYPE_F32);
-    Tensor src0_qf16(src0_->shape());
-    src0_qf16.setBackend(src0_->backend());
-    src0_qf16.setDtype(MLLM_TYPE_F16);
-    src0_qf16.alloc();
-        for (int b = 0; b < src0_->batch(); b++) {
-            for (int h = 0; h < src0_->head(); h++) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int s = 0; s < src0_->sequence(); s++) {
-                    mllm_fp32_to_fp16_row(src0_->hostPtr<float>() + src0_->offset(b, h, s, 0),
-                                      src0_qf16.hostPtr<mllm_fp16_t>() + src0_qf16.offset(b, h, s, 0),
-                                      src0_->dimension());
-                }
-            }
-        }
-    auto *src0 = &src0_qf16;
+    assert(k_lens.empty() || (int)k_lens.size() == src0_->batch());
+    if (!mat_mul_k_contiguous(src0_, src1, transpose0, transpose1)) {
+        // no dot products, so src0 stays F32
+        mat_mul_rows<mllm_fp16_t>(src0_, src1, dst, support_bias, bias, transpose0, transpose1, thread_count, causal, k_lens);
+        return MLLM_NO_ERROR;
+    }
+    Tensor src0_local(src0_->backend());
+    Tensor *src0 = mat_mul_src0_as(src0_, MLLM_TYPE_F16, workspace != nullptr ? workspace : &src0_local, thread_count);
     // for(int b=0; b<src0->dimension(); b++) {
     //     std::cout<<MLLM_COMPUTE_FP16_TO_FP32(*src0->ptrAt<mllm_fp16_t>(0, 0, 0, b))<<" ";
     // }
@@ -94,57 +196,34 @@ ErrorCode mat_mul_fp32_fp16(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
             const int b_1 = (src1->batch() == 1 && src1->head() == 1) ? 0 : b;
             const int h_1 = (src1->batch() == 1 && src1->head() == 1) ? 0 : h;
             for (int m = 0; m < M; m++) {
-                const int num_blocks = N / blck_0;
-                const int remainder = N % blck_0;
-#pragma omp parallel for num_threads(thread_count)
-                for (int block = 0; block < num_blocks + 1; block++) {
+                const int N_m = causal == CAUSAL_MM_OUTPUT ? mat_mul_causal_len(m, M, mat_mul_row_keys(k_lens, b, N)) : N;
+                const int K_m = causal == CAUSAL_MM_INPUT0 ? mat_mul_causal_len(m, M, mat_mul_row_keys(k_lens, b, K)) : K;
+                const int num_blocks = N_m / blck_0;
+                const int remainder = N_m % blck_0;
+                parallel_for(num_blocks + 1, thread_count, [&](int block) {
                     for (int n = block * blck_0; n < (block + 1) * blck_0 & n < num_blocks * blck_0 + remainder; n++) {
-                        int s_1, d_1;
-                        int s_0, d_0;
-                        if (!transpose0 && transpose1) {
-                            s_1 = n; d_1 = 0; s_0 = m; d_0 = 0;
-                        } else if (!transpose0 && !transpose1) {
-                            s_1 = 0; d_1 = n; s_0 = m; d_0 = 0;
-                        } else {
-                            s_1 = 0; d_1 = n; s_0 = 0; d_0 = m;
-                        }
-                        vec_dot_fp16(K, dst->ptrAt<float>(b, h, m, n),
+                        const int s_1 = transpose1 ? n : 0;
+                        const int d_1 = transpose1 ? 0 : n;
+                        const int s_0 = transpose0 ? 0 : m;
+                        const int d_0 = transpose0 ? m : 0;
+                        vec_dot_fp16(K_m, dst->ptrAt<float>(b, h, m, n),
                                      src1_cal->hostPtr<mllm_fp16_t>() + src1_cal->offset(b_1, h_1, s_1, d_1),
                                      src0_cal->hostPtr<mllm_fp16_t>() + src0_cal->offset(b, h, s_0, d_0));
                         if (support_bias) {
                             *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
                         }
                     }
-                }
+                });
             }
         }
     }
     return MLLM_NO_ERROR;
 }
 
-ErrorCode mat_mul_fp32_q4_0(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, int thread_count) {
+ErrorCode mat_mul_fp32_q4_0(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, int thread_count, Tensor *workspace) {
     assert(src1->dtype() == MLLM_TYPE_Q4_0);
-    assert(src0_->dtype() == MLLM_TYPE_F32);
-    Tensor src0_q8(src0_->shape());
-    src0_q8.setBackend(src0_->backend());
-    src0_q8.setDtype(MLLM_TYPE_Q8_0);
-    src0_q8.alloc();
-    if (src0_->dimension() % QK8_0 == 0) {
-        for (int b = 0; b < src0_->batch(); b++) {
-            for (int h = 0; h < src0_->head(); h++) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int s = 0; s < src0_->sequence(); s++) {
-                    quantize_row_q8_0(src0_->hostPtr<float>() + src0_->offset(b, h, s, 0),
-                                      src0_q8.hostPtr<block_q8_0>() + src0_q8.offset(b, h, s, 0) / QK8_0,
-                                      src0_->dimension());
-                }
-            }
-        }
-    } else {
-        std::cout << "[ERROR]: " << src0_->dimension() << "%" << QK8_0 << "!=0" << std::endl;
-        assert(src0_->dimension() % QK8_0 == 0);
-    }
-    auto *src0 = &src0_q8;
+    Tensor src0_local(src0_->backend());
+    Tensor *src0 = mat_mul_src0_as(src0_, MLLM_TYPE_Q8_0, workspace != nullptr ? workspace : &src0_local, thread_count);
     assert(src0->dtype() == MLLM_TYPE_Q8_0);
     int M = src0->sequence();
     int K = src0->dimension();
@@ -159,8 +238,7 @@ ErrorCode mat_mul_fp32_q4_0(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
             for (int m = 0; m < M; m++) {
                 int num_blocks = N / blck_0;
                 int remainder = N % blck_0;
-#pragma omp parallel for num_threads(thread_count)
-                for (int block = 0; block < num_blocks + 1; block++) {
+                parallel_for(num_blocks + 1, thread_count, [&](int block) {
                     for (int n = block * blck_0; n < (block + 1) * blck_0 & n < num_blocks * blck_0 + remainder; n++) {
                         vec_dot_q4_0_q8_0(K, dst->ptrAt<float>(b, h, m, n),
                                           src1_cal->hostPtr<block_q4_0>() + src1_cal->offset(b_1, h_1, n, 0) / QK4_0,
@@ -169,36 +247,17 @@ ErrorCode mat_mul_fp32_q4_0(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
                             *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
                         }
                     }
-                }
+                });
             }
         }
     }
     return MLLM_NO_ERROR;
 }
 
-ErrorCode mat_mul_fp32_q4_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, int thread_count) {
+ErrorCode mat_mul_fp32_q4_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, int thread_count, Tensor *workspace) {
     assert(src1->dtype() == MLLM_TYPE_Q4_K);
-    assert(src0_->dtype() == MLLM_TYPE_F32);
-    Tensor src0_q8(src0_->shape());
-    src0_q8.setBackend(src0_->backend());
-    src0_q8.setDtype(MLLM_TYPE_Q8_K);
-    src0_q8.alloc();
-    if (src0_->dimension() % QK_K == 0) {
-        for (int b = 0; b < src0_->batch(); b++) {
-            for (int h = 0; h < src0_->head(); h++) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int s = 0; s < src0_->sequence(); s++) {
-                    quantize_row_q8_K(src0_->hostPtr<float>() + src0_->offset(b, h, s, 0),
-                                      src0_q8.hostPtr<block_q8_K>() + src0_q8.offset(b, h, s, 0) / QK_K,
-                                      src0_->dimension());
-                }
-            }
-        }
-    } else {
-        std::cout << "[ERROR]: " << src0_->dimension() << "%" << QK_K << "!=0" << std::endl;
-        assert(src0_->dimension() % QK_K == 0);
-    }
-    auto *src0 = &src0_q8;
+    Tensor src0_local(src0_->backend());
+    Tensor *src0 = mat_mul_src0_as(src0_, MLLM_TYPE_Q8_K, workspace != nullptr ? workspace : &src0_local, thread_count);
     assert(src0->dtype() == MLLM_TYPE_Q8_K);
     int M = src0->sequence();
     int K = src0->dimension();
@@ -214,8 +273,7 @@ ErrorCode mat_mul_fp32_q4_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
             for (int m = 0; m < M; m++) {
                 int num_blocks = N / blck_0;
                 int remainder = N % blck_0;
-#pragma omp parallel for num_threads(thread_count)
-                for (int block = 0; block < num_blocks + 1; block++) {
+                parallel_for(num_blocks + 1, thread_count, [&](int block) {
                     for (int n = block * blck_0; n < (block + 1) * blck_0 & n < num_blocks * blck_0 + remainder; n++) {
                         if(dst->dtypeAt(n,h,m,n) == MLLM_TYPE_F32) {
                             vec_dot_q4_K_q8_K(K, dst->ptrAt<float>(b, h, m, n),
@@ -236,36 +294,17 @@ ErrorCode mat_mul_fp32_q4_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
                             }
                         }else{std::cout<<"Not support type [Matmul]"<<std::endl;}
                     }
-                }
+                });
             }
         }
     }
     return MLLM_NO_ERROR;
 }
 
-ErrorCode mat_mul_fp32_q6_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, int thread_count) {
+ErrorCode mat_mul_fp32_q6_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias, int thread_count, Tensor *workspace) {
     assert(src1->dtype() == MLLM_TYPE_Q6_K);
-    assert(src0_->dtype() == MLLM_TYPE_F32);
-    Tensor src0_q8(src0_->shape());
-    src0_q8.setBackend(src0_->backend());
-    src0_q8.setDtype(MLLM_TYPE_Q8_K);
-    src0_q8.alloc();
-    if (src0_->dimension() % QK_K == 0) {
-        for (int b = 0; b < src0_->batch(); b++) {
-            for (int h = 0; h < src0_->head(); h++) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int s = 0; s < src0_->sequence(); s++) {
-                    quantize_row_q8_K(src0_->hostPtr<float>() + src0_->offset(b, h, s, 0),
-                                      src0_q8.hostPtr<block_q8_K>() + src0_q8.offset(b, h, s, 0) / QK_K,
-                                      src0_->dimension());
-                }
-            }
-        }
-    } else {
-        std::cout << "[ERROR]: " << src0_->dimension() << "%" << QK_K << "!=0" << std::endl;
-        assert(src0_->dimension() % QK_K == 0);
-    }
-    auto *src0 = &src0_q8;
+    Tensor src0_local(src0_->backend());
+    Tensor *src0 = mat_mul_src0_as(src0_, MLLM_TYPE_Q8_K, workspace != nullptr ? workspace : &src0_local, thread_count);
     assert(src0->dtype() == MLLM_TYPE_Q8_K);
     int M = src0->sequence();
     int K = src0->dimension();
@@ -280,8 +319,7 @@ ErrorCode mat_mul_fp32_q6_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
             for (int m = 0; m < M; m++) {
                 int num_blocks = N / blck_0;
                 int remainder = N % blck_0;
-#pragma omp parallel for num_threads(thread_count)
-                for (int block = 0; block < num_blocks + 1; block++) {
+                parallel_for(num_blocks + 1, thread_count, [&](int block) {
                     for (int n = block * blck_0; n < (block + 1) * blck_0 & n < num_blocks * blck_0 + remainder; n++) {
                         if (dst->dtypeAt(n, h, m, n) == MLLM_TYPE_F32) {
                             vec_dot_q6_K_q8_K(K, dst->ptrAt<float>(b, h, m, n),
@@ -305,10 +343,276 @@ ErrorCode mat_mul_fp32_q6_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool suppo
                             std::cout << "Not support tupe [Matmul]" << std::endl;
                         }
                     }
-                }
+                });
+            }
+        }
+    }
+    return MLLM_NO_ERROR;
+}
+
+DataType mat_mul_vec_dot_type(DataType src1_dtype) {
+    switch (src1_dtype) {
+    case MLLM_TYPE_F16:
+        return MLLM_TYPE_F16;
+    case MLLM_TYPE_Q4_0:
+        return MLLM_TYPE_Q8_0;
+    case MLLM_TYPE_Q4_K:
+    case MLLM_TYPE_Q6_K:
+        return MLLM_TYPE_Q8_K;
+    default:
+        return MLLM_TYPE_F32;
+    }
+}
+
+void mat_mul_workspace(Tensor *workspace, Tensor *src0, DataType dtype) {
+    if (workspace->backend() == nullptr) {
+        workspace->setBackend(src0->backend());
+    }
+    if (workspace->dtype() != dtype) {
+        workspace->free();
+        workspace->setDtype(dtype);
+    }
+    workspace->reshape(src0->batch(), src0->head(), src0->sequence(), src0->dimension());
+    // keep a larger buffer around instead of shrinking it (e.g. prefill -> decode)
+    if (workspace->hostPtr<void>() == nullptr || workspace->count() > workspace->allocted()) {
+        workspace->alloc();
+    }
+}
+
+/**
+ * returns src0 in vec_dot_type: src0 itself if it already is (e.g. shared by a sibling CPULinear),
+ * otherwise its rows from first_row on converted into workspace.
+ */
+Tensor *mat_mul_src0_as(Tensor *src0, DataType vec_dot_type, Tensor *workspace, int thread_count, int first_row) {
+    if (src0->dtype() == vec_dot_type) {
+        return src0;
+    }
+    assert(src0->dtype() == MLLM_TYPE_F32);
+    mat_mul_workspace(workspace, src0, vec_dot_type);
+    switch (vec_dot_type) {
+    case MLLM_TYPE_F16: {
+        for (int b = 0; b < src0->batch(); b++) {
+            for (int h = 0; h < src0->head(); h++) {
+                parallel_for(src0->sequence() - first_row, thread_count, [&](int i) {
+                    const int s = first_row + i;
+                    mllm_fp32_to_fp16_row(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                                          workspace->hostPtr<mllm_fp16_t>() + workspace->offset(b, h, s, 0),
+                                          src0->dimension());
+                });
+            }
+        }
+        break;
+    }
+    case MLLM_TYPE_Q8_0: {
+        if (src0->dimension() % QK8_0 != 0) {
+            std::cout << "[ERROR]: " << src0->dimension() << "%" << QK8_0 << "!=0" << std::endl;
+            assert(src0->dimension() % QK8_0 == 0);
+        }
+        for (int b = 0; b < src0->batch(); b++) {
+            for (int h = 0; h < src0->head(); h++) {
+                parallel_for(src0->sequence() - first_row, thread_count, [&](int i) {
+                    const int s = first_row + i;
+                    quantize_row_q8_0(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                                      workspace->hostPtr<block_q8_0>() + workspace->offset(b, h, s, 0) / QK8_0,
+                                      src0->dimension());
+                });
+            }
+        }
+        break;
+    }
+    case MLLM_TYPE_Q8_K: {
+        if (src0->dimension() % QK_K != 0) {
+            std::cout << "[ERROR]: " << src0->dimension() << "%" << QK_K << "!=0" << std::endl;
+            assert(src0->dimension() % QK_K == 0);
+        }
+        for (int b = 0; b < src0->batch(); b++) {
+            for (int h = 0; h < src0->head(); h++) {
+                parallel_for(src0->sequence() - first_row, thread_count, [&](int i) {
+                    const int s = first_row + i;
+                    quantize_row_q8_K(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                                      workspace->hostPtr<block_q8_K>() + workspace->offset(b, h, s, 0) / QK_K,
+                                      src0->dimension());
+                });
+            }
+        }
+        break;
+    }
+    default:
+        std::cout << "Not support type [Matmul]" << std::endl;
+        return src0;
+    }
+    return workspace;
+}
+
+typedef void (*mat_mul_row_dot)(int n, float *s, const void *vx, const void *vy);
+static void row_dot_fp32(int n, float *s, const void *vx, const void *vy) {
+    vec_dot_fp32(n, s, (const float *)vx, (const float *)vy);
+}
+static void row_dot_fp16(int n, float *s, const void *vx, const void *vy) {
+    vec_dot_fp16(n, s, (const mllm_fp16_t *)vx, (const mllm_fp16_t *)vy);
+}
+
+static mat_mul_row_dot mat_mul_row_dot_for(DataType src1_dtype) {
+    switch (src1_dtype) {
+    case MLLM_TYPE_F32: return row_dot_fp32;
+    case MLLM_TYPE_F16: return row_dot_fp16;
+    case MLLM_TYPE_Q4_0: return vec_dot_q4_0_q8_0;
+    case MLLM_TYPE_Q4_K: return vec_dot_q4_K_q8_K;
+    case MLLM_TYPE_Q6_K: return vec_dot_q6_K_q8_K;
+    default:
+        std::cout << "Not support type [Matmul]" << std::endl;
+        return nullptr;
+    }
+}
+
+ErrorCode mat_mul_fp32_multi_dst(Tensor *src0_, Tensor *src1, const vector<Tensor *> &dsts, bool support_bias, Tensor *bias, int thread_count, Tensor *workspace) {
+    mat_mul_row_dot row_dot = mat_mul_row_dot_for(src1->dtype());
+    if (row_dot == nullptr) {
+        return NOT_SUPPORT;
+    }
+    const auto vec_dot_type = mat_mul_vec_dot_type(src1->dtype());
+    Tensor src0_local(src0_->backend());
+    Tensor *src0 = mat_mul_src0_as(src0_, vec_dot_type, workspace != nullptr ? workspace : &src0_local, thread_count);
+    const int M = src0->sequence();
+    const int K = src0->dimension();
+    const int N = src1->sequence();
+    vector<int> dst_end(dsts.size());
+    int n_total = 0;
+    for (size_t i = 0; i < dsts.size(); ++i) {
+        n_total += dsts[i]->dimension();
+        dst_end[i] = n_total;
+    }
+    assert(n_total == N);
+    assert(src1->dimension() == K);
+    const size_t src0_row_size = DataTypeSize(vec_dot_type, K);
+    const size_t src1_row_size = DataTypeSize(src1->dtype(), K);
+    const char *src1_data = src1->hostPtr<char>();
+    const int64_t blck_0 = 16;
+    const int num_blocks = (N + blck_0 - 1) / blck_0;
+    for (int b = 0; b < src0->batch(); b++) {
+        for (int h = 0; h < src0->head(); h++) {
+            for (int m = 0; m < M; m++) {
+                const char *src0_row = src0->hostPtr<char>() + DataTypeSize(vec_dot_type, src0->offset(b, h, m, 0));
+                parallel_for(num_blocks, thread_count, [&](int block) {
+                    int part = 0;
+                    const int n_end = std::min<int>((block + 1) * blck_0, N);
+                    for (int n = block * blck_0; n < n_end; n++) {
+                        while (n >= dst_end[part]) { part++; }
+                        float tmp;
+                        row_dot(K, &tmp, src1_data + n * src1_row_size, src0_row);
+                        if (support_bias) {
+                            tmp += bias->hostPtr<float>()[n];
+                        }
+                        const int n_dst = part == 0 ? n : n - dst_end[part - 1];
+                        *dsts[part]->ptrAt<float>(b, h, m, n_dst) = tmp;
+                    }
+                });
             }
         }
     }
     return MLLM_NO_ERROR;
 }
 
+ErrorCode mat_mul_fp32_glu(Tensor *src0_, Tensor *src1, Tensor *dst, GLUType glu, int thread_count, Tensor *workspace) {
+    mat_mul_row_dot row_dot = mat_mul_row_dot_for(src1->dtype());
+    if (row_dot == nullptr) {
+        return NOT_SUPPORT;
+    }
+    const auto vec_dot_type = mat_mul_vec_dot_type(src1->dtype());
+    Tensor src0_local(src0_->backend());
+    Tensor *src0 = mat_mul_src0_as(src0_, vec_dot_type, workspace != nullptr ? workspace : &src0_local, thread_count);
+    const int M = src0->sequence();
+    const int K = src0->dimension();
+    const int N = dst->dimension();
+    assert(src1->sequence() == 2 * N);
+    assert(src1->dimension() == K);
+    const size_t src1_row_size = DataTypeSize(src1->dtype(), K);
+    const char *gate_data = src1->hostPtr<char>();
+    const char *up_data = gate_data + N * src1_row_size;
+    const int64_t blck_0 = 16;
+    const int num_blocks = (N + blck_0 - 1) / blck_0;
+    for (int b = 0; b < src0->batch(); b++) {
+        for (int h = 0; h < src0->head(); h++) {
+            for (int m = 0; m < M; m++) {
+                const char *src0_row = src0->hostPtr<char>() + DataTypeSize(vec_dot_type, src0->offset(b, h, m, 0));
+                float *dst_row = dst->ptrAt<float>(b, h, m, 0);
+                parallel_for(num_blocks, thread_count, [&](int block) {
+                    const int n_end = std::min<int>((block + 1) * blck_0, N);
+                    for (int n = block * blck_0; n < n_end; n++) {
+                        float gate;
+                        float up;
+                        row_dot(K, &gate, gate_data + n * src1_row_size, src0_row);
+                        row_dot(K, &up, up_data + n * src1_row_size, src0_row);
+                        dst_row[n] = (glu == GLU_GELU ? mllm_gelu_f32(gate) : mllm_silu_f32(gate)) * up;
+                    }
+                });
+            }
+        }
+    }
+    return MLLM_NO_ERROR;
+}
+
+// a (value, column) candidate ranks above another with a larger value, or the same value at a lower column
+typedef std::pair<float, int> mat_mul_candidate;
+static inline bool mat_mul_better(const mat_mul_candidate &a, const mat_mul_candidate &b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+ErrorCode mat_mul_fp32_top_k(Tensor *src0_, Tensor *src1, Tensor *dst, int k, bool support_bias, Tensor *bias, int thread_count, Tensor *workspace) {
+    mat_mul_row_dot row_dot = mat_mul_row_dot_for(src1->dtype());
+    if (row_dot == nullptr) {
+        return NOT_SUPPORT;
+    }
+    const auto vec_dot_type = mat_mul_vec_dot_type(src1->dtype());
+    Tensor src0_local(src0_->backend());
+    // only the last row is multiplied
+    Tensor *src0 = mat_mul_src0_as(src0_, vec_dot_type, workspace != nullptr ? workspace : &src0_local, thread_count, src0_->sequence() - 1);
+    const int M = src0->sequence();
+    const int K = src0->dimension();
+    const int N = src1->sequence();
+    assert(src1->dimension() == K);
+    assert(k > 0 && k <= N);
+    assert(dst->sequence() == 2 && dst->dimension() == k);
+    const size_t src1_row_size = DataTypeSize(src1->dtype(), K);
+    const char *src1_data = src1->hostPtr<char>();
+    // one heap per chunk of columns, its root being the worst of the chunk's current top-k
+    const int num_chunks = std::max(1, std::min(thread_count, N / k));
+    const int chunk_size = (N + num_chunks - 1) / num_chunks;
+    vector<vector<mat_mul_candidate>> heaps(num_chunks);
+    for (int b = 0; b < src0->batch(); b++) {
+        for (int h = 0; h < src0->head(); h++) {
+            const char *src0_row = src0->hostPtr<char>() + DataTypeSize(vec_dot_type, src0->offset(b, h, M - 1, 0));
+            parallel_for(num_chunks, thread_count, [&](int chunk) {
+                auto &heap = heaps[chunk];
+                heap.clear();
+                const int n_end = std::min(N, (chunk + 1) * chunk_size);
+                for (int n = chunk * chunk_size; n < n_end; n++) {
+                    float tmp;
+                    row_dot(K, &tmp, src1_data + n * src1_row_size, src0_row);
+                    if (support_bias) {
+                        tmp += bias->hostPtr<float>()[n];
+                    }
+                    const mat_mul_candidate candidate(tmp, n);
+                    if ((int)heap.size() < k) {
+                        heap.push_back(candidate);
+                        std::push_heap(heap.begin(), heap.end(), mat_mul_better);
+                    } else if (mat_mul_better(candidate, heap.front())) {
+                        std::pop_heap(heap.begin(), heap.end(), mat_mul_better);
+                        heap.back() = candidate;
+                        std::push_heap(heap.begin(), heap.end(), mat_mul_better);
+                    }
+                }
+            });
+            vector<mat_mul_candidate> merged;
+            for (const auto &heap : heaps) {
+                merged.insert(merged.end(), heap.begin(), heap.end());
+            }
+            std::partial_sort(merged.begin(), merged.begin() + k, merged.end(), mat_mul_better);
+            for (int i = 0; i < k; i++) {
+                *dst->ptrAt<float>(b, h, 0, i) = (float)merged[i].second;
+                *dst->ptrAt<float>(b, h, 1, i) = merged[i].first;
+            }
+        }
+    }
+    return MLLM_NO_ERROR;
+}
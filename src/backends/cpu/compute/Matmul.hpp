@@ -9,10 +9,68 @@
 #include "VecDot.hpp"
 using namespace mllm;
 
-ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, bool transpose0 = false, bool transpose1 = false, int thread_count=4);
-ErrorCode mat_mul_fp32_fp16(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, bool transpose0 = false, bool transpose1 = false, int thread_count=4);
-ErrorCode mat_mul_fp32_q4_0(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, int thread_count=4);
-ErrorCode mat_mul_fp32_q4_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, int thread_count=4);
-ErrorCode mat_mul_fp32_q6_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, int thread_count=4);
+/**
+ * src0 is [M, K] and src1 is [K, N] (transpose0/transpose1 swap the sequence and dimension axes that
+ * hold them). Either operand may be stored in any layout: when src0 and src1 are both stored along K
+ * the vec_dot kernels are used, otherwise each output row is accumulated from src1 rows read where
+ * they are (vec_mad), so callers never need to relayout an operand, e.g. V or a transposed K.
+ *
+ * With \p causal set (attention matmuls only, see CausalMMType) just the lower-triangular part is
+ * computed: row m stops at key position m + k_len - M, where k_len is N for CAUSAL_MM_OUTPUT and K
+ * for CAUSAL_MM_INPUT0. \p k_lens, if given, is k_len per batch row instead, for a batch of
+ * sequences of different lengths: the keys past a row's own are padding and are skipped.
+ */
+ErrorCode mat_mul_fp32(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, bool transpose0 = false, bool transpose1 = false, int thread_count=4,
+                       CausalMMType causal = CAUSAL_MM_NONE, const vector<int> &k_lens = {});
+/**
+ * The fp16/quantized variants convert src0 to the vec_dot type of src1 before the dot products,
+ * unless src0 already has that type. Pass a per-op \p workspace to reuse that buffer across calls
+ * (see mat_mul_workspace); with nullptr a temporary Tensor is allocated on every call.
+ */
+ErrorCode mat_mul_fp32_fp16(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, bool transpose0 = false, bool transpose1 = false, int thread_count=4, Tensor *workspace = nullptr,
+                            CausalMMType causal = CAUSAL_MM_NONE, const vector<int> &k_lens = {});
+ErrorCode mat_mul_fp32_q4_0(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, int thread_count=4, Tensor *workspace = nullptr);
+ErrorCode mat_mul_fp32_q4_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, int thread_count=4, Tensor *workspace = nullptr);
+ErrorCode mat_mul_fp32_q6_K(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, int thread_count=4, Tensor *workspace = nullptr);
+/**
+ * \brief src0 x src1^T where the N = src1->sequence() output columns are scattered over \p dsts:
+ *        dsts[i] receives the columns [sum(dims before i), + dsts[i]->dimension()). Used to run
+ *        linears with packed weights in one pass while keeping separate outputs. src1 may be
+ *        F32, F16, Q4_0, Q4_K or Q6_K; bias (optional) is F32 of length N.
+ */
+ErrorCode mat_mul_fp32_multi_dst(Tensor *src0_, Tensor *src1, const vector<Tensor *> &dsts, bool support_bias, Tensor *bias = nullptr, int thread_count = 4, Tensor *workspace = nullptr);
+
+/**
+ * \brief dst = act(src0 x gate^T) * (src0 x up^T), where src1 packs the gate rows followed by the up
+ *        rows ([2 * N, K], N = dst->dimension()). Both dot products of a column are taken by the same
+ *        thread and combined right away, so the gate/up intermediates are never written out.
+ */
+ErrorCode mat_mul_fp32_glu(Tensor *src0_, Tensor *src1, Tensor *dst, GLUType glu, int thread_count = 4, Tensor *workspace = nullptr);
+
+/**
+ * \brief the \p k largest entries of the last row of src0 x src1^T, best first: dst[b, h, 0, i] holds the
+ *        column (token id for an lm_head, as a float) and dst[b, h, 1, i] its value. Each thread keeps a
+ *        running top-k of the columns it computes and only those candidates are merged, so the N values are
+ *        never written out. Ties go to the lower column, as with an argmax. src1 may be F32, F16, Q4_0, Q4_K
+ *        or Q6_K; bias (optional) is F32 of length N.
+ */
+ErrorCode mat_mul_fp32_top_k(Tensor *src0_, Tensor *src1, Tensor *dst, int k, bool support_bias, Tensor *bias = nullptr, int thread_count = 4, Tensor *workspace = nullptr);
+
+/**
+ * \brief the type src0 is converted to before it is multiplied with a src1 of type \p src1_dtype.
+ *        MLLM_TYPE_F32 means no conversion (and no workspace) is needed.
+ */
+DataType mat_mul_vec_dot_type(DataType src1_dtype);
+/**
+ * \brief shape \p workspace like \p src0 in \p dtype. The buffer only grows, so calling this at
+ *        reshape/setUp time and again in every execute costs no allocation once the largest shape has been seen.
+ */
+void mat_mul_workspace(Tensor *workspace, Tensor *src0, DataType dtype);
+/**
+ * \brief convert src0 (F32) to \p vec_dot_type into \p workspace and return it. If src0 already has
+ *        that type (e.g. it was converted once and is shared by sibling Linears) it is returned as is.
+ * \param first_row rows of each batch/head before it are left unconverted, for callers that only read the last rows.
+ */
+Tensor *mat_mul_src0_as(Tensor *src0, DataType vec_dot_type, Tensor *workspace, int thread_count = 4, int first_row = 0);
 
 #endif // MLLM_MATMUL_HPP
@@ -0,0 +1,240 @@
+#include "Norm.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__ARM_NEON)
+#define MLLM_NORM_SIMD
+#endif
+
+// x = a (+ b), written to s when b is given; returns sum(x * x)
+static float vec_add_sum_squares(int n, float *s, const float *a, const float *b) {
+    float sum_squares = 0;
+    int i = 0;
+#ifdef MLLM_NORM_SIMD
+    const int np = n & ~(MLLM_F32_STEP - 1);
+    MLLM_F32_VEC acc[MLLM_F32_ARR] = {MLLM_F32_VEC_ZERO};
+    MLLM_F32_VEC x[MLLM_F32_ARR];
+    for (; i < np; i += MLLM_F32_STEP) {
+        for (int j = 0; j < MLLM_F32_ARR; j++) {
+            x[j] = MLLM_F32_VEC_LOAD(a + i + j * MLLM_F32_EPR);
+            if (b != nullptr) {
+                x[j] = MLLM_F32_VEC_ADD(x[j], MLLM_F32_VEC_LOAD(b + i + j * MLLM_F32_EPR));
+                MLLM_F32_VEC_STORE(s + i + j * MLLM_F32_EPR, x[j]);
+            }
+            acc[j] = MLLM_F32_VEC_FMA(acc[j], x[j], x[j]);
+        }
+    }
+    MLLM_F32_VEC_REDUCE(sum_squares, acc);
+#endif
+    for (; i < n; ++i) {
+        float v = a[i];
+        if (b != nullptr) {
+            v += b[i];
+            s[i] = v;
+        }
+        sum_squares += v * v;
+    }
+    return sum_squares;
+}
+
+// x = a (+ b), written to s when b is given; returns sum(x)
+static float vec_add_sum(int n, float *s, const float *a, const float *b) {
+    float sum = 0;
+    int i = 0;
+#ifdef MLLM_NORM_SIMD
+    const int np = n & ~(MLLM_F32_STEP - 1);
+    MLLM_F32_VEC acc[MLLM_F32_ARR] = {MLLM_F32_VEC_ZERO};
+    MLLM_F32_VEC x[MLLM_F32_ARR];
+    for (; i < np; i += MLLM_F32_STEP) {
+        for (int j = 0; j < MLLM_F32_ARR; j++) {
+            x[j] = MLLM_F32_VEC_LOAD(a + i + j * MLLM_F32_EPR);
+            if (b != nullptr) {
+                x[j] = MLLM_F32_VEC_ADD(x[j], MLLM_F32_VEC_LOAD(b + i + j * MLLM_F32_EPR));
+                MLLM_F32_VEC_STORE(s + i + j * MLLM_F32_EPR, x[j]);
+            }
+            acc[j] = MLLM_F32_VEC_ADD(acc[j], x[j]);
+        }
+    }
+    MLLM_F32_VEC_REDUCE(sum, acc);
+#endif
+    for (; i < n; ++i) {
+        float v = a[i];
+        if (b != nullptr) {
+            v += b[i];
+            s[i] = v;
+        }
+        sum += v;
+    }
+    return sum;
+}
+
+// returns sum((x - mean)^2)
+static float vec_centered_sum_squares(int n, const float *x, float mean) {
+    float sum_squares = 0;
+    int i = 0;
+#ifdef MLLM_NORM_SIMD
+    const int np = n & ~(MLLM_F32_STEP - 1);
+    const MLLM_F32_VEC neg_mean = MLLM_F32_VEC_SET1(-mean);
+    MLLM_F32_VEC acc[MLLM_F32_ARR] = {MLLM_F32_VEC_ZERO};
+    MLLM_F32_VEC v[MLLM_F32_ARR];
+    for (; i < np; i += MLLM_F32_STEP) {
+        for (int j = 0; j < MLLM_F32_ARR; j++) {
+            v[j] = MLLM_F32_VEC_ADD(MLLM_F32_VEC_LOAD(x + i + j * MLLM_F32_EPR), neg_mean);
+            acc[j] = MLLM_F32_VEC_FMA(acc[j], v[j], v[j]);
+        }
+    }
+    MLLM_F32_VEC_REDUCE(sum_squares, acc);
+#endif
+    for (; i < n; ++i) {
+        const float v = x[i] - mean;
+        sum_squares += v * v;
+    }
+    return sum_squares;
+}
+
+// y = (x + shift) * scale * w (+ b); with unit_offset the weight is (1 + w)
+static void vec_norm_affine(int n, float *y, const float *x, float shift, float scale, const float *w, const float *b, bool unit_offset) {
+    int i = 0;
+#ifdef MLLM_NORM_SIMD
+    const int np = n & ~(MLLM_F32_EPR - 1);
+    const MLLM_F32_VEC vshift = MLLM_F32_VEC_SET1(shift);
+    const MLLM_F32_VEC vscale = MLLM_F32_VEC_SET1(scale);
+    for (; i < np; i += MLLM_F32_EPR) {
+        MLLM_F32_VEC t = MLLM_F32_VEC_MUL(MLLM_F32_VEC_ADD(MLLM_F32_VEC_LOAD(x + i), vshift), vscale);
+        const MLLM_F32_VEC vw = MLLM_F32_VEC_LOAD(w + i);
+        t = unit_offset ? MLLM_F32_VEC_FMA(t, t, vw) : MLLM_F32_VEC_MUL(t, vw);
+        if (b != nullptr) {
+            t = MLLM_F32_VEC_ADD(t, MLLM_F32_VEC_LOAD(b + i));
+        }
+        MLLM_F32_VEC_STORE(y + i, t);
+    }
+#endif
+    for (; i < n; ++i) {
+        float t = (x[i] + shift) * scale;
+        t = unit_offset ? t + t * w[i] : t * w[i];
+        y[i] = b != nullptr ? t + b[i] : t;
+    }
+}
+
+// Below this many elements per thread, splitting a row across threads costs more than it saves.
+static const int NORM_MIN_CHUNK = 1024;
+static const int NORM_CHUNK_ALIGN = 64;
+
+/*
+ * Rows are independent, so they are spread over the threads. When there are fewer rows than
+ * threads (decode: a single row), each row is instead split into chunks: the partial sums are
+ * reduced first, then every thread normalizes its own chunk.
+ */
+static int norm_dim_threads(int rows, int dim, int thread_count) {
+    if (rows >= thread_count) {
+        return 1;
+    }
+    return std::max(1, std::min(thread_count, dim / NORM_MIN_CHUNK));
+}
+
+static int norm_chunk(int dim, int n_chunks) {
+    const int chunk = (dim + n_chunks - 1) / n_chunks;
+    return (chunk + NORM_CHUNK_ALIGN - 1) / NORM_CHUNK_ALIGN * NORM_CHUNK_ALIGN;
+}
+
+// the per-chunk partial sums, added in chunk order so the result does not depend on the thread count
+static float norm_sum(const vector<float> &partial) {
+    float total = 0;
+    for (float p : partial) {
+        total += p;
+    }
+    return total;
+}
+
+void rmsnorm_fp32(Tensor *input, Tensor *residual, Tensor *sum, Tensor *output, Tensor *weight, float epsilon, bool add_unit_offset, int thread_count) {
+    const int batch = input->batch();
+    const int head = input->head();
+    const int seq = input->sequence();
+    const int dim = input->dimension();
+    const float *w = weight->hostPtr<float>();
+    const int dim_threads = norm_dim_threads(batch * head * seq, dim, thread_count);
+    if (dim_threads == 1) {
+        parallel_for(batch, head, seq, thread_count, [&](int n, int h, int s) {
+            const float *x = input->ptrAt<float>(n, h, s, 0);
+            float *x_sum = residual != nullptr ? sum->ptrAt<float>(n, h, s, 0) : nullptr;
+            const float sum_squares = vec_add_sum_squares(dim, x_sum, x, residual != nullptr ? residual->ptrAt<float>(n, h, s, 0) : nullptr);
+            const float rms = 1.0f / sqrtf(sum_squares / dim + epsilon);
+            vec_norm_affine(dim, output->ptrAt<float>(n, h, s, 0), x_sum != nullptr ? x_sum : x, 0, rms, w, nullptr, add_unit_offset);
+        });
+        return;
+    }
+    const int chunk = norm_chunk(dim, dim_threads);
+    const int n_chunks = (dim + chunk - 1) / chunk;
+    vector<float> partial(n_chunks);
+    for (int n = 0; n < batch; n++) {
+        for (int h = 0; h < head; h++) {
+            for (int s = 0; s < seq; s++) {
+                const float *x = input->ptrAt<float>(n, h, s, 0);
+                const float *r = residual != nullptr ? residual->ptrAt<float>(n, h, s, 0) : nullptr;
+                float *x_sum = residual != nullptr ? sum->ptrAt<float>(n, h, s, 0) : nullptr;
+                float *y = output->ptrAt<float>(n, h, s, 0);
+                parallel_for(n_chunks, n_chunks, [&](int c) {
+                    const int d0 = c * chunk;
+                    partial[c] = vec_add_sum_squares(std::min(chunk, dim - d0), x_sum != nullptr ? x_sum + d0 : nullptr, x + d0, r != nullptr ? r + d0 : nullptr);
+                });
+                const float rms = 1.0f / sqrtf(norm_sum(partial) / dim + epsilon);
+                parallel_for(n_chunks, n_chunks, [&](int c) {
+                    const int d0 = c * chunk;
+                    vec_norm_affine(std::min(chunk, dim - d0), y + d0, (x_sum != nullptr ? x_sum : x) + d0, 0, rms, w + d0, nullptr, add_unit_offset);
+                });
+            }
+        }
+    }
+}
+
+void layernorm_fp32(Tensor *input, Tensor *residual, Tensor *sum, Tensor *output, Tensor *weight, Tensor *bias, float epsilon, int thread_count) {
+    const int batch = input->batch();
+    const int head = input->head();
+    const int seq = input->sequence();
+    const int dim = input->dimension();
+    const float *w = weight->hostPtr<float>();
+    const float *b = bias != nullptr ? bias->hostPtr<float>() : nullptr;
+    const int dim_threads = norm_dim_threads(batch * head * seq, dim, thread_count);
+    if (dim_threads == 1) {
+        parallel_for(batch, head, seq, thread_count, [&](int n, int h, int s) {
+            const float *x = input->ptrAt<float>(n, h, s, 0);
+            float *x_sum = residual != nullptr ? sum->ptrAt<float>(n, h, s, 0) : nullptr;
+            const float mean = vec_add_sum(dim, x_sum, x, residual != nullptr ? residual->ptrAt<float>(n, h, s, 0) : nullptr) / dim;
+            if (x_sum != nullptr) {
+                x = x_sum;
+            }
+            const float rstd = 1.0f / std::sqrt(vec_centered_sum_squares(dim, x, mean) / dim + epsilon);
+            vec_norm_affine(dim, output->ptrAt<float>(n, h, s, 0), x, -mean, rstd, w, b, false);
+        });
+        return;
+    }
+    const int chunk = norm_chunk(dim, dim_threads);
+    const int n_chunks = (dim + chunk - 1) / chunk;
+    vector<float> partial(n_chunks);
+    for (int n = 0; n < batch; n++) {
+        for (int h = 0; h < head; h++) {
+            for (int s = 0; s < seq; s++) {
+                const float *x = input->ptrAt<float>(n, h, s, 0);
+                const float *r = residual != nullptr ? residual->ptrAt<float>(n, h, s, 0) : nullptr;
+                float *x_sum = residual != nullptr ? sum->ptrAt<float>(n, h, s, 0) : nullptr;
+                const float *x_norm = x_sum != nullptr ? x_sum : x;
+                float *y = output->ptrAt<float>(n, h, s, 0);
+                parallel_for(n_chunks, n_chunks, [&](int c) {
+                    const int d0 = c * chunk;
+                    partial[c] = vec_add_sum(std::min(chunk, dim - d0), x_sum != nullptr ? x_sum + d0 : nullptr, x + d0, r != nullptr ? r + d0 : nullptr);
+                });
+                const float mean = norm_sum(partial) / dim;
+                parallel_for(n_chunks, n_chunks, [&](int c) {
+                    const int d0 = c * chunk;
+                    partial[c] = vec_centered_sum_squares(std::min(chunk, dim - d0), x_norm + d0, mean);
+                });
+                const float rstd = 1.0f / std::sqrt(norm_sum(partial) / dim + epsilon);
+                parallel_for(n_chunks, n_chunks, [&](int c) {
+                    const int d0 = c * chunk;
+                    vec_norm_affine(std::min(chunk, dim - d0), y + d0, x_norm + d0, -mean, rstd, w + d0, b != nullptr ? b + d0 : nullptr, false);
+                });
+            }
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef MLLM_NORM_HPP
+#define MLLM_NORM_HPP
+
+#include "VecDot.hpp"
+using namespace mllm;
+
+/**
+ * \brief RMSNorm over the dimension axis. If \p residual is given, input + residual is written to
+ *        \p sum (the new residual stream) and normalized in the same sweep.
+ */
+void rmsnorm_fp32(Tensor *input, Tensor *residual, Tensor *sum, Tensor *output, Tensor *weight, float epsilon, bool add_unit_offset, int thread_count = 4);
+
+/**
+ * \brief LayerNorm over the dimension axis, optionally fused with a residual add like rmsnorm_fp32.
+ *        \p bias may be null.
+ */
+void layernorm_fp32(Tensor *input, Tensor *residual, Tensor *sum, Tensor *output, Tensor *weight, Tensor *bias, float epsilon, int thread_count = 4);
+
+#endif // MLLM_NORM_HPP
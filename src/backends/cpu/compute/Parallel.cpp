@@ -0,0 +1,250 @@
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#if defined(__linux__) || defined(__ANDROID__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace mllm {
+
+static thread_local bool in_parallel_region = false;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static bool pin_thread(std::thread::native_handle_type thread, int core) {
+#if defined(__linux__) || defined(__ANDROID__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (core < 0) { // unpin
+        for (int i = 0; i < CPU_SETSIZE; ++i) {
+            CPU_SET(i, &set);
+        }
+    } else {
+        CPU_SET(core, &set);
+    }
+#if defined(__ANDROID__)
+    (void)thread;
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+#endif
+#else
+    (void)thread;
+    (void)core;
+    return false;
+#endif
+}
+
+ThreadPool &ThreadPool::global() {
+    static ThreadPool pool((int)std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+ThreadPool::ThreadPool(int max_workers) :
+    max_workers_(std::max(0, max_workers)) {
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(park_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::grow(int workers) {
+    while ((int)workers_.size() < workers) {
+        const int id = (int)workers_.size() + 1;
+        workers_.emplace_back(&ThreadPool::work, this, id, generation_.load(std::memory_order_relaxed));
+#if !defined(__ANDROID__)
+        if (!cores_.empty()) {
+            pin_thread(workers_.back().native_handle(), cores_[id % cores_.size()]);
+        }
+#endif
+        started_.store((int)workers_.size(), std::memory_order_release);
+    }
+}
+
+void ThreadPool::work(int id, uint64_t seen) {
+    in_parallel_region = true;
+#if defined(__ANDROID__)
+    // started after pin(): sched_setaffinity only pins the calling thread
+    if (!cores_.empty()) {
+        pin_thread({}, cores_[id % cores_.size()]);
+    }
+#endif
+    // spin only after a dispatch this worker took part in; the others park right away
+    bool spin = false;
+    while (true) {
+        uint64_t generation = generation_.load(std::memory_order_acquire);
+        if (generation == seen && spin) {
+            // spin for a while: the next op of a decode step usually follows within microseconds
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spin_us_.load(std::memory_order_relaxed));
+            for (int i = 0; generation == seen && !stop_.load(std::memory_order_relaxed); ++i) {
+                cpu_relax();
+                if ((i & 63) == 63) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+                generation = generation_.load(std::memory_order_acquire);
+            }
+        }
+        if (generation == seen) {
+            std::unique_lock<std::mutex> lock(park_);
+            parked_++;
+            wake_.wait(lock, [&] { return generation_.load() != seen || stop_; });
+            parked_--;
+            generation = generation_.load(std::memory_order_acquire);
+        }
+        if (stop_) {
+            return;
+        }
+        seen = generation;
+        // workers that are not part of this dispatch are not waited for, and must not touch job_
+        const int parts = (int)(generation & 0xFFFF);
+        spin = id < parts;
+        if (spin) {
+            const int begin = (int)((int64_t)job_n_ * id / parts);
+            const int end = (int)((int64_t)job_n_ * (id + 1) / parts);
+            (*job_)(begin, end);
+            pending_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+void ThreadPool::run(int n, int thread_count, const std::function<void(int, int)> &fn) {
+    const int parts = std::min({thread_count, max_workers_ + 1, n, 0xFFFF});
+    if (parts <= 1 || in_parallel_region) {
+        fn(0, n);
+        return;
+    }
+    std::lock_guard<std::mutex> dispatch(dispatch_);
+    grow(parts - 1);
+    job_ = &fn;
+    job_n_ = n;
+    pending_.store(parts - 1, std::memory_order_relaxed);
+    const uint64_t generation = ((generation_.load(std::memory_order_relaxed) >> 16) + 1) << 16 | (uint64_t)parts;
+    generation_.store(generation);
+    if (parked_.load() > 0) {
+        std::lock_guard<std::mutex> lock(park_);
+        wake_.notify_all();
+    }
+    in_parallel_region = true;
+    fn(0, (int)((int64_t)n / parts));
+    in_parallel_region = false;
+    for (int i = 0; pending_.load(std::memory_order_acquire) > 0; ++i) {
+        cpu_relax();
+        if ((i & 63) == 63) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::pin(const std::vector<int> &cores) {
+#if defined(__ANDROID__)
+    {
+        std::lock_guard<std::mutex> dispatch(dispatch_);
+        cores_ = cores;
+    }
+    // sched_setaffinity only pins the calling thread: let each started worker pin itself through a dispatch
+    std::atomic<bool> pinned{true};
+    run(size(), size(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            if (!pin_thread({}, cores.empty() ? -1 : cores[i % cores.size()])) {
+                pinned = false;
+            }
+        }
+    });
+    return pinned;
+#else
+    std::lock_guard<std::mutex> dispatch(dispatch_);
+    cores_ = cores;
+    bool ok = pin_thread(pthread_self(), cores.empty() ? -1 : cores[0]);
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        ok &= pin_thread(workers_[i].native_handle(), cores.empty() ? -1 : cores[(i + 1) % cores.size()]);
+    }
+    return ok;
+#endif
+}
+
+static std::vector<int> all_cores() {
+    std::vector<int> cores(std::max(1u, std::thread::hardware_concurrency()));
+    for (size_t i = 0; i < cores.size(); ++i) {
+        cores[i] = (int)i;
+    }
+    return cores;
+}
+
+std::vector<int> cpu_big_cores() {
+    const auto cores = all_cores();
+    std::vector<long> max_freq(cores.size(), 0);
+    long top = 0;
+    for (int core : cores) {
+        std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(core) + "/cpufreq/cpuinfo_max_freq");
+        file >> max_freq[core];
+        top = std::max(top, max_freq[core]);
+    }
+    std::vector<int> big;
+    for (int core : cores) {
+        if (max_freq[core] == top) {
+            big.push_back(core);
+        }
+    }
+    return big;
+}
+
+std::vector<int> cpu_numa_node_cores(int node) {
+    // e.g. "0-15,32-47"
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!(file >> list)) {
+        return all_cores();
+    }
+    std::vector<int> cores;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        const auto dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int core = first; core <= last; ++core) {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
+
+bool cpu_pin_threads(const std::string &affinity) {
+    if (affinity == "none") {
+        return ThreadPool::global().pin({});
+    }
+    if (affinity == "big") {
+        return ThreadPool::global().pin(cpu_big_cores());
+    }
+    if (affinity.rfind("numa", 0) == 0 && affinity.size() > 4
+        && std::all_of(affinity.begin() + 4, affinity.end(), [](char c) { return isdigit((unsigned char)c); })) {
+        return ThreadPool::global().pin(cpu_numa_node_cores(std::stoi(affinity.substr(4))));
+    }
+    return false;
+}
+
+} // namespace mllm
@@ -0,0 +1,137 @@
+#ifndef MLLM_PARALLEL_HPP
+#define MLLM_PARALLEL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief The engine's persistent worker threads, which every CPU kernel dispatches its parallel loops to
+ *        (see parallel_for). A dispatch splits the work into contiguous parts, hands one to each worker
+ *        and runs the first on the calling thread. Between dispatches the workers spin for a short while
+ *        and then park, so back-to-back ops of a decode step pay no fork/join or wake-up latency while
+ *        an idle engine does not burn CPU.
+ *
+ *        Workers are started on demand, as many as the largest thread_count dispatched so far asks for
+ *        and at most one per hardware thread besides the caller. Only the workers a dispatch used spin
+ *        after it; the others park again right away. Parallel loops issued from inside a part run
+ *        serially on that thread, and dispatches from different threads take turns.
+ */
+class ThreadPool {
+public:
+    static ThreadPool &global();
+    // a pool that starts up to \p max_workers threads besides the caller
+    explicit ThreadPool(int max_workers);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * \brief fn(begin, end) over [0, n) split into min(thread_count, max_workers + 1, n) contiguous
+     *        ranges, run in parallel; returns when all of them are done.
+     */
+    void run(int n, int thread_count, const std::function<void(int, int)> &fn);
+    // the calling thread plus the workers started so far
+    int size() const {
+        return started_.load(std::memory_order_acquire) + 1;
+    }
+    /**
+     * \brief pin the workers, and the thread that calls this (normally the one running the model), to
+     *        \p cores: the caller to cores[0], worker i to cores[i % cores.size()], including the workers
+     *        started later. Empty unpins. Only supported on Linux/Android; elsewhere it does nothing and
+     *        returns false.
+     */
+    bool pin(const std::vector<int> &cores);
+    // how long an idle worker spins before it parks
+    void setSpinMicroseconds(int us) {
+        spin_us_ = us;
+    }
+
+private:
+    void work(int id, uint64_t seen);
+    // starts workers up to \p workers; called with dispatch_ held
+    void grow(int workers);
+
+    const int max_workers_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> started_{0};
+    std::vector<int> cores_; // pinned cores, empty if not pinned
+    std::mutex dispatch_;    // one dispatch at a time
+    std::mutex park_;
+    std::condition_variable wake_;
+    std::atomic<int> parked_{0};
+    // bumped on every dispatch; the low 16 bits carry the number of parts of that dispatch
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<int> pending_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<int> spin_us_{200};
+    const std::function<void(int, int)> *job_ = nullptr;
+    int job_n_ = 0;
+};
+
+/**
+ * \brief cores of the highest maximum frequency, i.e. the big cores of a big.LITTLE SoC; every core if
+ *        they all run at the same frequency or it cannot be read.
+ */
+std::vector<int> cpu_big_cores();
+/**
+ * \brief the cores of NUMA node \p node, or every core if the system reports no such node.
+ */
+std::vector<int> cpu_numa_node_cores(int node);
+
+/**
+ * \brief pins ThreadPool::global() by name: "none" unpins, "big" uses cpu_big_cores() and "numa<N>", e.g.
+ *        "numa0", the cores of NUMA node N. False for an unknown name or where pinning is not supported.
+ */
+bool cpu_pin_threads(const std::string &affinity);
+
+/**
+ * \brief fn(i) for i in [0, n) on up to thread_count threads of ThreadPool::global(), the drop-in for
+ *        `#pragma omp parallel for num_threads(thread_count)`. Each thread gets one contiguous range.
+ */
+template <typename F>
+void parallel_for(int n, int thread_count, F &&fn) {
+    if (n <= 0) {
+        return;
+    }
+    ThreadPool::global().run(n, thread_count, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            fn(i);
+        }
+    });
+}
+// fn(i, j) over [0, n0) x [0, n1), like collapse(2)
+template <typename F>
+void parallel_for(int n0, int n1, int thread_count, F &&fn) {
+    if (n0 <= 0 || n1 <= 0) {
+        return;
+    }
+    ThreadPool::global().run(n0 * n1, thread_count, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            fn(i / n1, i % n1);
+        }
+    });
+}
+// fn(i, j, k) over [0, n0) x [0, n1) x [0, n2), like collapse(3)
+template <typename F>
+void parallel_for(int n0, int n1, int n2, int thread_count, F &&fn) {
+    if (n0 <= 0 || n1 <= 0 || n2 <= 0) {
+        return;
+    }
+    ThreadPool::global().run(n0 * n1 * n2, thread_count, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            fn(i / (n1 * n2), i / n2 % n1, i % n2);
+        }
+    });
+}
+
+} // namespace mllm
+
+#endif // MLLM_PARALLEL_HPP
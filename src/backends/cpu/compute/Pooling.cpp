@@ -3,6 +3,7 @@
 //
 
 #include "Pooling.hpp"
+#include "Parallel.hpp"
 void avgpool2d_fp32_VALID(Tensor* input, Tensor* output, int kernel_h, int kernel_w, int stride_h, int stride_w, int thread_count) {
     int in_height = input->head();
     int in_width = input->dimension();
@@ -11,8 +12,7 @@ void avgpool2d_fp32_VALID(Tensor* input, Tensor* output, int kernel_h, int kerne
     int out_channel = output->sequence();
     std::vector<float> one_array(kernel_w, 1.0f);
     for (int b = 0; b < input->batch(); ++b) {
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(out_channel, thread_count, [&](int out_ch) {
             for (int out_h = 0; out_h < out_height; ++out_h) {
                 for (int out_w = 0; out_w < out_width; ++out_w) {
                     int blk_h = out_h * stride_h;
@@ -27,7 +27,7 @@ void avgpool2d_fp32_VALID(Tensor* input, Tensor* output, int kernel_h, int kerne
                     *output->ptrAt<float>(b, out_h, out_ch, out_w) = value/ (kernel_h*kernel_w);
                 }
             }
-        }
+        });
     }
 }
 
@@ -41,8 +41,7 @@ void avgpool2d_fp32_SAME(Tensor* input, Tensor* output, int kernel_h, int kernel
     int out_width = output->dimension();
     int out_channel = output->sequence();
     for (int b = 0; b < input->batch(); ++b) {
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(out_channel, thread_count, [&](int out_ch) {
             for (int out_h = 0; out_h < out_height; ++out_h) {
                 for (int out_w = 0; out_w < out_width; ++out_w) {
                     int blk_h = out_h * stride_h - padding_top;
@@ -73,7 +72,7 @@ void avgpool2d_fp32_SAME(Tensor* input, Tensor* output, int kernel_h, int kernel
                     *output->ptrAt<float>(b, out_h, out_ch, out_w) = value/  (kernel_h*kernel_w);
                 }
             }
-        }
+        });
     }
 }
 
@@ -86,8 +85,7 @@ void maxpool2d_fp32_VALID(Tensor* input, Tensor* output, int kernel_h, int kerne
     int out_channel = output->sequence();
     std::vector<float> one_array(kernel_w, 1.0f);
     for (int b = 0; b < input->batch(); ++b) {
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(out_channel, thread_count, [&](int out_ch) {
             for (int out_h = 0; out_h < out_height; ++out_h) {
                 for (int out_w = 0; out_w < out_width; ++out_w) {
                     int blk_h = out_h * stride_h;
@@ -102,7 +100,7 @@ void maxpool2d_fp32_VALID(Tensor* input, Tensor* output, int kernel_h, int kerne
                     *output->ptrAt<float>(b, out_h, out_ch, out_w) = value;
                 }
             }
-        }
+        });
     }
 }
 void maxpool2d_fp32_SAME(Tensor* input, Tensor* output, int kernel_h, int kernel_w,  int stride_h, int stride_w, int padding_h, int padding_w, int thread_count) {
@@ -115,8 +113,7 @@ void maxpool2d_fp32_SAME(Tensor* input, Tensor* output, int kernel_h, int kernel
     int out_width = output->dimension();
     int out_channel = output->sequence();
     for (int b = 0; b < input->batch(); ++b) {
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(out_channel, thread_count, [&](int out_ch) {
             for (int out_h = 0; out_h < out_height; ++out_h) {
                 for (int out_w = 0; out_w < out_width; ++out_w) {
                     int blk_h = out_h * stride_h - padding_top;
@@ -141,6 +138,6 @@ void maxpool2d_fp32_SAME(Tensor* input, Tensor* output, int kernel_h, int kernel
                     *output->ptrAt<float>(b, out_h, out_ch, out_w) = value;
                 }
             }
-        }
+        });
     }
 }
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "RoPE.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#if defined(__AVX2__) || defined(__ARM_NEON)
+#define MLLM_ROPE_SIMD
+#endif
+
+// dynamic NTK tables are keyed by the length rounded up to this
+#define ROPE_DYNAMIC_NTK_STEP 256
+
+int rope_resolve_scaling(RoPEScaling &scaling, int max_position_embeddings) {
+    if (scaling.type == ROPE_SCALING_NONE || scaling.factor <= 1.0f) {
+        scaling = RoPEScaling();
+        return max_position_embeddings;
+    }
+    if (scaling.original_max_position_embeddings <= 0) {
+        scaling.original_max_position_embeddings = max_position_embeddings;
+    }
+    return std::max(max_position_embeddings, (int)std::ceil(scaling.original_max_position_embeddings * scaling.factor));
+}
+
+// YaRN: frequencies that turn more than beta_fast times over the trained context are kept
+// (extrapolated), those that turn less than beta_slow times are interpolated, with a linear ramp
+// in between; sin/cos carry the attention temperature 0.1 * ln(factor) + 1.
+static void rope_yarn_inv_freq(vector<double> &inv_freq, double base, int rotary_dim, const RoPEScaling &scaling, float &mscale) {
+    const double beta_fast = 32;
+    const double beta_slow = 1;
+    const double orig = scaling.original_max_position_embeddings;
+    auto correction_dim = [&](double rotations) {
+        return rotary_dim * std::log(orig / (rotations * 2 * M_PI)) / (2 * std::log(base));
+    };
+    double low = std::max(std::floor(correction_dim(beta_fast)), 0.0);
+    double high = std::min(std::ceil(correction_dim(beta_slow)), rotary_dim - 1.0);
+    if (low == high) {
+        high += 0.001;
+    }
+    for (size_t i = 0; i < inv_freq.size(); ++i) {
+        const double ramp = std::min(std::max((i - low) / (high - low), 0.0), 1.0);
+        const double extrapolation = 1 - ramp;
+        inv_freq[i] = inv_freq[i] / scaling.factor * (1 - extrapolation) + inv_freq[i] * extrapolation;
+    }
+    mscale = 0.1f * std::log(scaling.factor) + 1.0f;
+}
+
+shared_ptr<const RoPETable> rope_table(RoPEType type, int head_dim, float theta, int pos_max, const RoPEScaling &scaling, int seq_len) {
+    using Key = std::tuple<int, int, float, int, int, float, int>;
+    static std::map<Key, shared_ptr<const RoPETable>> tables;
+    static std::map<Key, int> dynamic_len; // length the cached dynamic NTK table was built for
+    const Key key = std::make_tuple((int)type, head_dim, theta, pos_max, (int)scaling.type, scaling.factor, scaling.original_max_position_embeddings);
+    int ntk_len = 0;
+    if (scaling.type == ROPE_SCALING_DYNAMIC_NTK && seq_len > scaling.original_max_position_embeddings) {
+        ntk_len = (seq_len + ROPE_DYNAMIC_NTK_STEP - 1) / ROPE_DYNAMIC_NTK_STEP * ROPE_DYNAMIC_NTK_STEP;
+    }
+    auto &cached = tables[key];
+    if (cached != nullptr && (scaling.type != ROPE_SCALING_DYNAMIC_NTK || dynamic_len[key] == ntk_len)) {
+        return cached;
+    }
+    auto table = std::make_shared<RoPETable>();
+    table->type = type;
+    table->rotary_dim = type == PERSIMMONROPE ? head_dim / 2 : head_dim;
+    table->pos_max = pos_max;
+    double base = theta;
+    if (type == LLAMAROPE) {
+        base = 10000;
+    } else if (type == PERSIMMONROPE) {
+        base = 25000;
+    }
+    const int rotary_dim = table->rotary_dim;
+    const int half = rotary_dim / 2;
+    if (ntk_len > 0) {
+        const double orig = scaling.original_max_position_embeddings;
+        base *= std::pow(scaling.factor * ntk_len / orig - (scaling.factor - 1), rotary_dim / (rotary_dim - 2.0));
+    }
+    vector<double> inv_freq(half);
+    for (int i = 0; i < half; ++i) {
+        inv_freq[i] = 1.0 / std::pow(base, 2.0 * i / rotary_dim);
+    }
+    float mscale = 1.0f;
+    if (scaling.type == ROPE_SCALING_LINEAR) {
+        for (auto &f : inv_freq) {
+            f /= scaling.factor;
+        }
+    } else if (scaling.type == ROPE_SCALING_YARN) {
+        rope_yarn_inv_freq(inv_freq, base, rotary_dim, scaling, mscale);
+    }
+    // one extra row: the position counter wraps only after it passes pos_max
+    table->sin.resize((size_t)(pos_max + 1) * half);
+    table->cos.resize((size_t)(pos_max + 1) * half);
+    // built once per configuration, on the threads the engine has started
+    parallel_for(pos_max + 1, ThreadPool::global().size(), [&](int p) {
+        for (int i = 0; i < half; ++i) {
+            const double angle = p * inv_freq[i];
+            table->sin[(size_t)p * half + i] = (float)std::sin(angle) * mscale;
+            table->cos[(size_t)p * half + i] = (float)std::cos(angle) * mscale;
+        }
+    });
+    // ops keep their own reference, so replacing a dynamic NTK table never frees one in use
+    cached = table;
+    dynamic_len[key] = ntk_len;
+    return cached;
+}
+
+// y[i] = x[i] * c[i] - x[i + half] * s[i], y[i + half] = x[i + half] * c[i] + x[i] * s[i]
+static void rope_rotate_half(int half, const float *x, float *y, const float *s, const float *c) {
+    int i = 0;
+#ifdef MLLM_ROPE_SIMD
+    const int np = half & ~(MLLM_F32_EPR - 1);
+    const MLLM_F32_VEC neg_one = MLLM_F32_VEC_SET1(-1.0f);
+    for (; i < np; i += MLLM_F32_EPR) {
+        MLLM_F32_VEC a = MLLM_F32_VEC_LOAD(x + i);
+        MLLM_F32_VEC b = MLLM_F32_VEC_LOAD(x + half + i);
+        MLLM_F32_VEC sv = MLLM_F32_VEC_LOAD(s + i);
+        MLLM_F32_VEC cv = MLLM_F32_VEC_LOAD(c + i);
+        MLLM_F32_VEC lo = MLLM_F32_VEC_FMA(MLLM_F32_VEC_MUL(a, cv), b, MLLM_F32_VEC_MUL(sv, neg_one));
+        MLLM_F32_VEC hi = MLLM_F32_VEC_FMA(MLLM_F32_VEC_MUL(b, cv), a, sv);
+        MLLM_F32_VEC_STORE(y + i, lo);
+        MLLM_F32_VEC_STORE(y + half + i, hi);
+    }
+#endif
+    for (; i < half; ++i) {
+        const float a = x[i];
+        const float b = x[i + half];
+        y[i] = a * c[i] - b * s[i];
+        y[i + half] = b * c[i] + a * s[i];
+    }
+}
+
+// y[2i] = x[2i] * c[i] - x[2i + 1] * s[i], y[2i + 1] = x[2i + 1] * c[i] + x[2i] * s[i]
+static void rope_interleaved(int half, const float *x, float *y, const float *s, const float *c) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= half; i += 4) {
+        const __m128 s4 = _mm_loadu_ps(s + i);
+        const __m128 c4 = _mm_loadu_ps(c + i);
+        // [c0 c0 c1 c1 c2 c2 c3 c3]
+        const __m256 sv = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(s4, s4)), _mm_unpackhi_ps(s4, s4), 1);
+        const __m256 cv = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(c4, c4)), _mm_unpackhi_ps(c4, c4), 1);
+        const __m256 xv = _mm256_loadu_ps(x + 2 * i);
+        const __m256 xs = _mm256_permute_ps(xv, 0xB1); // swap each (even, odd) pair
+        // even lanes: x*c - xs*s, odd lanes: x*c + xs*s
+        _mm256_storeu_ps(y + 2 * i, _mm256_addsub_ps(_mm256_mul_ps(xv, cv), _mm256_mul_ps(xs, sv)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= half; i += 4) {
+        const float32x4_t sv = vld1q_f32(s + i);
+        const float32x4_t cv = vld1q_f32(c + i);
+        float32x4x2_t xv = vld2q_f32(x + 2 * i);
+        float32x4x2_t yv;
+        yv.val[0] = vfmsq_f32(vmulq_f32(xv.val[0], cv), xv.val[1], sv);
+        yv.val[1] = vfmaq_f32(vmulq_f32(xv.val[1], cv), xv.val[0], sv);
+        vst2q_f32(y + 2 * i, yv);
+    }
+#endif
+    for (; i < half; ++i) {
+        const float a = x[2 * i];
+        const float b = x[2 * i + 1];
+        y[2 * i] = a * c[i] - b * s[i];
+        y[2 * i + 1] = b * c[i] + a * s[i];
+    }
+}
+
+void rope_row_fp32(const float *x, float *y, const RoPETable &table, int pos, int dim) {
+    const int half = table.rotary_dim / 2;
+    const float *s = table.sin.data() + (size_t)pos * half;
+    const float *c = table.cos.data() + (size_t)pos * half;
+    if (table.type == LLAMAROPE) {
+        rope_interleaved(half, x, y, s, c);
+    } else {
+        rope_rotate_half(half, x, y, s, c);
+        if (x != y && dim > table.rotary_dim) {
+            memcpy(y + table.rotary_dim, x + table.rotary_dim, (dim - table.rotary_dim) * sizeof(float));
+        }
+    }
+}
+
+// rows are contiguous along the dimension axis
+static bool rope_dim_contiguous(Tensor *t) {
+    return t->ctype() == BSHD || t->ctype() == SBHD;
+}
+
+void rope_fp32(Tensor *input, Tensor *output, const RoPETable &table, const vector<int> &pos_offsets, int thread_count) {
+    assert((int)pos_offsets.size() == input->batch());
+    const int dim = input->dimension();
+    const bool in_direct = rope_dim_contiguous(input);
+    const bool out_direct = rope_dim_contiguous(output) && output->dtype() == MLLM_TYPE_F32;
+    parallel_for(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        const int pos = pos_offsets[n] + s;
+        if (in_direct && out_direct) {
+            rope_row_fp32(input->ptrAt<float>(n, h, s, 0), output->ptrAt<float>(n, h, s, 0), table, pos, dim);
+            return;
+        }
+        // other layouts / F16 output go through a row buffer
+        static thread_local vector<float> row;
+        row.resize(dim);
+        for (int d = 0; d < dim; ++d) {
+            row[d] = input->dataAt<float>(n, h, s, d);
+        }
+        rope_row_fp32(row.data(), row.data(), table, pos, dim);
+        for (int d = 0; d < dim; ++d) {
+            if (output->dtype() == MLLM_TYPE_F16) {
+                output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(row[d]));
+            } else {
+                output->setDataAt<float>(n, h, s, d, row[d]);
+            }
+        }
+    });
+}
+
+void rope_fp32(Tensor *input, Tensor *output, const RoPETable &table, int pos_offset, int thread_count) {
+    rope_fp32(input, output, table, vector<int>(input->batch(), pos_offset), thread_count);
+}
+
+void rope_heads_fp32(Tensor *x, int head_dim, const RoPETable &table, const vector<int> &pos_offsets, int thread_count) {
+    assert(rope_dim_contiguous(x) && x->head() == 1 && x->dimension() % head_dim == 0);
+    assert((int)pos_offsets.size() == x->batch());
+    const int heads = x->dimension() / head_dim;
+    parallel_for(x->batch(), x->sequence(), heads, thread_count, [&](int n, int s, int h) {
+        float *row = x->ptrAt<float>(n, 0, s, h * head_dim);
+        rope_row_fp32(row, row, table, pos_offsets[n] + s, head_dim);
+    });
+}
+
+void rope_heads_fp32(Tensor *x, int head_dim, const RoPETable &table, int pos_offset, int thread_count) {
+    rope_heads_fp32(x, head_dim, table, vector<int>(x->batch(), pos_offset), thread_count);
+}
@@ -0,0 +1,57 @@
+#ifndef MLLM_ROPE_HPP
+#define MLLM_ROPE_HPP
+
+#include "VecDot.hpp"
+using namespace mllm;
+
+/**
+ * \brief sin/cos of every (position, frequency) pair, stored once per frequency:
+ *        row p holds rotary_dim / 2 contiguous entries for position p. Tables are shared by all
+ *        RoPE ops with the same configuration, see rope_table().
+ */
+struct RoPETable {
+    RoPEType type;
+    int rotary_dim; // leading dims of a head that are rotated; PERSIMMONROPE passes the rest through
+    int pos_max;
+    vector<float> sin;
+    vector<float> cos;
+};
+
+/**
+ * \brief Fill in \p scaling's defaults and return how many positions the op must cover:
+ *        a scaled model runs up to original_max_position_embeddings * factor.
+ */
+int rope_resolve_scaling(RoPEScaling &scaling, int max_position_embeddings);
+
+/**
+ * \brief Get (building on first use) the table for a head of \p head_dim dims. \p theta is the base
+ *        of HFHUBROPE; LLAMAROPE and PERSIMMONROPE keep their fixed bases (10000 and 25000).
+ *        \p seq_len (positions seen so far, including this call) only matters for dynamic NTK scaling,
+ *        whose base depends on it; it is rounded up so the table is rebuilt every few hundred tokens,
+ *        not every step. Not thread safe: call it from reshape/load, not from inside a kernel.
+ */
+shared_ptr<const RoPETable> rope_table(RoPEType type, int head_dim, float theta, int pos_max,
+                                       const RoPEScaling &scaling = RoPEScaling(), int seq_len = 0);
+
+/**
+ * \brief Rotate one head row of \p dim floats at position \p pos. \p y may alias \p x.
+ */
+void rope_row_fp32(const float *x, float *y, const RoPETable &table, int pos, int dim);
+
+/**
+ * \brief RoPE over a [batch, head, sequence, dimension] tensor; sequence index s is at position
+ *        pos_offset + s. Rows are spread over threads, so decode (sequence = 1) still splits by head.
+ *        \p output may be F32 or F16.
+ */
+void rope_fp32(Tensor *input, Tensor *output, const RoPETable &table, int pos_offset, int thread_count = 4);
+// the same with batch row n at its own position: sequence index s of row n is at pos_offsets[n] + s
+void rope_fp32(Tensor *input, Tensor *output, const RoPETable &table, const vector<int> &pos_offsets, int thread_count = 4);
+
+/**
+ * \brief In-place RoPE on a projection output [batch, 1, sequence, heads * head_dim] before it is
+ *        viewed as heads, i.e. as the epilogue of the q/k projection.
+ */
+void rope_heads_fp32(Tensor *x, int head_dim, const RoPETable &table, int pos_offset, int thread_count = 4);
+void rope_heads_fp32(Tensor *x, int head_dim, const RoPETable &table, const vector<int> &pos_offsets, int thread_count = 4);
+
+#endif // MLLM_ROPE_HPP
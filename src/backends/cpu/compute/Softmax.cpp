@@ -0,0 +1,157 @@
+#include "Softmax.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+// exp(x) for a vector: x = n * ln2 + r, exp(r) by the cephes polynomial, 2^n through the exponent bits.
+// Relative error ~1e-7; inputs below -87.3 (including -inf) give exactly 0.
+#if defined(__AVX2__)
+static inline __m256 vec_exp_f32x8(__m256 x) {
+    const __m256 underflow = _mm256_cmp_ps(x, _mm256_set1_ps(-87.3f), _CMP_LT_OQ);
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+    const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(0.693359375f)));
+    r = _mm256_add_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(2.12194440e-4f)));
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(5.0000001201e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, _mm256_mul_ps(r, r)), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    const __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_andnot_ps(underflow, _mm256_mul_ps(p, _mm256_castsi256_ps(e)));
+}
+#elif defined(__ARM_NEON)
+static inline float32x4_t vec_exp_f32x4(float32x4_t x) {
+    const uint32x4_t keep = vcgeq_f32(x, vdupq_n_f32(-87.3f));
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-87.3f)), vdupq_n_f32(88.3f));
+    const float32x4_t n = vrndnq_f32(vmulq_f32(x, vdupq_n_f32(1.44269504088896341f)));
+    float32x4_t r = vfmsq_f32(x, n, vdupq_n_f32(0.693359375f));
+    r = vfmaq_f32(r, n, vdupq_n_f32(2.12194440e-4f));
+    float32x4_t p = vdupq_n_f32(1.9875691500e-4f);
+    p = vfmaq_f32(vdupq_n_f32(1.3981999507e-3f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(8.3334519073e-3f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(4.1665795894e-2f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(1.6666665459e-1f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(5.0000001201e-1f), p, r);
+    p = vfmaq_f32(vaddq_f32(r, vdupq_n_f32(1.0f)), p, vmulq_f32(r, r));
+    const int32x4_t e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+    const float32x4_t y = vmulq_f32(p, vreinterpretq_f32_s32(e));
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(y), keep));
+}
+#endif
+
+static float vec_max_f32(int n, const float *x) {
+    float max = -INFINITY;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256 vmax = _mm256_set1_ps(-INFINITY);
+    for (; i + 8 <= n; i += 8) {
+        vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(x + i));
+    }
+    __m128 m4 = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+    m4 = _mm_max_ps(m4, _mm_movehl_ps(m4, m4));
+    m4 = _mm_max_ss(m4, _mm_movehdup_ps(m4));
+    max = _mm_cvtss_f32(m4);
+#elif defined(__ARM_NEON)
+    float32x4_t vmax = vdupq_n_f32(-INFINITY);
+    for (; i + 4 <= n; i += 4) {
+        vmax = vmaxq_f32(vmax, vld1q_f32(x + i));
+    }
+    max = vmaxvq_f32(vmax);
+#endif
+    for (; i < n; ++i) {
+        max = std::max(max, x[i]);
+    }
+    return max;
+}
+
+// y = exp((x - max) * scale); returns sum(y)
+static float vec_exp_sum_f32(int n, const float *x, float *y, float max, float scale) {
+    float sum = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 vmax = _mm256_set1_ps(max);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    __m256 vsum = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = vec_exp_f32x8(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), vmax), vscale));
+        _mm256_storeu_ps(y + i, v);
+        vsum = _mm256_add_ps(vsum, v);
+    }
+    __m128 s4 = _mm_add_ps(_mm256_castps256_ps128(vsum), _mm256_extractf128_ps(vsum, 1));
+    s4 = _mm_hadd_ps(s4, s4);
+    s4 = _mm_hadd_ps(s4, s4);
+    sum = _mm_cvtss_f32(s4);
+#elif defined(__ARM_NEON)
+    const float32x4_t vmax = vdupq_n_f32(max);
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    float32x4_t vsum = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t v = vec_exp_f32x4(vmulq_f32(vsubq_f32(vld1q_f32(x + i), vmax), vscale));
+        vst1q_f32(y + i, v);
+        vsum = vaddq_f32(vsum, v);
+    }
+    sum = vaddvq_f32(vsum);
+#endif
+    for (; i < n; ++i) {
+        y[i] = expf((x[i] - max) * scale);
+        sum += y[i];
+    }
+    return sum;
+}
+
+float max_row_fp32(int n, const float *x) {
+    return vec_max_f32(n, x);
+}
+
+void softmax_row_fp32(int n, const float *x, float *y, float scale, int valid) {
+    assert(scale > 0);
+    valid = std::min(std::max(valid, 0), n);
+    const float max = valid > 0 ? vec_max_f32(valid, x) : -INFINITY;
+    if (max == -INFINITY) { // nothing to attend to
+        memset(y, 0, n * sizeof(float));
+        return;
+    }
+    const float sum = vec_exp_sum_f32(valid, x, y, max, scale);
+    const float inv_sum = 1.0f / sum;
+    int i = 0;
+#if defined(__AVX2__) || defined(__ARM_NEON)
+    const MLLM_F32_VEC vinv = MLLM_F32_VEC_SET1(inv_sum);
+    for (; i + MLLM_F32_EPR <= valid; i += MLLM_F32_EPR) {
+        MLLM_F32_VEC_STORE(y + i, MLLM_F32_VEC_MUL(MLLM_F32_VEC_LOAD(y + i), vinv));
+    }
+#endif
+    for (; i < valid; ++i) {
+        y[i] *= inv_sum;
+    }
+    if (valid < n) {
+        memset(y + valid, 0, (n - valid) * sizeof(float));
+    }
+}
+
+void softmax_fp32(Tensor *input, Tensor *output, float scale, bool causal, int thread_count, const vector<int> &k_lens) {
+    const int q_len = input->sequence();
+    const int k_len = input->dimension();
+    assert(k_lens.empty() || (int)k_lens.size() == input->batch());
+    // rows are contiguous along the dimension axis
+    const bool direct = (input->ctype() == BSHD || input->ctype() == SBHD) && (output->ctype() == BSHD || output->ctype() == SBHD);
+    parallel_for(input->batch(), input->head(), q_len, thread_count, [&](int n, int h, int s) {
+        const int keys = k_lens.empty() ? k_len : std::min(k_lens[n], k_len);
+        const int valid = causal ? s + keys - q_len + 1 : keys;
+        if (direct) {
+            softmax_row_fp32(k_len, input->ptrAt<float>(n, h, s, 0), output->ptrAt<float>(n, h, s, 0), scale, valid);
+            return;
+        }
+        static thread_local vector<float> row;
+        row.resize(k_len);
+        for (int d = 0; d < k_len; ++d) {
+            row[d] = input->dataAt<float>(n, h, s, d);
+        }
+        softmax_row_fp32(k_len, row.data(), row.data(), scale, valid);
+        for (int d = 0; d < k_len; ++d) {
+            output->setDataAt<float>(n, h, s, d, row[d]);
+        }
+    });
+}
@@ -0,0 +1,25 @@
+#ifndef MLLM_SOFTMAX_HPP
+#define MLLM_SOFTMAX_HPP
+
+#include "VecDot.hpp"
+using namespace mllm;
+
+/**
+ * \brief y = softmax(x * scale) over the first \p valid of \p n entries; the rest of y is zeroed
+ *        without being read, which is how a causal mask is applied. \p y may alias \p x; scale > 0.
+ */
+void softmax_row_fp32(int n, const float *x, float *y, float scale, int valid);
+
+// the largest of x[0, n), -inf for n == 0
+float max_row_fp32(int n, const float *x);
+
+/**
+ * \brief Softmax over the dimension axis of attention scores [batch, head, q_len, k_len], with the
+ *        1/sqrt(d) scale folded in. With \p causal, query s sees keys [0, s + k_len - q_len], the
+ *        same positions CPUCausalMask leaves unmasked, so no -inf pass over the scores is needed.
+ *        \p k_lens, if given, is the number of keys of each batch row: rows of a batch of sequences
+ *        at different lengths only see their own first k_lens[n] keys, the rest are padding.
+ */
+void softmax_fp32(Tensor *input, Tensor *output, float scale, bool causal, int thread_count = 4, const vector<int> &k_lens = {});
+
+#endif // MLLM_SOFTMAX_HPP
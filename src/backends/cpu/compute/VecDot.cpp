@@ -150,6 +150,86 @@ void vec_dot_fp16(const int n, float * __restrict s, const mllm_fp16_t * __restr
     *s = sumf;
 }
 
+void vec_mad_fp32(const int n, float *__restrict y, const float *__restrict x, const float v) {
+#if defined(__AVX2__) || defined(__ARM_NEON)
+    const int np = (n & ~(MLLM_F32_STEP - 1));
+
+    MLLM_F32_VEC vx = MLLM_F32_VEC_SET1(v);
+
+    MLLM_F32_VEC ax[MLLM_F32_ARR];
+    MLLM_F32_VEC ay[MLLM_F32_ARR];
+
+    for (int i = 0; i < np; i += MLLM_F32_STEP) {
+        for (int j = 0; j < MLLM_F32_ARR; j++) {
+            ax[j] = MLLM_F32_VEC_LOAD(x + i + j * MLLM_F32_EPR);
+            ay[j] = MLLM_F32_VEC_LOAD(y + i + j * MLLM_F32_EPR);
+            ay[j] = MLLM_F32_VEC_FMA(ay[j], ax[j], vx);
+
+            MLLM_F32_VEC_STORE(y + i + j * MLLM_F32_EPR, ay[j]);
+        }
+    }
+
+    // leftovers
+    for (int i = np; i < n; ++i) {
+        y[i] += x[i] * v;
+    }
+#else
+    for (int i = 0; i < n; ++i) {
+        y[i] += x[i] * v;
+    }
+#endif
+}
+
+void vec_mad_fp16(const int n, float *__restrict y, const mllm_fp16_t *__restrict x, const float v) {
+    // the accumulator is F32, so this needs the F16 vectors that are widened to F32 on load
+#if defined(__AVX2__) || (defined(__ARM_NEON) && !defined(__ARM_FEATURE_FP16_VECTOR_ARITHMETIC))
+    const int np = (n & ~(MLLM_F16_STEP - 1));
+
+    MLLM_F32_VEC vx = MLLM_F32_VEC_SET1(v);
+
+    MLLM_F16_VEC ax[MLLM_F16_ARR];
+    MLLM_F32_VEC ay[MLLM_F16_ARR];
+
+    for (int i = 0; i < np; i += MLLM_F16_STEP) {
+        for (int j = 0; j < MLLM_F16_ARR; j++) {
+            ax[j] = MLLM_F16_VEC_LOAD(x + i + j * MLLM_F16_EPR, j);
+            ay[j] = MLLM_F32_VEC_LOAD(y + i + j * MLLM_F16_EPR);
+            ay[j] = MLLM_F32_VEC_FMA(ay[j], ax[j], vx);
+
+            MLLM_F32_VEC_STORE(y + i + j * MLLM_F16_EPR, ay[j]);
+        }
+    }
+
+    // leftovers
+    for (int i = np; i < n; ++i) {
+        y[i] += MLLM_FP16_TO_FP32(x[i]) * v;
+    }
+#elif defined(__ARM_NEON)
+    // here MLLM_F16_VEC is 8 F16 lanes: load them as such and widen each half to F32
+    const int np = (n & ~(MLLM_F16_STEP - 1));
+
+    const float32x4_t vx = vdupq_n_f32(v);
+
+    for (int i = 0; i < np; i += MLLM_F16_STEP) {
+        for (int j = 0; j < MLLM_F16_ARR; j++) {
+            const float16x8_t ax = vld1q_f16(x + i + j * MLLM_F16_EPR);
+            float *py = y + i + j * MLLM_F16_EPR;
+            vst1q_f32(py, vfmaq_f32(vld1q_f32(py), vcvt_f32_f16(vget_low_f16(ax)), vx));
+            vst1q_f32(py + 4, vfmaq_f32(vld1q_f32(py + 4), vcvt_f32_f16(vget_high_f16(ax)), vx));
+        }
+    }
+
+    // leftovers
+    for (int i = np; i < n; ++i) {
+        y[i] += MLLM_FP16_TO_FP32(x[i]) * v;
+    }
+#else
+    for (int i = 0; i < n; ++i) {
+        y[i] += MLLM_FP16_TO_FP32(x[i]) * v;
+    }
+#endif
+}
+
 #ifdef __AVX2__
 static void vec_dot_q4_0_q8_0_avx(const int n, float * __restrict s, const void * __restrict vx, const void * __restrict vy) {
     const int qk = QK8_0;
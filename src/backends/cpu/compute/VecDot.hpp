@@ -350,5 +350,10 @@ void vec_dot_q6_K_q8_K(const int n, float * __restrict s, const void * __restric
 void vec_dot_q4_0_q8_0(const int n, float * __restrict s, const void * __restrict vx, const void * __restrict vy);
 void vec_dot_fp32(const int n, float * __restrict s, const float * __restrict vx, const float * __restrict vy);
 void vec_dot_fp16(const int n, float * __restrict s, const mllm_fp16_t * __restrict vx, const mllm_fp16_t * __restrict vy);
+/**
+ * \brief y[i] += x[i] * v over \p n elements, the row update of a matmul whose src1 is laid out along N.
+ */
+void vec_mad_fp32(const int n, float * __restrict y, const float * __restrict x, const float v);
+void vec_mad_fp16(const int n, float * __restrict y, const mllm_fp16_t * __restrict x, const float v);
 
 #endif // MLLM_VECDOT_HPP
@@ -31,6 +31,6 @@
 #include "Quantize.hpp"
 
 void quantize_row_q6_K(const float * __restrict x, void * __restrict y, int k);
-void dequantize_row_q6_K(const block_q8_K * __restrict x, float * __restrict y, int k);
+void dequantize_row_q6_K(const block_q6_K * __restrict x, float * __restrict y, int k);
 
 #endif // MLLM_QUANTIZEQ6_HPP
@@ -4,168 +4,297 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <iterator>
 
 namespace mllm {
-    MemoryPoolManager::MemoryPoolManager(size_t pool_size,size_t base_alignment):
-        data_(nullptr),
-        n_free_blocks_(0),
-        base_alignment_(base_alignment)
-    {
+
+static inline int msb64(uint64_t x) {
+    return 63 - __builtin_clzll(x);
+}
+static inline int lsb64(uint64_t x) {
+    return __builtin_ctzll(x);
+}
+
+MemoryPoolManager::MemoryPoolManager(size_t pool_size, size_t base_alignment) :
+    data_(nullptr),
+    pool_size_(0),
+    used_size_(0),
+    base_alignment_(base_alignment),
+    n_free_blocks_(0),
+    fl_bitmap_(0),
+    n_used_(0),
+    warned_fallback_(false) {
+    assert(base_alignment && !(base_alignment & (base_alignment - 1)));
+    pool_size_ = aligned_offset(pool_size, base_alignment_);
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    data_ = _aligned_malloc(pool_size_, base_alignment_);
+#else
+    data_ = std::aligned_alloc(base_alignment_, pool_size_);
+#endif
+    assert(data_ != nullptr);
+    memset(sl_bitmap_, 0, sizeof(sl_bitmap_));
+    for (auto &bin : bins_) {
+        for (int &head : bin) {
+            head = -1;
+        }
+    }
+    blocks_.reserve(1024);
+    used_keys_.assign(1024, 0);
+    used_vals_.assign(1024, -1);
+
+    int idx = newBlock();
+    blocks_[idx] = {(uint64_t)data_, pool_size_, -1, -1, -1, -1, true};
+    insertFree(idx);
+#ifdef MLLM_ALLOCATOR_DEBUG
+    std::cout << "MemoryPoolManager init. Range from " << data_ << " to " << (void *)((char *)data_ + pool_size_) << std::endl;
+#endif
+}
+
+MemoryPoolManager::~MemoryPoolManager() {
 #if defined(_MSC_VER) || defined(__MINGW32__)
-        data_ = _aligned_malloc(pool_size,base_alignment);
+    _aligned_free(data_);
 #else
-        data_ = std::aligned_alloc(base_alignment,pool_size);
+    std::free(data_);
+#endif
+}
+
+void MemoryPoolManager::mapping(size_t size, int &fl, int &sl) const {
+    uint64_t units = size / base_alignment_;
+    if (units < SL_COUNT) {
+        fl = 0;
+        sl = (int)units;
+    } else {
+        int m = msb64(units);
+        fl = m - SL_BITS + 1;
+        sl = (int)((units >> (m - SL_BITS)) - SL_COUNT);
+    }
+}
+
+// Round the request up to the next size class so that any block of the found bin fits.
+int MemoryPoolManager::findSuitable(size_t size) const {
+    uint64_t units = size / base_alignment_;
+    if (units >= SL_COUNT) {
+        units += (1ULL << (msb64(units) - SL_BITS)) - 1;
+    }
+    int fl, sl;
+    mapping(units * base_alignment_, fl, sl);
+    if (fl >= FL_COUNT) {
+        return -1;
+    }
+    uint32_t sl_map = sl_bitmap_[fl] & (~0U << sl);
+    if (sl_map == 0) {
+        uint64_t fl_map = fl + 1 < FL_COUNT ? fl_bitmap_ & (~0ULL << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return -1;
+        }
+        fl = lsb64(fl_map);
+        sl_map = sl_bitmap_[fl];
+    }
+    sl = lsb64(sl_map);
+    return bins_[fl][sl];
+}
+
+void MemoryPoolManager::insertFree(int idx) {
+    auto &block = blocks_[idx];
+    int fl, sl;
+    mapping(block.size, fl, sl);
+    block.is_free = true;
+    block.prev_free = -1;
+    block.next_free = bins_[fl][sl];
+    if (block.next_free >= 0) {
+        blocks_[block.next_free].prev_free = idx;
+    }
+    bins_[fl][sl] = idx;
+    sl_bitmap_[fl] |= 1U << sl;
+    fl_bitmap_ |= 1ULL << fl;
+    n_free_blocks_++;
+#ifdef MLLM_ALLOCATOR_DEBUG
+    debug_free_blocks[block.addr] = block.size;
 #endif
+}
 
-        n_free_blocks_ += 1;
-        free_blocks_.emplace_back(data_,pool_size);
-        #ifdef MLLM_ALLOCATOR_DEBUG
-        std::cout<<"MemoryPoolManager init. Range from "<<data_ << " to "<< (void*)((char*)data_+pool_size) <<std::endl;
-        #endif
-    }
-
-    void MemoryPoolManager::alloc(void **ptr, size_t size,size_t alignment){
-        // ensure alignment is the power of 2
-        assert((alignment & (alignment -1)) == 0);
-        assert( alignment <= base_alignment_);
-
-        // TODO: support different backends
-        size = aligned_offset(size,base_alignment_);
-        std::list<FreeBlock>::iterator best_fit_block;
-        auto last_block = free_blocks_.end()--;
-        size_t best_fit_size = SIZE_MAX;
-        size_t max_avail = 0;
-        for(auto it = free_blocks_.begin();it != last_block;it++){
-            auto block_size = it->size;
-            max_avail = std::max(max_avail,block_size);
-            if(block_size >= size && block_size <= best_fit_size){
-                best_fit_block = it;
-                best_fit_size = block_size;
+void MemoryPoolManager::removeFree(int idx) {
+    auto &block = blocks_[idx];
+    int fl, sl;
+    mapping(block.size, fl, sl);
+    if (block.prev_free >= 0) {
+        blocks_[block.prev_free].next_free = block.next_free;
+    } else {
+        bins_[fl][sl] = block.next_free;
+        if (block.next_free < 0) {
+            sl_bitmap_[fl] &= ~(1U << sl);
+            if (sl_bitmap_[fl] == 0) {
+                fl_bitmap_ &= ~(1ULL << fl);
             }
         }
-        if(best_fit_size == SIZE_MAX){
-            auto block_size = last_block->size;
-            max_avail = std::max(max_avail,block_size);
-            if(block_size >= size){
-                best_fit_block = last_block;
-                best_fit_size = block_size;
-            }else{
-                std::cerr<<"Not enough space,max available is "<<max_avail;
+    }
+    if (block.next_free >= 0) {
+        blocks_[block.next_free].prev_free = block.prev_free;
+    }
+    block.is_free = false;
+    n_free_blocks_--;
+#ifdef MLLM_ALLOCATOR_DEBUG
+    debug_free_blocks.erase(block.addr);
+#endif
+}
+
+int MemoryPoolManager::newBlock() {
+    if (!spare_blocks_.empty()) {
+        int idx = spare_blocks_.back();
+        spare_blocks_.pop_back();
+        return idx;
+    }
+    blocks_.push_back({});
+    return (int)blocks_.size() - 1;
+}
+
+void MemoryPoolManager::releaseBlock(int idx) {
+    spare_blocks_.push_back(idx);
+}
+
+void MemoryPoolManager::trackUsed(uint64_t addr, int idx) {
+    if ((n_used_ + 1) * 2 > used_keys_.size()) {
+        vector<uint64_t> keys(used_keys_.size() * 2, 0);
+        vector<int> vals(used_keys_.size() * 2, -1);
+        std::swap(keys, used_keys_);
+        std::swap(vals, used_vals_);
+        n_used_ = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (vals[i] >= 0) {
+                trackUsed(keys[i], vals[i]);
             }
         }
-        #ifdef MLLM_ALLOCATOR_DEBUG
-        debug_allocate_blocks[(uint64_t)best_fit_block->addr] = size;
-        #endif
-        *ptr = best_fit_block->addr;
-        block_size_.emplace((uint64_t)best_fit_block->addr,size);
-        if (best_fit_size > size){
-            #ifdef MLLM_ALLOCATOR_DEBUG
-            debug_free_blocks.erase((uint64_t)best_fit_block->addr);
-            debug_free_blocks[(uint64_t)best_fit_block->addr + size] = best_fit_block->size - size;
-            #endif
-            best_fit_block->addr = (void*)((const char*)best_fit_block->addr + size);
-            best_fit_block->size -= size;
-
-        }else{
-            // best_fit_size == size
-            #ifdef MLLM_ALLOCATOR_DEBUG
-            debug_free_blocks.erase((uint64_t)best_fit_block->addr);
-            #endif
-            free_blocks_.erase(best_fit_block);
+    }
+    size_t mask = used_keys_.size() - 1;
+    size_t i = (addr / base_alignment_ * 0x9E3779B97F4A7C15ULL) & mask;
+    while (used_vals_[i] >= 0) {
+        i = (i + 1) & mask;
+    }
+    used_keys_[i] = addr;
+    used_vals_[i] = idx;
+    n_used_++;
+}
+
+int MemoryPoolManager::untrackUsed(uint64_t addr) {
+    size_t mask = used_keys_.size() - 1;
+    size_t i = (addr / base_alignment_ * 0x9E3779B97F4A7C15ULL) & mask;
+    while (used_vals_[i] >= 0 && used_keys_[i] != addr) {
+        i = (i + 1) & mask;
+    }
+    int idx = used_vals_[i];
+    if (idx < 0) {
+        return -1;
+    }
+    used_vals_[i] = -1;
+    n_used_--;
+    // backward shift deletion keeps probe chains intact
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (used_vals_[j] < 0) {
+            break;
+        }
+        size_t home = (used_keys_[j] / base_alignment_ * 0x9E3779B97F4A7C15ULL) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            used_keys_[i] = used_keys_[j];
+            used_vals_[i] = used_vals_[j];
+            used_vals_[j] = -1;
+            i = j;
         }
     }
+    return idx;
+}
 
-    void MemoryPoolManager::free(void *ptr){
-        size_t size = 0;
-        assert(ptr != nullptr);
-        auto ptr_addr = (uint64_t)ptr;
+void MemoryPoolManager::alloc(void **ptr, size_t size, size_t alignment) {
+    // ensure alignment is the power of 2
+    assert((alignment & (alignment - 1)) == 0);
+    assert(alignment <= base_alignment_);
 
-        if (auto iter = block_size_.find(ptr_addr);iter != block_size_.end()){
-            size = iter->second;
-        }else{
-            // can not find size
-            throw "can not find address of ptr";
+    size = aligned_offset(size == 0 ? 1 : size, base_alignment_);
+    int idx = findSuitable(size);
+    if (idx < 0) {
+        if (!warned_fallback_) {
+            std::cerr << "MemoryPoolManager: pool exhausted (" << used_size_ << "/" << pool_size_
+                      << " bytes used), falling back to system allocation" << std::endl;
+            warned_fallback_ = true;
         }
-        #ifdef MLLM_ALLOCATOR_DEBUG
-        debug_allocate_blocks.erase(ptr_addr);
-        #endif
-        for(auto iter=free_blocks_.begin();iter != free_blocks_.end();iter++){
-            uint64_t block_addr = (uint64_t)iter->addr;
-            auto block_size = iter->size;
-            // check if the ptr is at the end of the block
-            if (block_addr + block_size == ptr_addr){
-                iter->size += size;
-                #ifdef MLLM_ALLOCATOR_DEBUG
-                debug_free_blocks[block_addr] = iter->size;
-                #endif
-                // check if we can merge next free block
-                if (auto nxt = std::next(iter);nxt != free_blocks_.end() && (uint64_t)iter->addr + iter->size == (uint64_t)nxt->addr){
-                    iter->size += nxt->size;
-                    n_free_blocks_--;
-                    free_blocks_.erase(nxt);
-
-                    #ifdef MLLM_ALLOCATOR_DEBUG
-                    debug_free_blocks.erase((uint64_t)nxt->addr);
-                    #endif
-                }
-                return;
-            }
-
-            // check if the ptr is at the front of the block
-            if (ptr_addr + size == block_addr){
-                iter->addr = (void*)ptr_addr;
-                iter->size += size;
-
-                #ifdef MLLM_ALLOCATOR_DEBUG
-                debug_free_blocks[block_addr] = iter->size;
-                #endif
-
-                // check if we can merge previous free block
-                if (iter != free_blocks_.begin()){
-                    auto prev = std::prev(iter);
-                    if ((uint64_t)prev->addr + prev->size == ptr_addr){
-                        prev->size += iter->size;
-                        n_free_blocks_--;
-                        free_blocks_.erase(prev);
-                        #ifdef MLLM_ALLOCATOR_DEBUG
-                        debug_free_blocks.erase((uint64_t)prev->addr);
-                        #endif
-                    }
-                }
-                return;
-            }
+        fallback_.alloc(ptr, size, alignment);
+        return;
+    }
+    removeFree(idx);
+    if (blocks_[idx].size > size) {
+        int rest = newBlock();
+        auto &block = blocks_[idx]; // newBlock may reallocate blocks_
+        blocks_[rest] = {block.addr + size, block.size - size, idx, block.next_phys, -1, -1, true};
+        if (block.next_phys >= 0) {
+            blocks_[block.next_phys].prev_phys = rest;
         }
+        block.next_phys = rest;
+        block.size = size;
+        insertFree(rest);
+    }
+    auto &block = blocks_[idx];
+    trackUsed(block.addr, idx);
+    used_size_ += block.size;
+#ifdef MLLM_ALLOCATOR_DEBUG
+    debug_allocate_blocks[block.addr] = block.size;
+#endif
+    *ptr = (void *)block.addr;
+}
 
-        // otherwise, create a new block
-        bool inserted = false;
-        for(auto iter = free_blocks_.begin();iter!=free_blocks_.end();iter++){
-            if((uint64_t)iter->addr >= ptr_addr){
-                free_blocks_.insert(iter,FreeBlock{ptr,size});
-                inserted = true;
-                break;
-            }
+void MemoryPoolManager::free(void *ptr) {
+    assert(ptr != nullptr);
+    auto ptr_addr = (uint64_t)ptr;
+    if (ptr_addr < (uint64_t)data_ || ptr_addr >= (uint64_t)data_ + pool_size_) {
+        fallback_.free(ptr);
+        return;
+    }
+    int idx = untrackUsed(ptr_addr);
+    if (idx < 0) {
+        // can not find size
+        throw "can not find address of ptr";
+    }
+    used_size_ -= blocks_[idx].size;
+#ifdef MLLM_ALLOCATOR_DEBUG
+    debug_allocate_blocks.erase(ptr_addr);
+#endif
+    // merge with the next free block
+    int next = blocks_[idx].next_phys;
+    if (next >= 0 && blocks_[next].is_free) {
+        removeFree(next);
+        blocks_[idx].size += blocks_[next].size;
+        blocks_[idx].next_phys = blocks_[next].next_phys;
+        if (blocks_[idx].next_phys >= 0) {
+            blocks_[blocks_[idx].next_phys].prev_phys = idx;
         }
-        if (!inserted){
-            free_blocks_.emplace_back(ptr,size);
+        releaseBlock(next);
+    }
+    // merge into the previous free block
+    int prev = blocks_[idx].prev_phys;
+    if (prev >= 0 && blocks_[prev].is_free) {
+        removeFree(prev);
+        blocks_[prev].size += blocks_[idx].size;
+        blocks_[prev].next_phys = blocks_[idx].next_phys;
+        if (blocks_[prev].next_phys >= 0) {
+            blocks_[blocks_[prev].next_phys].prev_phys = prev;
         }
-        #ifdef MLLM_ALLOCATOR_DEBUG
-        debug_free_blocks[(uint64_t)ptr] = size;
-        #endif
-        n_free_blocks_++;
-    }
-    MemoryPoolManager::~MemoryPoolManager(){
-        free(data_);
-    }
-    #ifdef MLLM_ALLOCATOR_DEBUG
-    void MemoryPoolManager::display(){
-        // show all blocks in the pool
-        std::cout<<"n_free_blocks: "<<n_free_blocks_<<std::endl;
-        for (auto iter = free_blocks_.begin();iter != free_blocks_.end();iter++){
-            std::cout<<"addr: "<<iter->addr<<" size: "<<iter->size<<std::endl;
+        releaseBlock(idx);
+        idx = prev;
+    }
+    insertFree(idx);
+}
+
+#ifdef MLLM_ALLOCATOR_DEBUG
+void MemoryPoolManager::display() {
+    // show all blocks in the pool
+    std::cout << "n_free_blocks: " << n_free_blocks_ << " used: " << used_size_ << "/" << pool_size_ << std::endl;
+    for (int idx = 0; idx >= 0; idx = blocks_[idx].next_phys) {
+        if (blocks_[idx].is_free) {
+            std::cout << "addr: " << (void *)blocks_[idx].addr << " size: " << blocks_[idx].size << std::endl;
         }
     }
-    #endif
+}
+#endif
 
-}
\ No newline at end of file
+} // namespace mllm
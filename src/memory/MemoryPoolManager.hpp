@@ -1,53 +1,102 @@
 #include "MemoryManager.hpp"
+#include "memory/SystemMemoryManager.hpp"
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <unordered_map>
-#include<list>
+#include <vector>
 
 using std::unordered_map;
 using std::uint64_t;
-using std::list;
+using std::vector;
 #ifndef MLLM_MEMORY_POOL_H
 #define MLLM_MEMORY_POOL_H
-#define MLLM_ALLOCATOR_DEBUG
-
 
 namespace mllm {
 
-struct FreeBlock{
-    void* addr;
-    size_t size;
-    FreeBlock(void*addr,size_t size):addr(addr),size(size){}
-};
-
-class MemoryPoolManager : public MemoryManager{
+/**
+ * \brief A TLSF-style pool allocator.
+ *
+ * Free blocks are kept in two-level segregated size-class bins (FL: power of two, SL: 16 linear
+ * subdivisions) with bitmaps, so both alloc and free are O(1). Block descriptors live outside the
+ * pool (the pool stays densely packed) and are recycled, so a steady-state decode step does not
+ * call malloc. Neighbouring free blocks are coalesced on free. If the pool is exhausted the request
+ * falls back to a SystemMemoryManager; pointers outside the pool range are released the same way.
+ *
+ * Define MLLM_ALLOCATOR_DEBUG to track the free/allocated blocks in debug maps (see test/TestMemoryPoolManager.cpp).
+ */
+class MemoryPoolManager : public MemoryManager {
 public:
-    MemoryPoolManager(size_t pool_size,size_t base_alignment);
-    
+    MemoryPoolManager(size_t pool_size, size_t base_alignment);
+
     ~MemoryPoolManager();
 
-    void alloc(void **ptr, size_t size,size_t alignment) override;
+    void alloc(void **ptr, size_t size, size_t alignment) override;
 
     void free(void *ptr) override;
 
+    size_t poolSize() const {
+        return pool_size_;
+    }
+    size_t usedSize() const {
+        return used_size_;
+    }
+
 #ifdef MLLM_ALLOCATOR_DEBUG
     void display();
-    unordered_map<uint64_t,size_t> debug_free_blocks;
-    unordered_map<uint64_t,size_t> debug_allocate_blocks;
+    unordered_map<uint64_t, size_t> debug_free_blocks;
+    unordered_map<uint64_t, size_t> debug_allocate_blocks;
 #endif
 
 private:
-    void * data_; 
-    int n_free_blocks_;
+    static constexpr int SL_BITS = 4;
+    static constexpr int SL_COUNT = 1 << SL_BITS;
+    static constexpr int FL_COUNT = 64 - SL_BITS;
+
+    struct Block {
+        uint64_t addr;
+        size_t size;
+        int prev_phys; // physical neighbours, address ordered
+        int next_phys;
+        int prev_free; // links inside a size-class bin
+        int next_free;
+        bool is_free;
+    };
+
+    void mapping(size_t size, int &fl, int &sl) const;
+    int findSuitable(size_t size) const;
+    void insertFree(int idx);
+    void removeFree(int idx);
+    int newBlock();
+    void releaseBlock(int idx);
+    void trackUsed(uint64_t addr, int idx);
+    int untrackUsed(uint64_t addr);
+
+    void *data_;
+    size_t pool_size_;
+    size_t used_size_;
     size_t base_alignment_;
-    list<struct FreeBlock> free_blocks_;
-    unordered_map<uint64_t, size_t> block_size_;
+    int n_free_blocks_;
+
+    uint64_t fl_bitmap_;
+    uint32_t sl_bitmap_[FL_COUNT];
+    int bins_[FL_COUNT][SL_COUNT];
+
+    vector<Block> blocks_;
+    vector<int> spare_blocks_;
+
+    // open addressing (linear probing) map: allocated address -> block index
+    vector<uint64_t> used_keys_;
+    vector<int> used_vals_;
+    size_t n_used_;
+
+    SystemMemoryManager fallback_;
+    bool warned_fallback_;
 };
 
-inline size_t aligned_offset(size_t offset,size_t alignment){
+inline size_t aligned_offset(size_t offset, size_t alignment) {
     assert(alignment && !(alignment & (alignment - 1)));
-    auto align = ((alignment - ( offset % alignment))) % alignment;
+    auto align = ((alignment - (offset % alignment))) % alignment;
     return offset + align;
 }
 
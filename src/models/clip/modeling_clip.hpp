@@ -82,7 +82,7 @@ class ClipTextBlock final : public Module {
     ClipTextMLP mlp;
     Layer down_proj;
     Layer norm1;
-    Layer norm2;
+    LayerNorm norm2;
 
 public:
     ClipTextBlock() = default;
@@ -97,8 +97,9 @@ public:
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto x = norm1(inputs[0]);
         x = attention({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = norm2(tmp);
+        auto res = norm2(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = down_proj(x);
         x = x + tmp;
@@ -40,6 +40,7 @@ public:
     int patch_size{};
     int chl_size{};
     int cache_limit{};
+    int top_k{}; // > 0: the lm_head returns only the top_k best tokens (LinearTopK) instead of all logits
 
     FuyuNameConfig name_config;
 
@@ -17,7 +17,7 @@ class PersimmonBlock final : public Module {
     MultiHeadAttention attention;
     FeedForward mlp;
     Layer norm1;
-    Layer norm2;
+    LayerNorm norm2;
 
 public:
     PersimmonBlock() = default;
@@ -32,8 +32,9 @@ public:
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto x = norm1(inputs[0]);
         x = attention({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = norm2(tmp);
+        auto res = norm2(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = x + tmp;
         return {x};
@@ -47,10 +48,14 @@ class Persimmon final : public Module {
 
 public:
     Persimmon() = default;
-    Persimmon(int hidden_dim, int head_size, int ffn_hidden, int cache_limit, int block_num, int vocab_size, const FuyuNameConfig &names) {
+    Persimmon(int hidden_dim, int head_size, int ffn_hidden, int cache_limit, int block_num, int vocab_size, const FuyuNameConfig &names, int top_k = 0) {
         blocks = List<PersimmonBlock>(block_num, hidden_dim, head_size, ffn_hidden, cache_limit, names, names.blk_name);
         norm = LayerNorm(hidden_dim, true, 1e-6, names.post_norm_name);
-        lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
+        if (top_k > 0) {
+            lm_head = LinearTopK(hidden_dim, vocab_size, top_k, false, names.lm_head_name);
+        } else {
+            lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
+        }
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto x = inputs[0];
@@ -84,15 +89,15 @@ public:
     explicit FuyuModel(const FuyuConfig &config) :
         FuyuModel(config.vocab_size, config.hidden_dim, config.head_size, config.ffn_hidden, config.block_num,
                   config.cache_limit, config.patch_size, config.chl_size,
-                  config.name_config) {
+                  config.name_config, config.top_k) {
     }
     FuyuModel(int vocab_size, int hidden_dim, int head_size, int ffn_hidden, int block_num,
               int cache_limit, int patch_size, int chl_size,
-              const FuyuNameConfig &names) {
+              const FuyuNameConfig &names, int top_k = 0) {
         embed_tokens = Embedding(vocab_size, hidden_dim, names.token_embd_name);
         vision_embed_tokens = Linear(patch_size * patch_size * chl_size, hidden_dim, true, names.vision_embed_tokens_name);
         fuyu_gather = FuyuGather("gather");
-        persimmon = Persimmon(hidden_dim, head_size, ffn_hidden, cache_limit, block_num, vocab_size, names);
+        persimmon = Persimmon(hidden_dim, head_size, ffn_hidden, cache_limit, block_num, vocab_size, names, top_k);
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto input_ids = embed_tokens(inputs[0]);
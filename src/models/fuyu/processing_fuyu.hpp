@@ -7,6 +7,7 @@
 
 #include "processor/FuyuPreProcess.hpp"
 #include "tokenizers/Unigram/Unigram.hpp"
+#include "Sampler.hpp"
 
 using namespace mllm;
 
@@ -14,21 +15,6 @@ class FuyuProcessor final {
     UnigramTokenizer *tokenizer;
     FuyuPreProcess *preprocessor;
 
-    unsigned int argmax(const std::vector<float> &scores) {
-        if (scores.empty()) {
-            throw std::invalid_argument("Input vector is empty");
-        }
-        unsigned int maxIndex = 0;
-        float maxValue = scores[0];
-        for (size_t i = 1; i < scores.size(); ++i) {
-            if (scores[i] > maxValue) {
-                maxIndex = i;
-                maxValue = scores[i];
-            }
-        }
-        return maxIndex;
-    }
-
     static Tensor patches2Tensor(vector<vector<vector<float>>> image_patches, string name = "input", BackendType type = MLLM_CPU) {
         int batch = 0;
         int seq = 0;
@@ -109,15 +95,11 @@ public:
     std::string detokenize(const std::vector<token_id_t> &tokens) {
         return tokenizer->detokenize(tokens);
     }
-    std::pair<std::string, unsigned> detokenize(Tensor &result) {
+    // the next token from the last position of the logits, greedy without a sampler
+    std::pair<std::string, unsigned> detokenize(Tensor &result, Sampler *sampler = nullptr) {
         assert(result.batch() == 1);
         assert(result.head() == 1);
-        vector<float> scores;
-        for (int i = 0; i < result.dimension(); ++i) {
-            auto value = result.dataAt<float>(0, 0, result.sequence() - 1, i);
-            scores.push_back(value);
-        }
-        auto token_idx = this->argmax(scores);
+        auto token_idx = sampler ? sampler->sample(result) : Sampler::greedy(result);
         return {tokenizer->detokenize({token_idx}), token_idx};
     }
 };
@@ -86,6 +86,7 @@ struct GemmaConfig {
 
     int vocab_size = 256000;
     int max_position_embeddings = 8192;
+    RoPEScaling rope_scaling; // context extension; set original_max_position_embeddings to the trained context
     int num_hidden_layers = 18;
     int num_attention_heads = 8;
     int num_key_value_heads = 1;
@@ -95,6 +96,10 @@ struct GemmaConfig {
     float rms_norm_eps = 1e-6;
 
     int cache_limit;
+    // pack q/k/v into a FusedLinear and gate/up into a FusedGLU at load time
+    bool pack_projections = false;
+    // > 0: the lm_head returns only the top_k best tokens and their logits (LinearTopK), not the whole vocab
+    int top_k = 0;
     RoPEType RoPE_type = RoPEType::HFHUBROPE;
     GemmaNameConfig names_config;
 };
@@ -16,7 +16,7 @@ class EncoderBlock final : public Module {
     MultiHeadAttention attention;
     FeedForward ffn;
     Layer norm1;
-    Layer norm2;
+    LayerNorm norm2;
 
 public:
     EncoderBlock() = default;
@@ -40,8 +40,9 @@ public:
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
         auto x = norm1(inputs[0]);
         x = attention({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = norm2(tmp);
+        auto res = norm2(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = ffn({x})[0];
         x = x + tmp;
         return {x};
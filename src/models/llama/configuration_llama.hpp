@@ -70,6 +70,12 @@ public:
     int block_num{};
     RoPEType RoPE_type;
     int cache_limit{};
+    // pack q/k/v into a FusedLinear and gate/up into a FusedGLU at load time
+    bool pack_projections = false;
+    // context extension; set original_max_position_embeddings to the trained context (e.g. 4096 for LLaMA-2)
+    RoPEScaling rope_scaling;
+    // > 0: the lm_head returns only the top_k best tokens and their logits (LinearTopK), not the whole vocab
+    int top_k = 0;
     LLaMANameConfig names_config;
 
     explicit LLaMAConfig(int token_limit, string billions = "7B", RoPEType type = LLAMAROPE, int vocab = 32000) {
@@ -13,6 +13,7 @@
 using namespace mllm;
 
 class LLaMAMLP final : public Module {
+    FusedGLU gate_up_proj;
     Layer gate_proj;
     Layer silu;
     Layer up_proj;
@@ -20,17 +21,31 @@ class LLaMAMLP final : public Module {
 
 public:
     LLaMAMLP() = default;
-    LLaMAMLP(int hidden_dim, int ffn_hidden, const LLaMANameConfig &names, const string &base_name) {
-        gate_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._gate_proj_name);
+    LLaMAMLP(int hidden_dim, int ffn_hidden, const LLaMANameConfig &names, const string &base_name) :
+        LLaMAMLP(hidden_dim, ffn_hidden, false, names, base_name) {
+    }
+    LLaMAMLP(int hidden_dim, int ffn_hidden, bool pack_gate_up, const LLaMANameConfig &names, const string &base_name) {
+        if (pack_gate_up) {
+            gate_up_proj = FusedGLU(hidden_dim, ffn_hidden, "SiLU", base_name + names._gate_proj_name, base_name + names._up_proj_name);
+        } else {
+            gate_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._gate_proj_name);
+            up_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._up_proj_name);
+        }
         silu = SiLU(base_name + "act");
-        up_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._up_proj_name);
         down_proj = Linear(ffn_hidden, hidden_dim, false, base_name + names._down_proj_name);
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
-        auto x = gate_proj(inputs[0]);
-        x = silu(x);
-        auto y = up_proj(inputs[0]);
-        x = x * y;
+        Tensor x;
+        if (gate_up_proj.ready()) {
+            // silu(gate) * up is applied in the matmul epilogue
+            x = gate_up_proj(inputs[0]);
+        } else {
+            // gate/up run back to back so up_proj reuses gate_proj's quantized input
+            x = gate_proj(inputs[0]);
+            auto y = up_proj(inputs[0]);
+            x = silu(x);
+            x = x * y;
+        }
         x = down_proj(x);
         return {x};
     }
@@ -40,22 +55,27 @@ class LLaMABlock final : public Module {
     MultiHeadAttention attention;
     LLaMAMLP mlp;
     Layer norm1;
-    Layer norm2;
+    RMSNorm norm2;
 
 public:
     LLaMABlock() = default;
-    LLaMABlock(int hidden_dim, int head_size, int ffn_hidden, RoPEType RoPE_type, int cache_limit, const LLaMANameConfig &names, const string &base_name) {
-        attention = MultiHeadAttention(hidden_dim, head_size, head_size, hidden_dim / head_size, SPLIT_NONE, false, false,
-                                       RoPE_type, cache_limit, true, false, names, base_name + names._attn_base_name);
-        mlp = LLaMAMLP(hidden_dim, ffn_hidden, names, base_name + names._ffn_base_name);
+    LLaMABlock(int hidden_dim, int head_size, int ffn_hidden, RoPEType RoPE_type, int cache_limit, const LLaMANameConfig &names, const string &base_name) :
+        LLaMABlock(hidden_dim, head_size, ffn_hidden, RoPE_type, cache_limit, false, RoPEScaling(), names, base_name) {
+    }
+    LLaMABlock(int hidden_dim, int head_size, int ffn_hidden, RoPEType RoPE_type, int cache_limit, bool pack_projections, const RoPEScaling &rope_scaling,
+               const LLaMANameConfig &names, const string &base_name) {
+        attention = MultiHeadAttention(hidden_dim, head_size, head_size, hidden_dim / head_size, pack_projections ? SPLIT_NONE_PACKED : SPLIT_NONE, false, false,
+                                       RoPE_type, cache_limit, true, false, names, base_name + names._attn_base_name, rope_scaling);
+        mlp = LLaMAMLP(hidden_dim, ffn_hidden, pack_projections, names, base_name + names._ffn_base_name);
         norm1 = RMSNorm(hidden_dim, 1e-6, base_name + names._attn_norm_name);
         norm2 = RMSNorm(hidden_dim, 1e-6, base_name + names._ffn_norm_name);
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto x = norm1(inputs[0]);
         x = attention({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = norm2(tmp);
+        auto res = norm2(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = x + tmp;
         return {x};
@@ -71,14 +91,18 @@ class LLaMAModel final : public Module {
 public:
     explicit LLaMAModel(const LLaMAConfig &config) :
         LLaMAModel(config.vocab_size, config.hidden_dim, config.head_size, config.ffn_hidden, config.block_num, config.RoPE_type, config.cache_limit,
-                   config.names_config, config.names_config.blk_name) {
+                   config.pack_projections, config.rope_scaling, config.names_config, config.names_config.blk_name, config.top_k) {
     }
     LLaMAModel(int vocab_size, int hidden_dim, int head_size, int ffn_hidden, int block_num, RoPEType RoPE_type, int cache_limit,
-               const LLaMANameConfig &names, const string &base_name) {
+               bool pack_projections, const RoPEScaling &rope_scaling, const LLaMANameConfig &names, const string &base_name, int top_k = 0) {
         embedding = Embedding(vocab_size, hidden_dim, names.token_embd_name);
-        blocks = List<LLaMABlock>(block_num, hidden_dim, head_size, ffn_hidden, RoPE_type, cache_limit, names, base_name);
+        blocks = List<LLaMABlock>(block_num, hidden_dim, head_size, ffn_hidden, RoPE_type, cache_limit, pack_projections, rope_scaling, names, base_name);
         norm = RMSNorm(hidden_dim, 1e-6, names.post_norm_name);
-        lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
+        if (top_k > 0) {
+            lm_head = LinearTopK(hidden_dim, vocab_size, top_k, false, names.lm_head_name);
+        } else {
+            lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
+        }
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto x = embedding(inputs[0]);
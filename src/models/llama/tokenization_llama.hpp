@@ -6,6 +6,7 @@
 #define TOKENIZATION_LLAMA_HPP
 
 #include "tokenizers/BPE/Bpe.hpp"
+#include "Sampler.hpp"
 
 using namespace mllm;
 
@@ -13,21 +14,6 @@ using namespace mllm;
 class LLaMATokenizer final {
     BPETokenizer* tokenizer;
 
-
-    unsigned int argmax(const std::vector<float> &scores) {
-        if (scores.empty()) {
-            throw std::invalid_argument("Input vector is empty");
-        }
-        unsigned int maxIndex = 0;
-        float maxValue = scores[0];
-        for (size_t i = 1; i < scores.size(); ++i) {
-            if (scores[i] > maxValue) {
-                maxIndex = i;
-                maxValue = scores[i];
-            }
-        }
-        return maxIndex;
-    }
 public:
     explicit LLaMATokenizer(const std::string &vocab_file) {
         Module::initBackend(MLLM_CPU);
@@ -49,15 +35,16 @@ public:
         return tokenizer->detokenize(tokens);
     }
 
-    std::pair<std::string, unsigned> detokenize(Tensor& result) {
+    // the text of each token id, e.g. for a JsonGrammar
+    std::vector<std::string> tokenTexts() const {
+        return tokenizer->tokenTexts();
+    }
+
+    // the next token from the last position of the logits, greedy without a sampler
+    std::pair<std::string, unsigned> detokenize(Tensor& result, Sampler *sampler = nullptr) {
         assert(result.batch() == 1);
         assert(result.head() == 1);
-        vector<float> scores;
-        for (int i = 0; i < result.dimension(); ++i) {
-            auto value = result.dataAt<float>(0, 0, result.sequence() - 1, i);
-            scores.push_back(value);
-        }
-        auto token_idx = this->argmax(scores);
+        auto token_idx = sampler ? sampler->sample(result) : Sampler::greedy(result);
         return {tokenizer->detokenize({token_idx}), token_idx};
     }
 
@@ -6,6 +6,7 @@
 #define PROCESSING_LLAVA_HPP
 #include "tokenizers/BPE/Bpe.hpp"
 #include "processor/ClipPreProcess.hpp"
+#include "Sampler.hpp"
 #include <numeric>
 #include <utility>
 
@@ -29,20 +30,6 @@ class LLaVAProcessor final {
         }
         return tensor1;
     }
-    unsigned int argmax(const std::vector<float> &scores) {
-        if (scores.empty()) {
-            throw std::invalid_argument("Input vector is empty");
-        }
-        unsigned int maxIndex = 0;
-        float maxValue = scores[0];
-        for (size_t i = 1; i < scores.size(); ++i) {
-            if (scores[i] > maxValue) {
-                maxIndex = i;
-                maxValue = scores[i];
-            }
-        }
-        return maxIndex;
-    }
 
     BPETokenizer *tokenizer;
     ClipPreProcessor *clip_processor;
@@ -88,15 +75,11 @@ public:
         return tokenizer->detokenize(tokens);
     }
 
-    std::pair<std::string, unsigned> detokenize(Tensor &result) {
+    // the next token from the last position of the logits, greedy without a sampler
+    std::pair<std::string, unsigned> detokenize(Tensor &result, Sampler *sampler = nullptr) {
         assert(result.batch() == 1);
         assert(result.head() == 1);
-        vector<float> scores;
-        for (int i = 0; i < result.dimension(); ++i) {
-            auto value = result.dataAt<float>(0, 0, result.sequence() - 1, i);
-            scores.push_back(value);
-        }
-        auto token_idx = this->argmax(scores);
+        auto token_idx = sampler ? sampler->sample(result) : Sampler::greedy(result);
         return {tokenizer->detokenize({token_idx}), token_idx};
     }
 };
@@ -108,6 +108,7 @@ struct MistralConfig {
     float initializer_range = 0.02;
     int intermediate_size = 14336;
     int max_position_embeddings = 32768;
+    RoPEScaling rope_scaling; // context extension beyond max_position_embeddings
     std::string model_type = "mistral";
     int num_attention_heads = 32;
     int num_hidden_layers = 32;
@@ -117,6 +118,10 @@ struct MistralConfig {
     int vocab_size = 32000;
 
     int cache_limit;
+    // pack q/k/v into a FusedLinear and gate/up into a FusedGLU at load time
+    bool pack_projections = false;
+    // > 0: the lm_head returns only the top_k best tokens and their logits (LinearTopK), not the whole vocab
+    int top_k = 0;
     RoPEType RoPE_type = RoPEType::HFHUBROPE;
     MistralNameConfig names_config;
 };
@@ -22,23 +22,35 @@ using namespace mllm;
 class MistralMLP final : public Module {
 public:
     MistralMLP() = default;
-    MistralMLP(int hidden_size, int intermediate_size, const MistralNameConfig &names, const std::string &base_name) {
-        gate_proj = Linear(hidden_size, intermediate_size, false, base_name + names._gate_proj_name);
+    MistralMLP(int hidden_size, int intermediate_size, bool pack_gate_up, const MistralNameConfig &names, const std::string &base_name) {
+        if (pack_gate_up) {
+            gate_up_proj = FusedGLU(hidden_size, intermediate_size, "SiLU", base_name + names._gate_proj_name, base_name + names._up_proj_name);
+        } else {
+            gate_proj = Linear(hidden_size, intermediate_size, false, base_name + names._gate_proj_name);
+            up_proj = Linear(hidden_size, intermediate_size, false, base_name + names._up_proj_name);
+        }
         silu = SiLU(base_name + "act");
-        up_proj = Linear(hidden_size, intermediate_size, false, base_name + names._up_proj_name);
         down_proj = Linear(intermediate_size, hidden_size, false, base_name + names._down_proj_name);
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
-        auto x = gate_proj(inputs[0]);
-        x = silu(x);
-        auto y = up_proj(inputs[0]);
-        x = x * y;
+        Tensor x;
+        if (gate_up_proj.ready()) {
+            // silu(gate) * up is applied in the matmul epilogue
+            x = gate_up_proj(inputs[0]);
+        } else {
+            // gate/up run back to back so up_proj reuses gate_proj's quantized input
+            x = gate_proj(inputs[0]);
+            auto y = up_proj(inputs[0]);
+            x = silu(x);
+            x = x * y;
+        }
         x = down_proj(x);
         return {x};
     }
 
 private:
+    FusedGLU gate_up_proj;
     Layer gate_proj;
     Layer up_proj;
     Layer down_proj;
@@ -57,22 +69,38 @@ public:
         num_key_value_groups = num_heads / num_key_value_heads;
 
         // init layers
-        q_proj = Linear(hidden_size, num_heads * head_dim, false, base_name + names._q_proj_name);
-        k_proj = Linear(hidden_size, num_key_value_heads * head_dim, false, base_name + names._k_proj_name);
-        v_proj = Linear(hidden_size, num_key_value_heads * head_dim, false, base_name + names._v_proj_name);
+        if (config.pack_projections) {
+            qkv_proj = FusedLinear(hidden_size, {num_heads * head_dim, num_key_value_heads * head_dim, num_key_value_heads * head_dim}, false,
+                                   {base_name + names._q_proj_name, base_name + names._k_proj_name, base_name + names._v_proj_name},
+                                   config.RoPE_type, head_dim, config.rope_theta, config.max_position_embeddings, config.rope_scaling);
+        } else {
+            q_proj = Linear(hidden_size, num_heads * head_dim, false, base_name + names._q_proj_name);
+            k_proj = Linear(hidden_size, num_key_value_heads * head_dim, false, base_name + names._k_proj_name);
+            v_proj = Linear(hidden_size, num_key_value_heads * head_dim, false, base_name + names._v_proj_name);
+        }
         o_proj = Linear(num_heads * head_dim, hidden_size, false, base_name + names._o_proj_name);
-        q_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, base_name + "q_rope");
-        k_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, base_name + "k_rope");
+        if (!qkv_proj.ready()) { // the packed projection applies RoPE itself
+            q_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, config.rope_scaling, base_name + "q_rope");
+            k_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, config.rope_scaling, base_name + "k_rope");
+        }
         k_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "k_cache");
         v_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "v_cache");
-        mask = Causalmask(base_name + "mask");
-        softmax = Softmax(DIMENSION, base_name + "softmax");
+        // scaled, causally masked softmax
+        softmax = Softmax(DIMENSION, 1.0f / std::sqrt((float)head_dim), true, base_name + "softmax");
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
-        auto query_states = q_proj(inputs[0]);
-        auto key_states = k_proj(inputs[1]);
-        auto value_states = v_proj(inputs[2]);
+        Tensor query_states, key_states, value_states;
+        if (qkv_proj.ready()) {
+            auto qkv = qkv_proj(inputs[0]);
+            query_states = qkv[0];
+            key_states = qkv[1];
+            value_states = qkv[2];
+        } else {
+            query_states = q_proj(inputs[0]);
+            key_states = k_proj(inputs[1]);
+            value_states = v_proj(inputs[2]);
+        }
 
         // [batch, heads, sequence, dims]
         query_states = query_states.view(-1, num_heads, -1, head_dim);
@@ -80,20 +108,21 @@ public:
         value_states = value_states.view(-1, num_key_value_heads, -1, head_dim);
 
         // embedding
-        query_states = q_rope(query_states);
-        key_states = k_rope(key_states);
+        if (q_rope.ready() && k_rope.ready()) {
+            query_states = q_rope(query_states);
+            key_states = k_rope(key_states);
+        }
 
         // kv cache
         key_states = k_cache(key_states);
         value_states = v_cache(value_states);
 
-        // attention weight
-        auto atten_weight = Tensor::mm(query_states, key_states.transpose(Chl::SEQUENCE, Chl::DIMENSION)) / std::sqrt(head_dim);
-        atten_weight = mask(atten_weight);
+        // attention weight: only the causally visible scores are computed, the softmax masks the rest
+        auto atten_weight = Tensor::mm(query_states, key_states.transpose(Chl::SEQUENCE, Chl::DIMENSION), CAUSAL_MM_OUTPUT);
         atten_weight = softmax(atten_weight);
 
         // attention output
-        auto atten_output = Tensor::mm(atten_weight, value_states);
+        auto atten_output = Tensor::mm(atten_weight, value_states, CAUSAL_MM_INPUT0);
         atten_output = atten_output.view(-1, 1, -1, head_dim * num_heads);
         atten_output = o_proj(atten_output);
         return {atten_output};
@@ -105,6 +134,7 @@ private:
     int head_dim;
     int num_key_value_heads;
     int num_key_value_groups;
+    FusedLinear qkv_proj;
     Layer q_proj;
     Layer k_proj;
     Layer v_proj;
@@ -113,7 +143,6 @@ private:
     Layer k_rope;
     Layer k_cache;
     Layer v_cache;
-    Layer mask;
     Layer softmax;
 };
 
@@ -122,7 +151,7 @@ public:
     MistralDecoder() = default;
     MistralDecoder(const MistralConfig &config, const MistralNameConfig &names, const string &base_name) {
         self_atten = MistralAttention(config, names, base_name + names._attn_base_name);
-        mlp = MistralMLP(config.hidden_size, config.intermediate_size, names, base_name + names._ffn_base_name);
+        mlp = MistralMLP(config.hidden_size, config.intermediate_size, config.pack_projections, names, base_name + names._ffn_base_name);
         input_layernorm = RMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._attn_norm_name);
         post_attention_layernorm = RMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._ffn_norm_name);
     }
@@ -130,8 +159,9 @@ public:
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
         auto x = input_layernorm(inputs[0]);
         x = self_atten({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = post_attention_layernorm(tmp);
+        auto res = post_attention_layernorm(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = x + tmp;
         return {x};
@@ -141,7 +171,7 @@ private:
     MistralAttention self_atten;
     MistralMLP mlp;
     Layer input_layernorm;
-    Layer post_attention_layernorm;
+    RMSNorm post_attention_layernorm;
 };
 
 class MistralModel final : public Module {
@@ -173,7 +203,11 @@ public:
         hidden_size = config.hidden_size;
         embedding = Embedding(config.vocab_size, config.hidden_size, names.token_embd_name);
         model = MistralModel(config, names, names.blk_name);
-        lm_head = Linear(hidden_size, config.vocab_size, false, names.lm_head_name);
+        if (config.top_k > 0) {
+            lm_head = LinearTopK(hidden_size, config.vocab_size, config.top_k, false, names.lm_head_name);
+        } else {
+            lm_head = Linear(hidden_size, config.vocab_size, false, names.lm_head_name);
+        }
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -12,6 +12,7 @@
 #define TOKENIZATION_MISTRAL_HPP
 
 #include "tokenizers/BPE/Bpe.hpp"
+#include "Sampler.hpp"
 #include <algorithm>
 #include <regex>
 
@@ -39,29 +40,16 @@ public:
         return tokenizer->detokenize(tokens);
     }
 
-    std::pair<std::string, unsigned> detokenize(Tensor &result) {
+    // the next token from the last position of the logits, greedy without a sampler
+    std::pair<std::string, unsigned> detokenize(Tensor &result, Sampler *sampler = nullptr) {
         assert(result.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
         assert(result.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
-        std::vector<float> scores;
-        int _dims = result.dimension();
-        int _seq = result.sequence() - 1;
-        for (int i = 0; i < _dims; ++i) {
-            auto value = result.dataAt<float>(0, 0, _seq, i);
-            scores.push_back(value);
-        }
-        auto token_idx = this->argmax(scores);
+        auto token_idx = sampler ? sampler->sample(result) : Sampler::greedy(result);
         auto text = tokenizer->detokenize({token_idx});
         return make_pair(text, token_idx);
     }
 
 private:
-    unsigned int argmax(const std::vector<float> &scores) {
-        if (scores.empty()) {
-            throw std::invalid_argument("Input vector is empty");
-        }
-        return std::max_element(scores.begin(), scores.end()) - scores.begin();
-    }
-
     BPETokenizer *tokenizer;
 
 public:
@@ -116,6 +116,7 @@ struct QWenConfig {
     float initializer_range = 0.02;
     int intermediate_size = 2816;
     int max_position_embeddings = 32768;
+    RoPEScaling rope_scaling; // context extension beyond max_position_embeddings
     int max_window_layers = 21;
     std::string model_type = "qwen2";
     int num_attention_heads = 16;
@@ -128,6 +129,10 @@ struct QWenConfig {
     bool tie_embedding_words = false;
 
     int cache_limit;
+    // pack q/k/v into a FusedLinear and gate/up into a FusedGLU at load time
+    bool pack_projections = false;
+    // > 0: the lm_head returns only the top_k best tokens and their logits (LinearTopK), not the whole vocab
+    int top_k = 0;
     RoPEType RoPE_type = RoPEType::HFHUBROPE;
     QWenNameConfig names_config;
 };
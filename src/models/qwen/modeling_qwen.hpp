@@ -23,23 +23,35 @@ using namespace mllm;
 class QWenMLP final : public Module {
 public:
     QWenMLP() = default;
-    QWenMLP(int hidden_size, int intermediate_size, const QWenNameConfig &names, const std::string &base_name) {
-        gate_proj = Linear(hidden_size, intermediate_size, false, base_name + names._gate_proj_name);
+    QWenMLP(int hidden_size, int intermediate_size, bool pack_gate_up, const QWenNameConfig &names, const std::string &base_name) {
+        if (pack_gate_up) {
+            gate_up_proj = FusedGLU(hidden_size, intermediate_size, "SiLU", base_name + names._gate_proj_name, base_name + names._up_proj_name);
+        } else {
+            gate_proj = Linear(hidden_size, intermediate_size, false, base_name + names._gate_proj_name);
+            up_proj = Linear(hidden_size, intermediate_size, false, base_name + names._up_proj_name);
+        }
         silu = SiLU(base_name + "act");
-        up_proj = Linear(hidden_size, intermediate_size, false, base_name + names._up_proj_name);
         down_proj = Linear(intermediate_size, hidden_size, false, base_name + names._down_proj_name);
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
-        auto x = gate_proj(inputs[0]);
-        x = silu(x);
-        auto y = up_proj(inputs[0]);
-        x = x * y;
+        Tensor x;
+        if (gate_up_proj.ready()) {
+            // silu(gate) * up is applied in the matmul epilogue
+            x = gate_up_proj(inputs[0]);
+        } else {
+            // gate/up run back to back so up_proj reuses gate_proj's quantized input
+            x = gate_proj(inputs[0]);
+            auto y = up_proj(inputs[0]);
+            x = silu(x);
+            x = x * y;
+        }
         x = down_proj(x);
         return {x};
     }
 
 private:
+    FusedGLU gate_up_proj;
     Layer gate_proj;
     Layer up_proj;
     Layer down_proj;
@@ -59,23 +71,39 @@ public:
         num_key_value_groups = num_heads / num_key_value_heads;
 
         // init layers
-        q_proj = Linear(hidden_size, num_heads * head_dim, true, base_name + names._q_proj_name);
-        k_proj = Linear(hidden_size, num_key_value_heads * head_dim, true, base_name + names._k_proj_name);
-        v_proj = Linear(hidden_size, num_key_value_heads * head_dim, true, base_name + names._v_proj_name);
+        if (config.pack_projections) {
+            qkv_proj = FusedLinear(hidden_size, {num_heads * head_dim, num_key_value_heads * head_dim, num_key_value_heads * head_dim}, true,
+                                   {base_name + names._q_proj_name, base_name + names._k_proj_name, base_name + names._v_proj_name},
+                                   config.RoPE_type, head_dim, config.rope_theta, config.max_position_embeddings, config.rope_scaling);
+        } else {
+            q_proj = Linear(hidden_size, num_heads * head_dim, true, base_name + names._q_proj_name);
+            k_proj = Linear(hidden_size, num_key_value_heads * head_dim, true, base_name + names._k_proj_name);
+            v_proj = Linear(hidden_size, num_key_value_heads * head_dim, true, base_name + names._v_proj_name);
+        }
         o_proj = Linear(num_heads * head_dim, hidden_size, false, base_name + names._o_proj_name);
-        q_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, base_name + "q_rope");
-        k_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, base_name + "k_rope");
+        if (!qkv_proj.ready()) { // the packed projection applies RoPE itself
+            q_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, config.rope_scaling, base_name + "q_rope");
+            k_rope = RoPE(config.RoPE_type, config.rope_theta, config.max_position_embeddings, config.rope_scaling, base_name + "k_rope");
+        }
         k_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "k_cache");
         v_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "v_cache");
         // mask = SlidingWindowMask(config.sliding_window, base_name + "mask");
-        mask = Causalmask(base_name + "mask");
-        softmax = Softmax(DIMENSION, base_name + "softmax");
+        // scaled, causally masked softmax
+        softmax = Softmax(DIMENSION, 1.0f / std::sqrt((float)head_dim), true, base_name + "softmax");
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
-        auto query_states = q_proj(inputs[0]);
-        auto key_states = k_proj(inputs[1]);
-        auto value_states = v_proj(inputs[2]);
+        Tensor query_states, key_states, value_states;
+        if (qkv_proj.ready()) {
+            auto qkv = qkv_proj(inputs[0]);
+            query_states = qkv[0];
+            key_states = qkv[1];
+            value_states = qkv[2];
+        } else {
+            query_states = q_proj(inputs[0]);
+            key_states = k_proj(inputs[1]);
+            value_states = v_proj(inputs[2]);
+        }
 
         // [batch, heads, sequence, dims]
         query_states = query_states.view(-1, num_heads, -1, head_dim);
@@ -83,20 +111,21 @@ public:
         value_states = value_states.view(-1, num_key_value_heads, -1, head_dim);
 
         // embedding
-        query_states = q_rope(query_states);
-        key_states = k_rope(key_states);
+        if (q_rope.ready() && k_rope.ready()) {
+            query_states = q_rope(query_states);
+            key_states = k_rope(key_states);
+        }
 
         // kv cache
         key_states = k_cache(key_states);
         value_states = v_cache(value_states);
 
-        // attention weight
-        auto atten_weight = Tensor::mm(query_states, key_states.transpose(Chl::SEQUENCE, Chl::DIMENSION)) / std::sqrt(head_dim);
-        atten_weight = mask(atten_weight);
+        // attention weight: only the causally visible scores are computed, the softmax masks the rest
+        auto atten_weight = Tensor::mm(query_states, key_states.transpose(Chl::SEQUENCE, Chl::DIMENSION), CAUSAL_MM_OUTPUT);
         atten_weight = softmax(atten_weight);
 
         // attention output
-        auto atten_output = Tensor::mm(atten_weight, value_states);
+        auto atten_output = Tensor::mm(atten_weight, value_states, CAUSAL_MM_INPUT0);
         atten_output = atten_output.view(-1, 1, -1, head_dim * num_heads);
         atten_output = o_proj(atten_output);
         return {atten_output};
@@ -108,6 +137,7 @@ private:
     int head_dim;
     int num_key_value_heads;
     int num_key_value_groups;
+    FusedLinear qkv_proj;
     Layer q_proj;
     Layer k_proj;
     Layer v_proj;
@@ -116,7 +146,6 @@ private:
     Layer k_rope;
     Layer k_cache;
     Layer v_cache;
-    Layer mask;
     Layer softmax;
 };
 
@@ -126,7 +155,7 @@ public:
     QWenDecoder() = default;
     QWenDecoder(const QWenConfig &config, const QWenNameConfig &names, const string &base_name) {
         self_atten = QWenAttention(config, names, base_name + names._attn_base_name);
-        mlp = QWenMLP(config.hidden_size, config.intermediate_size, names, base_name + names._ffn_base_name);
+        mlp = QWenMLP(config.hidden_size, config.intermediate_size, config.pack_projections, names, base_name + names._ffn_base_name);
         input_layernorm = RMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._attn_norm_name);
         post_attention_layernorm = RMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._ffn_norm_name);
     }
@@ -134,8 +163,9 @@ public:
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
         auto x = input_layernorm(inputs[0]);
         x = self_atten({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = post_attention_layernorm(tmp);
+        auto res = post_attention_layernorm(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = x + tmp;
         return {x};
@@ -145,7 +175,7 @@ private:
     QWenAttention self_atten;
     QWenMLP mlp;
     Layer input_layernorm;
-    Layer post_attention_layernorm;
+    RMSNorm post_attention_layernorm;
 };
 
 // Copied from GemmaModel with Gemma->Qwen and set RmsNorm(without add_unit_offset)
@@ -183,7 +213,12 @@ public:
         // FIXME Qwen-0.5 use tied embedding
         // Others use nn.Linear()
         if (tie_embedding_words) {
-            lm_head = Parameter(1, config.vocab_size, 1, config.hidden_size, names.token_embd_name + ".weight");
+            if (config.top_k > 0) {
+                lm_head = LinearTopK(config.hidden_size, config.vocab_size, config.top_k, false, names.lm_head_name);
+            } else {
+                lm_head = Linear(config.hidden_size, config.vocab_size, false, names.lm_head_name);
+            }
+            tie(names.lm_head_name + ".weight", names.token_embd_name + ".weight");
         }
     }
 
@@ -193,7 +228,7 @@ public:
         // go through model
         auto outputs = model({x})[0];
         if (tie_embedding_words) {
-            outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
+            outputs = lm_head(outputs);
         }
         return {outputs};
     }
@@ -202,7 +237,7 @@ private:
     int hidden_size;
     bool tie_embedding_words;
     Layer embedding;
-    Parameter lm_head;
+    Layer lm_head;
     QWenModel model;
 };
 
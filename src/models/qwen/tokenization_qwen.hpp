@@ -12,6 +12,7 @@
 
 #include "tokenizers/BPE/Bpe.hpp"
 #include "tokenizers/Tokenizer.hpp"
+#include "Sampler.hpp"
 #include <algorithm>
 #include <unordered_map>
 
@@ -147,24 +148,25 @@ public:
         return _byte_decode_(tokenizer->detokenize(tokens));
     }
 
-    std::pair<std::string, unsigned> detokenize(Tensor &result) {
-        assert(result.batch() == 1);
-        assert(result.head() == 1);
-        vector<float> scores;
-        for (int i = 0; i < result.dimension(); ++i) {
-            auto value = result.dataAt<float>(0, 0, result.sequence() - 1, i);
-            scores.push_back(value);
+    // the text of each token id, e.g. for a JsonGrammar; empty for <|im_start|> and the like
+    std::vector<std::string> tokenTexts() {
+        auto texts = tokenizer->tokenTexts();
+        for (auto &text : texts) {
+            if (text.size() > 4 && text.compare(0, 2, "<|") == 0 && text.compare(text.size() - 2, 2, "|>") == 0) {
+                text.clear();
+            } else {
+                text = _byte_decode_(text);
+            }
         }
-        auto token_idx = this->argmax(scores);
-        return {_byte_decode_(tokenizer->detokenize({token_idx})), token_idx};
+        return texts;
     }
 
-private:
-    unsigned int argmax(const std::vector<float> &scores) {
-        if (scores.empty()) {
-            throw std::invalid_argument("Input vector is empty");
-        }
-        return std::max_element(scores.begin(), scores.end()) - scores.begin();
+    // the next token from the last position of the logits, greedy without a sampler
+    std::pair<std::string, unsigned> detokenize(Tensor &result, Sampler *sampler = nullptr) {
+        assert(result.batch() == 1);
+        assert(result.head() == 1);
+        auto token_idx = sampler ? sampler->sample(result) : Sampler::greedy(result);
+        return {_byte_decode_(tokenizer->detokenize({token_idx})), token_idx};
     }
 
 public:
@@ -18,6 +18,8 @@ public:
     int block_num{};
     RoPEType RoPE_type;
     int cache_limit{};
+    // > 0: the lm_head returns only the top_k best tokens and their logits (LinearTopK), not the whole vocab
+    int top_k = 0;
     LLaMANameConfig names_config;
 
     explicit TinyLLaMAConfig(int token_limit, string billions = "1.5B", RoPEType type = HFHUBROPE, int vocab = 32000) {
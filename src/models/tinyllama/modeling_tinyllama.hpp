@@ -16,7 +16,7 @@ class TinyLLaMABlock final : public Module {
     MultiHeadAttention attention;
     LLaMAMLP mlp;
     Layer norm1;
-    Layer norm2;
+    RMSNorm norm2;
 
 public:
     TinyLLaMABlock() = default;
@@ -30,8 +30,9 @@ public:
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
         auto x = norm1(inputs[0]);
         x = attention({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = norm2(tmp);
+        auto res = norm2(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = x + tmp;
         return {x};
@@ -47,14 +48,18 @@ class TinyLLaMAModel final : public Module {
 public:
     explicit TinyLLaMAModel(const TinyLLaMAConfig &config) :
         TinyLLaMAModel(config.vocab_size, config.hidden_dim, config.head_size, config.kv_head_size, config.ffn_hidden, config.block_num, config.RoPE_type, config.cache_limit,
-                       config.names_config, config.names_config.blk_name) {
+                       config.names_config, config.names_config.blk_name, config.top_k) {
     }
     TinyLLaMAModel(int vocab_size, int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, int block_num, RoPEType RoPE_type, int cache_limit,
-                   const LLaMANameConfig &names, const string &base_name) {
+                   const LLaMANameConfig &names, const string &base_name, int top_k = 0) {
         embedding = Embedding(vocab_size, hidden_dim, names.token_embd_name);
         blocks = List<TinyLLaMABlock>(block_num, hidden_dim, head_size, kv_head_size, ffn_hidden, RoPE_type, cache_limit, names, base_name);
         norm = RMSNorm(hidden_dim, 1e-6, names.post_norm_name);
-        lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
+        if (top_k > 0) {
+            lm_head = LinearTopK(hidden_dim, vocab_size, top_k, false, names.lm_head_name);
+        } else {
+            lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
+        }
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
         auto x = embedding(inputs[0]);
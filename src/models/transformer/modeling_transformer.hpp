@@ -11,6 +11,7 @@ using namespace mllm;
 
 
 enum AttnQKVSplitType {
+    SPLIT_NONE_PACKED = -1, // separate q/k/v weights, packed into one FusedLinear at load time
     SPLIT_NONE = 0,
     SPLIT_HD = Chl::HD,
     SPLIT_D_HD = Chl::D_HD,
@@ -20,6 +21,7 @@ enum AttnQKVSplitType {
 class MultiHeadAttention final : public Module {
     Layer qkv_proj;
     Split qkv_split;
+    FusedLinear qkv_packed;
     Layer q_proj;
     Layer k_proj;
     Layer v_proj;
@@ -29,7 +31,6 @@ class MultiHeadAttention final : public Module {
     Layer k_norm;
     Layer k_cache;
     Layer v_cache;
-    Layer mask;
     Layer softmax;
     Layer o_proj;
     Parameter bias_k;
@@ -37,19 +38,30 @@ class MultiHeadAttention final : public Module {
     int head_size_{};
     int kv_head_size_{};
     int attn_hidden_dim_{};
+    bool causal_ = false;
 
 public:
     MultiHeadAttention() = default;
     MultiHeadAttention(int hidden_dim, int head_size,int kv_head_size, int attn_hidden_dim,
                        AttnQKVSplitType do_qkv_proj, bool post_qkv_norm, bool bias_kv_cat,
                        RoPEType RoPE_type, int cache_limit, bool do_mask, bool bias,
-                       const TransformerNameConfig &names, const string &base_name) {
+                       const TransformerNameConfig &names, const string &base_name,
+                       const RoPEScaling &rope_scaling = RoPEScaling()) {
         attn_hidden_dim_ = attn_hidden_dim;
         head_size_ = head_size;
         kv_head_size_ = kv_head_size;
         if (do_qkv_proj > 0) {
             qkv_proj = Linear(hidden_dim, head_size * attn_hidden_dim * 3, bias, base_name + names._qkv_proj_name);
             qkv_split = Split(3, (Chl)do_qkv_proj, head_size, base_name + names._qkv_proj_name + ".split");
+        } else if (do_qkv_proj == SPLIT_NONE_PACKED) {
+            vector<int> out_features = {head_size * attn_hidden_dim, kv_head_size * attn_hidden_dim, kv_head_size * attn_hidden_dim};
+            vector<string> proj_names = {base_name + names._q_proj_name, base_name + names._k_proj_name, base_name + names._v_proj_name};
+            if (RoPE_type > 0 && !post_qkv_norm && !bias_kv_cat) {
+                // nothing runs between the projection and RoPE: rotate q/k in its epilogue (RoPE()'s default theta and range)
+                qkv_packed = FusedLinear(hidden_dim, out_features, bias, proj_names, RoPE_type, attn_hidden_dim, 10000, 16384, rope_scaling);
+            } else {
+                qkv_packed = FusedLinear(hidden_dim, out_features, bias, proj_names);
+            }
         } else {
             q_proj = Linear(hidden_dim, head_size * attn_hidden_dim, bias, base_name + names._q_proj_name);
             k_proj = Linear(hidden_dim, kv_head_size * attn_hidden_dim, bias, base_name + names._k_proj_name);
@@ -59,18 +71,23 @@ public:
             q_norm = LayerNorm(attn_hidden_dim, true, 1e-6, base_name + names._q_norm_name);
             k_norm = LayerNorm(attn_hidden_dim, true, 1e-6, base_name + names._k_norm_name);
         }
-        if (RoPE_type > 0) {
-            q_rope = RoPE(RoPE_type, base_name + "q_rope");
-            k_rope = RoPE(RoPE_type, base_name + "k_rope");
+        if (RoPE_type > 0 && !(qkv_packed.ready() && !post_qkv_norm && !bias_kv_cat)) {
+            if (rope_scaling.type != ROPE_SCALING_NONE) {
+                q_rope = RoPE(RoPE_type, 10000, 16384, rope_scaling, base_name + "q_rope");
+                k_rope = RoPE(RoPE_type, 10000, 16384, rope_scaling, base_name + "k_rope");
+            } else {
+                q_rope = RoPE(RoPE_type, base_name + "q_rope");
+                k_rope = RoPE(RoPE_type, base_name + "k_rope");
+            }
         }
         if (cache_limit > 0) {
             k_cache = KVCache(head_size/kv_head_size, cache_limit, base_name + "k_cache");
             v_cache = KVCache(head_size/kv_head_size, cache_limit, base_name + "v_cache");
         }
-        if (do_mask) {
-            mask = Causalmask(base_name + "mask");
-        }
-        softmax = Softmax(DIMENSION, base_name + "softmax");
+        // the 1/sqrt(d) scale and the causal mask are applied inside the softmax; both matmuls
+        // skip the masked part
+        causal_ = do_mask;
+        softmax = Softmax(DIMENSION, 1.0f / std::sqrt((float)attn_hidden_dim), do_mask, base_name + "softmax");
         o_proj = Linear(head_size * attn_hidden_dim, hidden_dim, bias, base_name + names._o_proj_name);
         if (bias_kv_cat) {
             bias_k = Parameter(1, 1, head_size, attn_hidden_dim, base_name + "bias_k");
@@ -85,6 +102,12 @@ public:
             q = qkv_sp[0];
             k = qkv_sp[1];
             v = qkv_sp[2];
+        } else if (qkv_packed.ready()) {
+            // packing assumes self-attention: q, k and v all project inputs[0]
+            auto qkv = qkv_packed(inputs[0]);
+            q = qkv[0].view(-1, head_size_, -1, attn_hidden_dim_);
+            k = qkv[1].view(-1, kv_head_size_, -1, attn_hidden_dim_);
+            v = qkv[2].view(-1, kv_head_size_, -1, attn_hidden_dim_);
         } else {
             q = q_proj(inputs[0]);
             k = k_proj(inputs[1]);
@@ -110,13 +133,9 @@ public:
             v = v_cache(v);
         }
         k = k.transpose(SEQUENCE, DIMENSION);
-        auto qk = Tensor::mm(q, k);
-        qk = qk / std::sqrt(attn_hidden_dim_);
-        if (mask.ready()) {
-            qk = mask(qk);
-        }
+        auto qk = Tensor::mm(q, k, causal_ ? CAUSAL_MM_OUTPUT : CAUSAL_MM_NONE);
         qk = softmax(qk);
-        auto o = Tensor::mm(qk, v);
+        auto o = Tensor::mm(qk, v, causal_ ? CAUSAL_MM_INPUT0 : CAUSAL_MM_NONE);
         o = o.view(-1, 1, -1, attn_hidden_dim_ * head_size_);
         o = o_proj(o);
         return {o};
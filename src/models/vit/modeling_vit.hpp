@@ -33,7 +33,7 @@ class ViTBlock final : public Module {
     ViTMLP mlp;
     Layer down_proj;
     Layer norm1;
-    Layer norm2;
+    LayerNorm norm2;
 
 public:
     ViTBlock() = default;
@@ -48,8 +48,9 @@ public:
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override  {
         auto x = norm1(inputs[0]);
         x = attention({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = norm2(tmp);
+        auto res = norm2(x, inputs[0]);
+        auto tmp = res[0];
+        x = res[1];
         x = mlp({x})[0];
         x = down_proj(x);
         x = x + tmp;
@@ -7,6 +7,13 @@
 #include <Tensor.hpp>
 
 namespace mllm {
+/**
+ * \brief the i-th best token of a LinearTopK output ([batch, 1, 2, top_k]: token ids, then their logits).
+ */
+inline unsigned topKToken(Tensor &top_k, int i = 0, int batch = 0) {
+    return (unsigned)top_k.dataAt<float>(batch, 0, 0, i);
+}
+
 inline void chatPostProcessing(unsigned token_idx, Tensor &tokens_tensor, const vector<Tensor *>& clean_tensors) {
     tokens_tensor.reshape(1, 1, 1, 1);
     tokens_tensor.alloc();
@@ -161,6 +161,31 @@ string Tokenizer::detokenize(const vector<token_id_t> &tokens) {
     }
     return result;
 }
+vector<string> Tokenizer::tokenTexts() const {
+    static const string space = "\xe2\x96\x81"; // ▁
+    vector<string> texts(id_token_.size());
+    for (size_t id = 0; id < id_token_.size(); ++id) {
+        const auto &token = id_token_[id].token;
+        // the special ids are only assumed special when they look it: in Qwen's vocab 1 is '"'
+        if ((id == TokenBos || id == TokenEos || id == TokenUnk) && !token.empty() && token.front() == '<' && token.back() == '>') {
+            continue;
+        }
+        if (token.size() == 6 && token.compare(0, 3, "<0x") == 0 && token[5] == '>' && isxdigit(token[3]) && isxdigit(token[4])) {
+            texts[id] = string(1, (char)std::stoi(token.substr(3, 2), nullptr, 16));
+            continue;
+        }
+        auto &text = texts[id];
+        for (size_t i = 0; i < token.size();) {
+            if (token.compare(i, space.size(), space) == 0) {
+                text += ' ';
+                i += space.size();
+            } else {
+                text += token[i++];
+            }
+        }
+    }
+    return texts;
+}
 void Tokenizer::setSpecialToken(const string &bos, const string &eos, const string &unk, const string &nl) {
     if (!bos.empty()) {
         auto bos_token = this->vocab_map_.find(bos);
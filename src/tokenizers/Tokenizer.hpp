@@ -51,6 +51,10 @@ public:
     virtual ~Tokenizer() {}
     virtual void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) = 0;
     virtual std::string detokenize(const std::vector<token_id_t> &tokens);
+    // the text of every token id, with byte tokens (<0x0A>) as their byte and "▁" as a space;
+    // empty for <s>, </s> and <unk>. Used to match the vocab against a grammar, see JsonGrammar.
+    // LLaMATokenizer and QWenTokenizer wrap it (Qwen also decodes its bytes and blanks <|...|> tokens)
+    std::vector<std::string> tokenTexts() const;
     void setSpecialToken(const std::string &bos = "", const std::string &eos = "", const std::string &unk = "", const std::string &nl = "");
     static std::string replaceString(const std::string &str, char old_char, const std::string &new_char);
     static std::string unCapitalize(const std::string &str);
@@ -0,0 +1,211 @@
+// BatchScheduler over a stand-in model without weights: the next token of each row is its last
+// token + 1, and every forward records the rows, slots and positions the scheduler passed.
+#include "BatchScheduler.hpp"
+#include "gtest/gtest.h"
+
+using namespace mllm;
+
+namespace {
+
+struct ForwardCall {
+    vector<vector<token_id_t>> tokens;
+    int first_slot;
+    vector<int> positions;
+    vector<int> key_lengths;
+};
+
+class NextTokenModel final : public Module {
+public:
+    static constexpr int vocab = 64;
+    vector<ForwardCall> calls;
+
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto &input = inputs[0];
+        // owned by gph_ like the inputs of a Layer, so that the copies do not free it
+        Tensor::gph_.emplace(input.name(), input);
+        auto &logits = Tensor::gph_["logits"];
+        logits.setBackend(Module::backends[MLLM_CPU]);
+        logits.setName("logits");
+        logits.reshape(input.batch(), 1, input.sequence(), vocab);
+        logits.alloc();
+        if (Module::tensor_status != TENSOR_STATIC_READY) {
+            return {logits};
+        }
+        const auto &batch = Module::backends[MLLM_CPU]->sequenceBatch();
+        ForwardCall call{{}, batch.first_slot, batch.positions, batch.keyLengths(input.sequence())};
+        for (int b = 0; b < input.batch(); ++b) {
+            vector<token_id_t> row;
+            for (int s = 0; s < input.sequence(); ++s) {
+                row.push_back((token_id_t)input.dataAt<float>(b, 0, s, 0));
+                for (int v = 0; v < vocab; ++v) {
+                    logits.setDataAt<float>(b, 0, s, v, 0);
+                }
+            }
+            logits.setDataAt<float>(b, 0, input.sequence() - 1, (row.back() + 1) % vocab, 1);
+            call.tokens.push_back(row);
+        }
+        calls.push_back(call);
+        return {logits};
+    }
+};
+
+GenerationRequest request(int id, vector<token_id_t> prompt, int max_new_tokens) {
+    GenerationRequest r;
+    r.id = id;
+    r.prompt = std::move(prompt);
+    r.max_new_tokens = max_new_tokens;
+    r.eos = NextTokenModel::vocab - 1;
+    return r;
+}
+
+void expectCall(const ForwardCall &call, const vector<vector<token_id_t>> &tokens, int first_slot, const vector<int> &positions) {
+    EXPECT_EQ(call.tokens, tokens);
+    EXPECT_EQ(call.first_slot, first_slot);
+    EXPECT_EQ(call.positions, positions);
+    vector<int> key_lengths;
+    for (int p : positions) {
+        key_lengths.push_back(p + (int)tokens[0].size());
+    }
+    EXPECT_EQ(call.key_lengths, key_lengths);
+}
+
+} // namespace
+
+TEST(BatchSchedulerTest, AdmitsIntoFreeSlotsAndReusesThem) {
+    NextTokenModel model;
+    BatchScheduler scheduler(model, 2, 64);
+    scheduler.submit(request(0, {1, 2}, 2));
+    scheduler.submit(request(1, {5}, 4));
+    scheduler.submit(request(2, {9, 10, 11}, 1));
+
+    // two slots: the third request waits; each admitted prompt is prefilled, then both decode together
+    auto done = scheduler.step();
+    ASSERT_EQ(model.calls.size(), 3);
+    expectCall(model.calls[0], {{1, 2}}, 0, {0});
+    expectCall(model.calls[1], {{5}}, 1, {0});
+    expectCall(model.calls[2], {{3}, {6}}, 0, {2, 1});
+    ASSERT_EQ(done.size(), 1);
+    EXPECT_EQ(done[0].id, 0);
+    EXPECT_EQ(done[0].tokens, (vector<token_id_t>{3, 4}));
+    EXPECT_EQ(scheduler.running(), 1);
+
+    // the freed slot 0 takes the third request, which finishes in its prefill
+    done = scheduler.step();
+    ASSERT_EQ(model.calls.size(), 5);
+    expectCall(model.calls[3], {{9, 10, 11}}, 0, {0});
+    expectCall(model.calls[4], {{7}}, 1, {2});
+    ASSERT_EQ(done.size(), 1);
+    EXPECT_EQ(done[0].id, 2);
+    EXPECT_EQ(done[0].prompt_len, 3);
+    EXPECT_EQ(done[0].tokens, (vector<token_id_t>{12}));
+
+    done = scheduler.run();
+    ASSERT_EQ(done.size(), 1);
+    EXPECT_EQ(done[0].id, 1);
+    EXPECT_EQ(done[0].tokens, (vector<token_id_t>{6, 7, 8, 9}));
+    EXPECT_TRUE(scheduler.idle());
+}
+
+TEST(BatchSchedulerTest, FreeSlotRidesAlongAtPositionZero) {
+    NextTokenModel model;
+    BatchScheduler scheduler(model, 3, 64);
+    scheduler.submit(request(0, {1}, 3));
+    scheduler.submit(request(1, {20}, 1));
+    scheduler.submit(request(2, {30}, 3));
+
+    // slot 1 finishes in its prefill; the decode still runs slots 0..2 in one forward
+    auto done = scheduler.step();
+    ASSERT_EQ(model.calls.size(), 4);
+    expectCall(model.calls[3], {{2}, {0}, {31}}, 0, {1, 0, 1});
+    ASSERT_EQ(done.size(), 1);
+    EXPECT_EQ(done[0].id, 1);
+
+    done = scheduler.run();
+    ASSERT_EQ(model.calls.size(), 5);
+    expectCall(model.calls[4], {{3}, {0}, {32}}, 0, {2, 0, 2});
+    ASSERT_EQ(done.size(), 2);
+    // the ride-along row's output is dropped
+    EXPECT_EQ(done[0].tokens, (vector<token_id_t>{2, 3, 4}));
+    EXPECT_EQ(done[1].tokens, (vector<token_id_t>{31, 32, 33}));
+}
+
+TEST(BatchSchedulerTest, PrefillsInChunks) {
+    NextTokenModel model;
+    BatchScheduler scheduler(model, 1, 64);
+    scheduler.prefill_chunk = 2;
+    scheduler.submit(request(0, {1, 2, 3, 4, 5}, 2));
+
+    // the whole prompt in one step, each chunk after the ones before it; only the last is sampled
+    auto done = scheduler.run();
+    ASSERT_EQ(model.calls.size(), 4);
+    expectCall(model.calls[0], {{1, 2}}, 0, {0});
+    expectCall(model.calls[1], {{3, 4}}, 0, {2});
+    expectCall(model.calls[2], {{5}}, 0, {4});
+    expectCall(model.calls[3], {{6}}, 0, {5});
+    ASSERT_EQ(done.size(), 1);
+    EXPECT_EQ(done[0].tokens, (vector<token_id_t>{6, 7}));
+}
+
+TEST(BatchSchedulerTest, InterleavesPrefillChunksWithDecodeSteps) {
+    NextTokenModel model;
+    BatchScheduler scheduler(model, 3, 64);
+    scheduler.prefill_chunk = 2;
+    scheduler.interleave_prefill = true;
+    scheduler.submit(request(0, {1}, 10));
+    scheduler.submit(request(1, {20, 21, 22, 23, 24}, 1));
+    scheduler.submit(request(2, {30}, 10));
+
+    // one chunk of the long prompt per step; its slot rides along in the decode at the position its
+    // next chunk overwrites
+    scheduler.step();
+    ASSERT_EQ(model.calls.size(), 4);
+    expectCall(model.calls[0], {{1}}, 0, {0});
+    expectCall(model.calls[1], {{20, 21}}, 1, {0});
+    expectCall(model.calls[2], {{30}}, 2, {0});
+    expectCall(model.calls[3], {{2}, {0}, {31}}, 0, {1, 2, 1});
+
+    scheduler.step();
+    ASSERT_EQ(model.calls.size(), 6);
+    expectCall(model.calls[4], {{22, 23}}, 1, {2});
+    expectCall(model.calls[5], {{3}, {0}, {32}}, 0, {2, 4, 2});
+
+    // the last chunk gives its only token; the freed slot rides along at position 0
+    auto done = scheduler.step();
+    ASSERT_EQ(model.calls.size(), 8);
+    expectCall(model.calls[6], {{24}}, 1, {4});
+    expectCall(model.calls[7], {{4}, {0}, {33}}, 0, {3, 0, 3});
+    ASSERT_EQ(done.size(), 1);
+    EXPECT_EQ(done[0].id, 1);
+    EXPECT_EQ(done[0].tokens, (vector<token_id_t>{25}));
+}
+
+TEST(BatchSchedulerTest, RejectsPromptsThatDoNotFit) {
+    NextTokenModel model;
+    BatchScheduler scheduler(model, 1, 4);
+    scheduler.submit(request(0, {1, 2, 3, 4}, 2));
+    scheduler.submit(request(1, {}, 2));
+    auto done = scheduler.run();
+    ASSERT_EQ(done.size(), 2);
+    EXPECT_TRUE(done[0].tokens.empty());
+    EXPECT_TRUE(done[1].tokens.empty());
+    EXPECT_TRUE(model.calls.empty());
+}
+
+TEST(BatchSchedulerTest, RejectedRequestLeavesItsSlotToTheNext) {
+    NextTokenModel model;
+    BatchScheduler scheduler(model, 1, 4);
+    scheduler.submit(request(0, {}, 2));
+    scheduler.submit(request(1, {1, 2, 3, 4}, 2));
+    scheduler.submit(request(2, {7}, 1));
+
+    // both rejections and the prefill of the third request happen in the same step
+    auto done = scheduler.step();
+    ASSERT_EQ(model.calls.size(), 1);
+    expectCall(model.calls[0], {{7}}, 0, {0});
+    ASSERT_EQ(done.size(), 3);
+    EXPECT_EQ(done[0].id, 0);
+    EXPECT_EQ(done[1].id, 1);
+    EXPECT_EQ(done[2].id, 2);
+    EXPECT_EQ(done[2].tokens, (vector<token_id_t>{8}));
+    EXPECT_TRUE(scheduler.idle());
+}
@@ -0,0 +1,161 @@
+// JsonGrammar and JsonConstraint on a small synthetic vocab, no tokenizer needed.
+#include "Grammar.hpp"
+#include "Sampler.hpp"
+#include "gtest/gtest.h"
+
+using namespace mllm;
+
+namespace {
+
+// whether \p text fits the grammar from the start, and if so whether it is a complete value
+bool parses(const JsonGrammar &grammar, const std::string &text, bool *complete = nullptr) {
+    JsonState state;
+    if (!grammar.advance(state, text)) {
+        return false;
+    }
+    if (complete != nullptr) {
+        *complete = grammar.complete(state);
+    }
+    return true;
+}
+
+bool accepts(const JsonGrammar &grammar, const std::string &text) {
+    bool complete = false;
+    return parses(grammar, text, &complete) && complete;
+}
+
+JsonGrammar grammar(int max_depth = 16, int max_ws = 16) {
+    return JsonGrammar({"x"}, {0}, max_depth, max_ws);
+}
+
+// pieces of JSON and of broken JSON; the last, empty one stands for eos
+const vector<std::string> vocab = {
+    "{", "}", "[", "]", "\"", ":", ",", " ", "  ", "\n", "0", "1", "12", "-", ".", "e", "E+", "true", "tr", "ue",
+    "false", "null", "nul", "a", "\"a\"", "\"k\":", "\\", "\\n", "\\u", "00e9", "g", "},", "]}", "[{", "\"}", "1,", "", ""};
+const token_id_t eos = (token_id_t)vocab.size() - 1;
+
+bool isSet(const vector<uint64_t> &bits, token_id_t id) {
+    return id / 64 < bits.size() && (bits[id / 64] >> (id % 64) & 1);
+}
+
+} // namespace
+
+TEST(GrammarTest, AcceptsValidJson) {
+    auto json = grammar();
+    for (const std::string text : {"{}", "[]", "\"\"", "0", "-0", "12", "-1.5", "1e5", "2.5E-3", "0.0e+0", "true", "false", "null",
+                                   " {\"a\" : [1, {\"b\": null}]}", "[[[]], {}]", "{\"a\":{\"b\":{\"c\":[true,false]}}}",
+                                   "\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\\uABCD\"", "\"caf\xc3\xa9\"", "[1,\n\t2 ,3 ]"}) {
+        EXPECT_TRUE(accepts(json, text)) << text;
+    }
+}
+
+TEST(GrammarTest, RejectsInvalidJson) {
+    auto json = grammar();
+    for (const std::string text : {"{a:1}", "{'a':1}", "[1,]", "[1 2]", "{\"a\" 1}", "{\"a\":1,}", "{\"a\"}", "]", "[1]]",
+                                   "01", "1.", "1.e5", "-", "--1", "1e", "1e+", "+1", ".5", "\"\\x\"", "\"\\u12g4\"", "\"a\nb\"",
+                                   "tru", "truth", "nul l", "True", "{} ", "1 2", "[}", "{]"}) {
+        EXPECT_FALSE(accepts(json, text)) << text;
+    }
+}
+
+TEST(GrammarTest, PrefixesAreIncomplete) {
+    auto json = grammar();
+    for (const std::string text : {"", "{", "[1,", "{\"a\"", "{\"a\":", "\"abc", "\"\\u00", "-", "1.", "1e", "tr", "[[]"}) {
+        bool complete = true;
+        EXPECT_TRUE(parses(json, text, &complete)) << text;
+        EXPECT_FALSE(complete) << text;
+    }
+    // a top-level number may go on, but is a value already
+    bool complete = false;
+    EXPECT_TRUE(parses(json, "12", &complete));
+    EXPECT_TRUE(complete);
+}
+
+TEST(GrammarTest, LimitsDepth) {
+    auto json = grammar(3);
+    EXPECT_TRUE(accepts(json, "[[[]]]"));
+    EXPECT_TRUE(accepts(json, "{\"a\":[{}]}"));
+    EXPECT_FALSE(parses(json, "[[[["));
+    EXPECT_FALSE(parses(json, "{\"a\":[{\"b\":["));
+    // siblings do not add up
+    EXPECT_TRUE(accepts(json, "[[[]],[[]],[[]]]"));
+}
+
+TEST(GrammarTest, LimitsWhitespaceRuns) {
+    auto json = grammar(16, 2);
+    EXPECT_TRUE(accepts(json, "[  1,  2  ]"));
+    EXPECT_FALSE(parses(json, "[   1]"));
+    EXPECT_FALSE(parses(json, "   1"));
+    // inside a string it is text, not whitespace between tokens
+    EXPECT_TRUE(accepts(json, "\"     \""));
+}
+
+// the mask of every state met on the way through some documents is the per-token advance,
+// with eos allowed exactly when the value is complete
+TEST(GrammarTest, MaskMatchesPerTokenAdvance) {
+    JsonGrammar json(vocab, {eos}, 3, 2);
+    int states = 0;
+    for (const std::string doc : {"{\"k\": [1, -2.5e+3, true, null], \"a\": {\"b\": \"x\\n\\u00e9\"}}", "[[[]], 12, \"a\"]", "-0.5E+12",
+                                  "{\"a\" :  false}", "\"\\\\\"", "[{}, []]"}) {
+        JsonState state;
+        for (size_t i = 0; i <= doc.size(); ++i) {
+            if (i > 0) {
+                ASSERT_TRUE(json.advance(state, doc.substr(i - 1, 1))) << doc << " at " << i;
+            }
+            const auto &mask = json.mask(state);
+            for (token_id_t id = 0; id < vocab.size(); ++id) {
+                bool expected;
+                if (id == eos) {
+                    expected = json.complete(state);
+                } else {
+                    JsonState next = state;
+                    expected = !vocab[id].empty() && json.advance(next, vocab[id]);
+                }
+                EXPECT_EQ(isSet(mask, id), expected) << doc.substr(0, i) << " + token " << id << " '" << vocab[id] << "'";
+            }
+            states++;
+        }
+    }
+    EXPECT_GT(states, 100);
+    EXPECT_GT(json.cachedStates(), 20);
+}
+
+TEST(GrammarTest, ConstraintAllowsEosOnlyWhenComplete) {
+    // eos is the best token, then "[", then "]"; "[[" is past the depth limit
+    auto json = std::make_shared<JsonGrammar>(vocab, vector<token_id_t>{eos}, 1);
+    JsonConstraint constraint(json);
+    Sampler sampler;
+    sampler.setConstraint(&constraint);
+    vector<float> logits(vocab.size(), 0);
+    logits[eos] = 3;
+    logits[2] = 2;
+    logits[3] = 1;
+    EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 2);
+    EXPECT_FALSE(constraint.complete());
+    EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 3);
+    EXPECT_TRUE(constraint.complete());
+    EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), eos);
+    EXPECT_TRUE(constraint.complete());
+}
+
+TEST(GrammarTest, ConstraintEndsWithEosWhenNoTokenFits) {
+    // the empty texts are never allowed, so a complete value leaves no token of the vocab
+    const token_id_t outside = 1000;
+    auto json = std::make_shared<JsonGrammar>(vocab, vector<token_id_t>{outside});
+    JsonConstraint constraint(json);
+    Sampler sampler;
+    sampler.setConstraint(&constraint);
+    const vector<float> logits(vocab.size(), 0);
+    constraint.accept(0); // "{"
+    constraint.accept(1); // "}"
+    ASSERT_TRUE(constraint.complete());
+    EXPECT_FALSE(any_allowed(constraint.allowed(), (int)vocab.size()));
+    EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), outside);
+
+    // a token the mask did not allow ends the value as well
+    constraint.reset();
+    EXPECT_FALSE(constraint.complete());
+    constraint.accept(3); // "]"
+    EXPECT_TRUE(constraint.complete());
+    EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), outside);
+}
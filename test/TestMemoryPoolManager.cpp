@@ -88,10 +88,47 @@ void batch_allocate_but_odd_free(size_t pool_size,size_t block_size,size_t align
     printf("pass batch_allocate_but_odd_free(%ld,%ld,%ld)\n",pool_size,block_size,alignment);
 }
 
+void mixed_size_reuse_and_overflow(size_t pool_size,size_t alignment){
+    printf("mixed_size_reuse_and_overflow(%ld,%ld)\n",pool_size,alignment);
+    mllm::MemoryPoolManager manager(pool_size,alignment);
+    size_t sizes[] = {64, 4096, 100, 65536, 777, 12288, 1, 32768};
+    vector<void*> ptrs;
+    for (int round=0;round<16;round++){
+        for (auto size : sizes){
+            void* ptr = nullptr;
+            manager.alloc(&ptr,size,alignment);
+            check_alignment(ptr,alignment);
+            memset(ptr,round,size);
+            ptrs.push_back(ptr);
+        }
+        // free every other block, then everything of this round
+        for (size_t i=0;i<ptrs.size();i+=2){
+            manager.free(ptrs[i]);
+        }
+        for (size_t i=1;i<ptrs.size();i+=2){
+            manager.free(ptrs[i]);
+        }
+        ptrs.clear();
+        assert(manager.debug_allocate_blocks.empty());
+        assert(manager.debug_free_blocks.size() == 1);
+        assert(manager.debug_free_blocks.begin()->second == pool_size);
+    }
+    // requests larger than the pool fall back to the system allocator
+    void* big = nullptr;
+    manager.alloc(&big,pool_size*2,alignment);
+    assert(big != nullptr);
+    check_alignment(big,alignment);
+    memset(big,0,pool_size*2);
+    assert(manager.debug_allocate_blocks.empty());
+    manager.free(big);
+    printf("pass mixed_size_reuse_and_overflow(%ld,%ld)\n",pool_size,alignment);
+}
+
 int main(){
     batch_allocate_and_batch_free(1024*1024,256,16);
     // batch_allocate_and_batch_free(1024*1024,257,16);
     batch_allocate_but_odd_free(1024*1024,256,16);
-    
+    mixed_size_reuse_and_overflow(1024*1024,64);
+
     return 0;
 }
\ No newline at end of file
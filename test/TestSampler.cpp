@@ -0,0 +1,141 @@
+// Sampler against a fixed row of logits.
+#include "Sampler.hpp"
+#include "gtest/gtest.h"
+#include <cmath>
+#include <map>
+
+using namespace mllm;
+
+namespace {
+
+// token i has probability probs[i] at temperature 1
+const vector<float> probs = {0.4f, 0.3f, 0.15f, 0.1f, 0.05f};
+
+vector<float> logitsRow() {
+    vector<float> logits;
+    for (float p : probs) {
+        logits.push_back(std::log(p));
+    }
+    return logits;
+}
+
+// how often each token is drawn in \p n draws
+std::map<token_id_t, int> draw(SamplingParams params, int n) {
+    Sampler sampler(params);
+    const auto logits = logitsRow();
+    std::map<token_id_t, int> counts;
+    for (int i = 0; i < n; ++i) {
+        counts[sampler.sample(logits.data(), (int)logits.size())]++;
+    }
+    return counts;
+}
+
+SamplingParams sampling(uint64_t seed = 1) {
+    SamplingParams params;
+    params.temperature = 1;
+    params.seed = seed;
+    return params;
+}
+
+} // namespace
+
+TEST(SamplerTest, GreedyTakesTheFirstBest) {
+    const vector<float> logits = {0.5f, 2.0f, -1.0f, 2.0f};
+    EXPECT_EQ(Sampler::greedy(logits.data(), (int)logits.size()), 1);
+    Sampler sampler;
+    EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 1);
+}
+
+TEST(SamplerTest, SeedReproducesTheDraws) {
+    const auto logits = logitsRow();
+    Sampler a(sampling(7)), b(sampling(7)), c(sampling(8));
+    vector<token_id_t> from_a, from_b, from_c;
+    for (int i = 0; i < 200; ++i) {
+        from_a.push_back(a.sample(logits.data(), (int)logits.size()));
+        from_b.push_back(b.sample(logits.data(), (int)logits.size()));
+        from_c.push_back(c.sample(logits.data(), (int)logits.size()));
+    }
+    EXPECT_EQ(from_a, from_b);
+    EXPECT_NE(from_a, from_c);
+    // reset() starts over from the seed
+    a.reset();
+    vector<token_id_t> again;
+    for (int i = 0; i < 200; ++i) {
+        again.push_back(a.sample(logits.data(), (int)logits.size()));
+    }
+    EXPECT_EQ(from_a, again);
+}
+
+TEST(SamplerTest, SamplesInProportion) {
+    const int n = 20000;
+    const auto counts = draw(sampling(), n);
+    for (size_t i = 0; i < probs.size(); ++i) {
+        EXPECT_NEAR((double)counts.at(i) / n, probs[i], 0.02) << "token " << i;
+    }
+}
+
+TEST(SamplerTest, TopKKeepsTheKBest) {
+    auto params = sampling();
+    params.top_k = 2;
+    const int n = 4000;
+    const auto counts = draw(params, n);
+    ASSERT_EQ(counts.size(), 2);
+    // renormalized over the two left: 0.4 / 0.7
+    EXPECT_NEAR((double)counts.at(0) / n, 0.4 / 0.7, 0.03);
+    EXPECT_GT(counts.at(1), 0);
+}
+
+TEST(SamplerTest, TopPKeepsTheFewestReachingP) {
+    auto params = sampling();
+    params.top_p = 0.6f; // 0.4 + 0.3 is the first sum >= 0.6
+    auto counts = draw(params, 2000);
+    ASSERT_EQ(counts.size(), 2);
+    EXPECT_GT(counts.at(0), 0);
+    EXPECT_GT(counts.at(1), 0);
+
+    params.top_p = 0.8f; // 0.4 + 0.3 + 0.15
+    counts = draw(params, 2000);
+    EXPECT_EQ(counts.size(), 3);
+    EXPECT_EQ(counts.count(3) + counts.count(4), 0);
+}
+
+TEST(SamplerTest, MinPDropsTheUnlikely) {
+    auto params = sampling();
+    params.min_p = 0.3f; // p >= 0.3 * 0.4 = 0.12 keeps 0.4, 0.3 and 0.15
+    const auto counts = draw(params, 2000);
+    EXPECT_EQ(counts.size(), 3);
+    EXPECT_EQ(counts.count(3) + counts.count(4), 0);
+}
+
+TEST(SamplerTest, RepetitionPenaltyDemotesRecentTokens) {
+    const vector<float> logits = {2.0f, 1.9f, -1.0f, 0.5f};
+    SamplingParams params;
+    params.repetition_penalty = 1.2f;
+    {
+        // a positive logit is divided: 2.0 / 1.2 < 1.9
+        Sampler sampler(params);
+        sampler.accept({0});
+        EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 1);
+    }
+    {
+        // a negative one is multiplied: -0.45 * 1.2 < -0.5
+        const vector<float> negative = {-0.5f, -0.45f};
+        Sampler sampler(params);
+        sampler.accept({1});
+        EXPECT_EQ(sampler.sample(negative.data(), (int)negative.size()), 0);
+    }
+    {
+        // only the last penalty_last_n tokens count
+        params.penalty_last_n = 1;
+        Sampler sampler(params);
+        sampler.accept({0, 3});
+        EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 0);
+    }
+    {
+        // and the generated tokens join them
+        params.penalty_last_n = 64;
+        Sampler sampler(params);
+        EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 0);
+        EXPECT_EQ(sampler.sample(logits.data(), (int)logits.size()), 1);
+    }
+}
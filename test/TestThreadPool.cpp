@@ -0,0 +1,102 @@
+// ThreadPool::run and parallel_for: every index exactly once, nested loops on the calling thread,
+// and many dispatches in a row, spinning or parked in between.
+#include "backends/cpu/compute/Parallel.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace mllm;
+
+TEST(ThreadPoolTest, RunCoversTheRangeOnce) {
+    ThreadPool pool(3);
+    for (int n : {1, 2, 3, 4, 5, 17, 1000}) {
+        for (int thread_count : {1, 2, 4, 8}) {
+            std::vector<std::atomic<int>> hits(n);
+            std::mutex mutex;
+            std::vector<std::pair<int, int>> ranges;
+            pool.run(n, thread_count, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    hits[i]++;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                ranges.emplace_back(begin, end);
+            });
+            for (int i = 0; i < n; ++i) {
+                ASSERT_EQ(hits[i], 1) << "n " << n << " threads " << thread_count << " index " << i;
+            }
+            // one contiguous, non-empty range per part
+            EXPECT_EQ(ranges.size(), std::min({thread_count, 4, n})) << "n " << n << " threads " << thread_count;
+            std::sort(ranges.begin(), ranges.end());
+            for (size_t r = 0; r < ranges.size(); ++r) {
+                EXPECT_LT(ranges[r].first, ranges[r].second);
+                EXPECT_EQ(ranges[r].first, r == 0 ? 0 : ranges[r - 1].second);
+            }
+        }
+    }
+}
+
+TEST(ThreadPoolTest, StartsWorkersOnDemand) {
+    ThreadPool pool(5);
+    EXPECT_EQ(pool.size(), 1);
+    pool.run(100, 3, [](int, int) {});
+    EXPECT_EQ(pool.size(), 3);
+    pool.run(100, 2, [](int, int) {});
+    EXPECT_EQ(pool.size(), 3);
+    pool.run(100, 64, [](int, int) {});
+    EXPECT_EQ(pool.size(), 6);
+}
+
+TEST(ThreadPoolTest, NestedLoopsRunSerially) {
+    ThreadPool pool(3);
+    std::atomic<int> nested_calls{0}, total{0};
+    pool.run(4, 4, [&](int begin, int end) {
+        const auto outer = std::this_thread::get_id();
+        pool.run(10, 4, [&](int b, int e) {
+            EXPECT_EQ(std::this_thread::get_id(), outer);
+            EXPECT_EQ(b, 0);
+            EXPECT_EQ(e, 10);
+            nested_calls++;
+            total += e - b;
+        });
+        // parallel_for goes through the global pool, which is just as serial from inside a part
+        parallel_for(10, 4, [&](int) { total++; });
+    });
+    EXPECT_EQ(nested_calls, 4);
+    EXPECT_EQ(total, 80);
+}
+
+TEST(ThreadPoolTest, BackToBackDispatches) {
+    ThreadPool pool(3);
+    for (int spin_us : {200, 0}) {
+        pool.setSpinMicroseconds(spin_us);
+        std::atomic<int64_t> sum{0};
+        int64_t expected = 0;
+        for (int round = 0; round < 2000; ++round) {
+            // the part count changes from one dispatch to the next, so workers drop in and out
+            const int n = 1 + round % 7;
+            pool.run(n, 1 + round % 5, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    sum += round * 8 + i;
+                }
+            });
+            for (int i = 0; i < n; ++i) {
+                expected += round * 8 + i;
+            }
+        }
+        EXPECT_EQ(sum, expected) << "spin " << spin_us << " us";
+    }
+}
+
+TEST(ThreadPoolTest, ParallelForCollapsesLoops) {
+    std::vector<std::atomic<int>> hits(3 * 5 * 7);
+    parallel_for(3, 5, 7, 4, [&](int i, int j, int k) { hits[(i * 5 + j) * 7 + k]++; });
+    parallel_for(15, 7, 4, [&](int i, int j) { hits[i * 7 + j]++; });
+    parallel_for(3 * 5 * 7, 4, [&](int i) { hits[i]++; });
+    for (auto &h : hits) {
+        EXPECT_EQ(h, 3);
+    }
+    EXPECT_FALSE(cpu_pin_threads("fastest"));
+    EXPECT_FALSE(cpu_pin_threads("numa"));
+}
@@ -0,0 +1,34 @@
+// Helpers shared by the kernel micro-benchmarks in this directory.
+#ifndef MLLM_BENCHMARK_HPP
+#define MLLM_BENCHMARK_HPP
+#include "Tensor.hpp"
+#include <chrono>
+#include <functional>
+#include <random>
+
+namespace mllm {
+
+// uniform values in [-1, 1), the same for the same seed
+inline void fill(Tensor &t, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < t.count(); ++i) {
+        t.hostPtr<float>()[i] = dist(gen);
+    }
+}
+
+// mean time of one call of fn over iters calls after a warm-up call, in microseconds by default
+template <typename Period = std::micro>
+double bench(const std::function<void()> &fn, int iters) {
+    fn(); // warm up
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iters; ++i) {
+        fn();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, Period>(end - start).count() / iters;
+}
+
+} // namespace mllm
+
+#endif // MLLM_BENCHMARK_HPP
@@ -0,0 +1,90 @@
+// Micro-benchmark for the patch embedding convolutions on 224x224 inputs: ViT/CLIP (conv2d, 16x16 and
+// 14x14 patches) and ImageBind (conv3d, 2x14x14 patches over two frames).
+// usage: convBenchmark [threads]
+#include "backends/cpu/compute/Convolution.hpp"
+#include "memory/SystemMemoryManager.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "Benchmark.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mllm;
+
+// direct scalar convolution over the original weight layout, for a sanity check of the results
+static float max_conv2d_error(Tensor &in, Tensor &weight, Tensor &bias, Tensor &out, int patch) {
+    float err = 0;
+    for (int oh = 0; oh < out.head(); ++oh) {
+        for (int oc = 0; oc < out.sequence(); ++oc) {
+            for (int ow = 0; ow < out.dimension(); ++ow) {
+                double sum = bias.dataAt<float>(0, 0, 0, oc);
+                for (int ic = 0; ic < in.sequence(); ++ic) {
+                    for (int kh = 0; kh < patch; ++kh) {
+                        for (int kw = 0; kw < patch; ++kw) {
+                            sum += (double)in.dataAt<float>(0, oh * patch + kh, ic, ow * patch + kw) * weight.dataAt<float>(oc, kh, ic, kw);
+                        }
+                    }
+                }
+                err = std::max(err, (float)std::abs(sum - out.dataAt<float>(0, oh, oc, ow)));
+            }
+        }
+    }
+    return err;
+}
+
+static void run_conv2d(Backend *bn, int threads, int patch, int out_channel) {
+    const int size = 224;
+    const int grid = size / patch;
+    Tensor input(1, size, 3, size, bn, true); // [batch, height, channel, width]
+    Tensor weight(out_channel, patch, 3, patch, bn, true);
+    Tensor bias(1, 1, 1, out_channel, bn, true);
+    Tensor output(1, grid, out_channel, grid, bn, true);
+    Tensor kernel(bn);
+    Tensor workspace(bn);
+    fill(input, 1);
+    fill(weight, 2);
+    fill(bias, 3);
+    conv2d_kernel_fp32(&weight, &kernel);
+    const double t = bench<std::milli>([&] { conv2d_fp32_VALID(&input, &output, &kernel, patch, patch, true, &bias, patch, patch, threads, &workspace); }, 20);
+    printf("%-10s %-14s %10.3f   (max err %.2e)\n", "conv2d", (std::to_string(patch) + "x" + std::to_string(patch) + "->" + std::to_string(out_channel)).c_str(), t,
+           max_conv2d_error(input, weight, bias, output, patch));
+}
+
+static void run_conv3d(Backend *bn, int threads) {
+    const int size = 224;
+    const int patch = 14;
+    const int out_channel = 1280;
+    Tensor input(bn);
+    input.reshape(1, 3, 2, size, size);
+    input.alloc();
+    Tensor weight(bn);
+    weight.reshape(out_channel, 3, 2, patch, patch);
+    weight.alloc();
+    Tensor bias(bn);
+    bias.reshape(1, 1, 1, 1, out_channel);
+    bias.alloc();
+    Tensor output(bn);
+    output.reshape(1, out_channel, 1, size / patch, size / patch);
+    output.alloc();
+    Tensor kernel(bn);
+    Tensor workspace(bn);
+    fill(input, 4);
+    fill(weight, 5);
+    fill(bias, 6);
+    conv3d_kernel_fp32(&weight, &kernel);
+    const double t = bench<std::milli>([&] { conv3d_fp32_VALID(&input, &output, &kernel, 2, patch, patch, true, &bias, 2, patch, patch, threads, &workspace); }, 20);
+    printf("%-10s %-14s %10.3f\n", "conv3d", "2x14x14->1280", t);
+}
+
+int main(int argc, char **argv) {
+    const int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    std::shared_ptr<MemoryManager> mm(new SystemMemoryManager());
+    Backend *bn = new CPUBackend(mm);
+    printf("threads=%d input=224x224\n", threads);
+    printf("%-10s %-14s %10s\n", "op", "patch", "ms/call");
+    run_conv2d(bn, threads, 16, 768);
+    run_conv2d(bn, threads, 14, 1024);
+    run_conv3d(bn, threads);
+    delete bn;
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Micro-benchmark for the RMSNorm/LayerNorm kernels at decode (seq=1) and prefill (seq=512) shapes.
+// usage: normBenchmark [threads] [dim]
+#include "backends/cpu/compute/Norm.hpp"
+#include "memory/SystemMemoryManager.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "Benchmark.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mllm;
+
+// scalar reference, for a sanity check of the vectorized results
+static float max_rmsnorm_error(Tensor &in, Tensor &out, Tensor &w, float eps) {
+    const int dim = in.dimension();
+    float err = 0;
+    for (int s = 0; s < in.sequence(); ++s) {
+        double sum_squares = 0;
+        for (int d = 0; d < dim; ++d) {
+            sum_squares += (double)in.dataAt<float>(0, 0, s, d) * in.dataAt<float>(0, 0, s, d);
+        }
+        const float rms = 1.0f / std::sqrt(sum_squares / dim + eps);
+        for (int d = 0; d < dim; ++d) {
+            err = std::max(err, std::abs(out.dataAt<float>(0, 0, s, d) - in.dataAt<float>(0, 0, s, d) * rms * w.dataAt<float>(0, 0, 0, d)));
+        }
+    }
+    return err;
+}
+
+static void run(Backend *bn, int threads, int dim) {
+    Tensor weight(1, 1, 1, dim, bn, true);
+    Tensor bias(1, 1, 1, dim, bn, true);
+    fill(weight, 1);
+    fill(bias, 2);
+    printf("threads=%d dim=%d\n", threads, dim);
+    printf("%-8s %-16s %12s\n", "seq", "kernel", "us/call");
+    for (int seq : {1, 512}) {
+        const int iters = seq == 1 ? 20000 : 200;
+        Tensor input(1, 1, seq, dim, bn, true);
+        Tensor residual(1, 1, seq, dim, bn, true);
+        Tensor sum(1, 1, seq, dim, bn, true);
+        Tensor output(1, 1, seq, dim, bn, true);
+        fill(input, 3);
+        fill(residual, 4);
+        double t = bench([&] { rmsnorm_fp32(&input, nullptr, nullptr, &output, &weight, 1e-6, false, threads); }, iters);
+        printf("%-8d %-16s %12.2f   (max err %.2e)\n", seq, "rmsnorm", t, max_rmsnorm_error(input, output, weight, 1e-6));
+        t = bench([&] { rmsnorm_fp32(&input, &residual, &sum, &output, &weight, 1e-6, false, threads); }, iters);
+        printf("%-8d %-16s %12.2f\n", seq, "add+rmsnorm", t);
+        t = bench([&] { layernorm_fp32(&input, nullptr, nullptr, &output, &weight, &bias, 1e-6, threads); }, iters);
+        printf("%-8d %-16s %12.2f\n", seq, "layernorm", t);
+        t = bench([&] { layernorm_fp32(&input, &residual, &sum, &output, &weight, &bias, 1e-6, threads); }, iters);
+        printf("%-8d %-16s %12.2f\n", seq, "add+layernorm", t);
+    }
+}
+
+int main(int argc, char **argv) {
+    const int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    const int dim = argc > 2 ? std::atoi(argv[2]) : 4096;
+    std::shared_ptr<MemoryManager> mm(new SystemMemoryManager());
+    Backend *bn = new CPUBackend(mm);
+    run(bn, threads, dim);
+    delete bn;
+    return 0;
+}
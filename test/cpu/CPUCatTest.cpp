@@ -0,0 +1,133 @@
+// cat_bind_inputs + cat_copy_inputs against the same concat gathered element by element: inputs whose
+// slice of the output is contiguous are bound, the others (and broadcast or view inputs) are copied.
+#include "CPUTest.hpp"
+#include "backends/cpu/compute/Cat.hpp"
+#include <random>
+
+namespace {
+
+void fillRandom(Tensor &t, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int n = 0; n < t.batch(); ++n) {
+        for (int h = 0; h < t.head(); ++h) {
+            for (int s = 0; s < t.sequence(); ++s) {
+                for (int d = 0; d < t.dimension(); ++d) {
+                    t.setDataAt<float>(n, h, s, d, dist(gen));
+                }
+            }
+        }
+    }
+}
+
+int axisSize(Tensor &t, Chl axis) {
+    switch (axis) {
+    case BATCH: return t.batch();
+    case HEAD: return t.head();
+    case SEQUENCE: return t.sequence();
+    default: return t.dimension();
+    }
+}
+
+shared_ptr<Tensor> input(Backend *bn, int batch, int head, int seq, int dim, int seed) {
+    auto t = std::make_shared<Tensor>(batch, head, seq, dim, bn, true);
+    fillRandom(*t, seed);
+    return t;
+}
+
+// shape the output as CPUCat does and plan it; after the inputs' producers have written them and the
+// rest is copied, it must hold the inputs one after the other, batch-1 inputs repeated over the batch
+void expectCat(Backend *bn, const vector<shared_ptr<Tensor>> &inputs, Chl axis, const vector<bool> &bound) {
+    int batch = 0, total = 0;
+    for (auto &t : inputs) {
+        batch = axis == BATCH ? batch + t->batch() : std::max(batch, t->batch());
+        total += axisSize(*t, axis);
+    }
+    auto &first = *inputs[0];
+    Tensor output(batch, axis == HEAD ? total : first.head(), axis == SEQUENCE ? total : first.sequence(),
+                  axis == DIMENSION ? total : first.dimension(), bn, true);
+    Tensor expected(output.batch(), output.head(), output.sequence(), output.dimension(), bn, true);
+    vector<Tensor *> ins;
+    vector<vector<float>> values;
+    vector<int> offset = {0, 0, 0, 0};
+    const int index = axis == BATCH ? 0 : axis == HEAD ? 1 : axis == SEQUENCE ? 2 : 3;
+    for (auto &t : inputs) {
+        ins.push_back(t.get());
+        values.emplace_back();
+        for (int n = 0; n < (axis == BATCH ? t->batch() : batch); ++n) {
+            for (int h = 0; h < t->head(); ++h) {
+                for (int s = 0; s < t->sequence(); ++s) {
+                    for (int d = 0; d < t->dimension(); ++d) {
+                        const float v = t->dataAt<float>(t->batch() == 1 ? 0 : n, h, s, d);
+                        expected.setDataAt<float>(n + offset[0], h + offset[1], s + offset[2], d + offset[3], v);
+                        if (n < t->batch()) {
+                            values.back().push_back(v);
+                        }
+                    }
+                }
+            }
+        }
+        offset[index] += axisSize(*t, axis);
+    }
+    cat_bind_inputs(ins, &output, axis);
+    for (size_t i = 0; i < ins.size(); ++i) {
+        EXPECT_EQ(ins[i]->masterTensor() == &output, bound[i]) << "input " << i;
+        // the producer runs after the plan, into whatever memory the input has now
+        auto *t = ins[i];
+        int j = 0;
+        for (int n = 0; n < t->batch(); ++n) {
+            for (int h = 0; h < t->head(); ++h) {
+                for (int s = 0; s < t->sequence(); ++s) {
+                    for (int d = 0; d < t->dimension(); ++d) {
+                        t->setDataAt<float>(n, h, s, d, values[i][j++]);
+                    }
+                }
+            }
+        }
+    }
+    cat_copy_inputs(ins, &output, axis, 3);
+    for (int i = 0; i < output.count(); ++i) {
+        ASSERT_EQ(output.hostPtr<float>()[i], expected.hostPtr<float>()[i]) << "element " << i;
+    }
+}
+
+} // namespace
+
+TEST_F(CPUTest, CPUCatSequence) {
+    // batch 1: every slice is a block of whole rows
+    expectCat(bn_, {input(bn_, 1, 2, 3, 8, 1), input(bn_, 1, 2, 1, 8, 2), input(bn_, 1, 2, 4, 8, 3)}, SEQUENCE,
+              {true, true, true});
+    // batch 2: each slice is split over the batches
+    expectCat(bn_, {input(bn_, 2, 2, 3, 8, 4), input(bn_, 2, 2, 1, 8, 5)}, SEQUENCE, {false, false});
+}
+
+TEST_F(CPUTest, CPUCatDimension) {
+    // a single row: the slices are contiguous
+    expectCat(bn_, {input(bn_, 1, 1, 1, 5, 6), input(bn_, 1, 1, 1, 12, 7)}, DIMENSION, {true, true});
+    // several rows or heads: every row has a piece of each input
+    expectCat(bn_, {input(bn_, 1, 1, 3, 5, 8), input(bn_, 1, 1, 3, 12, 9)}, DIMENSION, {false, false});
+    expectCat(bn_, {input(bn_, 1, 2, 1, 5, 10), input(bn_, 1, 2, 1, 12, 11)}, DIMENSION, {false, false});
+}
+
+TEST_F(CPUTest, CPUCatBatch) {
+    // a slice holds fewer batches than the output, which a ChildTensor cannot express
+    expectCat(bn_, {input(bn_, 1, 2, 3, 8, 12), input(bn_, 2, 2, 3, 8, 13)}, BATCH, {false, false});
+}
+
+TEST_F(CPUTest, CPUCatBroadcastsBatchOne) {
+    expectCat(bn_, {input(bn_, 1, 2, 3, 8, 14), input(bn_, 2, 2, 1, 8, 15)}, SEQUENCE, {false, false});
+    expectCat(bn_, {input(bn_, 2, 1, 3, 5, 16), input(bn_, 1, 1, 3, 12, 17)}, DIMENSION, {false, false});
+}
+
+TEST_F(CPUTest, CPUCatKeepsParameterOnItsWeight) {
+    // a Parameter's output is a view of the weight it holds (see CPUParameter::setUp)
+    Tensor weight(1, 1, 2, 8, bn_, true);
+    fillRandom(weight, 18);
+    const vector<float> loaded(weight.hostPtr<float>(), weight.hostPtr<float>() + weight.count());
+    auto parameter = std::make_shared<Tensor>(bn_);
+    parameter->reshape(1, 1, 2, 8);
+    parameter->deepCopyFrom(&weight, false);
+    expectCat(bn_, {parameter, input(bn_, 1, 1, 3, 8, 19)}, SEQUENCE, {false, true});
+    EXPECT_EQ(parameter->masterTensor(), &weight);
+    EXPECT_EQ(vector<float>(weight.hostPtr<float>(), weight.hostPtr<float>() + weight.count()), loaded);
+}
@@ -17,4 +17,84 @@ TEST_F(CPUTest, CPUEmbedding1) {
     op->load(loader);
     op->execute({input0}, {output});
     COMPARE_TENSOR(p_output.get(), output.get(), true);
-}
\ No newline at end of file
+}
+#include "backends/cpu/compute/Embedding.hpp"
+#include "backends/cpu/quantize/QuantizeQ4.hpp"
+#include "backends/cpu/quantize/QuantizeQ6.hpp"
+#include "backends/cpu/quantize/QuantizeQ8.hpp"
+#include <random>
+
+// embedding_fp32 against dequantize_row_* for every table type, with the ids as I32 and as F32 and
+// ids repeated within and across the batch rows
+TEST_F(CPUTest, CPUEmbeddingQuantizedTables) {
+    const int vocab = 10, hidden = 256, batch = 2, seq = 4;
+    const vector<int> tokens = {3, 7, 3, 0, 9, 7, 7, 3};
+    Tensor table(1, 1, vocab, hidden, bn_, true);
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < table.count(); ++i) {
+        table.hostPtr<float>()[i] = dist(gen);
+    }
+    Tensor ids_f32(batch, 1, seq, 1, bn_, true), ids_i32(batch, 1, seq, 1, bn_, false);
+    ids_i32.setDtype(MLLM_TYPE_I32);
+    ids_i32.alloc();
+    for (int b = 0; b < batch; ++b) {
+        for (int s = 0; s < seq; ++s) {
+            ids_f32.setDataAt<float>(b, 0, s, 0, tokens[b * seq + s]);
+            *ids_i32.ptrAt<int32_t>(b, 0, s, 0) = tokens[b * seq + s];
+        }
+    }
+    for (auto dtype : {MLLM_TYPE_F32, MLLM_TYPE_F16, MLLM_TYPE_Q4_0, MLLM_TYPE_Q4_K, MLLM_TYPE_Q6_K, MLLM_TYPE_Q8_0, MLLM_TYPE_Q8_K}) {
+        Tensor weight(1, 1, vocab, hidden, bn_, false);
+        weight.setDtype(dtype);
+        weight.alloc();
+        vector<float> expected(vocab * hidden);
+        for (int r = 0; r < vocab; ++r) {
+            const float *x = table.hostPtr<float>() + r * hidden;
+            char *row = weight.hostPtr<char>() + r * DataTypeSize(dtype, hidden);
+            float *y = expected.data() + r * hidden;
+            switch (dtype) {
+            case MLLM_TYPE_F32:
+                memcpy(row, x, hidden * sizeof(float));
+                memcpy(y, x, hidden * sizeof(float));
+                break;
+            case MLLM_TYPE_F16:
+                mllm_fp32_to_fp16_row(x, (mllm_fp16_t *)row, hidden);
+                mllm_fp16_to_fp32_row((mllm_fp16_t *)row, y, hidden);
+                break;
+            case MLLM_TYPE_Q4_0:
+                quantize_row_q4_0(x, row, hidden);
+                dequantize_row_q4_0(row, y, hidden);
+                break;
+            case MLLM_TYPE_Q4_K:
+                quantize_row_q4_K(x, row, hidden);
+                dequantize_row_q4_K((block_q4_K *)row, y, hidden);
+                break;
+            case MLLM_TYPE_Q6_K:
+                quantize_row_q6_K(x, row, hidden);
+                dequantize_row_q6_K((block_q6_K *)row, y, hidden);
+                break;
+            case MLLM_TYPE_Q8_0:
+                quantize_row_q8_0(x, row, hidden);
+                dequantize_row_q8_0(row, y, hidden);
+                break;
+            default:
+                quantize_row_q8_K(x, row, hidden);
+                dequantize_row_q8_K((block_q8_K *)row, y, hidden);
+                break;
+            }
+        }
+        for (auto *ids : {&ids_f32, &ids_i32}) {
+            Tensor output(batch, 1, seq, hidden, bn_, true);
+            embedding_fp32(&weight, ids, &output, 3);
+            for (int b = 0; b < batch; ++b) {
+                for (int s = 0; s < seq; ++s) {
+                    for (int d = 0; d < hidden; ++d) {
+                        ASSERT_EQ(output.dataAt<float>(b, 0, s, d), expected[tokens[b * seq + s] * hidden + d])
+                            << DataTypeName(dtype) << " ids " << DataTypeName(ids->dtype()) << " b " << b << " s " << s << " d " << d;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+// Module::planInplace over small weightless modules: which outputs are written over their input,
+// and the outputs of the in-place run against the same module with Module::inplace off.
+#include "CPUTest.hpp"
+#include "Layer.hpp"
+#include "Module.hpp"
+#include <map>
+#include <random>
+
+namespace {
+
+void fillRandom(Tensor &t, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < t.count(); ++i) {
+        t.hostPtr<float>()[i] = dist(gen);
+    }
+}
+
+// a = silu(x); c = silu(2a); outputs relu(c + a) and c: a is read twice and c is returned, so
+// only 2a -> c and c + a -> relu run in place
+class ChainNet final : public Module {
+    SiLU act1, act2;
+    ReLU act3;
+
+public:
+    ChainNet() :
+        act1("inplace.chain.act1"), act2("inplace.chain.act2"), act3("inplace.chain.act3") {
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto a = act1(inputs[0]);
+        auto b = a * 2.0f;
+        auto c = act2(b);
+        auto d = c + a;
+        auto e = act3(d);
+        return {e, c};
+    }
+};
+
+// ops reading a view or a Cat, whose memory is also reachable under another name
+class ViewNet final : public Module {
+    SiLU act1, act2, act3, act4, act5, act6;
+
+public:
+    ViewNet() :
+        act1("inplace.view.act1"), act2("inplace.view.act2"), act3("inplace.view.act3"), act4("inplace.view.act4"),
+        act5("inplace.view.act5"), act6("inplace.view.act6") {
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto v = act1(inputs[0]).view(-1, 2, -1, 8);
+        auto f = act2(v).view(-1, 1, -1, 16);
+        auto h = act3(f);
+        auto k = Tensor::cat({act4(inputs[0]), act5(inputs[0])}, SEQUENCE);
+        auto m = act6(k) * 2.0f;
+        return {h, m};
+    }
+};
+
+Tensor input(const string &name, int seq, int seed) {
+    Tensor x(1, 1, seq, 16, Module::backends[MLLM_CPU], true);
+    x.setName(name);
+    x.setTtype(INPUT_TENSOR);
+    fillRandom(x, seed);
+    return x;
+}
+
+vector<vector<float>> run(Module &net, const string &name, int seq, int seed) {
+    auto outputs = net({input(name, seq, seed)});
+    vector<vector<float>> values;
+    for (auto &t : outputs) {
+        values.emplace_back(t.hostPtr<float>(), t.hostPtr<float>() + t.count());
+    }
+    return values;
+}
+
+vector<vector<float>> reference(Module &net, const string &name, int seq, int seed) {
+    Module::inplace = false;
+    auto values = run(net, name, seq, seed);
+    Module::inplace = true;
+    return values;
+}
+
+// output name -> the name of the input it is written over, for the tensors of one module
+std::map<string, string> aliases(const string &prefix) {
+    std::map<string, string> found;
+    for (auto &t : Tensor::gph_) {
+        if (t.first.rfind(prefix, 0) == 0 && t.second.aliasSource() != nullptr) {
+            found[t.first] = t.second.aliasSource()->name();
+        }
+    }
+    return found;
+}
+
+} // namespace
+
+TEST_F(CPUTest, InplaceSkipsInputsReadAgainAndReturnedOutputs) {
+    Module::initBackend(MLLM_CPU);
+    ChainNet net;
+    for (int seq : {3, 1}) {
+        const auto expected = reference(net, "inplace.chain.x", seq, seq);
+        EXPECT_TRUE(aliases("out-inplace.chain").empty());
+        const auto values = run(net, "inplace.chain.x", seq, seq);
+        EXPECT_EQ(values, expected);
+        const std::map<string, string> planned = {
+            {"out-inplace.chain.act2", "out-inplace.chain.act1-mul"},
+            {"out-inplace.chain.act3", "out-inplace.chain.act2-TTadd"},
+        };
+        EXPECT_EQ(aliases("out-inplace.chain"), planned);
+    }
+}
+
+TEST_F(CPUTest, InplaceSkipsViewsAndCats) {
+    Module::initBackend(MLLM_CPU);
+    ViewNet net;
+    const auto expected = reference(net, "inplace.view.x", 3, 7);
+    const auto values = run(net, "inplace.view.x", 3, 7);
+    EXPECT_EQ(values, expected);
+    const auto planned = aliases("out-inplace.view");
+    // only the plain silu output before the last multiply qualifies
+    EXPECT_EQ(planned.size(), 1);
+    EXPECT_EQ(planned.count("out-inplace.view.act6-mul"), 1);
+    for (const auto &a : planned) {
+        for (auto *t : {&Tensor::gph_[a.first], &Tensor::gph_[a.second]}) {
+            EXPECT_EQ(t->masterTensor(), nullptr) << t->name();
+            EXPECT_TRUE(t->childTensors().empty()) << t->name();
+            EXPECT_FALSE(t->aggregated()) << t->name();
+        }
+    }
+}
+
+TEST_F(CPUTest, InplacePlanIsKeptUntilTheShapesChange) {
+    Module::initBackend(MLLM_CPU);
+    ChainNet net;
+    const auto same = reference(net, "inplace.chain.x", 4, 2);
+    const auto longer = reference(net, "inplace.chain.x", 6, 3);
+    run(net, "inplace.chain.x", 4, 1);
+    auto &c = Tensor::gph_["out-inplace.chain.act2"];
+    ASSERT_NE(c.aliasSource(), nullptr);
+    // dropped behind the planner's back: a pass of the same shapes keeps the plan as it was
+    c.unalias();
+    c.alloc();
+    EXPECT_EQ(run(net, "inplace.chain.x", 4, 2), same);
+    EXPECT_EQ(c.aliasSource(), nullptr);
+    // new shapes plan again
+    EXPECT_EQ(run(net, "inplace.chain.x", 6, 3), longer);
+    EXPECT_NE(c.aliasSource(), nullptr);
+}
@@ -49,4 +49,101 @@ TEST_F(CPUTest, CPULinear2) {
 //     //    TEST_LOAD(&op->bias_());
 //     TEST_EXCUTE({input0}, {test_output});
 //     COMPARE_TENSOR(output.get(), test_output.get());
-// }
\ No newline at end of file
+// }
+#include "backends/cpu/quantize/QuantizeQ4.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+void fillRandom(Tensor &t, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < t.count(); ++i) {
+        t.hostPtr<float>()[i] = dist(gen);
+    }
+}
+
+// random rows, except that the columns in \p tied share one row (and bias) that scores high on
+// \p x, so they tie near the top
+void setWeights(CPULinear &linear, DataType dtype, bool bias, int in, int out, const vector<int> &tied, const float *x) {
+    Tensor w(1, 1, out, in, linear.backend(), true);
+    fillRandom(w, out);
+    for (int n : tied) {
+        for (int k = 0; k < in; ++k) {
+            w.hostPtr<float>()[n * in + k] = 0.5f * x[k];
+        }
+    }
+    auto &weight = linear.weight();
+    weight.reshape(1, 1, out, in);
+    weight.setDtype(dtype);
+    weight.alloc();
+    if (dtype == MLLM_TYPE_Q4_0) {
+        for (int n = 0; n < out; ++n) {
+            quantize_row_q4_0(w.hostPtr<float>() + n * in, weight.hostPtr<char>() + n * DataTypeSize(dtype, in), in);
+        }
+    } else {
+        memcpy(weight.hostPtr<float>(), w.hostPtr<float>(), w.cntSize());
+    }
+    if (bias) {
+        linear.bias().reshape(1, 1, 1, out);
+        linear.bias().alloc();
+        fillRandom(linear.bias(), out + 1);
+        for (int n : tied) {
+            linear.bias().hostPtr<float>()[n] = 0.25f;
+        }
+    }
+}
+
+} // namespace
+
+// the top-k Linear against the full Linear followed by a partial_sort, best first and ties to the
+// lower column; N = 1003 does not split evenly over the threads, so the chunks' heaps are uneven
+TEST_F(CPUTest, CPULinearTopKMatchesPartialSort) {
+    const int in = 64, out = 1003, seq = 3, threads = 4;
+    const vector<int> tied = {7, 500, 501, 1002};
+    for (auto dtype : {MLLM_TYPE_F32, MLLM_TYPE_Q4_0}) {
+        for (bool bias : {false, true}) {
+            for (int k : {1, 5, 400}) {
+                SCOPED_TRACE(std::string(DataTypeName(dtype)) + (bias ? " bias" : "") + " k " + std::to_string(k));
+                // only the last row is projected: the others are NaN, which would reach every id
+                auto x = std::make_shared<Tensor>(1, 1, seq, in, bn_, true);
+                fillRandom(*x, 1);
+                std::fill(x->hostPtr<float>(), x->hostPtr<float>() + (seq - 1) * in, NAN);
+                auto last = std::make_shared<Tensor>(1, 1, 1, in, bn_, true);
+                memcpy(last->hostPtr<float>(), x->ptrAt<float>(0, 0, seq - 1, 0), in * sizeof(float));
+                CPULinear full(bn_, "full", in, out, bias, threads);
+                CPULinear top(bn_, "top", in, out, bias, threads, k);
+                setWeights(full, dtype, bias, in, out, tied, last->hostPtr<float>());
+                setWeights(top, dtype, bias, in, out, tied, last->hostPtr<float>());
+                auto logits = std::make_shared<Tensor>(bn_), best = std::make_shared<Tensor>(bn_);
+                full.reshape({last}, {logits});
+                full.setUp({last}, {logits});
+                full.execute({last}, {logits});
+                bn_->advanceEpoch();
+                top.reshape({x}, {best});
+                top.setUp({x}, {best});
+                top.execute({x}, {best});
+                bn_->advanceEpoch();
+                ASSERT_EQ(best->sequence(), 2);
+                ASSERT_EQ(best->dimension(), k);
+                vector<std::pair<float, int>> expected;
+                for (int n = 0; n < out; ++n) {
+                    expected.emplace_back(logits->dataAt<float>(0, 0, 0, n), n);
+                }
+                std::partial_sort(expected.begin(), expected.begin() + k, expected.end(), [](const auto &a, const auto &b) {
+                    return a.first > b.first || (a.first == b.first && a.second < b.second);
+                });
+                // the tied columns lead, in column order
+                for (int i = 0; i < std::min(k, (int)tied.size()); ++i) {
+                    ASSERT_EQ(expected[i].second, tied[i]);
+                }
+                for (int i = 0; i < k; ++i) {
+                    ASSERT_EQ((int)best->dataAt<float>(0, 0, 0, i), expected[i].second) << "rank " << i;
+                    ASSERT_NEAR(best->dataAt<float>(0, 0, 1, i), expected[i].first, 1e-4) << "rank " << i;
+                }
+            }
+        }
+    }
+}
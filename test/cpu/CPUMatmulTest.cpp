@@ -51,4 +51,120 @@ TEST_F(CPUTest, CPUMatmul1) {
 //     TEST_EXCUTE({input0, input1}, {c_output});
 ////     c_output->printData<float>();
 //     COMPARE_TENSOR(c_output.get(), output.get(), true);
-// }
\ No newline at end of file
+// }
+#include "backends/cpu/compute/Matmul.hpp"
+#include <random>
+
+namespace {
+
+void fillRandom(Tensor &t, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < t.count(); ++i) {
+        t.hostPtr<float>()[i] = dist(gen);
+    }
+}
+
+// round t to values F16 can represent, and store them in t16 as F16
+void roundToFp16(Tensor &t, Tensor &t16) {
+    t16.setDtype(MLLM_TYPE_F16);
+    t16.reshape(t.batch(), t.head(), t.sequence(), t.dimension());
+    t16.alloc();
+    for (int i = 0; i < t.count(); ++i) {
+        t16.hostPtr<mllm_fp16_t>()[i] = MLLM_FP32_TO_FP16(t.hostPtr<float>()[i]);
+        t.hostPtr<float>()[i] = MLLM_FP16_TO_FP32(t16.hostPtr<mllm_fp16_t>()[i]);
+    }
+}
+
+// t read as its transpose over SEQUENCE and DIMENSION, as Tensor::transpose leaves it: K stored
+// (batch, sequence, head, dimension) becomes a BDHS K^T
+void transposeView(Tensor &t) {
+    std::swap(t.chls()[SEQUENCE], t.chls()[DIMENSION]);
+    t.changeCtype();
+}
+
+// dst = src0 x src1 through dataAt, with the same causal window as mat_mul_fp32; -1 where it computes nothing
+void naiveMatmul(Tensor &src0, Tensor &src1, CausalMMType causal, Tensor &dst) {
+    const int M = src0.sequence(), K = src0.dimension(), N = src1.dimension();
+    dst.reshape(src0.batch(), src0.head(), M, N);
+    dst.alloc();
+    for (int b = 0; b < src0.batch(); ++b) {
+        for (int h = 0; h < src0.head(); ++h) {
+            for (int m = 0; m < M; ++m) {
+                const int keys = causal == CAUSAL_MM_INPUT0 ? m + K - M + 1 : K;
+                const int columns = causal == CAUSAL_MM_OUTPUT ? m + N - M + 1 : N;
+                for (int n = 0; n < N; ++n) {
+                    float sum = 0;
+                    for (int k = 0; k < keys; ++k) {
+                        sum += src0.dataAt<float>(b, h, m, k) * src1.dataAt<float>(b, h, k, n);
+                    }
+                    dst.setDataAt<float>(b, h, m, n, n < columns ? sum : -1);
+                }
+            }
+        }
+    }
+}
+
+void expectNear(Tensor &out, Tensor &expected, float tolerance) {
+    for (int b = 0; b < out.batch(); ++b) {
+        for (int h = 0; h < out.head(); ++h) {
+            for (int m = 0; m < out.sequence(); ++m) {
+                for (int n = 0; n < out.dimension(); ++n) {
+                    if (expected.dataAt<float>(b, h, m, n) != -1) {
+                        ASSERT_NEAR(out.dataAt<float>(b, h, m, n), expected.dataAt<float>(b, h, m, n), tolerance)
+                            << "b " << b << " h " << h << " m " << m << " n " << n;
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+// P x V with V in (batch, sequence, head, dimension) order, which goes through mat_mul_rows and
+// vec_mad; N = 37 leaves a remainder after the MLLM_F32_STEP / MLLM_F16_STEP loops
+TEST_F(CPUTest, CPUMatmulVAlongNMatchesNaive) {
+    const int M = 3, T = 21;
+    for (int N : {37, 2 * MLLM_F16_STEP}) {
+        for (auto causal : {CAUSAL_MM_NONE, CAUSAL_MM_INPUT0}) {
+            Tensor p(2, 2, M, T, bn_, true), v(2, 2, T, N, bn_, true), out(2, 2, M, N, bn_, true);
+            Tensor v16(bn_), expected(bn_);
+            fillRandom(p, N);
+            fillRandom(v, N + 1);
+            roundToFp16(v, v16);
+            naiveMatmul(p, v, causal, expected);
+            SCOPED_TRACE("N " + std::to_string(N) + " causal " + std::to_string(causal));
+            mat_mul_fp32(&p, &v, &out, false, nullptr, false, false, 3, causal);
+            expectNear(out, expected, 1e-4);
+            mat_mul_fp32_fp16(&p, &v16, &out, false, nullptr, false, false, 3, nullptr, causal);
+            expectNear(out, expected, 1e-4);
+        }
+    }
+}
+
+// Q x K^T with K^T a BDHS view of a K stored (batch, sequence, head, dimension), the vec_dot path
+TEST_F(CPUTest, CPUMatmulTransposedKMatchesNaive) {
+    const int M = 5, T = 19;
+    for (int D : {37, 2 * MLLM_F16_STEP}) {
+        for (auto causal : {CAUSAL_MM_NONE, CAUSAL_MM_OUTPUT}) {
+            Tensor q(1, 2, M, D, bn_, true), k(1, 2, T, D, bn_, true), out(1, 2, M, T, bn_, true);
+            Tensor k16(bn_), expected(bn_);
+            fillRandom(q, D);
+            fillRandom(k, D + 1);
+            roundToFp16(k, k16);
+            transposeView(k);
+            transposeView(k16);
+            ASSERT_EQ(k.ctype(), BDHS);
+            ASSERT_EQ(k.sequence(), D);
+            ASSERT_EQ(k.dimension(), T);
+            naiveMatmul(q, k, causal, expected);
+            SCOPED_TRACE("D " + std::to_string(D) + " causal " + std::to_string(causal));
+            mat_mul_fp32(&q, &k, &out, false, nullptr, false, false, 3, causal);
+            expectNear(out, expected, 1e-4);
+            // Q is converted to F16 for the dot products
+            mat_mul_fp32_fp16(&q, &k16, &out, false, nullptr, false, false, 3, nullptr, causal);
+            expectNear(out, expected, 2e-2);
+        }
+    }
+}
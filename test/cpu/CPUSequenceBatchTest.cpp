@@ -0,0 +1,176 @@
+// The kernels a SequenceBatch reaches, each row of a batch at its own position, against the same
+// kernel run on that row alone.
+#include "CPUTest.hpp"
+#include "backends/cpu/compute/Matmul.hpp"
+#include "backends/cpu/compute/RoPE.hpp"
+#include "backends/cpu/compute/Softmax.hpp"
+#include <functional>
+#include <random>
+
+static void fillRandom(Tensor &t, int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int i = 0; i < t.count(); ++i) {
+        t.hostPtr<float>()[i] = dist(gen);
+    }
+}
+
+// batch row n of src, its first sequence x dimension entries
+template <typename T = float>
+static void copyRow(Tensor &src, int n, Tensor &dst) {
+    for (int h = 0; h < dst.head(); ++h) {
+        for (int s = 0; s < dst.sequence(); ++s) {
+            for (int d = 0; d < dst.dimension(); ++d) {
+                dst.setDataAt<T>(0, h, s, d, src.dataAt<T>(n, h, s, d));
+            }
+        }
+    }
+}
+
+// the first \p cols(s) entries of each row [h, s] of single, all of them by default
+static void expectRow(Tensor &batched, int n, Tensor &single, const std::function<int(int)> &cols = nullptr) {
+    for (int h = 0; h < single.head(); ++h) {
+        for (int s = 0; s < single.sequence(); ++s) {
+            const int dims = cols ? cols(s) : single.dimension();
+            for (int d = 0; d < dims; ++d) {
+                ASSERT_NEAR(batched.dataAt<float>(n, h, s, d), single.dataAt<float>(0, h, s, d), 1e-5)
+                    << "row " << n << " [" << h << ", " << s << ", " << d << "]";
+            }
+        }
+    }
+}
+
+TEST_F(CPUTest, SequenceBatchRoPE) {
+    const int batch = 3, heads = 2, seq = 2, dim = 16;
+    const vector<int> positions = {0, 7, 3};
+    auto table = rope_table(HFHUBROPE, dim, 10000, 64);
+    Tensor input(batch, heads, seq, dim, bn_, true);
+    Tensor output(batch, heads, seq, dim, bn_, true);
+    fillRandom(input, 1);
+    rope_fp32(&input, &output, *table, positions, 2);
+    for (int n = 0; n < batch; ++n) {
+        Tensor row(1, heads, seq, dim, bn_, true);
+        Tensor row_out(1, heads, seq, dim, bn_, true);
+        copyRow(input, n, row);
+        rope_fp32(&row, &row_out, *table, positions[n], 2);
+        expectRow(output, n, row_out);
+    }
+}
+
+TEST_F(CPUTest, SequenceBatchRoPEHeads) {
+    const int batch = 3, heads = 2, seq = 2, head_dim = 16;
+    const vector<int> positions = {5, 0, 11};
+    auto table = rope_table(HFHUBROPE, head_dim, 10000, 64);
+    Tensor x(batch, 1, seq, heads * head_dim, bn_, true);
+    fillRandom(x, 2);
+    vector<shared_ptr<Tensor>> rows;
+    for (int n = 0; n < batch; ++n) {
+        rows.push_back(std::make_shared<Tensor>(1, 1, seq, heads * head_dim, bn_, true));
+        copyRow(x, n, *rows.back());
+    }
+    rope_heads_fp32(&x, head_dim, *table, positions, 2);
+    for (int n = 0; n < batch; ++n) {
+        rope_heads_fp32(rows[n].get(), head_dim, *table, positions[n], 2);
+        expectRow(x, n, *rows[n]);
+    }
+}
+
+// rows of a batch padded to the longest, e.g. a decode step (q_len 1) or a prefill chunk (q_len 3)
+static const vector<int> k_lens = {9, 4, 6};
+
+TEST_F(CPUTest, SequenceBatchSoftmax) {
+    const int heads = 2, k_max = 9;
+    for (int q_len : {1, 3}) {
+        Tensor input(3, heads, q_len, k_max, bn_, true);
+        Tensor output(3, heads, q_len, k_max, bn_, true);
+        fillRandom(input, 3);
+        softmax_fp32(&input, &output, 0.5f, true, 2, k_lens);
+        for (int n = 0; n < 3; ++n) {
+            Tensor row(1, heads, q_len, k_lens[n], bn_, true);
+            Tensor row_out(1, heads, q_len, k_lens[n], bn_, true);
+            copyRow(input, n, row);
+            softmax_fp32(&row, &row_out, 0.5f, true, 2);
+            expectRow(output, n, row_out);
+            // the padding keys get no weight
+            for (int h = 0; h < heads; ++h) {
+                for (int s = 0; s < q_len; ++s) {
+                    for (int d = k_lens[n]; d < k_max; ++d) {
+                        ASSERT_EQ(output.dataAt<float>(n, h, s, d), 0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// scores = Q x K^T, each query up to its own last key
+TEST_F(CPUTest, SequenceBatchMatmulScores) {
+    const int heads = 2, dim = 32, k_max = 9;
+    for (auto k_type : {MLLM_TYPE_F32, MLLM_TYPE_F16}) {
+        for (int q_len : {1, 3}) {
+            Tensor q(3, heads, q_len, dim, bn_, true);
+            Tensor k_f32(3, heads, k_max, dim, bn_, true);
+            fillRandom(q, 4);
+            fillRandom(k_f32, 5);
+            Tensor k(bn_);
+            k.setDtype(k_type);
+            k.reshape(3, heads, k_max, dim);
+            k.alloc();
+            for (int i = 0; i < k.count(); ++i) {
+                if (k_type == MLLM_TYPE_F16) {
+                    k.hostPtr<mllm_fp16_t>()[i] = MLLM_FP32_TO_FP16(k_f32.hostPtr<float>()[i]);
+                } else {
+                    k.hostPtr<float>()[i] = k_f32.hostPtr<float>()[i];
+                }
+            }
+            Tensor scores(3, heads, q_len, k_max, bn_, true);
+            auto matmul = [&](Tensor &q, Tensor &k, Tensor &out, const vector<int> &lens) {
+                if (k_type == MLLM_TYPE_F16) {
+                    mat_mul_fp32_fp16(&q, &k, &out, false, nullptr, false, true, 2, nullptr, CAUSAL_MM_OUTPUT, lens);
+                } else {
+                    mat_mul_fp32(&q, &k, &out, false, nullptr, false, true, 2, CAUSAL_MM_OUTPUT, lens);
+                }
+            };
+            matmul(q, k, scores, k_lens);
+            for (int n = 0; n < 3; ++n) {
+                Tensor row_q(1, heads, q_len, dim, bn_, true);
+                Tensor row_k(bn_);
+                row_k.setDtype(k_type);
+                row_k.reshape(1, heads, k_lens[n], dim);
+                row_k.alloc();
+                Tensor row_scores(1, heads, q_len, k_lens[n], bn_, true);
+                copyRow(q, n, row_q);
+                if (k_type == MLLM_TYPE_F16) {
+                    copyRow<mllm_fp16_t>(k, n, row_k);
+                } else {
+                    copyRow(k, n, row_k);
+                }
+                matmul(row_q, row_k, row_scores, {});
+                // the later columns are left unwritten
+                expectRow(scores, n, row_scores, [&](int s) { return s + k_lens[n] - q_len + 1; });
+            }
+        }
+    }
+}
+
+// out = P x V, each query reducing over its own keys only
+TEST_F(CPUTest, SequenceBatchMatmulValues) {
+    const int heads = 2, dim = 32, k_max = 9;
+    for (int q_len : {1, 3}) {
+        Tensor p(3, heads, q_len, k_max, bn_, true);
+        Tensor v(3, heads, k_max, dim, bn_, true);
+        Tensor out(3, heads, q_len, dim, bn_, true);
+        fillRandom(p, 6);
+        fillRandom(v, 7);
+        mat_mul_fp32(&p, &v, &out, false, nullptr, false, false, 2, CAUSAL_MM_INPUT0, k_lens);
+        for (int n = 0; n < 3; ++n) {
+            Tensor row_p(1, heads, q_len, k_lens[n], bn_, true);
+            Tensor row_v(1, heads, k_lens[n], dim, bn_, true);
+            Tensor row_out(1, heads, q_len, dim, bn_, true);
+            copyRow(p, n, row_p);
+            copyRow(v, n, row_v);
+            mat_mul_fp32(&row_p, &row_v, &row_out, false, nullptr, false, false, 2, CAUSAL_MM_INPUT0);
+            expectRow(out, n, row_out);
+        }
+    }
+}